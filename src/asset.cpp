@@ -0,0 +1,228 @@
+#include "asset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static inline uint64_t AlignAssetOffset(uint64_t offset) {
+    return (offset + ASSET_BLOB_ALIGNMENT - 1) & ~(uint64_t)(ASSET_BLOB_ALIGNMENT - 1);
+}
+
+// The blob [offset, offset + bytes) lies in the file and starts on ASSET_BLOB_ALIGNMENT
+static bool CheckAssetBlob(const AssetFile *asset, uint64_t offset, uint64_t bytes) {
+    if (offset % ASSET_BLOB_ALIGNMENT != 0) return false;
+    return offset <= asset->size && bytes <= asset->size - offset;
+}
+
+static bool CheckAssetFile(const AssetFile *asset, const char *fileName) {
+    const AssetHeader *header = asset->header;
+
+    if (asset->size < sizeof(AssetHeader) || header->magic != ASSET_MAGIC) {
+        printf("%s is not a mesh asset file\n", fileName);
+        return false;
+    }
+
+    if (header->version != ASSET_VERSION || header->vertexStride != sizeof(BatchVertex)) {
+        printf("%s: asset version %u (vertex stride %u), expected %i (%i), convert it again\n", fileName,
+               header->version, header->vertexStride, ASSET_VERSION, (int)sizeof(BatchVertex));
+        return false;
+    }
+
+    if (header->fileSize != asset->size ||
+        (asset->size - sizeof(AssetHeader)) / sizeof(AssetMeshEntry) < header->meshCount) {
+        printf("%s: asset file truncated, %zu bytes\n", fileName, asset->size);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        const AssetMeshEntry *entry = &asset->meshes[i];
+        bool valid = entry->name[ASSET_NAME_LENGTH - 1] == '\0' &&
+                     CheckAssetBlob(asset, entry->vertexOffset, (uint64_t)entry->vertexCount * sizeof(BatchVertex));
+
+        if (valid && entry->indicesCount > 0) {
+            valid = (entry->indexSize == 2 && entry->vertexCount <= 65536) || entry->indexSize == 4;
+            valid = valid && CheckAssetBlob(asset, entry->indexOffset, (uint64_t)entry->indicesCount * entry->indexSize);
+        }
+
+        if (!valid) {
+            printf("%s: mesh %u has an invalid blob range\n", fileName, i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+AssetFile *OpenAssetFile(const char *fileName) {
+    int fd = open(fileName, O_RDONLY);
+
+    if (fd == -1) {
+        printf("%s Asset file could not be opened\n", fileName);
+        return NULL;
+    }
+
+    struct stat info;
+    void *data = MAP_FAILED;
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        printf("%s Asset file could not be mapped\n", fileName);
+        return NULL;
+    }
+
+    AssetFile *asset = (AssetFile *)malloc(sizeof(AssetFile));
+
+    asset->data = (const unsigned char *)data;
+    asset->size = (size_t)info.st_size;
+    asset->header = (const AssetHeader *)data;
+    asset->meshes = (const AssetMeshEntry *)(asset->data + sizeof(AssetHeader));
+
+    if (!CheckAssetFile(asset, fileName)) {
+        CloseAssetFile(asset);
+        return NULL;
+    }
+
+    // Every blob gets uploaded soon, start reading all of them ahead instead of faulting page by page
+    madvise(data, asset->size, MADV_WILLNEED);
+
+    return asset;
+}
+
+void CloseAssetFile(AssetFile *asset) {
+    if (asset == NULL) return;
+
+    munmap((void *)asset->data, asset->size);
+    free(asset);
+}
+
+int FindAssetMesh(const AssetFile *asset, const char *name) {
+    for (uint32_t i = 0; i < asset->header->meshCount; i++) {
+        if (strcmp(asset->meshes[i].name, name) == 0) return (int)i;
+    }
+
+    return -1;
+}
+
+PackedMesh GetAssetPackedMesh(const AssetFile *asset, int index) {
+    const AssetMeshEntry *entry = &asset->meshes[index];
+    PackedMesh packed = { 0 };
+
+    packed.vertices = (const BatchVertex *)(asset->data + entry->vertexOffset);
+    packed.vertexCount = (int)entry->vertexCount;
+    packed.translucent = entry->translucent != 0;
+    packed.hash = entry->hash;
+
+    if (entry->indicesCount > 0) {
+        packed.indices = asset->data + entry->indexOffset;
+        packed.indicesCount = (int)entry->indicesCount;
+        packed.indexType = entry->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    return packed;
+}
+
+unsigned int LoadAssetMesh(const AssetFile *asset, int index, Mesh *mesh) {
+    const AssetMeshEntry *entry = &asset->meshes[index];
+    const PackedMesh packed = GetAssetPackedMesh(asset, index);
+
+    *mesh = { 0 };
+    mesh->vertexCount = packed.vertexCount * 3;
+    mesh->indicesCount = packed.indicesCount;
+    mesh->triangleCount = (packed.indicesCount > 0 ? packed.indicesCount : packed.vertexCount) / 3;
+    mesh->boundsMin = glm::vec3(entry->boundsMin[0], entry->boundsMin[1], entry->boundsMin[2]);
+    mesh->boundsMax = glm::vec3(entry->boundsMax[0], entry->boundsMax[1], entry->boundsMax[2]);
+
+    unsigned int registryId = UploadPackedMesh(mesh, &packed);
+    if (registryId == 0) *mesh = { 0 }; // Registry full, nothing to draw
+
+    return registryId;
+}
+
+bool WriteAssetFile(const char *fileName, const Mesh *meshes, const char *const *names, int meshCount) {
+    AssetMeshEntry *entries = (AssetMeshEntry *)calloc(meshCount > 0 ? meshCount : 1, sizeof(AssetMeshEntry));
+    uint64_t offset = AlignAssetOffset(sizeof(AssetHeader) + meshCount * sizeof(AssetMeshEntry));
+
+    // Layout first, the whole file is then built in one buffer
+    for (int i = 0; i < meshCount; i++) {
+        const Mesh *mesh = &meshes[i];
+        AssetMeshEntry *entry = &entries[i];
+
+        strncpy(entry->name, names[i], ASSET_NAME_LENGTH - 1);
+        entry->vertexCount = mesh->vertexCount / 3;
+        entry->vertexOffset = offset;
+        offset = AlignAssetOffset(offset + (uint64_t)entry->vertexCount * sizeof(BatchVertex));
+
+        if (mesh->indices != NULL && mesh->indicesCount > 0) {
+            entry->indicesCount = mesh->indicesCount;
+            entry->indexSize = entry->vertexCount <= 65536 ? 2 : 4;
+            entry->indexOffset = offset;
+            offset = AlignAssetOffset(offset + (uint64_t)entry->indicesCount * entry->indexSize);
+        }
+    }
+
+    unsigned char *data = (unsigned char *)calloc(offset, 1);
+    AssetHeader *header = (AssetHeader *)data;
+
+    header->magic = ASSET_MAGIC;
+    header->version = ASSET_VERSION;
+    header->meshCount = meshCount;
+    header->vertexStride = sizeof(BatchVertex);
+    header->fileSize = offset;
+
+    for (int i = 0; i < meshCount; i++) {
+        Mesh mesh = meshes[i];
+        AssetMeshEntry *entry = &entries[i];
+        BatchVertex *vertices = (BatchVertex *)(data + entry->vertexOffset);
+
+        entry->translucent = PackMeshVertices(vertices, &mesh) ? 1 : 0;
+
+        for (uint32_t j = 0; j < entry->indicesCount; j++) {
+            if (entry->indexSize == 2) ((uint16_t *)(data + entry->indexOffset))[j] = (uint16_t)mesh.indices[j];
+            else ((uint32_t *)(data + entry->indexOffset))[j] = (uint32_t)mesh.indices[j];
+        }
+
+        // Same key as UploadMesh, an asset mesh shares the registry slot of the same geometry created at runtime
+        PackedMesh packed = { 0 };
+        packed.vertices = vertices;
+        packed.vertexCount = (int)entry->vertexCount;
+
+        if (entry->indicesCount > 0) {
+            packed.indices = data + entry->indexOffset;
+            packed.indicesCount = (int)entry->indicesCount;
+            packed.indexType = entry->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        }
+
+        entry->hash = HashPackedMesh(&packed);
+
+        ComputeMeshBounds(&mesh);
+        for (int axis = 0; axis < 3; axis++) {
+            entry->boundsMin[axis] = mesh.boundsMin[axis];
+            entry->boundsMax[axis] = mesh.boundsMax[axis];
+        }
+    }
+
+    memcpy(data + sizeof(AssetHeader), entries, meshCount * sizeof(AssetMeshEntry));
+    free(entries);
+
+    FILE *file = fopen(fileName, "wb");
+    bool written = false;
+
+    if (file != NULL) {
+        written = fwrite(data, 1, offset, file) == offset;
+        written = fclose(file) == 0 && written;
+    }
+
+    if (!written) printf("%s Asset file could not be written\n", fileName);
+
+    free(data);
+    return written;
+}
@@ -0,0 +1,57 @@
+#ifndef CGAME_ENGINE_ASSET_H
+#define CGAME_ENGINE_ASSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#if !defined(COD3R_GL_IMPLEMENTATION)
+    #include "cod3rGL.h" // for Mesh, BatchVertex and PackedMesh
+#endif
+
+#define ASSET_MAGIC 0x414d4743 // "CGMA" read as a little endian uint32
+#define ASSET_VERSION 2 // Bumped with every layout change, older files have to be converted again
+#define ASSET_BLOB_ALIGNMENT 64 // Vertex and index blobs start on a cache line
+#define ASSET_NAME_LENGTH 48 // Mesh names, null terminated
+
+// Mesh asset file: header, mesh table, then the blobs of every mesh. Little endian, every field naturally aligned.
+typedef struct AssetHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t vertexStride;      // sizeof(BatchVertex) the file was written with
+    uint64_t fileSize;
+} AssetHeader;
+
+typedef struct AssetMeshEntry {
+    char name[ASSET_NAME_LENGTH];
+    uint64_t hash;              // Content hash of both blobs, the registry key of the mesh
+    uint64_t vertexOffset;      // From the start of the file, vertexCount BatchVertex
+    uint64_t indexOffset;       // From the start of the file, 0 when the mesh is not indexed
+    uint32_t vertexCount;
+    uint32_t indicesCount;
+    uint32_t indexSize;         // 2 under 65536 vertices, 4 otherwise
+    uint32_t translucent;       // A vertex color has alpha < 1
+    float boundsMin[3];         // Local AABB, see ComputeMeshBounds
+    float boundsMax[3];
+} AssetMeshEntry;
+
+// File mapped read only: the blobs are used in place, nothing is parsed or copied on load
+typedef struct AssetFile {
+    const unsigned char *data;
+    size_t size;
+    const AssetHeader *header;
+    const AssetMeshEntry *meshes;
+} AssetFile;
+
+AssetFile *OpenAssetFile(const char *fileName); // Maps the file and checks the header and every blob range, NULL on error
+void CloseAssetFile(AssetFile *asset); // Meshes loaded from it stay valid
+int FindAssetMesh(const AssetFile *asset, const char *name); // Index of the mesh called `name`, -1 when missing
+PackedMesh GetAssetPackedMesh(const AssetFile *asset, int index); // Points into the mapping, valid until CloseAssetFile
+// Fills counts and bounds of `mesh` and uploads its blobs to the mesh registry straight from the mapping.
+// The mesh has no CPU geometry, it is drawn by DrawMesh until UnloadMesh. GL thread only.
+// Returns 0 and leaves `mesh` empty when the registry is full.
+unsigned int LoadAssetMesh(const AssetFile *asset, int index, Mesh *mesh);
+
+// Packs `meshCount` meshes in GPU layout and writes them to `fileName`, used by the offline converter
+bool WriteAssetFile(const char *fileName, const Mesh *meshes, const char *const *names, int meshCount);
+
+#endif // CGAME_ENGINE_ASSET_H
@@ -0,0 +1,382 @@
+#include "atlas.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+void InitAtlasPacker(AtlasPacker *packer, int size) {
+    packer->nodes = (AtlasSkylineNode *)malloc((size + 1) * sizeof(AtlasSkylineNode));
+    packer->nodes[0].x = 0;
+    packer->nodes[0].y = 0;
+    packer->nodes[0].width = size;
+    packer->nodeCount = 1;
+    packer->size = size;
+}
+
+void FreeAtlasPacker(AtlasPacker *packer) {
+    free(packer->nodes);
+    packer->nodes = NULL;
+    packer->nodeCount = 0;
+}
+
+// Lowest y a `width` wide rectangle can sit at with its left edge on node `index`, -1 when it does not fit
+static int FitAtlasSkyline(const AtlasPacker *packer, int index, int width, int height) {
+    const int x = packer->nodes[index].x;
+    if (x + width > packer->size) return -1;
+
+    int y = 0;
+    int remaining = width;
+
+    for (int i = index; remaining > 0; i++) {
+        if (packer->nodes[i].y > y) y = packer->nodes[i].y;
+        if (y + height > packer->size) return -1;
+
+        remaining -= packer->nodes[i].width;
+    }
+
+    return y;
+}
+
+bool PackAtlasRect(AtlasPacker *packer, int width, int height, int *x, int *y) {
+    int bestIndex = -1;
+    int bestY = INT_MAX;
+    int bestWidth = INT_MAX;
+
+    // Lowest top edge first, the narrowest node on a tie wastes the least of the skyline
+    for (int i = 0; i < packer->nodeCount; i++) {
+        const int fit = FitAtlasSkyline(packer, i, width, height);
+        if (fit == -1) continue;
+
+        if (fit < bestY || (fit == bestY && packer->nodes[i].width < bestWidth)) {
+            bestIndex = i;
+            bestY = fit;
+            bestWidth = packer->nodes[i].width;
+        }
+    }
+
+    if (bestIndex == -1) return false;
+
+    AtlasSkylineNode *nodes = packer->nodes;
+    *x = nodes[bestIndex].x;
+    *y = bestY;
+
+    memmove(&nodes[bestIndex + 1], &nodes[bestIndex], (packer->nodeCount - bestIndex) * sizeof(AtlasSkylineNode));
+    nodes[bestIndex].y = bestY + height;
+    nodes[bestIndex].width = width;
+    packer->nodeCount++;
+
+    // Nodes now under the rectangle are cut at its right edge, or dropped
+    for (int i = bestIndex + 1; i < packer->nodeCount; ) {
+        const int covered = nodes[i - 1].x + nodes[i - 1].width - nodes[i].x;
+        if (covered <= 0) break;
+
+        if (covered < nodes[i].width) {
+            nodes[i].x += covered;
+            nodes[i].width -= covered;
+            break;
+        }
+
+        memmove(&nodes[i], &nodes[i + 1], (packer->nodeCount - i - 1) * sizeof(AtlasSkylineNode));
+        packer->nodeCount--;
+    }
+
+    for (int i = 0; i + 1 < packer->nodeCount; ) {
+        if (nodes[i].y != nodes[i + 1].y) {
+            i++;
+            continue;
+        }
+
+        nodes[i].width += nodes[i + 1].width;
+        memmove(&nodes[i + 1], &nodes[i + 2], (packer->nodeCount - i - 2) * sizeof(AtlasSkylineNode));
+        packer->nodeCount--;
+    }
+
+    return true;
+}
+
+TextureAtlas *CreateTextureAtlas(int pageSize, int maxPages, int padding) {
+    if (pageSize <= 0 || pageSize > ATLAS_MAX_PAGE_SIZE || (pageSize & (pageSize - 1)) != 0 || maxPages <= 0 || padding < 0) {
+        printf("Invalid atlas: %i texel pages (power of two up to %i), %i pages, %i padding\n", pageSize, ATLAS_MAX_PAGE_SIZE, maxPages, padding);
+        return NULL;
+    }
+
+    TextureAtlas *atlas = (TextureAtlas *)calloc(1, sizeof(TextureAtlas));
+    atlas->pageSize = pageSize;
+    atlas->maxPages = maxPages;
+    atlas->padding = padding;
+    atlas->packers = (AtlasPacker *)calloc(maxPages, sizeof(AtlasPacker));
+    atlas->pixels = (unsigned char **)calloc(maxPages, sizeof(unsigned char *));
+    atlas->dirty = (bool *)calloc(maxPages, sizeof(bool));
+
+    return atlas;
+}
+
+void DestroyTextureAtlas(TextureAtlas *atlas) {
+    if (atlas == NULL) return;
+
+    for (int i = 0; i < atlas->pageCount; i++) {
+        FreeAtlasPacker(&atlas->packers[i]);
+        free(atlas->pixels[i]);
+    }
+
+    UnloadTextureArray(atlas->textureId);
+
+    free(atlas->packers);
+    free(atlas->pixels);
+    free(atlas->dirty);
+    free(atlas->regions);
+    free(atlas);
+}
+
+static bool OpenAtlasPage(TextureAtlas *atlas) {
+    if (atlas->pageCount == atlas->maxPages) return false;
+
+    const int page = atlas->pageCount++;
+    InitAtlasPacker(&atlas->packers[page], atlas->pageSize);
+    atlas->pixels[page] = (unsigned char *)calloc((size_t)atlas->pageSize * atlas->pageSize, 4);
+    atlas->dirty[page] = true;
+
+    return true;
+}
+
+// The image at (x, y) of the page, surrounded by `padding` texels repeating its edges
+static void CopyAtlasImage(TextureAtlas *atlas, int page, int x, int y, const unsigned char *rgba, int width, int height) {
+    const int padding = atlas->padding;
+    unsigned char *pixels = atlas->pixels[page];
+
+    for (int row = -padding; row < height + padding; row++) {
+        const int srcRow = row < 0 ? 0 : (row >= height ? height - 1 : row);
+        unsigned char *dst = pixels + ((size_t)(y + row) * atlas->pageSize + x - padding) * 4;
+        const unsigned char *src = rgba + (size_t)srcRow * width * 4;
+
+        for (int column = -padding; column < 0; column++, dst += 4) memcpy(dst, src, 4);
+
+        memcpy(dst, src, (size_t)width * 4);
+        dst += (size_t)width * 4;
+
+        for (int column = 0; column < padding; column++, dst += 4) memcpy(dst, src + (size_t)(width - 1) * 4, 4);
+    }
+}
+
+int AddAtlasImage(TextureAtlas *atlas, const char *name, const unsigned char *rgba, int width, int height) {
+    const int paddedWidth = width + atlas->padding * 2;
+    const int paddedHeight = height + atlas->padding * 2;
+
+    if (width <= 0 || height <= 0 || paddedWidth > atlas->pageSize || paddedHeight > atlas->pageSize) {
+        printf("Atlas image %s is %ix%i, pages are %i texels\n", name != NULL ? name : "", width, height, atlas->pageSize);
+        return -1;
+    }
+
+    int page = 0;
+    int x = 0;
+    int y = 0;
+
+    while (page < atlas->pageCount && !PackAtlasRect(&atlas->packers[page], paddedWidth, paddedHeight, &x, &y)) page++;
+
+    if (page == atlas->pageCount && !(OpenAtlasPage(atlas) && PackAtlasRect(&atlas->packers[page], paddedWidth, paddedHeight, &x, &y))) {
+        printf("Atlas full, %i pages, image %s dropped\n", atlas->maxPages, name != NULL ? name : "");
+        return -1;
+    }
+
+    x += atlas->padding;
+    y += atlas->padding;
+    CopyAtlasImage(atlas, page, x, y, rgba, width, height);
+    atlas->dirty[page] = true;
+
+    if (atlas->regionCount == atlas->regionCapacity) {
+        atlas->regionCapacity = atlas->regionCapacity == 0 ? 64 : atlas->regionCapacity * 2;
+        atlas->regions = (AtlasRegion *)realloc(atlas->regions, atlas->regionCapacity * sizeof(AtlasRegion));
+    }
+
+    AtlasRegion *region = &atlas->regions[atlas->regionCount];
+    memset(region, 0, sizeof(AtlasRegion));
+    if (name != NULL) strncpy(region->name, name, ATLAS_NAME_LENGTH - 1);
+
+    region->page = page;
+    region->x = x;
+    region->y = y;
+    region->width = width;
+    region->height = height;
+
+    // Power of two pages: every texel edge is exact, in floats and in the half floats of the batch
+    const float scale = 1.0f / atlas->pageSize;
+    region->uv[0] = x * scale;
+    region->uv[1] = y * scale;
+    region->uv[2] = (x + width) * scale;
+    region->uv[3] = (y + height) * scale;
+
+    for (int i = 0; i < width * height && !region->translucent; i++) region->translucent = rgba[i * 4 + 3] != 0xff;
+
+    return atlas->regionCount++;
+}
+
+int FindAtlasRegion(const TextureAtlas *atlas, const char *name) {
+    for (int i = 0; i < atlas->regionCount; i++) {
+        if (strncmp(atlas->regions[i].name, name, ATLAS_NAME_LENGTH) == 0) return i;
+    }
+
+    return -1;
+}
+
+const AtlasRegion *GetAtlasRegion(const TextureAtlas *atlas, int region) {
+    if (region < 0 || region >= atlas->regionCount) return NULL;
+
+    return &atlas->regions[region];
+}
+
+double GetAtlasOccupancy(const TextureAtlas *atlas) {
+    if (atlas->pageCount == 0) return 0.0;
+
+    double packed = 0.0;
+
+    for (int i = 0; i < atlas->regionCount; i++) {
+        packed += (double)(atlas->regions[i].width + atlas->padding * 2) * (atlas->regions[i].height + atlas->padding * 2);
+    }
+
+    return packed / ((double)atlas->pageSize * atlas->pageSize * atlas->pageCount);
+}
+
+bool UploadTextureAtlas(TextureAtlas *atlas) {
+    if (atlas->pageCount == 0) return false;
+
+    // Texture arrays cannot grow, new pages mean a new texture with every page in it
+    if (atlas->textureId == 0 || atlas->textureLayers < atlas->pageCount) {
+        UnloadTextureArray(atlas->textureId);
+        atlas->textureId = CreateTextureArray(atlas->pageSize, atlas->pageCount, NULL);
+        atlas->textureLayers = atlas->pageCount;
+
+        for (int i = 0; i < atlas->pageCount; i++) atlas->dirty[i] = true;
+    }
+
+    for (int i = 0; i < atlas->pageCount; i++) {
+        if (!atlas->dirty[i]) continue;
+
+        UpdateTextureArrayLayer(atlas->textureId, atlas->pageSize, i, atlas->pixels[i]);
+        atlas->dirty[i] = false;
+    }
+
+    return atlas->textureId != 0;
+}
+
+void DrawSprite(const TextureAtlas *atlas, int region, const glm::mat4 &matrix, const Vector4 *color) {
+    if (atlas->textureId == 0 || region < 0 || region >= atlas->regionCount) return;
+
+    const AtlasRegion *sprite = &atlas->regions[region];
+    DrawTexturedQuad(atlas->textureId, sprite->page, sprite->uv, sprite->translucent != 0, matrix, color);
+}
+
+bool WriteAtlasFile(const TextureAtlas *atlas, const char *fileName) {
+    FILE *file = fopen(fileName, "wb");
+
+    if (file == NULL) {
+        printf("%s Atlas file could not be opened\n", fileName);
+        return false;
+    }
+
+    AtlasFileHeader header = { 0 };
+    header.magic = ATLAS_MAGIC;
+    header.version = ATLAS_VERSION;
+    header.pageSize = atlas->pageSize;
+    header.pageCount = atlas->pageCount;
+    header.padding = atlas->padding;
+    header.regionCount = atlas->regionCount;
+
+    const size_t pageBytes = (size_t)atlas->pageSize * atlas->pageSize * 4;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (atlas->regionCount > 0) written = written && fwrite(atlas->regions, sizeof(AtlasRegion), atlas->regionCount, file) == (size_t)atlas->regionCount;
+
+    for (int i = 0; i < atlas->pageCount && written; i++) {
+        const AtlasPacker *packer = &atlas->packers[i];
+        const int32_t nodeCount = packer->nodeCount;
+
+        written = fwrite(&nodeCount, sizeof(nodeCount), 1, file) == 1 &&
+                  fwrite(packer->nodes, sizeof(AtlasSkylineNode), nodeCount, file) == (size_t)nodeCount &&
+                  fwrite(atlas->pixels[i], pageBytes, 1, file) == 1;
+    }
+
+    written = fclose(file) == 0 && written;
+    if (!written) printf("%s Atlas file could not be written\n", fileName);
+
+    return written;
+}
+
+// Nodes have to cover the page width left to right, the packer walks them without bounds checks
+static bool CheckAtlasSkyline(const AtlasPacker *packer) {
+    int x = 0;
+
+    for (int i = 0; i < packer->nodeCount; i++) {
+        const AtlasSkylineNode *node = &packer->nodes[i];
+        if (node->x != x || node->width <= 0 || node->y < 0 || node->y > packer->size) return false;
+
+        x += node->width;
+    }
+
+    return x == packer->size;
+}
+
+static bool CheckAtlasRegion(const TextureAtlas *atlas, const AtlasRegion *region) {
+    return region->name[ATLAS_NAME_LENGTH - 1] == '\0' && region->page >= 0 && region->page < atlas->pageCount &&
+           region->x >= 0 && region->y >= 0 && region->width > 0 && region->height > 0 &&
+           region->x + region->width <= atlas->pageSize && region->y + region->height <= atlas->pageSize;
+}
+
+TextureAtlas *LoadAtlasFile(const char *fileName, int maxPages) {
+    FILE *file = fopen(fileName, "rb");
+
+    if (file == NULL) {
+        printf("%s Atlas file could not be opened\n", fileName);
+        return NULL;
+    }
+
+    AtlasFileHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == ATLAS_MAGIC;
+
+    if (!valid || header.version != ATLAS_VERSION) {
+        printf("%s Not an atlas file, or an unsupported version (bake it again)\n", fileName);
+        fclose(file);
+        return NULL;
+    }
+
+    TextureAtlas *atlas = NULL;
+    if (header.pageCount >= 0 && header.regionCount >= 0) {
+        atlas = CreateTextureAtlas(header.pageSize, maxPages > header.pageCount ? maxPages : (header.pageCount > 0 ? header.pageCount : 1), header.padding);
+    }
+
+    if (atlas == NULL) {
+        printf("%s Atlas file has an invalid header\n", fileName);
+        fclose(file);
+        return NULL;
+    }
+
+    atlas->regionCapacity = header.regionCount;
+    atlas->regions = (AtlasRegion *)malloc((header.regionCount + 1) * sizeof(AtlasRegion));
+    atlas->regionCount = header.regionCount;
+    valid = fread(atlas->regions, sizeof(AtlasRegion), header.regionCount, file) == (size_t)header.regionCount;
+
+    const size_t pageBytes = (size_t)atlas->pageSize * atlas->pageSize * 4;
+
+    for (int i = 0; i < header.pageCount && valid; i++) {
+        OpenAtlasPage(atlas);
+        AtlasPacker *packer = &atlas->packers[i];
+
+        int32_t nodeCount = 0;
+        valid = fread(&nodeCount, sizeof(nodeCount), 1, file) == 1 && nodeCount > 0 && nodeCount <= atlas->pageSize + 1 &&
+                fread(packer->nodes, sizeof(AtlasSkylineNode), nodeCount, file) == (size_t)nodeCount &&
+                fread(atlas->pixels[i], pageBytes, 1, file) == 1;
+
+        packer->nodeCount = valid ? nodeCount : 1;
+        valid = valid && CheckAtlasSkyline(packer);
+    }
+
+    for (int i = 0; i < atlas->regionCount && valid; i++) valid = CheckAtlasRegion(atlas, &atlas->regions[i]);
+
+    fclose(file);
+
+    if (!valid) {
+        printf("%s Atlas file is truncated or corrupt\n", fileName);
+        DestroyTextureAtlas(atlas);
+        return NULL;
+    }
+
+    return atlas;
+}
@@ -0,0 +1,97 @@
+#ifndef CGAME_ENGINE_ATLAS_H
+#define CGAME_ENGINE_ATLAS_H
+
+#include <stdint.h>
+#if !defined(COD3R_GL_IMPLEMENTATION)
+    #include "cod3rGL.h" // for DrawTexturedQuad and the texture arrays
+#endif
+
+#define ATLAS_MAGIC 0x41544743 // "CGTA" read as a little endian uint32
+#define ATLAS_VERSION 1
+#define ATLAS_MAX_PAGE_SIZE 2048 // Power of two pages up to it have exact texel edges in the half float texcoords
+#define ATLAS_NAME_LENGTH 48 // Region names, null terminated
+
+// Images are packed into square pages, the pages are the layers of one texture array. Sprites of the same page
+// share a batch, thousands of them are drawn with one draw call per page:
+//
+//   TextureAtlas *atlas = CreateTextureAtlas(1024, 4, 1);
+//   int ship = AddAtlasImage(atlas, "ship", pixels, 32, 32);
+//   UploadTextureAtlas(atlas); // GL thread, after adding images
+//   DrawSprite(atlas, ship, matrix, NULL);
+//
+// Shipping builds load the pages baked by cgame_atlas_baker with LoadAtlasFile instead.
+
+// Skyline segment: the packed area ends at `y` over [x, x + width)
+typedef struct AtlasSkylineNode {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+} AtlasSkylineNode;
+
+// Bottom-left skyline packer of one page, its nodes cover the page width left to right
+typedef struct AtlasPacker {
+    AtlasSkylineNode *nodes;    // size + 1 at most
+    int nodeCount;
+    int size;
+} AtlasPacker;
+
+typedef struct AtlasRegion {
+    char name[ATLAS_NAME_LENGTH];
+    int32_t page;               // Layer of the texture array
+    int32_t x;                  // Texels of the image in the page, padding excluded
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    float uv[4];                // u0, v0 (top left) then u1, v1 (bottom right), v goes down like every engine texture
+    uint32_t translucent;       // A texel has alpha < 255
+} AtlasRegion;
+
+typedef struct TextureAtlas {
+    int pageSize;               // Texels per side, power of two
+    int pageCount;
+    int maxPages;
+    int padding;                // Texels repeated around every image, linear filtering never reaches a neighbour
+    AtlasPacker *packers;       // One per page
+    unsigned char **pixels;     // RGBA8 copy of every page, kept to upload again and to bake
+    bool *dirty;                // Page changed since UploadTextureAtlas
+    AtlasRegion *regions;
+    int regionCount;
+    int regionCapacity;
+    unsigned int textureId;     // GL_TEXTURE_2D_ARRAY, 0 until UploadTextureAtlas
+    int textureLayers;          // Layers of textureId, it is created again when pages were added
+} TextureAtlas;
+
+// Packer alone, for callers laying out their own pages
+void InitAtlasPacker(AtlasPacker *packer, int size);
+void FreeAtlasPacker(AtlasPacker *packer);
+bool PackAtlasRect(AtlasPacker *packer, int width, int height, int *x, int *y); // Lowest place it fits, false when full
+
+TextureAtlas *CreateTextureAtlas(int pageSize, int maxPages, int padding); // NULL when pageSize is not a power of two up to ATLAS_MAX_PAGE_SIZE
+void DestroyTextureAtlas(TextureAtlas *atlas); // GL thread once uploaded, the texture is deleted
+// Copies `width` x `height` RGBA8 texels (top row first) into the first page with room, a new page is opened when none
+// has. Returns the region index, -1 when the image does not fit in maxPages.
+int AddAtlasImage(TextureAtlas *atlas, const char *name, const unsigned char *rgba, int width, int height);
+int FindAtlasRegion(const TextureAtlas *atlas, const char *name); // Index of the region called `name`, -1 when missing
+const AtlasRegion *GetAtlasRegion(const TextureAtlas *atlas, int region);
+double GetAtlasOccupancy(const TextureAtlas *atlas); // Packed texels (padding included) over the texels of the pages
+bool UploadTextureAtlas(TextureAtlas *atlas); // GL thread, sends the pages changed since the last call
+
+// Sprite batching: unit quad like CreateRect showing the region, NULL color is white. Sprites drawn before the atlas
+// is uploaded are skipped.
+void DrawSprite(const TextureAtlas *atlas, int region, const glm::mat4 &matrix, const Vector4 *color);
+
+// Atlas file: AtlasFileHeader, regionCount AtlasRegion, then for every page its skyline nodes and RGBA8 texels.
+// Loaded atlases keep their packers, images can still be added up to `maxPages`.
+typedef struct AtlasFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t pageSize;
+    int32_t pageCount;
+    int32_t padding;
+    int32_t regionCount;
+} AtlasFileHeader;
+
+bool WriteAtlasFile(const TextureAtlas *atlas, const char *fileName); // Used by the offline baker
+TextureAtlas *LoadAtlasFile(const char *fileName, int maxPages); // NULL when the file is missing or invalid
+
+#endif // CGAME_ENGINE_ATLAS_H
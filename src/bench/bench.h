@@ -0,0 +1,27 @@
+#ifndef CGAME_ENGINE_BENCH_H
+#define CGAME_ENGINE_BENCH_H
+
+#include <stdint.h>
+#include "../profiler.h" // ProfileNowNs, the clock of every bench timing
+
+// Every metric is printed as one "scenario,metric,value" CSV line on stdout
+void ReportBenchMetric(const char *scenario, const char *metric, double value);
+
+// Scenarios
+void BenchTransform();
+void BenchEcs();
+void BenchBatch();
+void BenchQueue();
+void BenchJobs();
+void BenchCulling();
+void BenchTerrain();
+void BenchAsset();
+void BenchProfiler();
+void BenchInput();
+void BenchCamera(); // Scenarios below need the GL context created by cgame_bench
+void BenchShader();
+void BenchReplay();
+void BenchAtlas();
+void BenchGeometry();
+
+#endif // CGAME_ENGINE_BENCH_H
@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "../cod3rGL.h"
+#include "../asset.h"
+#include "bench.h"
+
+#define BENCH_ASSET_MESHES 256
+#define BENCH_ASSET_QUADS 32 // Grid quads per mesh side, 1089 vertices and 6144 indices per mesh
+#define BENCH_ASSET_RUNS 10
+#define BENCH_ASSET_FILE "cgame_bench_asset.cga"
+
+static volatile unsigned int benchAssetSink; // Keeps the reads of both paths from being optimised out
+
+// Reads one byte per page, what the driver copy would fault in
+static unsigned int TouchBlob(const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    unsigned int sum = 0;
+
+    for (size_t i = 0; i < size; i += 4096) sum += bytes[i];
+
+    return sum;
+}
+
+// Grid of BENCH_ASSET_QUADS^2 quads with a different height per mesh, so no two meshes share a hash
+static void CreateBenchGrid(Mesh *mesh, int seed) {
+    const int side = BENCH_ASSET_QUADS + 1;
+    const int vertexCount = side * side;
+
+    *mesh = { 0 };
+    mesh->vertexCount = vertexCount * 3;
+    mesh->indicesCount = BENCH_ASSET_QUADS * BENCH_ASSET_QUADS * 6;
+    mesh->triangleCount = mesh->indicesCount / 3;
+    mesh->vertices = (float *)malloc(mesh->vertexCount * sizeof(float));
+    mesh->colors = (float *)malloc(vertexCount * 4 * sizeof(float));
+    mesh->texcoords = (float *)malloc(vertexCount * 2 * sizeof(float));
+    mesh->indices = (int *)malloc(mesh->indicesCount * sizeof(int));
+
+    for (int z = 0; z < side; z++) {
+        for (int x = 0; x < side; x++) {
+            const int i = z * side + x;
+
+            mesh->vertices[i * 3] = (float)x;
+            mesh->vertices[i * 3 + 1] = (float)((x * 7 + z * 13 + seed) % 17) * 0.1f;
+            mesh->vertices[i * 3 + 2] = (float)z;
+            mesh->colors[i * 4] = x / (float)side;
+            mesh->colors[i * 4 + 1] = z / (float)side;
+            mesh->colors[i * 4 + 2] = 0.5f;
+            mesh->colors[i * 4 + 3] = 1.0f;
+            mesh->texcoords[i * 2] = x / (float)BENCH_ASSET_QUADS;
+            mesh->texcoords[i * 2 + 1] = z / (float)BENCH_ASSET_QUADS;
+        }
+    }
+
+    int *index = mesh->indices;
+    for (int z = 0; z < BENCH_ASSET_QUADS; z++) {
+        for (int x = 0; x < BENCH_ASSET_QUADS; x++) {
+            const int corner = z * side + x;
+
+            *index++ = corner;
+            *index++ = corner + side;
+            *index++ = corner + 1;
+            *index++ = corner + 1;
+            *index++ = corner + side;
+            *index++ = corner + side + 1;
+        }
+    }
+}
+
+// Loads 256 meshes both ways, up to the point where UploadMesh / UploadPackedMesh would call glBufferData:
+// packing the CPU meshes to the GPU layout, and mapping the asset file and reading its blobs in place.
+void BenchAsset() {
+    Mesh *meshes = (Mesh *)malloc(BENCH_ASSET_MESHES * sizeof(Mesh));
+    const char **names = (const char **)malloc(BENCH_ASSET_MESHES * sizeof(const char *));
+    char (*nameData)[ASSET_NAME_LENGTH] = (char (*)[ASSET_NAME_LENGTH])malloc(BENCH_ASSET_MESHES * ASSET_NAME_LENGTH);
+
+    for (int i = 0; i < BENCH_ASSET_MESHES; i++) {
+        CreateBenchGrid(&meshes[i], i);
+        snprintf(nameData[i], ASSET_NAME_LENGTH, "grid%i", i);
+        names[i] = nameData[i];
+    }
+
+    uint64_t start = ProfileNowNs();
+    bool written = WriteAssetFile(BENCH_ASSET_FILE, meshes, names, BENCH_ASSET_MESHES);
+    uint64_t writeNs = ProfileNowNs() - start;
+
+    if (!written) return;
+
+    const int vertexCount = (BENCH_ASSET_QUADS + 1) * (BENCH_ASSET_QUADS + 1);
+    BatchVertex *vertices = (BatchVertex *)malloc(vertexCount * sizeof(BatchVertex));
+    unsigned short *indices = (unsigned short *)malloc(meshes[0].indicesCount * sizeof(unsigned short));
+    unsigned int checksum = 0;
+    uint64_t packNs = 0;
+    uint64_t mappedNs = 0;
+    size_t fileSize = 0;
+
+    for (int run = 0; run < BENCH_ASSET_RUNS; run++) {
+        start = ProfileNowNs();
+        for (int i = 0; i < BENCH_ASSET_MESHES; i++) {
+            PackMeshVertices(vertices, &meshes[i]);
+            for (int j = 0; j < meshes[i].indicesCount; j++) indices[j] = (unsigned short)meshes[i].indices[j];
+            checksum += TouchBlob(vertices, vertexCount * sizeof(BatchVertex)) + indices[0];
+        }
+        packNs += ProfileNowNs() - start;
+
+        start = ProfileNowNs();
+        AssetFile *asset = OpenAssetFile(BENCH_ASSET_FILE);
+        for (int i = 0; i < BENCH_ASSET_MESHES; i++) {
+            const PackedMesh packed = GetAssetPackedMesh(asset, i);
+            checksum += TouchBlob(packed.vertices, packed.vertexCount * sizeof(BatchVertex));
+            checksum += TouchBlob(packed.indices, packed.indicesCount * sizeof(unsigned short));
+        }
+        fileSize = asset->size;
+        CloseAssetFile(asset);
+        mappedNs += ProfileNowNs() - start;
+    }
+
+    // Asset meshes get the registry key of the same geometry uploaded at runtime, with its 32-bit indices
+    int matchingHashes = 0;
+    AssetFile *asset = OpenAssetFile(BENCH_ASSET_FILE);
+    for (int i = 0; i < BENCH_ASSET_MESHES; i++) {
+        PackedMesh packed = { 0 };
+        packed.vertices = vertices;
+        packed.vertexCount = vertexCount;
+        packed.indices = meshes[i].indices;
+        packed.indicesCount = meshes[i].indicesCount;
+        packed.indexType = GL_UNSIGNED_INT;
+        PackMeshVertices(vertices, &meshes[i]);
+
+        if (HashPackedMesh(&packed) == GetAssetPackedMesh(asset, i).hash) matchingHashes++;
+    }
+    CloseAssetFile(asset);
+
+    benchAssetSink = checksum;
+    remove(BENCH_ASSET_FILE);
+
+    ReportBenchMetric("asset", "meshes", BENCH_ASSET_MESHES);
+    ReportBenchMetric("asset", "file_mb", fileSize / (1024.0 * 1024.0));
+    ReportBenchMetric("asset", "write_ms", writeNs / 1e6);
+    ReportBenchMetric("asset", "pack_ms", packNs / 1e6 / BENCH_ASSET_RUNS);
+    ReportBenchMetric("asset", "mapped_ms", mappedNs / 1e6 / BENCH_ASSET_RUNS);
+    ReportBenchMetric("asset", "mapped_speedup", (double)packNs / (mappedNs > 0 ? mappedNs : 1));
+    ReportBenchMetric("asset", "registry_hash_matches", (double)matchingHashes / BENCH_ASSET_MESHES);
+
+    for (int i = 0; i < BENCH_ASSET_MESHES; i++) {
+        free(meshes[i].vertices);
+        free(meshes[i].colors);
+        free(meshes[i].texcoords);
+        free(meshes[i].indices);
+    }
+
+    free(vertices);
+    free(indices);
+    free(nameData);
+    free(names);
+    free(meshes);
+}
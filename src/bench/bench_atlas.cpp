@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "../cod3rGL.h"
+#include "../atlas.h"
+#include "bench.h"
+
+#define BENCH_ATLAS_IMAGES 1024 // Distinct images, 8 to 64 texels per side
+#define BENCH_ATLAS_PAGE_SIZE 1024
+#define BENCH_ATLAS_MAX_PAGES 16
+#define BENCH_ATLAS_SPRITES 20000 // Per frame, every image drawn about 20 times
+#define BENCH_ATLAS_FRAMES 10
+#define BENCH_ATLAS_FILE "cgame_bench_atlas.cgta"
+#define BENCH_ATLAS_CAPTURE "cgame_bench_atlas.cgfc"
+
+// Solid color per image, every 8th one half transparent
+static unsigned int GetBenchImageColor(int image) {
+    const unsigned int hash = (unsigned int)image * 2654435761u;
+    const unsigned int alpha = image % 8 == 7 ? 0x80 : 0xff;
+
+    return (hash & 0x00ffffff) | (alpha << 24);
+}
+
+static TextureAtlas *BuildBenchAtlas(uint64_t *packNs) {
+    TextureAtlas *atlas = CreateTextureAtlas(BENCH_ATLAS_PAGE_SIZE, BENCH_ATLAS_MAX_PAGES, 1);
+    unsigned int *pixels = (unsigned int *)malloc(64 * 64 * sizeof(unsigned int));
+    unsigned int seed = 12345;
+    char name[ATLAS_NAME_LENGTH];
+
+    *packNs = 0;
+
+    for (int i = 0; i < BENCH_ATLAS_IMAGES; i++) {
+        seed = seed * 1103515245u + 12345u;
+        const int width = 8 + (seed >> 16) % 57;
+        seed = seed * 1103515245u + 12345u;
+        const int height = 8 + (seed >> 16) % 57;
+
+        const unsigned int color = GetBenchImageColor(i);
+        for (int p = 0; p < width * height; p++) pixels[p] = color; // R in the lowest byte, RGBA8 in memory
+        snprintf(name, sizeof(name), "image_%i", i);
+
+        uint64_t start = ProfileNowNs();
+        AddAtlasImage(atlas, name, (const unsigned char *)pixels, width, height);
+        *packNs += ProfileNowNs() - start;
+    }
+
+    free(pixels);
+    return atlas;
+}
+
+// Regions and pages of the baked file are the ones packed at runtime
+static bool MatchBenchAtlas(const TextureAtlas *a, const TextureAtlas *b) {
+    if (a->pageCount != b->pageCount || a->regionCount != b->regionCount) return false;
+    if (memcmp(a->regions, b->regions, a->regionCount * sizeof(AtlasRegion)) != 0) return false;
+
+    for (int i = 0; i < a->pageCount; i++) {
+        if (memcmp(a->pixels[i], b->pixels[i], (size_t)a->pageSize * a->pageSize * 4) != 0) return false;
+    }
+
+    return true;
+}
+
+static void DrawBenchSprites(const TextureAtlas *atlas) {
+    for (int i = 0; i < BENCH_ATLAS_SPRITES; i++) {
+        const glm::vec3 position = glm::vec3((float)(i % 200) - 100.0f, (float)(i / 200) - 50.0f, -20.0f);
+        DrawSprite(atlas, i % atlas->regionCount, glm::translate(glm::mat4(1.0f), position), NULL);
+    }
+}
+
+// Packing, bake round trip, then thousands of differently textured sprites per frame (needs a current GL context)
+void BenchAtlas() {
+    uint64_t packNs = 0;
+    TextureAtlas *atlas = BuildBenchAtlas(&packNs);
+
+    uint64_t start = ProfileNowNs();
+    bool baked = WriteAtlasFile(atlas, BENCH_ATLAS_FILE);
+    TextureAtlas *loaded = baked ? LoadAtlasFile(BENCH_ATLAS_FILE, BENCH_ATLAS_MAX_PAGES) : NULL;
+    uint64_t bakeNs = ProfileNowNs() - start;
+    remove(BENCH_ATLAS_FILE);
+
+    ReportBenchMetric("atlas", "images", atlas->regionCount);
+    ReportBenchMetric("atlas", "pages", atlas->pageCount);
+    ReportBenchMetric("atlas", "occupancy", GetAtlasOccupancy(atlas));
+    ReportBenchMetric("atlas", "pack_us_per_image", packNs / 1e3 / BENCH_ATLAS_IMAGES);
+    ReportBenchMetric("atlas", "bake_round_trip_ms", bakeNs / 1e6);
+    ReportBenchMetric("atlas", "baked_match", loaded != NULL && MatchBenchAtlas(atlas, loaded) ? 1.0 : 0.0);
+
+    if (glGenBuffers == NULL) {
+        ReportBenchMetric("atlas", "skipped_no_gl_context", 1.0);
+        DestroyTextureAtlas(atlas);
+        DestroyTextureAtlas(loaded);
+        return;
+    }
+
+    InitCod3rGL(64, 64);
+    SetupCamera(glm::vec3(0.0f, 0.0f, 60.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+
+    start = ProfileNowNs();
+    UploadTextureAtlas(loaded);
+    glFinish();
+    uint64_t uploadNs = ProfileNowNs() - start;
+
+    // The first frames create the batch streams
+    uint64_t frameNs = 0;
+    RenderStats stats = { 0 };
+
+    for (int frame = 0; frame < BENCH_ATLAS_FRAMES + 2; frame++) {
+        start = ProfileNowNs();
+        DrawBenchSprites(loaded);
+        RenderCod3rGL();
+        glFinish();
+
+        if (frame >= 2) frameNs += ProfileNowNs() - start;
+        stats = GetRenderStats();
+    }
+
+    // One sprite covering the target, its texels have to reach the framebuffer
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    DrawSprite(loaded, 0, glm::scale(glm::mat4(1.0f), glm::vec3(100.0f)), NULL);
+    RenderCod3rGL();
+
+    unsigned int pixel = 0;
+    glReadPixels(32, 32, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixel);
+
+    // Captured with the texture, replayed on a texture created from the capture
+    CaptureNextFrame(BENCH_ATLAS_CAPTURE);
+    DrawBenchSprites(loaded);
+    RenderCod3rGL();
+    DrawBenchSprites(loaded);
+    RenderCod3rGL();
+    RenderStats live = GetRenderStats();
+
+    FrameCapture *capture = LoadFrameCapture(BENCH_ATLAS_CAPTURE);
+    RenderStats replayed = { 0 };
+    if (capture != NULL && PrepareFrameCapture(capture)) replayed = ReplayFrameCapture(capture, COMMAND_BACKEND_GL);
+    remove(BENCH_ATLAS_CAPTURE);
+
+    ReportBenchMetric("atlas", "upload_ms", uploadNs / 1e6);
+    ReportBenchMetric("atlas", "sprites_per_frame", BENCH_ATLAS_SPRITES);
+    ReportBenchMetric("atlas", "draw_calls", stats.drawCalls);
+    ReportBenchMetric("atlas", "frame_ms", frameNs / 1e6 / BENCH_ATLAS_FRAMES);
+    ReportBenchMetric("atlas", "sprite_pixel_match", pixel == GetBenchImageColor(0) ? 1.0 : 0.0);
+    ReportBenchMetric("atlas", "replay_draw_calls", replayed.drawCalls);
+    ReportBenchMetric("atlas", "replay_vertices_match", replayed.verticesDrawn == live.verticesDrawn ? 1.0 : 0.0);
+
+    FreeFrameCapture(capture);
+    DestroyTextureAtlas(atlas);
+    DestroyTextureAtlas(loaded);
+    CleanCod3rGL();
+}
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "../cod3rGL.h"
+#include "bench.h"
+
+#define BENCH_BATCH_QUADS 1000000
+#define BENCH_BATCH_FRAMES 3
+
+static const int batchSizes[] = { 4096, STREAM_REGION_VERTICES, 65536, 262144 };
+
+// Submits 1M quads per frame through the batcher for several batch sizes (needs a current GL context)
+void BenchBatch() {
+    if (glGenBuffers == NULL) {
+        ReportBenchMetric("batch", "skipped_no_gl_context", 1.0);
+        return;
+    }
+
+    Vector4 color = { 0.72f, 0.55f, 0.9f, 1.0f };
+    Entity quad = CreateRect(&color, glm::vec3(0.0f));
+
+    for (unsigned int b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++) {
+        char scenario[64];
+        snprintf(scenario, sizeof(scenario), "batch_%i", batchSizes[b]);
+
+        InitCod3rGLEx(64, 64, batchSizes[b]);
+        SetupCamera(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+
+        uint64_t submitNs = 0;
+        uint64_t renderNs = 0;
+
+        for (int frame = 0; frame < BENCH_BATCH_FRAMES; frame++) {
+            uint64_t start = ProfileNowNs();
+
+            for (int i = 0; i < BENCH_BATCH_QUADS; i++) {
+                quad.matrix[3][0] = (float)(i % 1000) - 500.0f;
+                quad.matrix[3][1] = (float)(i / 1000) - 500.0f;
+                DrawEntity(quad);
+            }
+
+            uint64_t submitted = ProfileNowNs();
+            RenderCod3rGL();
+            glFinish();
+
+            submitNs += submitted - start;
+            renderNs += ProfileNowNs() - submitted;
+        }
+
+        RenderStats stats = GetRenderStats();
+        ReportBenchMetric(scenario, "quads", BENCH_BATCH_QUADS);
+        ReportBenchMetric(scenario, "draw_calls", stats.drawCalls);
+        ReportBenchMetric(scenario, "mb_uploaded", stats.bytesUploaded / (1024.0 * 1024.0));
+        ReportBenchMetric(scenario, "submit_ns_per_entity", (double)submitNs / ((double)BENCH_BATCH_QUADS * BENCH_BATCH_FRAMES));
+        ReportBenchMetric(scenario, "submit_ms", submitNs / 1e6 / BENCH_BATCH_FRAMES);
+        ReportBenchMetric(scenario, "render_ms", renderNs / 1e6 / BENCH_BATCH_FRAMES);
+
+        CleanCod3rGL();
+    }
+
+    free(quad.meshes[0].colors);
+    free(quad.meshes);
+}
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "../cod3rGL.h"
+#include "../ecs.h"
+#include "bench.h"
+
+#define BENCH_CAMERA_COLUMNS 400
+#define BENCH_CAMERA_ROWS 250 // 100k rects, 2 world units apart on the XY plane
+#define BENCH_CAMERA_FRAMES 120
+#define BENCH_CAMERA_HEIGHT 40.0f // Camera distance to the plane
+
+// Sweeps the camera across a world of rects: SubmitMeshSystem culls through the BVH and fills the batches,
+// RenderCod3rGL sorts and uploads them (needs a current GL context)
+void BenchCamera() {
+    if (glGenBuffers == NULL) {
+        ReportBenchMetric("camera", "skipped_no_gl_context", 1.0);
+        return;
+    }
+
+    const int entityCount = BENCH_CAMERA_COLUMNS * BENCH_CAMERA_ROWS;
+    Vector4 color = { 0.33f, 0.7f, 0.52f, 1.0f };
+    Entity rect = CreateRect(&color, glm::vec3(0.0f));
+    World *world = CreateWorld();
+
+    for (int i = 0; i < entityCount; i++) {
+        const float x = (float)(i % BENCH_CAMERA_COLUMNS - BENCH_CAMERA_COLUMNS / 2) * 2.0f;
+        const float y = (float)(i / BENCH_CAMERA_COLUMNS - BENCH_CAMERA_ROWS / 2) * 2.0f;
+
+        rect.matrix = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+        SpawnEntity(world, rect, false);
+    }
+
+    UpdateWorldTransforms(world);
+    InitCod3rGL(512, 512);
+
+    uint64_t submitNs = 0;
+    uint64_t renderNs = 0;
+    long long bytesUploaded = 0;
+    long long drawCalls = 0;
+    long long uniformBytes = 0;
+    long long visible = 0;
+    long long culled = 0;
+
+    for (int frame = 0; frame < BENCH_CAMERA_FRAMES; frame++) {
+        // Left to right over the grid, turning from looking ahead-left to ahead-right
+        const float t = frame / (float)(BENCH_CAMERA_FRAMES - 1);
+        const glm::vec3 position = glm::vec3((t - 0.5f) * BENCH_CAMERA_COLUMNS * 2.0f, 0.0f, BENCH_CAMERA_HEIGHT);
+
+        SetupCamera(position, glm::vec3(0.0f, 1.0f, 0.0f), -90.0f - 30.0f + t * 60.0f, -20.0f);
+
+        uint64_t start = ProfileNowNs();
+        SubmitMeshSystem(world);
+        uint64_t submitted = ProfileNowNs();
+        RenderCod3rGL();
+        glFinish();
+
+        submitNs += submitted - start;
+        renderNs += ProfileNowNs() - submitted;
+
+        RenderStats stats = GetRenderStats();
+        CullStats cull = GetWorldCullStats(world);
+        bytesUploaded += stats.bytesUploaded;
+        drawCalls += stats.drawCalls;
+        uniformBytes += stats.uniformBytes;
+        visible += cull.visible;
+        culled += cull.culled;
+    }
+
+    ReportBenchMetric("camera", "entities", entityCount);
+    ReportBenchMetric("camera", "visible_per_frame", (double)visible / BENCH_CAMERA_FRAMES);
+    ReportBenchMetric("camera", "culled_per_frame", (double)culled / BENCH_CAMERA_FRAMES);
+    ReportBenchMetric("camera", "draw_calls_per_frame", (double)drawCalls / BENCH_CAMERA_FRAMES);
+    ReportBenchMetric("camera", "mb_uploaded_per_frame", bytesUploaded / (1024.0 * 1024.0) / BENCH_CAMERA_FRAMES);
+    ReportBenchMetric("camera", "uniform_bytes_per_frame", (double)uniformBytes / BENCH_CAMERA_FRAMES);
+    ReportBenchMetric("camera", "submit_ns_per_entity", (double)submitNs / ((double)entityCount * BENCH_CAMERA_FRAMES));
+    ReportBenchMetric("camera", "frame_ns_per_visible", (double)(submitNs + renderNs) / (visible > 0 ? visible : 1));
+    ReportBenchMetric("camera", "frame_ms", (submitNs + renderNs) / 1e6 / BENCH_CAMERA_FRAMES);
+
+    CleanCod3rGL();
+    DestroyWorld(world);
+    free(rect.meshes[0].colors);
+    free(rect.meshes);
+}
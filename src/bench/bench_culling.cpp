@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include "../cod3rGL.h"
+#include "../culling.h"
+#include "bench.h"
+
+#define BENCH_CULLING_BOXES 100000
+#define BENCH_CULLING_FRAMES 20
+#define BENCH_CULLING_MOVES 1000 // Boxes moved between frames
+#define BENCH_CULLING_MARGIN 0.1f
+
+static float RandomRange(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+// Culls 100k boxes scattered around a camera, through the BVH and by testing every box
+void BenchCulling() {
+    glm::vec3 *mins = (glm::vec3 *)malloc(BENCH_CULLING_BOXES * sizeof(glm::vec3));
+    glm::vec3 *maxs = (glm::vec3 *)malloc(BENCH_CULLING_BOXES * sizeof(glm::vec3));
+    int *proxies = (int *)malloc(BENCH_CULLING_BOXES * sizeof(int));
+    int *results = (int *)malloc(BENCH_CULLING_BOXES * sizeof(int));
+
+    BoundingVolumeHierarchy *bvh = CreateBVH(BENCH_CULLING_MARGIN);
+
+    srand(1);
+    uint64_t start = ProfileNowNs();
+    for (int i = 0; i < BENCH_CULLING_BOXES; i++) {
+        glm::vec3 center(RandomRange(-500.0f, 500.0f), RandomRange(-50.0f, 50.0f), RandomRange(-500.0f, 500.0f));
+        glm::vec3 extent(RandomRange(0.5f, 2.0f));
+
+        mins[i] = center - extent;
+        maxs[i] = center + extent;
+        proxies[i] = CreateBVHProxy(bvh, mins[i], maxs[i], i);
+    }
+    uint64_t buildNs = ProfileNowNs() - start;
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    CullStats stats = { 0 };
+    uint64_t moveNs = 0;
+    uint64_t bvhNs = 0;
+    uint64_t bruteNs = 0;
+    int bruteVisible = 0;
+
+    for (int frame = 0; frame < BENCH_CULLING_FRAMES; frame++) {
+        float yaw = frame * 0.3f;
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(glm::cos(yaw), 0.0f, glm::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = MakeFrustum(projection * view);
+
+        start = ProfileNowNs();
+        for (int i = 0; i < BENCH_CULLING_MOVES; i++) {
+            int box = rand() % BENCH_CULLING_BOXES;
+            glm::vec3 offset(RandomRange(-0.2f, 0.2f), 0.0f, RandomRange(-0.2f, 0.2f));
+
+            mins[box] += offset;
+            maxs[box] += offset;
+            MoveBVHProxy(bvh, proxies[box], mins[box], maxs[box]);
+        }
+        moveNs += ProfileNowNs() - start;
+
+        start = ProfileNowNs();
+        QueryBVHFrustum(bvh, &frustum, results, &stats);
+        bvhNs += ProfileNowNs() - start;
+
+        start = ProfileNowNs();
+        bruteVisible = 0;
+        for (int i = 0; i < BENCH_CULLING_BOXES; i++) {
+            if (TestFrustumAABB(&frustum, mins[i], maxs[i]) != CULL_OUTSIDE) results[bruteVisible++] = i;
+        }
+        bruteNs += ProfileNowNs() - start;
+    }
+
+    ReportBenchMetric("culling", "boxes", BENCH_CULLING_BOXES);
+    ReportBenchMetric("culling", "bvh_height", GetBVHHeight(bvh));
+    ReportBenchMetric("culling", "build_ms", buildNs / 1e6);
+    ReportBenchMetric("culling", "move_us", moveNs / 1e3 / BENCH_CULLING_FRAMES);
+    ReportBenchMetric("culling", "visible", stats.visible);
+    ReportBenchMetric("culling", "culled", stats.culled);
+    ReportBenchMetric("culling", "nodes_tested", stats.nodesTested);
+    ReportBenchMetric("culling", "bvh_query_ms", bvhNs / 1e6 / BENCH_CULLING_FRAMES);
+    ReportBenchMetric("culling", "brute_visible", bruteVisible);
+    ReportBenchMetric("culling", "brute_ms", bruteNs / 1e6 / BENCH_CULLING_FRAMES);
+
+    DestroyBVH(bvh);
+    free(results);
+    free(proxies);
+    free(maxs);
+    free(mins);
+}
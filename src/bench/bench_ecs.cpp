@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "../cod3rGL.h"
+#include "../ecs.h"
+#include "bench.h"
+
+#define BENCH_ECS_ENTITIES 100000
+#define BENCH_ECS_FRAMES 50
+#define BENCH_ECS_CHURN 10000
+
+void BenchEcs() {
+    World *world = CreateWorld();
+    int spinComponent = RegisterComponent(world, sizeof(float));
+    EntityHandle *handles = (EntityHandle *)malloc(BENCH_ECS_ENTITIES * sizeof(EntityHandle));
+
+    ComponentMask mask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_COLOR) | COMPONENT_BIT(spinComponent);
+
+    uint64_t start = ProfileNowNs();
+    for (int i = 0; i < BENCH_ECS_ENTITIES; i++) {
+        handles[i] = CreateWorldEntity(world, mask);
+        *(glm::mat4 *)GetWorldComponent(world, handles[i], COMPONENT_TRANSFORM) = glm::translate(glm::mat4(1.0f), glm::vec3((float)i, 0.0f, 0.0f));
+        *(float *)GetWorldComponent(world, handles[i], spinComponent) = 1.0f;
+    }
+    ReportBenchMetric("ecs_create", "ns_per_entity", (double)(ProfileNowNs() - start) / BENCH_ECS_ENTITIES);
+
+    start = ProfileNowNs();
+    for (int frame = 0; frame < BENCH_ECS_FRAMES; frame++) {
+        RotateZSystem(world, spinComponent, 1.0f);
+    }
+    ReportBenchMetric("ecs_rotate_system", "ns_per_entity", (double)(ProfileNowNs() - start) / ((double)BENCH_ECS_ENTITIES * BENCH_ECS_FRAMES));
+
+    // Reference: the same work through loose Entity structs
+    Entity *entities = (Entity *)malloc(BENCH_ECS_ENTITIES * sizeof(Entity));
+    for (int i = 0; i < BENCH_ECS_ENTITIES; i++) {
+        entities[i].matrix = glm::translate(glm::mat4(1.0f), glm::vec3((float)i, 0.0f, 0.0f));
+        entities[i].meshCount = 0;
+        entities[i].meshes = NULL;
+    }
+
+    start = ProfileNowNs();
+    for (int frame = 0; frame < BENCH_ECS_FRAMES; frame++) {
+        for (int i = 0; i < BENCH_ECS_ENTITIES; i++) RotateEntityZ(&entities[i], 1.0f);
+    }
+    ReportBenchMetric("entity_rotate_loop", "ns_per_entity", (double)(ProfileNowNs() - start) / ((double)BENCH_ECS_ENTITIES * BENCH_ECS_FRAMES));
+
+    start = ProfileNowNs();
+    for (int i = 0; i < BENCH_ECS_CHURN; i++) {
+        int slot = rand() % BENCH_ECS_ENTITIES;
+        DestroyWorldEntity(world, handles[slot]);
+        handles[slot] = CreateWorldEntity(world, mask);
+    }
+    ReportBenchMetric("ecs_destroy_create", "ns_per_op", (double)(ProfileNowNs() - start) / BENCH_ECS_CHURN);
+
+    start = ProfileNowNs();
+    for (int i = 0; i < BENCH_ECS_CHURN; i++) {
+        int slot = rand() % BENCH_ECS_ENTITIES;
+        RemoveWorldComponent(world, handles[slot], spinComponent);
+        AddWorldComponent(world, handles[slot], spinComponent);
+    }
+    ReportBenchMetric("ecs_remove_add_component", "ns_per_op", (double)(ProfileNowNs() - start) / BENCH_ECS_CHURN);
+
+    ReportBenchMetric("ecs", "entities", world->entityCount);
+
+    free(entities);
+    free(handles);
+    DestroyWorld(world);
+}
@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "../cod3rGL.h"
+#include "bench.h"
+
+#define BENCH_GEOMETRY_MESHES 1000 // Distinct registry meshes, grids of 1 to 6 cells per side
+#define BENCH_GEOMETRY_FRAMES 10
+#define BENCH_GEOMETRY_PIXELS (64 * 64) // Whole bench render target
+#define BENCH_GEOMETRY_BIG_VERTICES 40000 // Vertices of the meshes filling an arena for the automatic compaction
+#define BENCH_GEOMETRY_FILE "cgame_bench_geometry.cgfc"
+
+static Mesh CreateBenchGridMesh(int cells, unsigned int seed) {
+    Mesh mesh = { 0 };
+    const int side = cells + 1;
+
+    mesh.vertexCount = side * side * 3;
+    mesh.indicesCount = cells * cells * 6;
+    mesh.triangleCount = cells * cells * 2;
+    mesh.vertices = (float *)malloc(mesh.vertexCount * sizeof(float));
+    mesh.colors = (float *)malloc(side * side * 4 * sizeof(float));
+    mesh.indices = (int *)malloc(mesh.indicesCount * sizeof(int));
+
+    // One color per mesh, every mesh has its own content
+    const float red = (float)(seed % 97) / 96.0f;
+    const float green = (float)(seed % 89) / 88.0f;
+    const float blue = (float)(seed % 83) / 82.0f;
+
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            const int v = y * side + x;
+            mesh.vertices[v * 3] = (float)x / cells - 0.5f;
+            mesh.vertices[v * 3 + 1] = (float)y / cells - 0.5f;
+            mesh.vertices[v * 3 + 2] = 0.0f;
+
+            mesh.colors[v * 4] = red;
+            mesh.colors[v * 4 + 1] = green;
+            mesh.colors[v * 4 + 2] = blue;
+            mesh.colors[v * 4 + 3] = 1.0f;
+        }
+    }
+
+    int *index = mesh.indices;
+    for (int y = 0; y < cells; y++) {
+        for (int x = 0; x < cells; x++) {
+            const int v = y * side + x;
+            *index++ = v; *index++ = v + 1; *index++ = v + side;
+            *index++ = v + 1; *index++ = v + side + 1; *index++ = v + side;
+        }
+    }
+
+    ComputeMeshBounds(&mesh);
+    return mesh;
+}
+
+static void FreeBenchMesh(Mesh *mesh) {
+    UnloadMesh(mesh);
+    free(mesh->vertices);
+    free(mesh->colors);
+    free(mesh->indices);
+}
+
+// Moving meshes have a matrix each, static world meshes share the identity. Entity translations are scaled by
+// VERTEX_TRANSFORM_W, the 40 x 25 grid fills the view.
+static void DrawBenchGeometry(const Mesh *meshes, bool world) {
+    for (int i = 0; i < BENCH_GEOMETRY_MESHES; i++) {
+        if (meshes[i].registryId == 0) continue;
+
+        const glm::vec3 position = glm::vec3((float)(i % 40) - 20.0f, (float)(i / 40) - 12.5f, -20.0f) / VERTEX_TRANSFORM_W;
+        DrawMesh(&meshes[i], world ? glm::mat4(1.0f) : glm::translate(glm::mat4(1.0f), position));
+    }
+}
+
+static void RenderBenchImage(const Mesh *meshes, unsigned int *pixels) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    DrawBenchGeometry(meshes, false);
+    RenderCod3rGL();
+    glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+// One draw path: the registry meshes drawn from the arenas, rendered before and after a compaction and replayed
+static void BenchGeometryPath(const char *path, unsigned int *image) {
+    char metric[64];
+    Mesh *meshes = (Mesh *)malloc(BENCH_GEOMETRY_MESHES * sizeof(Mesh));
+
+    InitCod3rGL(64, 64);
+    SetupCamera(glm::vec3(0.0f, 0.0f, 60.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+
+    uint64_t start = ProfileNowNs();
+    for (int i = 0; i < BENCH_GEOMETRY_MESHES; i++) {
+        meshes[i] = CreateBenchGridMesh(1 + i % 6, i);
+        UploadMesh(&meshes[i]);
+    }
+    glFinish();
+    uint64_t uploadNs = ProfileNowNs() - start;
+
+    // The first frames fill the streaming regions
+    uint64_t frameNs = 0;
+    RenderStats moving = { 0 };
+
+    for (int frame = 0; frame < BENCH_GEOMETRY_FRAMES + 2; frame++) {
+        start = ProfileNowNs();
+        DrawBenchGeometry(meshes, false);
+        RenderCod3rGL();
+        glFinish();
+
+        if (frame >= 2) frameNs += ProfileNowNs() - start;
+        moving = GetRenderStats();
+    }
+
+    DrawBenchGeometry(meshes, true);
+    RenderCod3rGL();
+    RenderStats world = GetRenderStats();
+
+    RenderBenchImage(meshes, image);
+
+    // Every other mesh unloaded, the ones left render the same from the compacted arena
+    for (int i = 0; i < BENCH_GEOMETRY_MESHES; i += 2) UnloadMesh(&meshes[i]);
+    GeometryStats fragmented = GetGeometryStats();
+
+    unsigned int *before = (unsigned int *)malloc(BENCH_GEOMETRY_PIXELS * sizeof(unsigned int));
+    unsigned int *after = (unsigned int *)malloc(BENCH_GEOMETRY_PIXELS * sizeof(unsigned int));
+    RenderBenchImage(meshes, before);
+
+    start = ProfileNowNs();
+    CompactGeometryArenas();
+    glFinish();
+    uint64_t compactNs = ProfileNowNs() - start;
+
+    GeometryStats compacted = GetGeometryStats();
+    RenderBenchImage(meshes, after);
+
+    // Captured from the arenas, replayed on arenas created from the capture
+    CaptureNextFrame(BENCH_GEOMETRY_FILE);
+    DrawBenchGeometry(meshes, false);
+    RenderCod3rGL();
+    DrawBenchGeometry(meshes, false);
+    RenderCod3rGL();
+    RenderStats live = GetRenderStats();
+
+    FrameCapture *capture = LoadFrameCapture(BENCH_GEOMETRY_FILE);
+    RenderStats replayed = { 0 };
+    if (capture != NULL && PrepareFrameCapture(capture)) replayed = ReplayFrameCapture(capture, COMMAND_BACKEND_GL);
+    remove(BENCH_GEOMETRY_FILE);
+
+    snprintf(metric, sizeof(metric), "%s_draw_calls", path);
+    ReportBenchMetric("geometry", metric, moving.drawCalls);
+    snprintf(metric, sizeof(metric), "%s_world_draw_calls", path);
+    ReportBenchMetric("geometry", metric, world.drawCalls);
+    snprintf(metric, sizeof(metric), "%s_frame_ms", path);
+    ReportBenchMetric("geometry", metric, frameNs / 1e6 / BENCH_GEOMETRY_FRAMES);
+    snprintf(metric, sizeof(metric), "%s_upload_ms", path);
+    ReportBenchMetric("geometry", metric, uploadNs / 1e6);
+    snprintf(metric, sizeof(metric), "%s_free_spans_fragmented", path);
+    ReportBenchMetric("geometry", metric, fragmented.freeSpans);
+    snprintf(metric, sizeof(metric), "%s_free_spans_compacted", path);
+    ReportBenchMetric("geometry", metric, compacted.freeSpans);
+    snprintf(metric, sizeof(metric), "%s_compact_ms", path);
+    ReportBenchMetric("geometry", metric, compactNs / 1e6);
+    snprintf(metric, sizeof(metric), "%s_compaction_pixels_match", path);
+    ReportBenchMetric("geometry", metric, memcmp(before, after, BENCH_GEOMETRY_PIXELS * sizeof(unsigned int)) == 0 ? 1.0 : 0.0);
+    snprintf(metric, sizeof(metric), "%s_replay_draw_calls", path);
+    ReportBenchMetric("geometry", metric, replayed.drawCalls);
+    snprintf(metric, sizeof(metric), "%s_replay_vertices_match", path);
+    ReportBenchMetric("geometry", metric, replayed.verticesDrawn == live.verticesDrawn ? 1.0 : 0.0);
+
+    FreeFrameCapture(capture);
+    for (int i = 0; i < BENCH_GEOMETRY_MESHES; i++) FreeBenchMesh(&meshes[i]);
+    free(meshes);
+    free(before);
+    free(after);
+    CleanCod3rGL();
+}
+
+// Meshes only the holes of a full arena have room for, put together by the compaction UploadMesh starts
+static void BenchGeometryAutoCompaction() {
+    Mesh meshes[7];
+    InitCod3rGL(64, 64);
+
+    for (int i = 0; i < 7; i++) {
+        // Vertex heavy: one quad drawn, the other vertices only take arena space
+        meshes[i] = { 0 };
+        meshes[i].vertexCount = (i < 6 ? BENCH_GEOMETRY_BIG_VERTICES : BENCH_GEOMETRY_BIG_VERTICES * 3 / 2) * 3;
+        meshes[i].vertices = (float *)calloc(meshes[i].vertexCount, sizeof(float));
+        meshes[i].vertices[0] = (float)i; // Content differs, every mesh gets its own slot
+        meshes[i].indicesCount = 6;
+        meshes[i].indices = (int *)calloc(6, sizeof(int));
+        meshes[i].indices[1] = 1;
+        meshes[i].indices[2] = 2;
+    }
+
+    for (int i = 0; i < 6; i++) UploadMesh(&meshes[i]);
+    UnloadMesh(&meshes[1]);
+    UnloadMesh(&meshes[3]);
+
+    uint64_t start = ProfileNowNs();
+    UploadMesh(&meshes[6]);
+    glFinish();
+    uint64_t uploadNs = ProfileNowNs() - start;
+
+    GeometryStats stats = GetGeometryStats();
+
+    ReportBenchMetric("geometry", "auto_compactions", stats.compactions);
+    ReportBenchMetric("geometry", "auto_arenas", stats.arenas);
+    ReportBenchMetric("geometry", "auto_compacting_upload_ms", uploadNs / 1e6);
+
+    for (int i = 0; i < 7; i++) FreeBenchMesh(&meshes[i]);
+    CleanCod3rGL();
+}
+
+// Thousands of registry meshes drawn from shared arenas, with indirect draws then with base vertex multi-draws (needs a
+// current GL context)
+void BenchGeometry() {
+    if (glGenBuffers == NULL) {
+        ReportBenchMetric("geometry", "skipped_no_gl_context", 1.0);
+        return;
+    }
+
+    unsigned int *indirect = (unsigned int *)calloc(BENCH_GEOMETRY_PIXELS, sizeof(unsigned int));
+    unsigned int *baseVertex = (unsigned int *)calloc(BENCH_GEOMETRY_PIXELS, sizeof(unsigned int));
+    const int multiDrawIndirect = GLAD_GL_ARB_multi_draw_indirect;
+
+    ReportBenchMetric("geometry", "meshes", BENCH_GEOMETRY_MESHES);
+    ReportBenchMetric("geometry", "indirect_supported", multiDrawIndirect && GLAD_GL_ARB_base_instance ? 1.0 : 0.0);
+
+    if (multiDrawIndirect && GLAD_GL_ARB_base_instance) BenchGeometryPath("indirect", indirect);
+
+    // InitCod3rGL picks the path from the extension
+    GLAD_GL_ARB_multi_draw_indirect = 0;
+    BenchGeometryPath("base_vertex", baseVertex);
+    GLAD_GL_ARB_multi_draw_indirect = multiDrawIndirect;
+
+    if (multiDrawIndirect && GLAD_GL_ARB_base_instance) {
+        ReportBenchMetric("geometry", "paths_pixels_match", memcmp(indirect, baseVertex, BENCH_GEOMETRY_PIXELS * sizeof(unsigned int)) == 0 ? 1.0 : 0.0);
+    }
+
+    BenchGeometryAutoCompaction();
+
+    free(indirect);
+    free(baseVertex);
+}
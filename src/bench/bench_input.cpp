@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <thread>
+#include "../input.h"
+#include "bench.h"
+
+#define BENCH_INPUT_TAPS 200000 // Press and release pairs, plus one cursor move per tap
+#define BENCH_INPUT_FRAME_TAPS 50 // Taps between two consumes of the single thread run
+#define BENCH_INPUT_ACTION_TAP 0
+#define BENCH_INPUT_ACTION_LOOK 1
+#define BENCH_INPUT_KEY 32
+
+static void PushBenchTap(InputSystem *input, int i) {
+    InputEvent events[3] = {};
+    events[0].type = INPUT_EVENT_KEY;
+    events[0].code = BENCH_INPUT_KEY;
+    events[0].action = INPUT_PRESS;
+    events[1] = events[0];
+    events[1].action = INPUT_RELEASE;
+    events[2].type = INPUT_EVENT_CURSOR;
+    events[2].x = (double)i;
+
+    for (int e = 0; e < 3; e++) {
+        events[e].timeNs = ProfileNowNs();
+        while (!PushInputEvent(input, &events[e])) std::this_thread::yield(); // Full, wait for the consumer
+    }
+}
+
+// Stands in for the thread polling the window
+static void PushBenchTaps(InputSystem *input) {
+    for (int i = 0; i < BENCH_INPUT_TAPS; i++) PushBenchTap(input, i);
+}
+
+// Cost of the queue and the mapping, then taps pushed by another thread while this one consumes:
+// taps shorter than a frame must all come out as presses.
+void BenchInput() {
+    InputSystem *input = CreateInputSystem();
+    BindInput(input, BENCH_INPUT_ACTION_TAP, INPUT_SOURCE_KEY, BENCH_INPUT_KEY, 1.0f);
+    BindInput(input, BENCH_INPUT_ACTION_LOOK, INPUT_SOURCE_CURSOR_X, 0, 1.0f);
+
+    uint64_t pushNs = 0;
+    uint64_t consumeNs = 0;
+
+    for (int i = 0; i < BENCH_INPUT_TAPS; i += BENCH_INPUT_FRAME_TAPS) {
+        uint64_t start = ProfileNowNs();
+        for (int tap = i; tap < i + BENCH_INPUT_FRAME_TAPS; tap++) PushBenchTap(input, tap);
+        pushNs += ProfileNowNs() - start;
+
+        start = ProfileNowNs();
+        ConsumeInputEvents(input, ProfileNowNs());
+        consumeNs += ProfileNowNs() - start;
+    }
+
+    std::thread producer(PushBenchTaps, input);
+
+    long long taps = 0;
+    int consumed = 0;
+
+    while (consumed < BENCH_INPUT_TAPS * 3) {
+        const int count = ConsumeInputEvents(input, ProfileNowNs());
+        if (count == 0) std::this_thread::yield();
+        consumed += count;
+
+        taps += GetInputAction(input, BENCH_INPUT_ACTION_TAP)->pressed;
+    }
+
+    producer.join();
+
+    ReportBenchMetric("input", "push_ns_per_event", (double)pushNs / (BENCH_INPUT_TAPS * 3));
+    ReportBenchMetric("input", "consume_ns_per_event", (double)consumeNs / (BENCH_INPUT_TAPS * 3));
+    ReportBenchMetric("input", "threaded_taps_sent", BENCH_INPUT_TAPS);
+    ReportBenchMetric("input", "threaded_taps_seen", (double)taps);
+    ReportBenchMetric("input", "threaded_queue_full", input->dropped.load()); // Pushes retried, the producer outran the consumer
+
+    input->dropped.store(0);
+    DestroyInputSystem(input);
+}
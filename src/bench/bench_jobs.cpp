@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <thread>
+#include "../cod3rGL.h"
+#include "../jobs.h"
+#include "bench.h"
+
+#define BENCH_JOBS_ENTITIES 50000
+#define BENCH_JOBS_FRAMES 20
+#define BENCH_JOBS_BATCH_VERTICES 65536
+
+// 1, 2, 4... and the hardware thread count last
+static int NextThreadCount(int threads, int maxThreads) {
+    return threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2;
+}
+
+// Fills batches with 50k quads through FillBatchParallel for 1..N worker threads (no GL context needed)
+void BenchJobs() {
+    Vector4 color = { 0.72f, 0.55f, 0.9f, 1.0f };
+    Entity quad = CreateRect(&color, glm::vec3(0.0f));
+    Entity *entities = (Entity *)malloc(BENCH_JOBS_ENTITIES * sizeof(Entity));
+
+    for (int i = 0; i < BENCH_JOBS_ENTITIES; i++) {
+        entities[i] = quad;
+        entities[i].matrix = glm::translate(glm::mat4(1.0f), glm::vec3((float)(i % 250), (float)(i / 250), 0.0f));
+        entities[i].matrix = glm::rotate(entities[i].matrix, (float)i, glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    DynamicVBuffer vertices = { 0 };
+    DynamicIBuffer indices = { 0 };
+    vertices.data = (BatchVertex *)malloc(BENCH_JOBS_BATCH_VERTICES * sizeof(BatchVertex));
+    indices.data = (int *)malloc(BENCH_JOBS_BATCH_VERTICES * 3 * sizeof(int));
+
+    int maxThreads = (int)std::thread::hardware_concurrency();
+    if (maxThreads < 2) maxThreads = 2;
+
+    double singleThreadMs = 0.0;
+
+    for (int threads = 1; threads <= maxThreads; threads = NextThreadCount(threads, maxThreads)) {
+        char scenario[64];
+        snprintf(scenario, sizeof(scenario), "jobs_%i", threads);
+
+        JobSystem *jobs = CreateJobSystem(threads);
+        uint64_t fillNs = 0;
+        int batches = 0;
+
+        for (int frame = 0; frame < BENCH_JOBS_FRAMES; frame++) {
+            uint64_t start = ProfileNowNs();
+            int stored = 0;
+
+            // A full batch is thrown away where DrawEntitiesParallel would flush it
+            while (stored < BENCH_JOBS_ENTITIES) {
+                vertices.vertexCount = 0;
+                indices.vertexCount = 0;
+                indices.triangleCount = 0;
+
+                stored += FillBatchParallel(jobs, &vertices, &indices, BENCH_JOBS_BATCH_VERTICES, BENCH_JOBS_BATCH_VERTICES * 3,
+                                            entities + stored, BENCH_JOBS_ENTITIES - stored);
+                batches++;
+            }
+
+            fillNs += ProfileNowNs() - start;
+        }
+
+        double fillMs = fillNs / 1e6 / BENCH_JOBS_FRAMES;
+        if (threads == 1) singleThreadMs = fillMs;
+
+        ReportBenchMetric(scenario, "entities", BENCH_JOBS_ENTITIES);
+        ReportBenchMetric(scenario, "batches", (double)batches / BENCH_JOBS_FRAMES);
+        ReportBenchMetric(scenario, "fill_ms", fillMs);
+        ReportBenchMetric(scenario, "speedup", singleThreadMs / fillMs);
+        ReportBenchMetric(scenario, "jobs_stolen", (double)jobs->stolenJobs.load() / BENCH_JOBS_FRAMES);
+
+        DestroyJobSystem(jobs);
+    }
+
+    free(vertices.data);
+    free(indices.data);
+    free(entities);
+    free(quad.meshes[0].colors);
+    free(quad.meshes);
+}
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../external/glad.h"
+
+#define COD3R_GL_IMPLEMENTATION
+#include "../cod3rGL.h"
+#include "../headless_gl.h"
+#include "bench.h"
+
+typedef struct BenchScenario {
+    const char *name;
+    void (*run)();
+} BenchScenario;
+
+static const BenchScenario scenarios[] = {
+    { "transform", BenchTransform },
+    { "ecs", BenchEcs },
+    { "batch", BenchBatch },
+    { "queue", BenchQueue },
+    { "jobs", BenchJobs },
+    { "culling", BenchCulling },
+    { "terrain", BenchTerrain },
+    { "asset", BenchAsset },
+    { "profiler", BenchProfiler },
+    { "input", BenchInput },
+    { "camera", BenchCamera },
+    { "shader", BenchShader },
+    { "replay", BenchReplay },
+    { "atlas", BenchAtlas },
+    { "geometry", BenchGeometry },
+};
+
+static FILE *benchOutput = NULL; // The original stdout, only the CSV goes there
+
+void ReportBenchMetric(const char *scenario, const char *metric, double value) {
+    fprintf(benchOutput, "%s,%s,%.4f\n", scenario, metric, value);
+}
+
+#define BENCH_TARGET_SIZE 64 // Offscreen render target, pixels per side. Kept small, llvmpipe rasterizes on the CPU
+
+// Usage: cgame_bench [scenario...] (runs every scenario when none is given), from the repository root (shaders are
+// loaded from src/shaders). Scenarios that need GL report "skipped_no_gl_context" when EGL is not usable.
+int main(int argc, char **argv) {
+    // The engine logs with printf (shader builds, full batches...), its lines go to stderr with the context logs
+    benchOutput = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    SetShaderCacheDir(NULL);
+
+    HeadlessContext *headless = CreateHeadlessContext(BENCH_TARGET_SIZE);
+
+    fprintf(benchOutput, "scenario,metric,value\n");
+
+    for (unsigned int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        bool selected = argc < 2;
+
+        for (int arg = 1; arg < argc; arg++) {
+            if (strcmp(argv[arg], scenarios[i].name) == 0) selected = true;
+        }
+
+        if (!selected) continue;
+
+        uint64_t start = ProfileNowNs();
+        scenarios[i].run();
+        ReportBenchMetric(scenarios[i].name, "wall_ms", (ProfileNowNs() - start) / 1e6);
+    }
+
+    DestroyHeadlessContext(headless);
+    fclose(benchOutput);
+
+    return 0;
+}
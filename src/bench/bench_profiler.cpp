@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include "../profiler.h"
+#include "bench.h"
+
+#define BENCH_PROFILER_ZONES 1000000
+#define BENCH_PROFILER_REPEATS 15 // Runs of each loop, the fastest is reported
+#define BENCH_PROFILER_TRACE "cgame_bench_trace.json"
+
+static volatile float benchProfilerSink;
+
+// Same tiny amount of work in every zone, the zone cost is measured against it
+static void __attribute__((noinline)) BenchProfilerWork(int i) {
+    benchProfilerSink = benchProfilerSink * 0.5f + (float)i;
+}
+
+static uint64_t RunBenchBare() {
+    uint64_t start = ProfileNowNs();
+    for (int i = 0; i < BENCH_PROFILER_ZONES; i++) BenchProfilerWork(i);
+    return ProfileNowNs() - start;
+}
+
+static uint64_t RunBenchZones() {
+    uint64_t start = ProfileNowNs();
+
+    for (int i = 0; i < BENCH_PROFILER_ZONES; i++) {
+        PROFILE_ZONE("BenchZone");
+        BenchProfilerWork(i);
+    }
+
+    return ProfileNowNs() - start;
+}
+
+// Fastest run, the one least disturbed by the rest of the machine
+static uint64_t FastestBenchNs(const uint64_t *runs) {
+    return *std::min_element(runs, runs + BENCH_PROFILER_REPEATS);
+}
+
+// Cost of a zone compiled in but outside a capture, and while capturing. After a warmup pass, the bare and zoned loops
+// alternate so drifts of the clock or the cache hit both. An idle zone is one relaxed load, close to the noise.
+void BenchProfiler() {
+    uint64_t bareRuns[BENCH_PROFILER_REPEATS];
+    uint64_t idleRuns[BENCH_PROFILER_REPEATS];
+    uint64_t capturingRuns[BENCH_PROFILER_REPEATS];
+
+    RunBenchBare();
+    RunBenchZones();
+
+    for (int run = 0; run < BENCH_PROFILER_REPEATS; run++) {
+        bareRuns[run] = RunBenchBare();
+        idleRuns[run] = RunBenchZones();
+    }
+
+    // The rings keep the latest events, the capture never runs out of room
+    BeginProfilerCapture();
+    for (int run = 0; run < BENCH_PROFILER_REPEATS; run++) capturingRuns[run] = RunBenchZones();
+
+    uint64_t start = ProfileNowNs();
+    EndProfilerCapture(BENCH_PROFILER_TRACE);
+    uint64_t exportNs = ProfileNowNs() - start;
+
+    remove(BENCH_PROFILER_TRACE);
+
+    const uint64_t bareNs = FastestBenchNs(bareRuns);
+    std::nth_element(bareRuns, bareRuns + BENCH_PROFILER_REPEATS / 2, bareRuns + BENCH_PROFILER_REPEATS);
+    const uint64_t bareMedianNs = bareRuns[BENCH_PROFILER_REPEATS / 2];
+    const uint64_t idleNs = FastestBenchNs(idleRuns);
+    const uint64_t capturingNs = FastestBenchNs(capturingRuns);
+
+    ReportBenchMetric("profiler", "bare_ns", (double)bareNs / BENCH_PROFILER_ZONES);
+    ReportBenchMetric("profiler", "bare_noise_ns", ((double)bareMedianNs - bareNs) / BENCH_PROFILER_ZONES); // Zone costs below it are noise
+    ReportBenchMetric("profiler", "idle_zone_ns", ((double)idleNs - bareNs) / BENCH_PROFILER_ZONES);
+    ReportBenchMetric("profiler", "capturing_zone_ns", ((double)capturingNs - bareNs) / BENCH_PROFILER_ZONES);
+    ReportBenchMetric("profiler", "export_ms", exportNs / 1e6);
+}
@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include <algorithm>
+#include "../cod3rGL.h"
+#include "bench.h"
+
+#define BENCH_QUEUE_ITEMS 100000
+#define BENCH_QUEUE_RUNS 20
+
+static bool CompareRenderKeys(const RenderKey &a, const RenderKey &b) {
+    return a.key < b.key;
+}
+
+// Sorts a frame worth of render keys: few layers, shaders and meshes, random depths
+void BenchQueue() {
+    RenderKey *source = (RenderKey *)malloc(BENCH_QUEUE_ITEMS * sizeof(RenderKey));
+    RenderKey *keys = (RenderKey *)malloc(BENCH_QUEUE_ITEMS * sizeof(RenderKey));
+    RenderKey *scratch = (RenderKey *)malloc(BENCH_QUEUE_ITEMS * sizeof(RenderKey));
+
+    srand(1);
+    for (int i = 0; i < BENCH_QUEUE_ITEMS; i++) {
+        unsigned long long layer = rand() % 4;
+        unsigned long long translucent = rand() % 8 == 0;
+        unsigned long long mesh = rand() % 300;
+        unsigned long long depth = ((unsigned long long)rand() << 8 ^ rand()) & 0xFFFFFF;
+
+        source[i].key = layer << 61 | translucent << 60 | mesh << 38 | depth << 14;
+        source[i].command = i;
+    }
+
+    uint64_t radixNs = 0;
+    uint64_t stdNs = 0;
+
+    for (int run = 0; run < BENCH_QUEUE_RUNS; run++) {
+        memcpy(keys, source, BENCH_QUEUE_ITEMS * sizeof(RenderKey));
+        uint64_t start = ProfileNowNs();
+        SortRenderKeys(keys, scratch, BENCH_QUEUE_ITEMS);
+        radixNs += ProfileNowNs() - start;
+
+        memcpy(keys, source, BENCH_QUEUE_ITEMS * sizeof(RenderKey));
+        start = ProfileNowNs();
+        std::stable_sort(keys, keys + BENCH_QUEUE_ITEMS, CompareRenderKeys);
+        stdNs += ProfileNowNs() - start;
+    }
+
+    ReportBenchMetric("queue_radix_sort", "ms_per_100k", radixNs / 1e6 / BENCH_QUEUE_RUNS);
+    ReportBenchMetric("queue_std_stable_sort", "ms_per_100k", stdNs / 1e6 / BENCH_QUEUE_RUNS);
+
+    free(source);
+    free(keys);
+    free(scratch);
+}
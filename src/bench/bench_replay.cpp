@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <initializer_list>
+#include "../cod3rGL.h"
+#include "bench.h"
+
+#define BENCH_REPLAY_QUADS 20000 // Per path: batched, registry and instanced
+#define BENCH_REPLAY_RUNS 20
+#define BENCH_REPLAY_FILE "cgame_bench_frame.cgfc"
+
+static void DrawBenchReplayFrame(Entity *batched, Entity *registry, Entity *instanced) {
+    for (int i = 0; i < BENCH_REPLAY_QUADS; i++) {
+        const glm::vec3 position = glm::vec3((float)(i % 200) - 100.0f, (float)(i / 200) - 50.0f, -20.0f);
+
+        batched->matrix = glm::translate(glm::mat4(1.0f), position);
+        registry->matrix = glm::translate(glm::mat4(1.0f), position + glm::vec3(0.25f, 0.0f, 0.0f));
+        instanced->matrix = glm::translate(glm::mat4(1.0f), position + glm::vec3(0.5f, 0.0f, 0.0f));
+
+        DrawEntity(*batched);
+        DrawEntity(*registry);
+        DrawEntityInstanced(*instanced);
+    }
+}
+
+// Captures a frame going through the three draw paths, then replays it on both backends (needs a current GL context)
+void BenchReplay() {
+    if (glGenBuffers == NULL) {
+        ReportBenchMetric("replay", "skipped_no_gl_context", 1.0);
+        return;
+    }
+
+    Vector4 colors[3] = { { 0.9f, 0.4f, 0.3f, 1.0f }, { 0.3f, 0.9f, 0.4f, 1.0f }, { 0.3f, 0.4f, 0.9f, 1.0f } };
+    Entity batched = CreateRect(&colors[0], glm::vec3(0.0f));
+    Entity registry = CreateRect(&colors[1], glm::vec3(0.0f));
+    Entity instanced = CreateRect(&colors[2], glm::vec3(0.0f));
+
+    InitCod3rGL(64, 64);
+    SetupCamera(glm::vec3(0.0f, 0.0f, 60.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+    UploadEntityMeshes(&registry);
+
+    // The capture starts with the frame after the next RenderCod3rGL
+    CaptureNextFrame(BENCH_REPLAY_FILE);
+    DrawBenchReplayFrame(&batched, &registry, &instanced);
+    RenderCod3rGL();
+
+    uint64_t start = ProfileNowNs();
+    DrawBenchReplayFrame(&batched, &registry, &instanced);
+    RenderCod3rGL();
+    glFinish();
+    uint64_t liveNs = ProfileNowNs() - start;
+    RenderStats live = GetRenderStats();
+
+    FrameCapture *capture = LoadFrameCapture(BENCH_REPLAY_FILE);
+
+    if (capture == NULL || !PrepareFrameCapture(capture)) {
+        ReportBenchMetric("replay", "failed", 1.0);
+        FreeFrameCapture(capture);
+        CleanCod3rGL();
+        return;
+    }
+
+    RenderStats replayed = { 0 };
+    start = ProfileNowNs();
+    for (int run = 0; run < BENCH_REPLAY_RUNS; run++) {
+        replayed = ReplayFrameCapture(capture, COMMAND_BACKEND_GL);
+        glFinish();
+    }
+    uint64_t glNs = ProfileNowNs() - start;
+
+    start = ProfileNowNs();
+    for (int run = 0; run < BENCH_REPLAY_RUNS; run++) ReplayFrameCapture(capture, COMMAND_BACKEND_NULL);
+    uint64_t nullNs = ProfileNowNs() - start;
+
+    FILE *file = fopen(BENCH_REPLAY_FILE, "rb");
+    long fileSize = 0;
+    if (file != NULL) {
+        fseek(file, 0, SEEK_END);
+        fileSize = ftell(file);
+        fclose(file);
+    }
+    remove(BENCH_REPLAY_FILE);
+
+    ReportBenchMetric("replay", "commands", capture->header.commandCount);
+    ReportBenchMetric("replay", "resources", capture->header.resourceCount);
+    ReportBenchMetric("replay", "file_kb", fileSize / 1024.0);
+    ReportBenchMetric("replay", "live_draw_calls", live.drawCalls);
+    ReportBenchMetric("replay", "replay_draw_calls", replayed.drawCalls);
+    ReportBenchMetric("replay", "replay_vertices_match", replayed.verticesDrawn == live.verticesDrawn ? 1.0 : 0.0);
+    ReportBenchMetric("replay", "replay_mb_uploaded", replayed.bytesUploaded / (1024.0 * 1024.0));
+    ReportBenchMetric("replay", "live_uniform_kb", live.uniformBytes / 1024.0);
+    ReportBenchMetric("replay", "live_frame_ms", liveNs / 1e6);
+    ReportBenchMetric("replay", "gl_replay_ms", glNs / 1e6 / BENCH_REPLAY_RUNS);
+    ReportBenchMetric("replay", "null_replay_us", nullNs / 1e3 / BENCH_REPLAY_RUNS);
+
+    FreeFrameCapture(capture);
+    CleanCod3rGL();
+
+    for (Entity *entity : { &batched, &registry, &instanced }) {
+        free(entity->meshes[0].colors);
+        free(entity->meshes);
+    }
+}
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "../cod3rGL.h"
+#include "bench.h"
+
+#define BENCH_SHADER_CACHE "cgame_bench_shader_cache"
+
+static void ClearBenchShaderCache() {
+    DIR *directory = opendir(BENCH_SHADER_CACHE);
+    if (directory == NULL) return;
+
+    char path[512];
+    struct dirent *entry;
+
+    while ((entry = readdir(directory)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        snprintf(path, sizeof(path), "%s/%s", BENCH_SHADER_CACHE, entry->d_name);
+        remove(path);
+    }
+
+    closedir(directory);
+    rmdir(BENCH_SHADER_CACHE);
+}
+
+// Builds the engine programs the way InitCod3rGL does, returns the wall time in nanoseconds
+static uint64_t LoadBenchShaders() {
+    uint64_t start = ProfileNowNs();
+
+    int defaultHandle = QueueShader("src/shaders/vertex.glsl", "src/shaders/fragment.glsl");
+    int instancedHandle = QueueShader("src/shaders/vertex_instanced.glsl", "src/shaders/fragment.glsl");
+    int texturedHandle = QueueShader("src/shaders/vertex.glsl", "src/shaders/fragment_textured.glsl");
+    int geometryHandle = QueueShader("src/shaders/vertex_geometry.glsl", "src/shaders/fragment.glsl");
+    Shader defaultShader = WaitShader(defaultHandle);
+    Shader instancedShader = WaitShader(instancedHandle);
+    Shader texturedShader = WaitShader(texturedHandle);
+    Shader geometryShader = WaitShader(geometryHandle);
+
+    uint64_t elapsed = ProfileNowNs() - start;
+
+    if (defaultShader.id == 0 || instancedShader.id == 0 || texturedShader.id == 0 || geometryShader.id == 0) elapsed = 0;
+
+    UnloadShader(defaultShader);
+    UnloadShader(instancedShader);
+    UnloadShader(texturedShader);
+    UnloadShader(geometryShader);
+
+    return elapsed;
+}
+
+// Cold (compiled from source) and warm (program binary cache) load of the engine shaders, needs a current GL
+// context and the repository root as working directory
+void BenchShader() {
+    if (glGenBuffers == NULL) {
+        ReportBenchMetric("shader", "skipped_no_gl_context", 1.0);
+        return;
+    }
+
+    ClearBenchShaderCache();
+    SetShaderCacheDir(BENCH_SHADER_CACHE);
+
+    ShaderCacheStats before = GetShaderCacheStats();
+    uint64_t coldNs = LoadBenchShaders();
+    ShaderCacheStats cold = GetShaderCacheStats();
+    uint64_t warmNs = LoadBenchShaders();
+    ShaderCacheStats warm = GetShaderCacheStats();
+
+    SetShaderCacheDir(NULL);
+    ClearBenchShaderCache();
+
+    if (coldNs == 0 || warmNs == 0) {
+        ReportBenchMetric("shader", "failed", 1.0);
+        return;
+    }
+
+    ReportBenchMetric("shader", "cold_ms", coldNs / 1e6);
+    ReportBenchMetric("shader", "warm_ms", warmNs / 1e6);
+    ReportBenchMetric("shader", "cold_compiled", cold.programsCompiled - before.programsCompiled);
+    ReportBenchMetric("shader", "warm_loaded", warm.programsLoaded - cold.programsLoaded);
+    ReportBenchMetric("shader", "parallel_compile", warm.parallelCompile ? 1.0 : 0.0);
+}
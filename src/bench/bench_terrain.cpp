@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "../cod3rGL.h"
+#include "../terrain.h"
+#include "bench.h"
+
+#define BENCH_TERRAIN_FRAMES 1000
+#define BENCH_TERRAIN_SPEED 8.0f // World units per frame, 8 km over the flight
+#define BENCH_TERRAIN_BUDGET (16 * 1024 * 1024)
+
+// Flies the camera in a straight line over the streaming terrain (no GL context needed)
+static void BenchTerrainFlight(const char *scenario, JobSystem *jobs) {
+    TerrainDesc desc = GetDefaultTerrainDesc();
+    desc.viewChunks = 16;
+    desc.memoryBudget = BENCH_TERRAIN_BUDGET;
+
+    ChunkedTerrain *terrain = CreateChunkedTerrain(&desc, jobs);
+    glm::vec3 camera = glm::vec3(0.0f, 100.0f, 0.0f);
+    uint64_t updateNs = 0;
+    uint64_t maxUpdateNs = 0;
+    uint64_t start = ProfileNowNs();
+
+    for (int frame = 0; frame < BENCH_TERRAIN_FRAMES; frame++) {
+        uint64_t updateStart = ProfileNowNs();
+        UpdateTerrain(terrain, camera);
+        uint64_t frameNs = ProfileNowNs() - updateStart;
+
+        updateNs += frameNs;
+        if (frameNs > maxUpdateNs) maxUpdateNs = frameNs;
+
+        camera.x += BENCH_TERRAIN_SPEED;
+        camera.z += BENCH_TERRAIN_SPEED * 0.25f;
+    }
+
+    // Lets the last chunks finish, the flight ends once the view is fully loaded
+    while (GetTerrainStats(terrain).chunksGenerating > 0 || GetTerrainStats(terrain).chunksLoaded < terrain->budgetChunks) {
+        UpdateTerrain(terrain, camera);
+    }
+
+    double seconds = (ProfileNowNs() - start) / 1e9;
+    TerrainStats stats = GetTerrainStats(terrain);
+
+    ReportBenchMetric(scenario, "chunks_generated", (double)stats.chunksGenerated);
+    ReportBenchMetric(scenario, "chunks_evicted", (double)stats.chunksEvicted);
+    ReportBenchMetric(scenario, "chunks_per_second", stats.chunksGenerated / seconds);
+    ReportBenchMetric(scenario, "ms_per_chunk", stats.generationMs / stats.chunksGenerated);
+    ReportBenchMetric(scenario, "update_ms", updateNs / 1e6 / BENCH_TERRAIN_FRAMES);
+    ReportBenchMetric(scenario, "max_update_ms", maxUpdateNs / 1e6);
+    ReportBenchMetric(scenario, "peak_memory_mb", stats.memoryPeak / (1024.0 * 1024.0));
+    ReportBenchMetric(scenario, "budget_mb", BENCH_TERRAIN_BUDGET / (1024.0 * 1024.0));
+    ReportBenchMetric(scenario, "index_kb", stats.indexBytes / 1024.0);
+
+    DestroyChunkedTerrain(terrain);
+}
+
+void BenchTerrain() {
+    BenchTerrainFlight("terrain_inline", NULL);
+
+    JobSystem *jobs = CreateJobSystem(0);
+    BenchTerrainFlight("terrain_jobs", jobs);
+    DestroyJobSystem(jobs);
+}
@@ -0,0 +1,49 @@
+#include <stdlib.h>
+#include <math.h>
+#include <stdio.h>
+#include "../cod3rGL.h"
+#include "bench.h"
+
+#define BENCH_TRANSFORM_VERTICES 4096
+#define BENCH_TRANSFORM_ITERATIONS 2000
+
+void BenchTransform() {
+    float *src = (float *)malloc(BENCH_TRANSFORM_VERTICES * 3 * sizeof(float));
+    float *dstScalar = (float *)malloc(BENCH_TRANSFORM_VERTICES * 3 * sizeof(float));
+    float *dstSimd = (float *)malloc(BENCH_TRANSFORM_VERTICES * 3 * sizeof(float));
+
+    for (int i = 0; i < BENCH_TRANSFORM_VERTICES * 3; i++) {
+        src[i] = (float)(rand() % 2000) / 1000.0f - 1.0f;
+    }
+
+    glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(-130.0f, 100.0f, 0.0f));
+    matrix = glm::rotate(matrix, glm::radians(33.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    matrix = glm::scale(matrix, glm::vec3(2.0f, 3.0f, 1.0f));
+
+    const double vertices = (double)BENCH_TRANSFORM_VERTICES * BENCH_TRANSFORM_ITERATIONS;
+
+    uint64_t start = ProfileNowNs();
+    for (int i = 0; i < BENCH_TRANSFORM_ITERATIONS; i++) {
+        TransformVerticesScalar(matrix, src, dstScalar, 3, BENCH_TRANSFORM_VERTICES);
+    }
+    ReportBenchMetric("transform_scalar", "ns_per_vertex", (double)(ProfileNowNs() - start) / vertices);
+
+    start = ProfileNowNs();
+    for (int i = 0; i < BENCH_TRANSFORM_ITERATIONS; i++) {
+        TransformVertices(matrix, src, dstSimd, 3, BENCH_TRANSFORM_VERTICES);
+    }
+
+    char scenario[64];
+    snprintf(scenario, sizeof(scenario), "transform_%s", GetTransformVerticesPath());
+    ReportBenchMetric(scenario, "ns_per_vertex", (double)(ProfileNowNs() - start) / vertices);
+
+    float maxError = 0.0f;
+    for (int i = 0; i < BENCH_TRANSFORM_VERTICES * 3; i++) {
+        maxError = fmaxf(maxError, fabsf(dstScalar[i] - dstSimd[i]));
+    }
+    ReportBenchMetric(scenario, "max_abs_error", maxError);
+
+    free(src);
+    free(dstScalar);
+    free(dstSimd);
+}
@@ -3,25 +3,93 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include "external/glad.h"
 
+// Defined by jobs.h and culling.h, included by the implementation only. Offline tools define COD3R_GL_STANDALONE
+// with COD3R_GL_IMPLEMENTATION: the functions below that need those modules are left out, the tools build without
+// jobs.cpp, culling.cpp and profiler.cpp.
+typedef struct JobSystem JobSystem;
+typedef struct Frustum Frustum;
+
 #define DEFAULT_ATTRIB_POSITION_NAME "vertexPosition"
 #define DEFAULT_ATTRIB_COLOR_NAME "vertexColor"
+#define DEFAULT_ATTRIB_TEXCOORD_NAME "vertexTexCoord"
+#define DEFAULT_ATTRIB_INSTANCE_MODEL_NAME "instanceModel"
+#define DEFAULT_ATTRIB_INSTANCE_COLOR_NAME "instanceColor"
 #define MAX_SHADER_LOCATIONS 32      // Maximum number of predefined locations stored in shader struct
-#define MAX_DYNAMIC_DATA_PER_BUFFER 50000 // Maximum number of items per Dynamic Buffer
+#define MAX_SHADER_UNIFORMS 64 // Reflected uniforms per program, outside blocks (the state cache keeps a bit per uniform)
+#define SHADER_UNIFORM_NAME_LENGTH 64
+#define FRAME_UNIFORM_BLOCK_NAME "FrameData" // std140 block of the shaders laid out as FrameUniforms
+#define FRAME_UNIFORM_BINDING 0 // Binding point of the frame uniform buffer, shared by every program
+#define MAX_DYNAMIC_DATA_PER_BUFFER 50000 // Default number of indices per batch
 #define MAX_BUFFERS_RENDER 5 // Maximum number of buffers (VAO, VBOs)
+#define MAX_QUAD_BATCHES 32 // Texture layers drawn by DrawTexturedQuad in the same frame, each one fills its own batch
+#define STREAM_FRAMES_IN_FLIGHT 3 // Frames the CPU can run ahead of the GPU through the streaming buffers
+#define STREAM_REGION_VERTICES (MAX_DYNAMIC_DATA_PER_BUFFER / 3) // Default number of vertices per batch, see InitCod3rGLEx
+#define MAX_INSTANCED_MESHES 64 // Maximum number of distinct meshes drawn with instancing
+#define MAX_INSTANCES_PER_FRAME 65536 // Maximum number of instances streamed per frame
+#define MAX_STATIC_MESHES 1024 // Maximum number of distinct meshes in the mesh registry
+#define GEOMETRY_ARENA_VERTICES 262144 // Vertices per geometry arena (5 MB of BatchVertex), see UploadMesh
+#define GEOMETRY_ARENA_INDICES (GEOMETRY_ARENA_VERTICES * 3) // 16-bit indices per geometry arena
+#define MAX_GEOMETRY_ARENAS 8 // Meshes that fit in none of them get their own buffers
+#ifndef FRAME_ARENA_SIZE
+    #define FRAME_ARENA_SIZE (8 * 1024 * 1024) // Bytes of transient memory per frame, see FrameAlloc. Define it before the include to size it
+#endif
+#define FRAME_BLOCK_ITEMS 256 // Items per frame arena block of instances and static draws
+#define MAX_RENDER_LAYERS 8 // Layers are drawn in increasing order, see SetRenderLayer
+#define MAX_CACHED_PROGRAMS 16 // Programs whose uniforms are tracked by the state cache
+#define MAX_FILL_RANGES 256 // Entity ranges of one FillBatchParallel pass
+#define FILL_RANGE_MIN_ENTITIES 64 // Smallest entity range worth a job
+#define VERTEX_TRANSFORM_W 0.01f // w component used when baking entity transforms into the batch
+#define MAX_PENDING_SHADERS 16 // Shader programs building at the same time, see QueueShader
+#define SHADER_CACHE_DIR "shader_cache" // Default directory of the program binary cache, see SetShaderCacheDir
 
 // Structs
+
+// Uniform of the default block, found by ReflectShaderUniforms when the program is loaded
+typedef struct ShaderUniform {
+    char name[SHADER_UNIFORM_NAME_LENGTH]; // Without the "[0]" of arrays
+    int location;
+    unsigned int type;          // GL_FLOAT_MAT4, GL_FLOAT_VEC4, GL_SAMPLER_2D...
+    int count;                  // Array elements, 1 for plain uniforms
+    int size;                   // Bytes of the value, every element included
+    int offset;                 // Offset of the value in the program values kept by the state cache
+} ShaderUniform;
+
 typedef struct Shader {
     unsigned int id;    // Shader Program ID
     int *locs;          // Shader locations array
+    ShaderUniform *uniforms; // Reflected uniforms, see GetShaderUniform
+    int uniformCount;
+    int uniformDataSize; // Bytes of the values of every uniform
 } Shader;
 
+typedef enum {
+    SHADER_PENDING = 0,
+    SHADER_READY,
+    SHADER_FAILED
+} ShaderStatus;
+
+typedef struct ShaderCacheStats {
+    int programsLoaded;         // Programs created from the binary cache
+    int programsCompiled;       // Programs compiled from source, cache misses and stale binaries included
+    int programsStale;          // Cached binaries the driver rejected
+    double startupMs;           // Time with programs in flight, cold (compiled) vs warm (cached) startup
+    bool parallelCompile;       // The driver compiles in the background (KHR/ARB_parallel_shader_compile)
+} ShaderCacheStats;
+
 typedef enum {
     LOC_VERTEX_POSITION = 0,
     LOC_VERTEX_COLOR = 1,
+    LOC_VERTEX_TEXCOORD = 2,
+    LOC_VERTEX_INSTANCE_MODEL = 3, // mat4, takes locations 3 to 6
+    LOC_VERTEX_INSTANCE_COLOR = 7,
     LOC_MATRIX_PROJECTION,
     LOC_MATRIX_VIEW,
     LOC_MATRIX_MODEL,
@@ -48,6 +116,10 @@ typedef struct Mesh {
     // OpenGL identifiers
     unsigned int vaoId;     // OpenGL Vertex Array Object id
     unsigned int *vboId;    // OpenGL Vertex Buffer Objects id
+    unsigned int registryId; // Mesh registry handle, 0 when the geometry is not GPU-resident
+
+    glm::vec3 boundsMin;    // Local AABB of the vertices, see ComputeMeshBounds
+    glm::vec3 boundsMax;
 } Mesh;
 
 typedef struct Entity {
@@ -75,29 +147,205 @@ typedef struct Vector4 {
     float w;
 } Vector4;
 
-typedef struct DynamicIBuffer {
+// Batch vertex as built on the CPU, uploaded as is with VERTEX_FORMAT_DEFAULT
+typedef struct BatchVertex {
+    float position[3];          // XYZ (shader-location = 0)
+    unsigned int color;         // RGBA8, normalized by the GPU (shader-location = 1)
+    unsigned short texcoord[2]; // UV half floats (shader-location = 2)
+} BatchVertex;
+
+// Batch vertex as uploaded with VERTEX_FORMAT_COMPACT
+typedef struct CompactBatchVertex {
+    unsigned short position[4]; // XYZ half floats, 4th component is padding
+    unsigned int color;
+    unsigned short texcoord[2];
+} CompactBatchVertex;
+
+typedef enum {
+    VERTEX_FORMAT_DEFAULT = 0,  // Float positions (20 bytes per vertex)
+    VERTEX_FORMAT_COMPACT,      // Half float positions (16 bytes per vertex), for small coordinates only
+} VertexFormat;
+
+// Camera data of the frame, std140 layout of the FRAME_UNIFORM_BLOCK_NAME block. Written once per frame into the
+// frame uniform buffer bound at FRAME_UNIFORM_BINDING, every program reads it from there.
+typedef struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 viewProjection;
+} FrameUniforms;
+
+// Per-instance data streamed for instanced draws
+typedef struct InstanceData {
+    glm::mat4 model;            // Entity matrix, translation scaled by VERTEX_TRANSFORM_W (shader-location = 3)
+    unsigned int color;         // RGBA8 (shader-location = 7)
+} InstanceData;
+
+// Instances recorded this frame, allocated from the frame arena
+typedef struct InstanceBlock {
+    InstanceData items[FRAME_BLOCK_ITEMS];
+    int count;
+    struct InstanceBlock *next;
+} InstanceBlock;
+
+// Instances of one mesh in one layer, drawn with one call
+typedef struct InstanceGroup {
+    int instanceCount;
+    bool translucent;           // An instance color has alpha < 1
+    InstanceBlock *firstBlock;
+    InstanceBlock *lastBlock;
+} InstanceGroup;
+
+// Mesh geometry kept on the GPU and the instances submitted for it this frame
+typedef struct InstancedMesh {
+    unsigned int registryId;    // Registry mesh drawn, 0 for meshes drawn without UploadMesh
+    unsigned long long hash;    // Positions and indices of the unregistered mesh, equal content shares the GPU copy
+    unsigned int vaoId;
+    unsigned int vboId[2];      // Positions and indices
+    int indicesCount;
+    long attribOffset;          // Instance ring offset the instance attributes point at
+
+    InstanceGroup groups[MAX_RENDER_LAYERS];
+} InstancedMesh;
+
+// Immutable geometry uploaded once by UploadMesh, shared by every mesh with the same content
+typedef struct StaticMesh {
+    unsigned long long hash;    // Content hash of the geometry
+    unsigned int vaoId;
+    unsigned int vboId[2];      // Interleaved BatchVertex vertices and indices
     int vertexCount;
-    int triangleCount;
-    unsigned int bufferId;
+    int indicesCount;
+    unsigned int indexType;     // GL_UNSIGNED_SHORT under 65536 vertices, 0 when the mesh is not indexed
+    bool translucent;           // A vertex color has alpha < 1
+    bool sharedIndices;         // vboId[1] belongs to an IndexBuffer, see UploadMeshVertices
+    int refCount;               // Slot is free when 0
+    unsigned int arenaId;       // Geometry arena (index + 1) whose VAO and buffers hold the mesh, 0 for its own
+    int firstVertex;            // Place of the mesh in its arena
+    int firstIndex;
+} StaticMesh;
+
+// Index buffer shared by several registry meshes, each draw picks a range of it
+typedef struct IndexBuffer {
+    unsigned int id;
+    unsigned int indexType;     // GL_UNSIGNED_SHORT when the indexed vertices fit 16 bits
+    int indicesCount;
+} IndexBuffer;
+
+// Geometry already in GPU layout, uploaded as is by UploadPackedMesh
+typedef struct PackedMesh {
+    const BatchVertex *vertices;
+    int vertexCount;
+    const void *indices;        // NULL when the mesh is not indexed
+    int indicesCount;
+    unsigned int indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    bool translucent;           // A vertex color has alpha < 1
+    unsigned long long hash;    // Content hash, packed meshes with the same hash share one registry slot
+} PackedMesh;
+
+// Free span of a geometry arena buffer, in vertices or indices
+typedef struct GeometrySpan {
+    int offset;
+    int count;
+} GeometrySpan;
+
+// First fit allocator, the free spans are sorted by offset and freed neighbours are merged
+typedef struct GeometryAllocator {
+    GeometrySpan *spans;
+    int spanCount;
+    int spanCapacity;
+    int capacity;
+    int used;
+} GeometryAllocator;
+
+// Vertex and index buffers shared by the registry meshes placed in it, one VAO for all of them. Indices stay
+// relative to the mesh, the base vertex of the draw points them at its vertices.
+typedef struct GeometryArena {
+    unsigned int vaoId;
+    unsigned int vboId[2];      // BatchVertex vertices and 16-bit indices
+    GeometryAllocator vertices;
+    GeometryAllocator indices;
+    long attribOffset;          // Instance ring offset the model attributes point at
+    int meshCount;
+} GeometryArena;
+
+typedef struct GeometryStats {
+    int arenas;
+    int meshes;                 // Registry meshes placed in an arena
+    int verticesUsed;
+    int indicesUsed;
+    int freeSpans;              // Vertex and index spans, the free end of every arena included
+    int compactions;            // Since InitCod3rGL, the ones done by UploadMesh included
+} GeometryStats;
+
+// One draw of a multi-draw, laid out as the indirect draw commands of GL
+typedef struct DrawElementsCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;  // Instance ring slot of the draw model
+} DrawElementsCommand;
+
+// Registry mesh drawn this frame
+typedef struct StaticDraw {
+    unsigned int registryId;
+    int layer;
+    int firstIndex;             // Index range drawn, the whole mesh when indicesCount is 0
+    int indicesCount;
+    int instance;               // Geometry arena draws: slot of the model in the instance ring region, -1 otherwise
+    glm::mat4 model;            // Entity matrix, translation scaled by VERTEX_TRANSFORM_W
+} StaticDraw;
+
+typedef struct StaticDrawBlock {
+    StaticDraw items[FRAME_BLOCK_ITEMS];
+    int count;
+    struct StaticDrawBlock *next;
+} StaticDrawBlock;
+
+// Linear allocator reset once per frame
+typedef struct FrameArena {
+    unsigned char *memory;
+    size_t capacity;
+    size_t used;
+} FrameArena;
+
+typedef struct DynamicIBuffer {
+    int vertexCount;            // number of indices stored
+    int triangleCount;          // number of vertices the indices are rebased on
     int *data;
 } DynamicIBuffer;
 
-typedef struct DynamicFBuffer {
-    int vertexCount;
-    int triangleCount;
-    unsigned int bufferId;
-    float *data;
-} DynamicFBuffer;
+typedef struct DynamicVBuffer {
+    int vertexCount;            // number of vertices stored
+    bool translucent;           // A stored vertex color has alpha < 1
+    BatchVertex *data;
+} DynamicVBuffer;
+
+// GPU side of a batch: STREAM_FRAMES_IN_FLIGHT regions, each sized for one full batch
+typedef struct BatchStream {
+    unsigned int vaoId;
+    unsigned int vertexBufferId;
+    unsigned int indexBufferId;
+    int drawCount;              // Indices (vertices for Arrays buffers) uploaded this frame
+    unsigned int indexType;
+    int layer;
+    bool translucent;
+    unsigned int textureId;     // Texture array sampled by the batch, 0 for vertex color only
+    int textureLayer;
+} BatchStream;
 
 enum BufferRenderType { Arrays, Elements };
 
 typedef struct Buffer {
-  unsigned int vaoId;
-  DynamicFBuffer verticesBuffer;
-  DynamicFBuffer colorsBuffer;
-  DynamicIBuffer indexBuffer;
+  DynamicVBuffer vertexBuffer;  // Interleaved vertices of the batch being filled
+  DynamicIBuffer indexBuffer;   // Uploaded as 16-bit indices when the batch has less than 65536 vertices
+  BatchStream *streams;         // Pool, grown when a frame fills more batches than ever before
+  int streamCount;
+  int usedStreams;              // Batches uploaded this frame, drawn in order by RenderCod3rGL
+  VertexFormat format;
   BufferRenderType type;
   int id;
+  unsigned int textureId;       // Texture array of the quads batched by DrawTexturedQuad, 0 for the stored buffers
+  int textureLayer;
 } Buffer;
 
 typedef struct BufferHandler {
@@ -106,6 +354,193 @@ typedef struct BufferHandler {
   int currentBuffer;
 } BufferHandler;
 
+// Render queue, built and sorted by RenderCod3rGL.
+// Key bits, high to low: layer (3) | translucent (1) | then, for opaque work,
+// shader (6) | mesh (16) | depth (24, front to back), or for translucent work,
+// inverted depth (24, back to front) | shader (6) | mesh (16).
+typedef enum {
+    RENDER_COMMAND_BATCH = 0,
+    RENDER_COMMAND_STATIC,
+    RENDER_COMMAND_INSTANCED,
+    RENDER_COMMAND_GEOMETRY,    // Static draw of a geometry arena mesh, merged with its neighbours into one multi-draw
+} RenderCommandType;
+
+typedef struct RenderCommand {
+    RenderCommandType type;
+    int count;                  // Instances, for instanced draws
+    long offset;                // Byte offset of the instances in the instance ring
+    const void *data;           // BatchStream, StaticDraw (static and geometry draws) or InstancedMesh
+} RenderCommand;
+
+typedef struct RenderKey {
+    unsigned long long key;
+    unsigned int command;       // Index in the command list
+} RenderKey;
+
+typedef struct RenderStats {
+    long long bytesUploaded;    // Bytes written into the streaming buffers
+    double stallTimeMs;         // Time spent waiting for the GPU to release a frame region
+    int drawCalls;              // Number of draw calls issued
+    long long verticesDrawn;    // Vertices submitted by the draw calls, indices for indexed draws, every instance counted
+    int renderCommands;         // Items sorted by the render queue
+    int stateCallsIssued;       // GL state calls that reached the driver
+    int stateCallsSkipped;      // GL state calls skipped by the state cache
+    long long arenaBytesUsed;   // Frame arena bytes allocated for the frame
+    long long arenaHighWater;   // Highest arenaBytesUsed since InitCod3rGL, size FRAME_ARENA_SIZE from it
+    int arenaFailedAllocs;      // Frame arena allocations that did not fit
+    long long uniformBytes;     // Uniform values sent to the driver, through glUniform* and the frame uniform buffer
+} RenderStats;
+
+// Frame draw flags
+#define FRAME_DRAW_INSTANCED 1      // Recorded by DrawMeshInstanced
+#define FRAME_DRAW_COLOR 2          // `color` overrides the mesh color
+#define FRAME_DRAW_QUAD 4           // Recorded by DrawTexturedQuad, no mesh
+#define FRAME_DRAW_TRANSLUCENT 8    // Textured quad whose texels have alpha < 1
+
+#define FRAME_GEOMETRY_CACHE 64     // Meshes a packet recognizes without copying them again
+
+// Copy of a drawn mesh, taken by its first draw of the frame
+typedef struct FrameGeometry {
+    int vertexCount;            // Floats, like Mesh
+    int triangleCount;
+    int indicesCount;
+    int vertices;               // Offsets in the packet floats, -1 when the mesh has none
+    int colors;
+    int texcoords;
+    int indices;                // Offset in the packet indices, -1 when the mesh has none
+} FrameGeometry;
+
+typedef struct FrameDraw {
+    unsigned int registryId;    // Mesh registry handle, 0 for the meshes drawn from their copy
+    int geometry;               // Index of the copy in the packet geometries, -1 for registry draws and quads
+    glm::mat4 matrix;
+    Vector4 color;
+    int layer;
+    int flags;
+    int firstIndex;             // Index range of DrawMeshRange
+    int indicesCount;
+    unsigned int textureId;     // Texture array, layer and texcoords of DrawTexturedQuad
+    int textureLayer;
+    float uv[4];
+} FrameDraw;
+
+// Everything needed to render one frame on another thread, filled between BeginFramePacket and EndFramePacket
+typedef struct FramePacket {
+    glm::mat4 view;             // Camera of the frame
+    FrameDraw *draws;
+    int drawCount;
+    int drawCapacity;           // Kept across frames, grown when a frame records more draws
+    FrameGeometry *geometries;  // Meshes outside the registry and instanced meshes, the render thread never reads a Mesh
+    int geometryCount;
+    int geometryCapacity;
+    float *floats;              // Vertex data of the geometries
+    int floatCount;
+    int floatCapacity;
+    int *indices;
+    int indexCount;
+    int indexCapacity;
+    const Mesh *cachedMeshes[FRAME_GEOMETRY_CACHE]; // Meshes copied this frame, compared by address while recording
+    const float *cachedVertices[FRAME_GEOMETRY_CACHE];
+    int cachedGeometries[FRAME_GEOMETRY_CACHE];
+    int layer;                  // Layer of the next recorded draw
+    int width;                  // Framebuffer size, filled by the application
+    int height;
+    uint64_t inputTimeNs;       // When the input handled by the frame was sampled, 0 if unknown
+    unsigned long long frameIndex;
+} FramePacket;
+
+enum { RENDER_SHADER_DEFAULT = 0, RENDER_SHADER_INSTANCED = 1, RENDER_SHADER_TEXTURED = 2, RENDER_SHADER_GEOMETRY = 3, RENDER_SHADER_COUNT };
+
+// Render command buffers, see SubmitCommandBuffer. Fields not listed for a command are 0.
+typedef enum {
+    GPU_COMMAND_USE_SHADER = 0,     // resource: one of the RENDER_SHADER_* programs
+    GPU_COMMAND_SET_FRAME_UNIFORMS, // count: payload bytes, payload: FrameUniforms
+    GPU_COMMAND_SET_UNIFORM,        // resource: reflected uniform of the current shader, count: payload bytes, payload: value
+    GPU_COMMAND_SET_BLEND,          // count: 1 for translucent work (alpha blending on, depth writes off), 0 for opaque
+    GPU_COMMAND_BIND_VERTEX_ARRAY,  // resource: VAO
+    GPU_COMMAND_BIND_TEXTURE,       // resource: texture array, bound to unit 0
+    GPU_COMMAND_UPLOAD,             // resource: buffer, offset: bytes into it, count: bytes of payload
+    GPU_COMMAND_INSTANCE_ATTRIBS,   // resource: instance ring, offset: bytes into it the instance attributes point at
+    GPU_COMMAND_DRAW_ARRAYS,        // base: first vertex, count: vertices
+    GPU_COMMAND_DRAW_ELEMENTS,      // count: indices, target: index type, offset: byte offset of the first index, base: base vertex
+    GPU_COMMAND_DRAW_INSTANCED,     // count: GL_UNSIGNED_INT indices, instances, base: base instance (-1 to use the attribute offset)
+    GPU_COMMAND_MULTI_DRAW_ELEMENTS, // count: payload bytes, target: index type, payload: DrawElementsCommand per draw (instance fields unused)
+    GPU_COMMAND_MULTI_DRAW_INDIRECT, // Same, resource: indirect ring the payload is written to, offset: bytes into it
+} GpuCommandType;
+
+typedef struct GpuCommand {
+    unsigned int type;          // GpuCommandType
+    unsigned int resource;      // GL object ids as created by the recording context
+    unsigned int target;
+    int count;
+    int base;
+    int instances;
+    long long offset;
+    unsigned long long data;    // Byte offset of the payload in CommandBuffer::data
+} GpuCommand;
+
+// Plain data all the way down, a command buffer can be copied, appended to another one or written to disk as is
+typedef struct CommandBuffer {
+    GpuCommand *commands;
+    int commandCount;
+    int commandCapacity;
+    unsigned char *data;        // Payloads of the commands, 16 byte aligned
+    size_t dataSize;
+    size_t dataCapacity;
+} CommandBuffer;
+
+typedef enum {
+    COMMAND_BACKEND_GL = 0,     // Issues the commands through the state cache, GL thread only
+    COMMAND_BACKEND_NULL,       // Walks and counts the commands without calling GL, the submission cost without the driver
+} CommandBackend;
+
+// Frame capture file: FrameCaptureHeader, resourceCount CaptureResource, commandCount GpuCommand, dataSize payload bytes
+#define FRAME_CAPTURE_MAGIC 0x43464743 // "CGFC" read as a little endian uint32
+#define FRAME_CAPTURE_VERSION 4
+
+typedef enum {
+    CAPTURE_RESOURCE_BATCH_STREAM = 0,  // Filled by the upload commands of the frame
+    CAPTURE_RESOURCE_STATIC_MESH,       // Registry mesh, its vertex and index buffers are read back
+    CAPTURE_RESOURCE_INSTANCED_MESH,    // Positions and indices are read back
+    CAPTURE_RESOURCE_INSTANCE_RING,     // Filled by the upload commands of the frame
+    CAPTURE_RESOURCE_TEXTURE_ARRAY,     // Every layer is read back
+    CAPTURE_RESOURCE_GEOMETRY_ARENA,    // Its vertex and index buffers are read back up to the last mesh
+    CAPTURE_RESOURCE_INDIRECT_RING,     // Filled by the indirect draws of the frame
+} CaptureResourceType;
+
+typedef struct FrameCaptureHeader {
+    unsigned int magic;
+    unsigned int version;
+    int batchVertices;          // Batch size of the captured frame, the replay has to be initialised with the same
+    int resourceCount;
+    int commandCount;
+    unsigned int padding;
+    unsigned long long dataSize;
+} FrameCaptureHeader;
+
+// GL objects the captured commands use, with the ids they had in the captured context
+typedef struct CaptureResource {
+    unsigned int type;          // CaptureResourceType
+    unsigned int vaoId;
+    unsigned int bufferIds[2];  // Vertices and indices (the ring alone for CAPTURE_RESOURCE_INSTANCE_RING, the texture for CAPTURE_RESOURCE_TEXTURE_ARRAY)
+    int format;                 // VertexFormat of batch streams
+    int renderType;             // BufferRenderType of batch streams
+    int vertexCount;            // Static meshes and geometry arenas
+    unsigned int indexType;     // Static meshes and geometry arenas, 0 when not indexed
+    int textureSize;            // Texture arrays, width and height of every layer
+    int textureLayers;
+    unsigned long long data[2]; // Payload offsets of the read back buffers
+    unsigned long long size[2];
+} CaptureResource;
+
+typedef struct FrameCapture {
+    FrameCaptureHeader header;
+    CaptureResource *resources;
+    CommandBuffer *commands;
+    unsigned int *objects;      // VAO and two buffers (or the texture) per resource, created by PrepareFrameCapture
+    bool prepared;
+} FrameCapture;
+
 typedef struct Camera {
     glm::vec3 position;
     glm::vec3 front;
@@ -133,26 +568,134 @@ enum CameraMovement {
 Shader LoadShader(const char *vsFileName, const char *fsFileName);
 Shader LoadShaderCode(const char *vsCode, const char *fsCode);
 static unsigned int CompileShader(const char *shaderStr, int type);
-static unsigned int LoadShaderProgram(unsigned int vShaderId, unsigned int fShaderId);
 void UnloadShader(Shader shader);
 static void SetShaderDefaultLocations(Shader *shader);
 char *LoadText(const char *fileName);
+int GetShaderUniform(const Shader *shader, const char *name); // Index in shader->uniforms, -1 when the program has none
+
+// Shader manager: programs are built together and loaded from the binary cache when it is up to date. GL thread only.
+int QueueShader(const char *vsFileName, const char *fsFileName); // Starts building the program, returns its handle (-1 when MAX_PENDING_SHADERS are building)
+int QueueShaderCode(const char *vsCode, const char *fsCode);
+ShaderStatus PollShader(int handle); // Does not block while the driver compiles in parallel
+Shader WaitShader(int handle); // Blocks until the program is built and releases the handle, id 0 on failure
+void SetShaderCacheDir(const char *directory); // Before the first QueueShader, NULL disables the cache
+ShaderCacheStats GetShaderCacheStats();
 
 Entity CreateRect(Vector4 *color, glm::vec3 position);
 void DrawRect(Mesh mesh);
 
 void DrawEntity(Entity entity);
+void DrawEntityInstanced(Entity entity); // Draws every mesh of the entity as one instance of a GPU-resident mesh
+void DrawEntities(Entity *entities, int entityCount); // Appends every mesh of every entity to the current buffer
+void DrawEntitiesParallel(JobSystem *jobs, Entity *entities, int entityCount); // Same result, batches are filled by every job worker
+void DrawMesh(const Mesh *mesh, const glm::mat4 &matrix); // Appends one mesh to the current buffer
+void DrawMeshInstanced(const Mesh *mesh, const glm::mat4 &matrix, const Vector4 *color); // NULL color uses the first mesh vertex color
+void DrawMeshRange(const Mesh *mesh, const glm::mat4 &matrix, int firstIndex, int indicesCount); // Part of the indices of a registry mesh
 void RotateEntityZ(Entity *entity, float angle);
+void SetRenderLayer(int layer); // Layer of the draws that follow, 0 to MAX_RENDER_LAYERS - 1 (reset to 0 every frame)
+
+// Textured quads, see atlas.h for sprites. Quads sampling the same texture layer share a batch and one draw call,
+// batches of different layers do not keep the draw order between them (use SetRenderLayer for that).
+// `uv` is u0, v0 (top left corner) then u1, v1 (bottom right), `translucent` when the texels sampled have alpha < 1.
+void DrawTexturedQuad(unsigned int textureId, int textureLayer, const float *uv, bool translucent, const glm::mat4 &matrix, const Vector4 *color); // Unit quad like CreateRect, NULL color is white
+unsigned int CreateTextureArray(int size, int layers, const void *pixels); // RGBA8 layers of size x size texels, NULL pixels leaves them undefined
+void UpdateTextureArrayLayer(unsigned int textureId, int size, int layer, const void *pixels); // Replaces every texel of `layer`
+void UnloadTextureArray(unsigned int textureId);
+
+// Bounds and culling
+void ComputeMeshBounds(Mesh *mesh); // Called by the Create* functions, call it again after editing the vertices
+void GetDrawBounds(const glm::vec3 &localMin, const glm::vec3 &localMax, const glm::mat4 &matrix, glm::vec3 *min, glm::vec3 *max); // World AABB of DrawMesh(mesh, matrix)
+Frustum GetCameraFrustum(); // Frustum of the current camera and the projection set by InitCod3rGL
+
+// Mesh registry, meshes uploaded here are drawn straight from GPU memory by DrawMesh. Indexed meshes under 65536
+// vertices are placed in shared geometry arenas, the draws of an arena go out as one multi-draw.
+unsigned int UploadMesh(Mesh *mesh); // Uploads the geometry once (deduplicated by content), fills vaoId/vboId and returns the handle
+void UnloadMesh(Mesh *mesh); // Drops the mesh reference, GPU buffers are freed with the last one
+void UploadEntityMeshes(Entity *entity);
+unsigned int UploadMeshVertices(Mesh *mesh, const IndexBuffer *indices); // Same, the mesh is drawn with the shared `indices`
+IndexBuffer UploadIndexBuffer(const int *indices, int indicesCount, int vertexCount); // `vertexCount` vertices are indexed
+void UnloadIndexBuffer(IndexBuffer *indices); // Meshes using it have to be unloaded first
+unsigned int UploadPackedMesh(Mesh *mesh, const PackedMesh *packed); // Uploads `packed` without converting it, fills vaoId/vboId only
+bool PackMeshVertices(BatchVertex *dst, const Mesh *mesh); // Mesh vertices in GPU layout, returns true when a color is translucent
+unsigned long long HashPackedMesh(const PackedMesh *packed); // Registry key of the geometry, UploadMesh and the mesh assets agree on it
+void CompactGeometryArenas(); // Closes the holes left by UnloadMesh, GL thread. Uploads compact a fragmented arena by themselves
+GeometryStats GetGeometryStats();
 
 void InitCod3rGL(int windowWidth, int windowHeight); // Initialise all global variables and other setups.
+void InitCod3rGLEx(int windowWidth, int windowHeight, int batchVertices); // Same with `batchVertices` vertices (3x indices) per batch
 void CleanCod3rGL();
 void RenderCod3rGL();
-
-void StoreDataToBufferf(DynamicFBuffer *buffer, float *data, int dataSize);
+void RenderCod3rGLEx(const glm::mat4 &view); // Renders with `view` instead of the current camera
+RenderStats GetRenderStats(); // Stats of the last frame rendered by RenderCod3rGL
+void SortRenderKeys(RenderKey *keys, RenderKey *scratch, int count); // Stable LSD radix sort, result in `keys`
+
+// Frame packets: the draws of a frame are recorded on one thread and rendered on the thread owning the GL context
+void BeginFramePacket(FramePacket *packet); // DrawMesh, DrawMeshInstanced, DrawTexturedQuad and SetRenderLayer of the calling thread go to the packet
+void EndFramePacket(FramePacket *packet); // Stops recording and stores the current camera view
+void RenderFramePacket(const FramePacket *packet); // Replays the draws from the packet copies and renders them, GL thread only
+void FreeFramePacket(FramePacket *packet);
+
+// Render command buffers: recording touches no GL state and works on any thread, submitting to COMMAND_BACKEND_GL
+// needs the GL thread. RenderCod3rGL records its sorted render queue into one and submits it.
+CommandBuffer *CreateCommandBuffer();
+void DestroyCommandBuffer(CommandBuffer *buffer);
+void ResetCommandBuffer(CommandBuffer *buffer); // Empties it, the memory is kept
+void CmdUseShader(CommandBuffer *buffer, int shader);
+void CmdSetFrameUniforms(CommandBuffer *buffer, const FrameUniforms *uniforms);
+void CmdSetUniform(CommandBuffer *buffer, int uniform, const void *value, int size); // `uniform` from GetShaderUniform on the current shader
+void CmdSetBlend(CommandBuffer *buffer, bool translucent);
+void CmdBindVertexArray(CommandBuffer *buffer, unsigned int vaoId);
+void CmdBindTexture(CommandBuffer *buffer, unsigned int textureId);
+void CmdUpload(CommandBuffer *buffer, unsigned int bufferId, long offset, const void *data, int size); // `data` is copied
+void CmdSetInstanceAttribs(CommandBuffer *buffer, unsigned int bufferId, long offset);
+void CmdDrawArrays(CommandBuffer *buffer, int first, int count);
+void CmdDrawElements(CommandBuffer *buffer, int count, unsigned int indexType, long offset, int baseVertex);
+void CmdDrawInstanced(CommandBuffer *buffer, int indicesCount, int instances, int baseInstance);
+void CmdMultiDrawElements(CommandBuffer *buffer, unsigned int indexType, const DrawElementsCommand *draws, int drawCount);
+void CmdMultiDrawIndirect(CommandBuffer *buffer, unsigned int bufferId, long offset, unsigned int indexType, const DrawElementsCommand *draws, int drawCount); // `draws` are written to `bufferId` on submit
+void AppendCommandBuffer(CommandBuffer *dst, const CommandBuffer *src); // Buffers recorded on several threads are merged in order
+void SubmitCommandBuffer(const CommandBuffer *buffer, CommandBackend backend); // Draw calls, vertices and uploads go to the frame stats
+
+// Frame capture: the commands and uploads of one frame, with the geometry they draw, saved for offline replay
+bool CaptureNextFrame(const char *fileName); // Any thread, the frame started after the next RenderCod3rGL is written. False if one is pending
+FrameCapture *LoadFrameCapture(const char *fileName); // NULL when the file is missing or invalid
+bool PrepareFrameCapture(FrameCapture *capture); // GL thread, after InitCod3rGLEx with header.batchVertices: recreates the resources
+RenderStats ReplayFrameCapture(FrameCapture *capture, CommandBackend backend); // The GL backend needs PrepareFrameCapture first
+void FreeFrameCapture(FrameCapture *capture); // Deletes the prepared resources
+
+// GL state cache, calls that would not change the current state are skipped
+void StateUseProgram(unsigned int programId);
+void StateBindVertexArray(unsigned int vaoId);
+void StateBindBuffer(unsigned int target, unsigned int bufferId); // Array and element array targets are tracked
+void StateBindTexture(unsigned int textureId); // GL_TEXTURE_2D_ARRAY of texture unit 0
+void StateSetEnabled(unsigned int capability, bool enabled); // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and GL_MULTISAMPLE are tracked
+void StateDepthMask(bool enabled);
+void StateBlendFunc(unsigned int srcFactor, unsigned int dstFactor);
+void StateSetUniform(const Shader *shader, int uniform, const void *value); // Sent when it differs from the program's current value
+void StateSetFrameUniforms(const FrameUniforms *uniforms); // Written to the next frame uniform buffer region when it changed
+void ResetStateCache(); // Call after changing GL state behind the cache, or deleting objects
+
+// Transient memory of the frame being built, NULL when FRAME_ARENA_SIZE is exhausted. There is one arena per
+// frame in flight: memory stays valid until RenderCod3rGL has rendered STREAM_FRAMES_IN_FLIGHT - 1 more frames.
+void *FrameAlloc(size_t size, size_t alignment);
+
+// Low level batch writes, nothing is stored when the batch is full (DrawMesh flushes full batches instead)
+void StoreDataToBufferv(DynamicVBuffer *buffer, const Mesh *mesh, const glm::mat4 &matrix); // Transforms and packs mesh vertices
 void StoreDataToBufferi(DynamicIBuffer *buffer, int *data, int dataSize, int numTriangles);
+// Appends the batch meshes (registryId 0) of the entities until one does not fit, `indices` is NULL for Arrays buffers.
+// Ranges of entities are written by the job workers at offsets given by a prefix sum. Returns the number of entities stored.
+int FillBatchParallel(JobSystem *jobs, DynamicVBuffer *vertices, DynamicIBuffer *indices, int vertexCapacity, int indexCapacity, const Entity *entities, int entityCount);
+
+// Transforms `count` XYZ positions from `src` into `dst` (w = VERTEX_TRANSFORM_W), `src` and `dst` must not overlap.
+// Output positions are `dstStride` floats apart (>= 3), the float right after each position may be overwritten.
+void TransformVertices(const glm::mat4 &matrix, const float *src, float *dst, int dstStride, int count); // Best SIMD path compiled in
+void TransformVerticesScalar(const glm::mat4 &matrix, const float *src, float *dst, int dstStride, int count); // Reference scalar path
+const char *GetTransformVerticesPath(); // Name of the path used by TransformVertices
 
 Buffer CreateBuffer(enum BufferRenderType type);
-void StoreBuffer(Buffer *buffer);
+Buffer CreateBufferEx(enum BufferRenderType type, VertexFormat format);
+int GetVertexFormatStride(VertexFormat format); // Size in bytes of one uploaded vertex
+void StoreBuffer(Buffer *buffer); // Sets buffer->id, -1 when MAX_BUFFERS_RENDER buffers are already stored
 void BindBuffer(int id);
 int GetCurrentBuffer();
 void CleanBuffer(int id);
@@ -172,11 +715,69 @@ Entity CreateTerrain(glm::vec3 position);
 
 #if defined(COD3R_GL_IMPLEMENTATION)
 
+#include <sys/stat.h>
+#include <atomic>
+#include "jobs.h"
+#include "culling.h"
+#if defined(COD3R_GL_STANDALONE)
+    #undef CGAME_PROFILER // Zones compile to nothing, profiler.cpp is not linked
+#endif
+#include "profiler.h"
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+
 // Global Variables
 
 BufferHandler bufferHandler;
 
 Shader defaultShader;
+Shader instancedShader;
+Shader texturedShader;
+Shader geometryShader;
+
+// Batches of DrawTexturedQuad, one per texture layer drawn this frame (kept apart from the stored buffers)
+Buffer quadBuffers[MAX_QUAD_BATCHES];
+int quadBufferCount = 0;
+
+InstancedMesh instancedMeshes[MAX_INSTANCED_MESHES];
+int instancedMeshCount = 0;
+unsigned int instanceBufferId = 0; // Streaming ring, STREAM_FRAMES_IN_FLIGHT regions of MAX_INSTANCES_PER_FRAME
+int frameInstanceCount = 0;
+
+StaticMesh staticMeshes[MAX_STATIC_MESHES];
+int staticMeshCount = 0; // Slots used so far, free slots included
+StaticDrawBlock *staticDrawFirst = NULL;
+StaticDrawBlock *staticDrawLast = NULL;
+int staticDrawCount = 0;
+
+GeometryArena geometryArenas[MAX_GEOMETRY_ARENAS];
+int geometryArenaCount = 0;
+int geometryCompactions = 0;
+int frameGeometryDrawCount = 0; // Arena draws of the frame, their models start the instance ring region
+unsigned int indirectBufferId = 0; // Streaming ring of STREAM_FRAMES_IN_FLIGHT regions of MAX_INSTANCES_PER_FRAME draws, 0 without indirect draws
+
+// Arrays of glMultiDrawElementsBaseVertex, grown to the largest multi-draw submitted
+GLsizei *multiDrawCounts = NULL;
+const void **multiDrawOffsets = NULL;
+GLint *multiDrawBaseVertices = NULL;
+int multiDrawCapacity = 0;
+
+// Geometry shared by every rect, so they can be drawn with instancing
+static float rectVertices[] = {
+     0.5f,  0.5f, 0.0f,  // top right
+     0.5f, -0.5f, 0.0f,  // bottom right
+    -0.5f, -0.5f, 0.0f,  // bottom left
+    -0.5f,  0.5f, 0.0f   // top left
+};
+
+static int rectIndices[] = {
+    0, 1, 3,  // first Triangle
+    1, 2, 3   // second Triangle
+};
 
 glm::mat4 projection = {
     1, 0, 0, 0,
@@ -193,8 +794,295 @@ glm::mat4 model = {
 
 Camera currentCamera;
 
+// Streaming buffers state, region `streamFrame` of every Buffer is written this frame
+GLsync streamFences[STREAM_FRAMES_IN_FLIGHT] = { 0 };
+int streamFrame = 0;
+bool streamFrameReady = false; // Region `streamFrame` is released by the GPU and can be written
+
+int renderLayer = 0;
+static thread_local FramePacket *recordingPacket = NULL; // Packet the draws of this thread go to, see BeginFramePacket
+
+int batchVertexCapacity = STREAM_REGION_VERTICES;
+int batchIndexCapacity = MAX_DYNAMIC_DATA_PER_BUFFER;
+
+RenderStats frameStats = { 0 };
+RenderStats lastFrameStats = { 0 };
+CommandBuffer *frameCommands = NULL; // Render queue of the frame, recorded then submitted by RenderCod3rGL
+
+// Frame capture, requested from any thread and recorded on the GL thread from one RenderCod3rGL to the next
+#define FRAME_CAPTURE_PATH_LENGTH 512
+
+std::atomic<bool> captureRequested(false);
+char captureRequestName[FRAME_CAPTURE_PATH_LENGTH];
+char captureFileName[FRAME_CAPTURE_PATH_LENGTH];
+bool captureRecording = false;
+CommandBuffer *captureCommands = NULL;
+void *captureMapping = NULL; // Stream region written through the capture, see MapStreamRegion
+void *streamStaging = NULL; // Written instead of a region glMapBufferRange refused, uploaded by UnmapStreamRegion with glBufferSubData
+long streamStagingSize = 0;
+long streamStagingOffset = -1; // Region of the staged upload, -1 when the region is mapped
+
+// One arena per stream frame, arena `streamFrame` is the one being filled
+FrameArena frameArenas[STREAM_FRAMES_IN_FLIGHT] = { 0 };
+long long frameArenaHighWater = 0;
+unsigned char *renderQueueHeap = NULL; // Render queue of the frames whose arena was full, grown to the largest one
+size_t renderQueueHeapSize = 0;
+int frameArenaFailedAllocs = 0;
+
+// State cache, STATE_UNKNOWN until the first call sets a value
+#define STATE_UNKNOWN 0xFFFFFFFFu
+#define STATE_CACHED_CAPABILITIES 4
+
+// Current uniform values of a program, each at the offset reflection gave it
+typedef struct ProgramUniformCache {
+    unsigned int programId;
+    unsigned long long validMask; // Bit per reflected uniform
+    unsigned char *values;
+    int capacity;               // Bytes of values, kept when the slot is reused
+} ProgramUniformCache;
+
+typedef struct GLStateCache {
+    unsigned int program;
+    unsigned int vao;
+    unsigned int arrayBuffer;
+    unsigned int elementBuffer; // Of the bound VAO
+    unsigned int textureArray;  // Texture unit 0
+    unsigned int capabilities[STATE_CACHED_CAPABILITIES];
+    unsigned int depthMask;
+    unsigned int blendSrc;
+    unsigned int blendDst;
+    ProgramUniformCache programs[MAX_CACHED_PROGRAMS];
+    int programCount;
+    FrameUniforms frameUniforms; // Content of the bound frame uniform buffer region
+    bool frameUniformsValid;
+} GLStateCache;
+
+static const unsigned int cachedCapabilities[STATE_CACHED_CAPABILITIES] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_MULTISAMPLE };
+
+GLStateCache stateCache;
+int stateCallsIssued = 0;
+int stateCallsSkipped = 0;
+
+// Frame uniform buffer, STREAM_FRAMES_IN_FLIGHT regions. A new region is written only when the frame data changes.
+unsigned int frameUniformBufferId = 0;
+long frameUniformStride = 0; // sizeof(FrameUniforms) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+int frameUniformRegion = 0;
+
+// Shader manager, programs in flight and the binary cache
+#define SHADER_BINARY_MAGIC 0x42534743 // "CGSB" read as a little endian uint32
+#define SHADER_CACHE_PATH_LENGTH 512
+
+typedef struct ShaderBinaryHeader {
+    unsigned int magic;
+    unsigned int format;        // Returned by glGetProgramBinary
+    unsigned long long key;     // Source and driver hash, also the file name
+    unsigned int length;        // Bytes of binary after the header
+    unsigned int padding;
+} ShaderBinaryHeader;
+
+typedef struct PendingShader {
+    bool used;
+    bool fromCache;             // Program created from a cached binary
+    ShaderStatus status;
+    unsigned int programId;
+    unsigned int vertexId;      // 0 once linked, or when loaded from the cache
+    unsigned int fragmentId;
+    char *vsCode;               // Kept until linked, a stale binary is compiled again from them
+    char *fsCode;
+    unsigned long long key;
+} PendingShader;
+
+PendingShader pendingShaders[MAX_PENDING_SHADERS] = { 0 };
+int shaderPendingCount = 0;
+std::chrono::steady_clock::time_point shaderBusyStart;
+ShaderCacheStats shaderStats = { 0 };
+const char *shaderCacheDir = SHADER_CACHE_DIR;
+unsigned long long shaderDriverHash = 0;
+bool shaderBinarySupported = false;
+bool shaderManagerReady = false;
+
 // Functions Implementations
 
+// FNV-1a
+static unsigned long long HashBytes(unsigned long long hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+void ResetStateCache() {
+  stateCache.program = STATE_UNKNOWN;
+  stateCache.vao = STATE_UNKNOWN;
+  stateCache.arrayBuffer = STATE_UNKNOWN;
+  stateCache.elementBuffer = STATE_UNKNOWN;
+  stateCache.textureArray = STATE_UNKNOWN;
+  for (int i = 0; i < STATE_CACHED_CAPABILITIES; i++) stateCache.capabilities[i] = STATE_UNKNOWN;
+  stateCache.depthMask = STATE_UNKNOWN;
+  stateCache.blendSrc = STATE_UNKNOWN;
+  stateCache.blendDst = STATE_UNKNOWN;
+  stateCache.programCount = 0;
+  stateCache.frameUniformsValid = false;
+}
+
+// Counts the call and tells whether it has to be issued
+static inline bool StateChanged(unsigned int *cached, unsigned int value) {
+  if (*cached == value) {
+    stateCallsSkipped++;
+    return false;
+  }
+
+  *cached = value;
+  stateCallsIssued++;
+  return true;
+}
+
+void StateUseProgram(unsigned int programId) {
+  if (StateChanged(&stateCache.program, programId)) glUseProgram(programId);
+}
+
+void StateBindVertexArray(unsigned int vaoId) {
+  if (StateChanged(&stateCache.vao, vaoId)) {
+    glBindVertexArray(vaoId);
+    stateCache.elementBuffer = STATE_UNKNOWN; // Element array binding is VAO state
+  }
+}
+
+void StateBindBuffer(unsigned int target, unsigned int bufferId) {
+  unsigned int *cached = NULL;
+
+  if (target == GL_ARRAY_BUFFER) cached = &stateCache.arrayBuffer;
+  else if (target == GL_ELEMENT_ARRAY_BUFFER) cached = &stateCache.elementBuffer;
+
+  if (cached == NULL) {
+    glBindBuffer(target, bufferId);
+    stateCallsIssued++;
+  } else if (StateChanged(cached, bufferId)) {
+    glBindBuffer(target, bufferId);
+  }
+}
+
+void StateBindTexture(unsigned int textureId) {
+  if (StateChanged(&stateCache.textureArray, textureId)) glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+}
+
+void StateSetEnabled(unsigned int capability, bool enabled) {
+  int tracked = -1;
+
+  for (int i = 0; i < STATE_CACHED_CAPABILITIES; i++) {
+    if (cachedCapabilities[i] == capability) tracked = i;
+  }
+
+  if (tracked == -1) stateCallsIssued++;
+  else if (!StateChanged(&stateCache.capabilities[tracked], enabled)) return;
+
+  if (enabled) glEnable(capability);
+  else glDisable(capability);
+}
+
+void StateDepthMask(bool enabled) {
+  if (StateChanged(&stateCache.depthMask, enabled)) glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void StateBlendFunc(unsigned int srcFactor, unsigned int dstFactor) {
+  if (stateCache.blendSrc == srcFactor && stateCache.blendDst == dstFactor) {
+    stateCallsSkipped++;
+    return;
+  }
+
+  stateCache.blendSrc = srcFactor;
+  stateCache.blendDst = dstFactor;
+  stateCallsIssued++;
+  glBlendFunc(srcFactor, dstFactor);
+}
+
+static ProgramUniformCache *GetProgramUniformCache(const Shader *shader) {
+  for (int i = 0; i < stateCache.programCount; i++) {
+    if (stateCache.programs[i].programId == shader->id) return &stateCache.programs[i];
+  }
+
+  if (stateCache.programCount == MAX_CACHED_PROGRAMS) return NULL;
+
+  ProgramUniformCache *cache = &stateCache.programs[stateCache.programCount++];
+  cache->programId = shader->id;
+  cache->validMask = 0;
+
+  if (cache->capacity < shader->uniformDataSize) {
+    cache->values = (unsigned char *)realloc(cache->values, shader->uniformDataSize);
+    cache->capacity = shader->uniformDataSize;
+  }
+
+  return cache;
+}
+
+static void UploadShaderUniform(const ShaderUniform *uniform, const void *value) {
+  const GLfloat *f = (const GLfloat *)value;
+  const GLint *i = (const GLint *)value;
+
+  switch (uniform->type) {
+    case GL_FLOAT: glUniform1fv(uniform->location, uniform->count, f); break;
+    case GL_FLOAT_VEC2: glUniform2fv(uniform->location, uniform->count, f); break;
+    case GL_FLOAT_VEC3: glUniform3fv(uniform->location, uniform->count, f); break;
+    case GL_FLOAT_VEC4: glUniform4fv(uniform->location, uniform->count, f); break;
+    case GL_FLOAT_MAT2: glUniformMatrix2fv(uniform->location, uniform->count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT3: glUniformMatrix3fv(uniform->location, uniform->count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT4: glUniformMatrix4fv(uniform->location, uniform->count, GL_FALSE, f); break;
+    case GL_INT_VEC2: glUniform2iv(uniform->location, uniform->count, i); break;
+    case GL_INT_VEC3: glUniform3iv(uniform->location, uniform->count, i); break;
+    case GL_INT_VEC4: glUniform4iv(uniform->location, uniform->count, i); break;
+    default: glUniform1iv(uniform->location, uniform->count, i); break; // int, bool and samplers
+  }
+}
+
+void StateSetUniform(const Shader *shader, int uniform, const void *value) {
+  if (uniform < 0 || uniform >= shader->uniformCount) return;
+
+  const ShaderUniform *reflected = &shader->uniforms[uniform];
+  ProgramUniformCache *cache = GetProgramUniformCache(shader);
+
+  if (cache != NULL) {
+    unsigned char *current = cache->values + reflected->offset;
+
+    if ((cache->validMask & (1ull << uniform)) && memcmp(current, value, reflected->size) == 0) {
+      stateCallsSkipped++;
+      return;
+    }
+
+    memcpy(current, value, reflected->size);
+    cache->validMask |= 1ull << uniform;
+  }
+
+  // Uniforms are program state, the program has to be current
+  StateUseProgram(shader->id);
+  UploadShaderUniform(reflected, value);
+  stateCallsIssued++;
+  frameStats.uniformBytes += reflected->size;
+}
+
+void StateSetFrameUniforms(const FrameUniforms *uniforms) {
+  if (stateCache.frameUniformsValid && memcmp(&stateCache.frameUniforms, uniforms, sizeof(FrameUniforms)) == 0) {
+    stateCallsSkipped++;
+    return;
+  }
+
+  // Each change goes to the next region, draws of the previous frames still read theirs
+  frameUniformRegion = (frameUniformRegion + 1) % STREAM_FRAMES_IN_FLIGHT;
+  const long offset = frameUniformRegion * frameUniformStride;
+
+  glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBufferId);
+  glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(FrameUniforms), uniforms);
+  glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frameUniformBufferId, offset, sizeof(FrameUniforms));
+
+  stateCache.frameUniforms = *uniforms;
+  stateCache.frameUniformsValid = true;
+  stateCallsIssued++;
+  frameStats.uniformBytes += sizeof(FrameUniforms);
+}
+
 Shader LoadShader(const char *vsFileName, const char *fsFileName) {
     Shader shader = { 0 };
 
@@ -242,47 +1130,20 @@ char *LoadText(const char *fileName) {
 }
 
 Shader LoadShaderCode(const char *vsCode, const char *fsCode) {
-    Shader shader = { 0 };
-    shader.locs = (int *)malloc(MAX_SHADER_LOCATIONS * sizeof(int));
-
-    unsigned int vertexShaderId = 0;
-    unsigned int fragmentShaderId = 0;
-
-    if (vsCode != NULL) vertexShaderId = CompileShader(vsCode, GL_VERTEX_SHADER);
-    if (fsCode != NULL) fragmentShaderId = CompileShader(fsCode, GL_FRAGMENT_SHADER);
-
-    shader.id = LoadShaderProgram(vertexShaderId, fragmentShaderId);
-
-    if (shader.id == 0) std::cout << "Custom shader could not be" << std::endl;
-
-    if (shader.id > 0) SetShaderDefaultLocations(&shader);
-
-    int uniformCount = -1;
-
-    for (int i = 0; i < uniformCount; i++) {
-        int namelen = -1;
-        int num = -1;
-        char name[256];
-        GLenum type = GL_ZERO;
-
-        // get the name of the uniform
-        glGetActiveUniform(shader.id, i, sizeof(name) - 1, &namelen, &num, &type, name);
-        name[namelen] = 0;
-
-        // get the location of the named uniform
-        unsigned int location = glGetUniformLocation(shader.id, name);
-        printf("[Shader ID: %i] Active uniform [%s] set at locatiom: %i\n", shader.id, name, location);
-    }
-
-    return shader;
+    return WaitShader(QueueShaderCode(vsCode, fsCode));
 }
 
+// Compile status is read once the program is linked, querying it here would wait for the driver
 static unsigned int CompileShader(const char *shaderStr, int type) {
     unsigned int shader = glCreateShader(type);
     glShaderSource(shader, 1, &shaderStr, NULL);
+    glCompileShader(shader);
 
+    return shader;
+}
+
+static void PrintShaderLog(unsigned int shader) {
     GLint success = 0;
-    glCompileShader(shader);
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 
     if (success != GL_TRUE) {
@@ -292,306 +1153,3469 @@ static unsigned int CompileShader(const char *shaderStr, int type) {
 
         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
 
-        char log[maxLength];
-        glGetShaderInfoLog(shader, maxLength, &length, log);
+        char log[maxLength + 1];
+        log[0] = '\0';
+        glGetShaderInfoLog(shader, maxLength + 1, &length, log);
         printf("%s\n", log);
     }
+}
 
-    printf("[Shader ID: %i] Shader compiled successfully\n", shader);
+// Driver part of the cache key, a driver update invalidates every binary
+static unsigned long long HashShaderDriver() {
+    const char *strings[3] = {
+        (const char *)glGetString(GL_VENDOR),
+        (const char *)glGetString(GL_RENDERER),
+        (const char *)glGetString(GL_VERSION)
+    };
+    unsigned long long hash = 14695981039346656037ULL;
 
-    return shader;
+    for (int i = 0; i < 3; i++) {
+        if (strings[i] != NULL) hash = HashBytes(hash, strings[i], strlen(strings[i]) + 1);
+    }
+
+    return hash;
 }
 
-static unsigned int LoadShaderProgram(unsigned int vShaderId, unsigned int fShaderId) {
-    unsigned int program = 0;
-    GLint success = 0;
-    program = glCreateProgram();
+static void InitShaderManager() {
+    if (shaderManagerReady) return;
 
-    glAttachShader(program, vShaderId);
-    glAttachShader(program, fShaderId);
+    GLint binaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
 
-    glBindAttribLocation(program, 0, DEFAULT_ATTRIB_POSITION_NAME);
-    glBindAttribLocation(program, 1, DEFAULT_ATTRIB_COLOR_NAME);
+    shaderBinarySupported = binaryFormats > 0;
+    shaderDriverHash = HashShaderDriver();
 
-    glLinkProgram(program);
+    // Lets the driver use as many compiler threads as it wants
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        shaderStats.parallelCompile = true;
+    } else if (GLAD_GL_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        shaderStats.parallelCompile = true;
+    }
 
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    shaderManagerReady = true;
+}
 
-    if (success == GL_FALSE) {
-        printf("[Program ID: %i] Failed to link shader program...\n", program);
-        int maxLength = 0;
-        int length;
+static void GetShaderCachePath(char *path, size_t size, unsigned long long key) {
+    snprintf(path, size, "%s/%016llx.bin", shaderCacheDir, key);
+}
 
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
-        char log[maxLength];
+// Creates the program from the cached binary, false when the cache has none for `key`
+static bool LoadProgramBinary(PendingShader *pending) {
+    if (!shaderBinarySupported || shaderCacheDir == NULL) return false;
 
-        glGetProgramInfoLog(program, maxLength, &length, log);
+    char path[SHADER_CACHE_PATH_LENGTH];
+    GetShaderCachePath(path, sizeof(path), pending->key);
 
-        printf("%s", log);
-    } else {
-        printf("[Program ID: %i] Shader program loaded successfully\n", program);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    ShaderBinaryHeader header;
+    void *binary = NULL;
+    bool loaded = fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_BINARY_MAGIC &&
+                  header.key == pending->key && header.length > 0;
+
+    if (loaded) {
+        binary = malloc(header.length);
+        loaded = fread(binary, 1, header.length, file) == header.length;
     }
 
-    return program;
-}
+    fclose(file);
 
-void UnloadShader(Shader shader) {
-    if (shader.id > 0) {
-        glDeleteShader(shader.id);
-        printf("[Program ID: %i] Unloaded shader program data\n", shader.id);
+    if (loaded) {
+        pending->programId = glCreateProgram();
+        glProgramBinary(pending->programId, header.format, binary, (GLsizei)header.length);
+        pending->fromCache = true;
     }
+
+    free(binary);
+    return loaded;
 }
 
-static void SetShaderDefaultLocations(Shader *shader) {
-    shader->locs[LOC_VERTEX_POSITION] = glGetAttribLocation(shader->id, DEFAULT_ATTRIB_POSITION_NAME);
-    shader->locs[LOC_VERTEX_COLOR] = glGetAttribLocation(shader->id, DEFAULT_ATTRIB_COLOR_NAME);
+// Written to a temporary file first, a crash mid-write never leaves a truncated binary behind
+static void SaveProgramBinary(const PendingShader *pending) {
+    if (!shaderBinarySupported || shaderCacheDir == NULL) return;
 
-    shader->locs[LOC_MATRIX_PROJECTION] = glGetUniformLocation(shader->id, "projection");
-    shader->locs[LOC_MATRIX_VIEW] = glGetUniformLocation(shader->id, "view");
-    shader->locs[LOC_MATRIX_MODEL] = glGetUniformLocation(shader->id, "model");
-}
+    GLint length = 0;
+    glGetProgramiv(pending->programId, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
 
-Entity CreateRect(Vector4 *color, glm::vec3 position) {
-    Entity entity;
-    entity.meshes = (Mesh *)malloc(sizeof(Mesh));
-    // entity.matrix = (mat4 *)malloc(sizeof(mat4));
+    ShaderBinaryHeader header = { 0 };
+    void *binary = malloc(length);
+    GLenum format = 0;
 
-    Mesh mesh = { 0 };
-    mesh.vertexCount = 12;
-    mesh.triangleCount = 4;
-    mesh.indicesCount = 6;
+    glGetProgramBinary(pending->programId, length, NULL, &format, binary);
 
-    mesh.vertices = (float *)malloc( 12 * sizeof(float));
-    mesh.colors = (float *)malloc( 16 * sizeof(float));
-    mesh.indices = (int *)malloc(6 * sizeof(unsigned int));
+    header.magic = SHADER_BINARY_MAGIC;
+    header.format = format;
+    header.key = pending->key;
+    header.length = (unsigned int)length;
 
-    float vertices[] = {
-         0.5f,  0.5f, 0.0f,  // top right
-         0.5f, -0.5f, 0.0f,  // bottom right
-        -0.5f, -0.5f, 0.0f,  // bottom left
-        -0.5f,  0.5f, 0.0f   // top left
-    };
+    char path[SHADER_CACHE_PATH_LENGTH];
+    char tempPath[SHADER_CACHE_PATH_LENGTH + 4];
+    GetShaderCachePath(path, sizeof(path), pending->key);
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
 
-    unsigned int indices[] = {
-        0, 1, 3,  // first Triangle
-        1, 2, 3   // second Triangle
-    };
+    mkdir(shaderCacheDir, 0755);
 
-    for (int i = 0; i < 12; i++) {
-        mesh.vertices[i] = vertices[i];
-    }
+    FILE *file = fopen(tempPath, "wb");
+    bool written = false;
 
-    if (color == NULL) {
-        // default white
-        // color = malloc(sizeof(Vector4));
-        color->x = 1.0f;
-        color->y = 1.0f;
-        color->z = 1.0f;
-        color->w = 1.0f;
+    if (file != NULL) {
+        written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, 1, length, file) == (size_t)length;
+        written = fclose(file) == 0 && written;
     }
 
-    for (int i = 0; i < 4; i++) {
-        mesh.colors[i * 4] = color->x;
-        mesh.colors[i * 4 + 1] = color->y;
-        mesh.colors[i * 4 + 2] = color->z;
-        mesh.colors[i * 4 + 3] = color->w;
-    }
+    if (written) written = rename(tempPath, path) == 0;
+    if (!written) printf("%s Shader cache file could not be written\n", path);
 
-    for (int i = 0; i < 6; i++) {
-        mesh.indices[i] = indices[i];
-    }
+    free(binary);
+}
 
-    glm::mat4 matrix = {
-        1, 0, 0, 0,
-        0, 1, 0, 0,
-        0, 0, 1, 0,
-        0, 0, 0, 1
-    };
+// Compiles and links from source, nothing waits for the driver
+static void BuildShaderProgram(PendingShader *pending) {
+    pending->programId = glCreateProgram();
+    pending->fromCache = false;
 
-    matrix = glm::translate(matrix, position);
-    entity.matrix = matrix;
+    if (pending->vsCode != NULL) pending->vertexId = CompileShader(pending->vsCode, GL_VERTEX_SHADER);
+    if (pending->fsCode != NULL) pending->fragmentId = CompileShader(pending->fsCode, GL_FRAGMENT_SHADER);
 
-    entity.meshes[0] = mesh;
-    entity.meshCount = 1;
+    if (pending->vertexId != 0) glAttachShader(pending->programId, pending->vertexId);
+    if (pending->fragmentId != 0) glAttachShader(pending->programId, pending->fragmentId);
 
-    return entity;
-}
+    glBindAttribLocation(pending->programId, 0, DEFAULT_ATTRIB_POSITION_NAME);
+    glBindAttribLocation(pending->programId, 1, DEFAULT_ATTRIB_COLOR_NAME);
+    glBindAttribLocation(pending->programId, 2, DEFAULT_ATTRIB_TEXCOORD_NAME);
+    glBindAttribLocation(pending->programId, LOC_VERTEX_INSTANCE_MODEL, DEFAULT_ATTRIB_INSTANCE_MODEL_NAME);
+    glBindAttribLocation(pending->programId, LOC_VERTEX_INSTANCE_COLOR, DEFAULT_ATTRIB_INSTANCE_COLOR_NAME);
 
-void DrawRect(Mesh mesh) {
-    // @TODO: transformations
-  StoreDataToBufferf(&bufferHandler.buffers[bufferHandler.currentBuffer].verticesBuffer, mesh.vertices, 12);
-  StoreDataToBufferf(&bufferHandler.buffers[bufferHandler.currentBuffer].colorsBuffer, mesh.colors, 16);
-  StoreDataToBufferi(&bufferHandler.buffers[bufferHandler.currentBuffer].indexBuffer, mesh.indices, 6, 4);
+    if (shaderBinarySupported && shaderCacheDir != NULL) {
+        glProgramParameteri(pending->programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    glLinkProgram(pending->programId);
+    shaderStats.programsCompiled++;
 }
 
-void RenderCod3rGL() {
-  // @TODO: 3D render
-  // @TODO: 2D render
-  // @TODO: Use bufferHandler
-  glUseProgram(defaultShader.id);
+static void ReleaseShaderSources(PendingShader *pending) {
+    if (pending->vertexId != 0) {
+        glDetachShader(pending->programId, pending->vertexId);
+        glDeleteShader(pending->vertexId);
+    }
 
-  for (int i = 0; i < bufferHandler.size; i++) {
-    glBindVertexArray(bufferHandler.buffers[i].vaoId);
-    glBindBuffer(GL_ARRAY_BUFFER, bufferHandler.buffers[i].verticesBuffer.bufferId);
-    glBufferData(
-                 GL_ARRAY_BUFFER,
-                 bufferHandler.buffers[i].verticesBuffer.vertexCount * sizeof(float),
-                 bufferHandler.buffers[i].verticesBuffer.data,
-                 GL_STATIC_DRAW
-                 );
+    if (pending->fragmentId != 0) {
+        glDetachShader(pending->programId, pending->fragmentId);
+        glDeleteShader(pending->fragmentId);
+    }
 
-    glVertexAttribPointer(LOC_VERTEX_POSITION, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-    glEnableVertexAttribArray(LOC_VERTEX_POSITION);
+    free(pending->vsCode);
+    free(pending->fsCode);
 
-    glBindBuffer(GL_ARRAY_BUFFER, bufferHandler.buffers[i].colorsBuffer.bufferId);
-    glBufferData(
-                 GL_ARRAY_BUFFER,
-                 bufferHandler.buffers[i].colorsBuffer.vertexCount * sizeof(float),
-                 bufferHandler.buffers[i].colorsBuffer.data,
-                 GL_STATIC_DRAW
-                 );
+    pending->vertexId = 0;
+    pending->fragmentId = 0;
+    pending->vsCode = NULL;
+    pending->fsCode = NULL;
+}
 
-    glVertexAttribPointer(LOC_VERTEX_COLOR, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-    glEnableVertexAttribArray(LOC_VERTEX_COLOR);
+// Reads the link result. Without `block`, returns SHADER_PENDING while the driver is still compiling in parallel.
+static ShaderStatus UpdatePendingShader(PendingShader *pending, bool block) {
+    if (pending->status != SHADER_PENDING) return pending->status;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferHandler.buffers[i].indexBuffer.bufferId);
-    glBufferData(
-                 GL_ELEMENT_ARRAY_BUFFER,
-                 bufferHandler.buffers[i].indexBuffer.vertexCount * sizeof(unsigned int),
-                 bufferHandler.buffers[i].indexBuffer.data,
-                 GL_STATIC_DRAW
-                 );
+    GLint success = GL_FALSE;
 
-    if (defaultShader.locs[LOC_MATRIX_PROJECTION] != -1) {
-        glUniformMatrix4fv(defaultShader.locs[LOC_MATRIX_PROJECTION], 1, GL_FALSE, glm::value_ptr(projection));
+    if (!block && shaderStats.parallelCompile) {
+        glGetProgramiv(pending->programId, GL_COMPLETION_STATUS_KHR, &success);
+        if (success == GL_FALSE) return SHADER_PENDING;
     }
 
-    if (defaultShader.locs[LOC_MATRIX_VIEW] != -1) {
-        glUniformMatrix4fv(defaultShader.locs[LOC_MATRIX_VIEW], 1, GL_FALSE, glm::value_ptr(GetViewMatrixCamera()));
-    }
+    glGetProgramiv(pending->programId, GL_LINK_STATUS, &success);
+
+    // The driver rejects binaries it can no longer load, they are compiled again and replaced
+    if (success == GL_FALSE && pending->fromCache) {
+        printf("[Program ID: %i] Cached shader program is stale, compiling it again\n", pending->programId);
+        glDeleteProgram(pending->programId);
+        shaderStats.programsStale++;
 
-    if (defaultShader.locs[LOC_MATRIX_MODEL] != -1) {
-        glUniformMatrix4fv(defaultShader.locs[LOC_MATRIX_MODEL], 1, GL_FALSE, glm::value_ptr(model));
+        BuildShaderProgram(pending);
+        return SHADER_PENDING;
     }
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (success == GL_FALSE) {
+        printf("[Program ID: %i] Failed to link shader program...\n", pending->programId);
+        if (pending->vertexId != 0) PrintShaderLog(pending->vertexId);
+        if (pending->fragmentId != 0) PrintShaderLog(pending->fragmentId);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferHandler.buffers[i].indexBuffer.bufferId);
+        int maxLength = 0;
+        int length;
 
-    glDrawElements(GL_TRIANGLES, bufferHandler.buffers[i].indexBuffer.vertexCount, GL_UNSIGNED_INT, 0);
+        glGetProgramiv(pending->programId, GL_INFO_LOG_LENGTH, &maxLength);
+        char log[maxLength + 1];
+        log[0] = '\0';
 
-    glDisable(GL_BLEND);
+        glGetProgramInfoLog(pending->programId, maxLength + 1, &length, log);
 
-    CleanBuffer(i);
-  }
+        printf("%s", log);
 
-  glBindVertexArray(0);
-  glUseProgram(0);
-}
+        ReleaseShaderSources(pending);
+        glDeleteProgram(pending->programId);
+        pending->programId = 0;
+        pending->status = SHADER_FAILED;
+    } else {
+        if (pending->fromCache) {
+            shaderStats.programsLoaded++;
+        } else {
+            SaveProgramBinary(pending);
+        }
 
-void InitCod3rGL(int windowWidth, int windowHeight) {
-  // Initialise buffers
-  bufferHandler.buffers = (Buffer *)malloc(MAX_BUFFERS_RENDER * sizeof(struct Buffer));
-  Buffer buffer = CreateBuffer(BufferRenderType::Elements); // Creates default Buffer
-  StoreBuffer(&buffer);
+        ReleaseShaderSources(pending);
+        printf("[Program ID: %i] Shader program loaded successfully%s\n", pending->programId,
+               pending->fromCache ? " from the cache" : "");
+        pending->status = SHADER_READY;
+    }
 
-  defaultShader = LoadShader("src/shaders/vertex.glsl", "src/shaders/fragment.glsl");
+    // Startup time covers every period with programs in flight
+    if (--shaderPendingCount == 0) {
+        shaderStats.startupMs += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - shaderBusyStart
+        ).count();
+    }
 
-  // setup matrices
-  projection = glm::perspective(glm::radians(45.0f), (float)windowWidth / (float)windowHeight, 0.1f, 100.0f);
+    return pending->status;
 }
 
-void CleanCod3rGL() {
-  for (int i = 0; i < bufferHandler.size; i++) {
-    glDeleteVertexArrays(1, &bufferHandler.buffers[i].vaoId);
-    glDeleteBuffers(1, &bufferHandler.buffers[i].verticesBuffer.bufferId);
-    glDeleteBuffers(1, &bufferHandler.buffers[i].colorsBuffer.bufferId);
-    glDeleteBuffers(1, &bufferHandler.buffers[i].indexBuffer.bufferId);
-  }
-}
+static char *CopyShaderCode(const char *code) {
+    if (code == NULL) return NULL;
 
-void StoreDataToBufferf(DynamicFBuffer *buffer, float *data, int dataSize) {
-    for (int i = 0; i < dataSize; i++) {
-        buffer->data[buffer->vertexCount + i] = data[i];
-    }
+    size_t size = strlen(code) + 1;
+    char *copy = (char *)malloc(size);
+    memcpy(copy, code, size);
 
-    buffer->vertexCount += dataSize;
+    return copy;
 }
 
-void StoreDataToBufferi(DynamicIBuffer *buffer, int *data, int dataSize, int numTriangles) {
-    for (int i = 0; i < dataSize; i++) {
-        buffer->data[buffer->vertexCount + i] = data[i] + buffer->triangleCount;
-    }
+int QueueShaderCode(const char *vsCode, const char *fsCode) {
+    int handle = -1;
 
-    buffer->vertexCount += dataSize;
-    buffer->triangleCount += numTriangles;
-}
+    for (int i = 0; i < MAX_PENDING_SHADERS && handle == -1; i++) {
+        if (!pendingShaders[i].used) handle = i;
+    }
 
-void DrawEntity(Entity entity) {
-    for (int i = 0; i < entity.meshCount; i++) {
-        // apply matrix to vertex
-        float formattedVertex[entity.meshes[i].vertexCount];
-        glm::vec4 newPos = { 0.0f, 0.0f, 0.0f, 0.0f };
-        for (int vertIndex = 0; vertIndex < entity.meshes[i].vertexCount;) {
-            // glm_mat4_mulv(entity.matrix, (vec4){entity.meshes[i].vertices[vertIndex], entity.meshes[i].vertices[vertIndex + 1], entity.meshes[i].vertices[vertIndex + 2], 0.01f}, newPos);
-            newPos = entity.matrix * glm::vec4(entity.meshes[i].vertices[vertIndex], entity.meshes[i].vertices[vertIndex + 1], entity.meshes[i].vertices[vertIndex + 2], 0.01f);
-            formattedVertex[vertIndex] = newPos[0];
-            formattedVertex[vertIndex + 1] = newPos[1];
-            formattedVertex[vertIndex + 2] = newPos[2];
-
-            vertIndex++;
-            vertIndex++;
-            vertIndex++;
-        }
-
-        StoreDataToBufferf(
-                           &bufferHandler.buffers[bufferHandler.currentBuffer].verticesBuffer,
-                           formattedVertex,
-                           entity.meshes[i].vertexCount
-                           );
-        StoreDataToBufferf(
-                           &bufferHandler.buffers[bufferHandler.currentBuffer].colorsBuffer,
-                           entity.meshes[i].colors,
-                           entity.meshes[i].vertexCount + entity.meshes[i].triangleCount
-                           );
-        StoreDataToBufferi(
-                           &bufferHandler.buffers[bufferHandler.currentBuffer].indexBuffer,
-                           entity.meshes[i].indices,
-                           entity.meshes[i].indicesCount,
-                           entity.meshes[i].triangleCount
-                           );
+    if (handle == -1) {
+        printf("Too many shader programs building, max: %i\n", MAX_PENDING_SHADERS);
+        return -1;
     }
-}
 
-void RotateEntityZ(Entity *entity, float angle) {
-    glm::mat4 matrix = {
-        1, 0, 0, 0,
-        0, 1, 0, 0,
-        0, 0, 1, 0,
-        0, 0, 0, 1
-    };
+    InitShaderManager();
 
-    entity->matrix = glm::rotate(entity->matrix, glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
-}
+    PendingShader *pending = &pendingShaders[handle];
+    *pending = { 0 };
+    pending->used = true;
+    pending->status = SHADER_PENDING;
 
-void SetupCamera(glm::vec3 position, glm::vec3 up, float yaw, float pitch) {
-    currentCamera.position = position;
-    currentCamera.worldUp = up;
+    unsigned long long key = shaderDriverHash;
+    if (vsCode != NULL) key = HashBytes(key, vsCode, strlen(vsCode) + 1);
+    key = HashBytes(key, "|", 1);
+    if (fsCode != NULL) key = HashBytes(key, fsCode, strlen(fsCode) + 1);
+    pending->key = key;
 
-    currentCamera.yaw = yaw;
-    currentCamera.pitch = pitch;
+    if (shaderPendingCount++ == 0) shaderBusyStart = std::chrono::steady_clock::now();
 
-    currentCamera.front = glm::vec3(0.0f, 0.0f, -1.0f);
-    currentCamera.movementSpeed = 2.5f;
-    currentCamera.mouseSensitivity = 0.1f;
-    currentCamera.zoom = 45.0f;
+    // Sources are kept until the program is linked, in case the driver rejects the cached binary
+    pending->vsCode = CopyShaderCode(vsCode);
+    pending->fsCode = CopyShaderCode(fsCode);
 
-    UpdateCameraVectors();
+    if (!LoadProgramBinary(pending)) BuildShaderProgram(pending);
+
+    return handle;
 }
 
-void UpdateCameraVectors() {
-    glm::vec3 front;
+int QueueShader(const char *vsFileName, const char *fsFileName) {
+    char *vShaderStr = NULL;
+    char *fShaderStr = NULL;
+
+    if (vsFileName != NULL) vShaderStr = LoadText(vsFileName);
+    if (fsFileName != NULL) fShaderStr = LoadText(fsFileName);
+
+    int handle = QueueShaderCode(vShaderStr, fShaderStr);
+
+    if (vShaderStr != NULL) free(vShaderStr);
+    if (fShaderStr != NULL) free(fShaderStr);
+
+    return handle;
+}
+
+ShaderStatus PollShader(int handle) {
+    if (handle < 0 || handle >= MAX_PENDING_SHADERS || !pendingShaders[handle].used) return SHADER_FAILED;
+
+    return UpdatePendingShader(&pendingShaders[handle], false);
+}
+
+Shader WaitShader(int handle) {
+    Shader shader = { 0 };
+    shader.locs = (int *)malloc(MAX_SHADER_LOCATIONS * sizeof(int));
+
+    if (handle < 0 || handle >= MAX_PENDING_SHADERS || !pendingShaders[handle].used) {
+        std::cout << "Custom shader could not be" << std::endl;
+        return shader;
+    }
+
+    PendingShader *pending = &pendingShaders[handle];
+
+    while (UpdatePendingShader(pending, true) == SHADER_PENDING) {}
+
+    shader.id = pending->programId;
+    pending->used = false;
+
+    if (shader.id == 0) std::cout << "Custom shader could not be" << std::endl;
+
+    if (shader.id > 0) SetShaderDefaultLocations(&shader);
+
+    return shader;
+}
+
+void SetShaderCacheDir(const char *directory) {
+    shaderCacheDir = directory;
+}
+
+ShaderCacheStats GetShaderCacheStats() {
+    return shaderStats;
+}
+
+void UnloadShader(Shader shader) {
+    free(shader.uniforms);
+    free(shader.locs);
+
+    if (shader.id > 0) {
+        glDeleteProgram(shader.id);
+        ResetStateCache();
+        printf("[Program ID: %i] Unloaded shader program data\n", shader.id);
+    }
+}
+
+// Bytes of one element of a uniform, 0 for the types StateSetUniform cannot send (doubles...)
+static int GetUniformTypeSize(unsigned int type) {
+    switch (type) {
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: return 8;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: return 12;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_FLOAT_MAT2: return 16;
+        case GL_FLOAT_MAT3: return 36;
+        case GL_FLOAT_MAT4: return 64;
+        case GL_FLOAT: case GL_INT: case GL_BOOL: case GL_SAMPLER_2D: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_CUBE: return 4;
+        default: return 0;
+    }
+}
+
+// Default block uniforms get an offset each in the values the state cache keeps. Block members are left to their
+// buffer, the frame block is bound to FRAME_UNIFORM_BINDING again after every load (linking resets it).
+static void ReflectShaderUniforms(Shader *shader) {
+    GLint activeCount = 0;
+    glGetProgramiv(shader->id, GL_ACTIVE_UNIFORMS, &activeCount);
+
+    shader->uniforms = (ShaderUniform *)malloc((activeCount + 1) * sizeof(ShaderUniform));
+    shader->uniformCount = 0;
+    shader->uniformDataSize = 0;
+
+    for (GLuint i = 0; i < (GLuint)activeCount; i++) {
+        GLint block = -1;
+        glGetActiveUniformsiv(shader->id, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block);
+        if (block != -1) continue;
+
+        if (shader->uniformCount == MAX_SHADER_UNIFORMS) {
+            printf("[Program ID: %i] Too many uniforms, max: %i\n", shader->id, MAX_SHADER_UNIFORMS);
+            break;
+        }
+
+        ShaderUniform *uniform = &shader->uniforms[shader->uniformCount];
+        GLint count = 0;
+        GLenum type = 0;
+        glGetActiveUniform(shader->id, i, SHADER_UNIFORM_NAME_LENGTH, NULL, &count, &type, uniform->name);
+
+        char *bracket = strchr(uniform->name, '[');
+        if (bracket != NULL) *bracket = '\0';
+
+        uniform->location = glGetUniformLocation(shader->id, uniform->name);
+        uniform->type = type;
+        uniform->count = count;
+        uniform->size = GetUniformTypeSize(type) * count;
+        if (uniform->location == -1 || uniform->size == 0) continue;
+
+        uniform->offset = shader->uniformDataSize;
+        shader->uniformDataSize += (uniform->size + 15) & ~15;
+        shader->uniformCount++;
+    }
+
+    const GLuint frameBlock = glGetUniformBlockIndex(shader->id, FRAME_UNIFORM_BLOCK_NAME);
+    if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(shader->id, frameBlock, FRAME_UNIFORM_BINDING);
+}
+
+int GetShaderUniform(const Shader *shader, const char *name) {
+    for (int i = 0; i < shader->uniformCount; i++) {
+        if (strcmp(shader->uniforms[i].name, name) == 0) return i;
+    }
+
+    return -1;
+}
+
+static void SetShaderDefaultLocations(Shader *shader) {
+    shader->locs[LOC_VERTEX_POSITION] = glGetAttribLocation(shader->id, DEFAULT_ATTRIB_POSITION_NAME);
+    shader->locs[LOC_VERTEX_COLOR] = glGetAttribLocation(shader->id, DEFAULT_ATTRIB_COLOR_NAME);
+    shader->locs[LOC_VERTEX_TEXCOORD] = glGetAttribLocation(shader->id, DEFAULT_ATTRIB_TEXCOORD_NAME);
+
+    ReflectShaderUniforms(shader);
+
+    const char *matrixNames[3] = { "projection", "view", "model" };
+
+    for (int i = 0; i < 3; i++) {
+        const int uniform = GetShaderUniform(shader, matrixNames[i]);
+        shader->locs[LOC_MATRIX_PROJECTION + i] = uniform != -1 ? shader->uniforms[uniform].location : -1;
+    }
+}
+
+Entity CreateRect(Vector4 *color, glm::vec3 position) {
+    Entity entity;
+    entity.meshes = (Mesh *)malloc(sizeof(Mesh));
+    // entity.matrix = (mat4 *)malloc(sizeof(mat4));
+
+    Mesh mesh = { 0 };
+    mesh.vertexCount = 12;
+    mesh.triangleCount = 4;
+    mesh.indicesCount = 6;
+
+    // Rect geometry is shared, only colors are owned by the entity
+    mesh.vertices = rectVertices;
+    mesh.indices = rectIndices;
+    mesh.colors = (float *)malloc( 16 * sizeof(float));
+
+    if (color == NULL) {
+        // default white
+        // color = malloc(sizeof(Vector4));
+        color->x = 1.0f;
+        color->y = 1.0f;
+        color->z = 1.0f;
+        color->w = 1.0f;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        mesh.colors[i * 4] = color->x;
+        mesh.colors[i * 4 + 1] = color->y;
+        mesh.colors[i * 4 + 2] = color->z;
+        mesh.colors[i * 4 + 3] = color->w;
+    }
+
+    glm::mat4 matrix = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    };
+
+    matrix = glm::translate(matrix, position);
+    entity.matrix = matrix;
+
+    ComputeMeshBounds(&mesh);
+
+    entity.meshes[0] = mesh;
+    entity.meshCount = 1;
+
+    return entity;
+}
+
+void DrawRect(Mesh mesh) {
+    // @TODO: transformations
+    DrawMesh(&mesh, glm::mat4(1.0f));
+}
+
+// Waits until the GPU is done with the region of the current stream frame
+static void WaitStreamFrame() {
+    frameStats = { 0 };
+
+    if (streamFences[streamFrame] == NULL) return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    GLenum result = glClientWaitSync(streamFences[streamFrame], 0, 0);
+
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(streamFences[streamFrame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+
+    frameStats.stallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    glDeleteSync(streamFences[streamFrame]);
+    streamFences[streamFrame] = NULL;
+}
+
+// Called before the first write of a frame, which can happen before RenderCod3rGL when a batch fills
+static void BeginStreamFrame() {
+    if (streamFrameReady) return;
+
+    WaitStreamFrame();
+    streamFrameReady = true;
+}
+
+// Protects the region written this frame and moves to the next one
+static void FenceStreamFrame() {
+    streamFences[streamFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    streamFrameReady = false;
+
+    FrameArena *arena = &frameArenas[streamFrame];
+    if ((long long)arena->used > frameArenaHighWater) frameArenaHighWater = arena->used;
+
+    frameStats.arenaBytesUsed = arena->used;
+    frameStats.arenaHighWater = frameArenaHighWater;
+    frameStats.arenaFailedAllocs = frameArenaFailedAllocs;
+    frameArenaFailedAllocs = 0;
+
+    frameStats.stateCallsIssued = stateCallsIssued;
+    frameStats.stateCallsSkipped = stateCallsSkipped;
+    stateCallsIssued = 0;
+    stateCallsSkipped = 0;
+
+    streamFrame = (streamFrame + 1) % STREAM_FRAMES_IN_FLIGHT;
+
+    // Oldest arena, its frame was submitted STREAM_FRAMES_IN_FLIGHT - 1 frames ago
+    frameArenas[streamFrame].used = 0;
+
+    lastFrameStats = frameStats;
+
+    PROFILE_COUNTER("draw_calls", frameStats.drawCalls);
+    PROFILE_COUNTER("vertices", (double)frameStats.verticesDrawn);
+    PROFILE_COUNTER("bytes_uploaded", (double)frameStats.bytesUploaded);
+    PROFILE_COUNTER("stall_ms", frameStats.stallTimeMs);
+}
+
+void *FrameAlloc(size_t size, size_t alignment) {
+    FrameArena *arena = &frameArenas[streamFrame];
+    size_t offset = (arena->used + alignment - 1) & ~(alignment - 1);
+
+    if (offset + size > arena->capacity) {
+        printf("Frame arena full, %i bytes requested, capacity: %i\n", (int)size, (int)arena->capacity);
+        frameArenaFailedAllocs++;
+        return NULL;
+    }
+
+    arena->used = offset + size;
+    return arena->memory + offset;
+}
+
+static void *RecordUpload(CommandBuffer *buffer, unsigned int bufferId, long offset, int size);
+
+// The region is fenced, so it can be mapped unsynchronized without waiting on the driver. NULL only when the map
+// failed and the staging copy could not be allocated either.
+static void *MapStreamRegion(unsigned int target, unsigned int bufferId, long offset, long size) {
+    StateBindBuffer(target, bufferId);
+
+    void *dst = glMapBufferRange(target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+    // The region is written to the CPU staging copy instead, glBufferSubData uploads it on unmap
+    if (dst == NULL) {
+        if (streamStagingSize < size) {
+            void *staging = realloc(streamStaging, size);
+            if (staging == NULL) {
+                printf("[Buffer ID: %i] Failed to map streaming region\n", bufferId);
+                return NULL;
+            }
+
+            streamStaging = staging;
+            streamStagingSize = size;
+        }
+
+        streamStagingOffset = offset;
+        dst = streamStaging;
+    }
+
+    frameStats.bytesUploaded += size;
+
+    // The mapping is write only: a captured frame is written to an upload command, copied over by UnmapStreamRegion
+    if (captureRecording) {
+        captureMapping = dst;
+        return RecordUpload(captureCommands, bufferId, offset, (int)size);
+    }
+
+    return dst;
+}
+
+static void UnmapStreamRegion(unsigned int target, const void *written, long size) {
+    if (captureMapping != NULL) {
+        memcpy(captureMapping, written, size);
+        captureMapping = NULL;
+    }
+
+    if (streamStagingOffset >= 0) {
+        glBufferSubData(target, streamStagingOffset, size, streamStaging);
+        streamStagingOffset = -1;
+        return;
+    }
+
+    glUnmapBuffer(target);
+}
+
+// Writes the batch vertices into the region in the GPU layout of the buffer format
+static bool UploadBatchVertices(Buffer *buffer, BatchStream *stream, int baseVertex) {
+    const int stride = GetVertexFormatStride(buffer->format);
+    const int vertexCount = buffer->vertexBuffer.vertexCount;
+
+    void *dst = MapStreamRegion(GL_ARRAY_BUFFER, stream->vertexBufferId, (long)baseVertex * stride, (long)vertexCount * stride);
+    if (dst == NULL) return false;
+
+    if (buffer->format == VERTEX_FORMAT_COMPACT) {
+        CompactBatchVertex *compact = (CompactBatchVertex *)dst;
+
+        for (int i = 0; i < vertexCount; i++) {
+            const BatchVertex *v = &buffer->vertexBuffer.data[i];
+            compact[i].position[0] = glm::packHalf1x16(v->position[0]);
+            compact[i].position[1] = glm::packHalf1x16(v->position[1]);
+            compact[i].position[2] = glm::packHalf1x16(v->position[2]);
+            compact[i].position[3] = 0;
+            compact[i].color = v->color;
+            compact[i].texcoord[0] = v->texcoord[0];
+            compact[i].texcoord[1] = v->texcoord[1];
+        }
+    } else {
+        memcpy(dst, buffer->vertexBuffer.data, (size_t)vertexCount * stride);
+    }
+
+    UnmapStreamRegion(GL_ARRAY_BUFFER, dst, (long)vertexCount * stride);
+    return true;
+}
+
+// Returns the index type used for the draw, 0 if the upload failed
+static GLenum UploadBatchIndices(Buffer *buffer, BatchStream *stream, long indexOffset) {
+    const int indexCount = buffer->indexBuffer.vertexCount;
+    const bool shortIndices = buffer->vertexBuffer.vertexCount < 65536;
+    const int indexSize = shortIndices ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    void *dst = MapStreamRegion(GL_ELEMENT_ARRAY_BUFFER, stream->indexBufferId, indexOffset, (long)indexCount * indexSize);
+    if (dst == NULL) return 0;
+
+    if (shortIndices) {
+        unsigned short *indices = (unsigned short *)dst;
+        for (int i = 0; i < indexCount; i++) indices[i] = (unsigned short)buffer->indexBuffer.data[i];
+    } else {
+        memcpy(dst, buffer->indexBuffer.data, (size_t)indexCount * indexSize);
+    }
+
+    UnmapStreamRegion(GL_ELEMENT_ARRAY_BUFFER, dst, (long)indexCount * indexSize);
+    return shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+static void CreateBatchStream(BatchStream *stream, BufferRenderType type, VertexFormat format);
+
+// Points the instance attributes of the bound VAO at `offset` in the bound instance ring
+static void SetInstanceAttribPointers(long offset) {
+  for (int column = 0; column < 4; column++) {
+    glVertexAttribPointer(LOC_VERTEX_INSTANCE_MODEL + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(offset + column * sizeof(glm::vec4)));
+  }
+  glVertexAttribPointer(LOC_VERTEX_INSTANCE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(InstanceData), (void *)(offset + offsetof(InstanceData, color)));
+}
+
+static void ResetBatch(Buffer *buffer) {
+  buffer->vertexBuffer.vertexCount = 0;
+  buffer->vertexBuffer.translucent = false;
+  buffer->indexBuffer.vertexCount = 0;
+  buffer->indexBuffer.triangleCount = 0;
+}
+
+// Uploads the batch into the next stream of the pool and empties it, the draw is issued by RenderCod3rGL
+static void FlushBatch(Buffer *buffer) {
+  if (buffer->vertexBuffer.vertexCount == 0) return;
+
+  BeginStreamFrame();
+
+  if (buffer->usedStreams == buffer->streamCount) {
+    buffer->streams = (BatchStream *)realloc(buffer->streams, (buffer->streamCount + 1) * sizeof(BatchStream));
+    CreateBatchStream(&buffer->streams[buffer->streamCount++], buffer->type, buffer->format);
+  }
+
+  BatchStream *stream = &buffer->streams[buffer->usedStreams];
+  const int baseVertex = streamFrame * batchVertexCapacity;
+  const long indexOffset = (long)streamFrame * batchIndexCapacity * sizeof(unsigned int);
+
+  // The index map binds the element array buffer of this VAO
+  StateBindVertexArray(stream->vaoId);
+
+  bool uploaded = UploadBatchVertices(buffer, stream, baseVertex);
+
+  if (uploaded && buffer->type == BufferRenderType::Elements) {
+    stream->indexType = UploadBatchIndices(buffer, stream, indexOffset);
+    stream->drawCount = buffer->indexBuffer.vertexCount;
+    uploaded = stream->indexType != 0;
+  } else {
+    stream->drawCount = buffer->vertexBuffer.vertexCount;
+  }
+
+  stream->layer = renderLayer;
+  stream->translucent = buffer->vertexBuffer.translucent;
+  stream->textureId = buffer->textureId;
+  stream->textureLayer = buffer->textureLayer;
+
+  if (uploaded) buffer->usedStreams++;
+
+  ResetBatch(buffer);
+}
+
+void SetRenderLayer(int layer) {
+  if (layer < 0 || layer >= MAX_RENDER_LAYERS) {
+    printf("Invalid render layer %i, max: %i\n", layer, MAX_RENDER_LAYERS - 1);
+    return;
+  }
+
+  if (recordingPacket != NULL) {
+    recordingPacket->layer = layer;
+    return;
+  }
+
+  if (layer == renderLayer) return;
+
+  // A batch holds one layer, what was batched so far keeps the previous one
+  for (int i = 0; i < bufferHandler.size; i++) FlushBatch(&bufferHandler.buffers[i]);
+  for (int i = 0; i < quadBufferCount; i++) FlushBatch(&quadBuffers[i]);
+
+  renderLayer = layer;
+}
+
+// Positive floats keep their order as integers, the top 24 bits are enough to sort
+static inline unsigned long long QuantizeDepth(float depth) {
+  if (!(depth > 0.0f)) return 0;
+
+  unsigned int bits;
+  memcpy(&bits, &depth, sizeof(float));
+
+  return bits >> 7;
+}
+
+static inline unsigned long long MakeRenderKey(int layer, bool translucent, int shader, int mesh, float depth) {
+  unsigned long long key = (unsigned long long)layer << 61;
+  const unsigned long long depthBits = QuantizeDepth(depth);
+
+  if (translucent) {
+    key |= 1ULL << 60;
+    key |= (0xFFFFFFULL - depthBits) << 36;
+    key |= (unsigned long long)(shader & 0x3F) << 30;
+    key |= (unsigned long long)(mesh & 0xFFFF) << 14;
+  } else {
+    key |= (unsigned long long)(shader & 0x3F) << 54;
+    key |= (unsigned long long)(mesh & 0xFFFF) << 38;
+    key |= depthBits << 14;
+  }
+
+  return key;
+}
+
+void SortRenderKeys(RenderKey *keys, RenderKey *scratch, int count) {
+  if (count < 2) return;
+
+  RenderKey *src = keys;
+  RenderKey *dst = scratch;
+
+  // Histograms of the 8 key bytes in one read of the keys
+  int histograms[8][256] = { { 0 } };
+
+  for (int i = 0; i < count; i++) {
+    const unsigned long long key = keys[i].key;
+    for (int byte = 0; byte < 8; byte++) histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+  }
+
+  for (int byte = 0; byte < 8; byte++) {
+    const int shift = byte * 8;
+    int *histogram = histograms[byte];
+
+    // Every key has the same byte, the pass would not move anything
+    if (histogram[(src[0].key >> shift) & 0xFF] == count) continue;
+
+    int offset = 0;
+    for (int b = 0; b < 256; b++) {
+      int bucket = histogram[b];
+      histogram[b] = offset;
+      offset += bucket;
+    }
+
+    for (int i = 0; i < count; i++) dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+    RenderKey *swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  if (src != keys) memcpy(keys, src, count * sizeof(RenderKey));
+}
+
+// Streams the models of the arena draws then the instances of every group into the instance ring, returns false if
+// the ring could not be mapped
+static bool UploadInstances(long regionOffset) {
+  if (frameInstanceCount == 0) return true;
+
+  InstanceData *dst = (InstanceData *)MapStreamRegion(GL_ARRAY_BUFFER, instanceBufferId, regionOffset, frameInstanceCount * sizeof(InstanceData));
+  if (dst == NULL) return false;
+
+  for (StaticDrawBlock *block = staticDrawFirst; block != NULL; block = block->next) {
+    for (int i = 0; i < block->count; i++) {
+      const StaticDraw *draw = &block->items[i];
+      if (draw->instance < 0) continue;
+
+      dst[draw->instance].model = draw->model;
+      dst[draw->instance].color = 0xffffffff;
+    }
+  }
+  dst += frameGeometryDrawCount;
+
+  for (int i = 0; i < instancedMeshCount; i++) {
+    for (int layer = 0; layer < MAX_RENDER_LAYERS; layer++) {
+      for (InstanceBlock *block = instancedMeshes[i].groups[layer].firstBlock; block != NULL; block = block->next) {
+        memcpy(dst, block->items, block->count * sizeof(InstanceData));
+        dst += block->count;
+      }
+    }
+  }
+
+  UnmapStreamRegion(GL_ARRAY_BUFFER, dst - frameInstanceCount, frameInstanceCount * sizeof(InstanceData));
+
+  return true;
+}
+
+// Collects the batch streams, registry draws and instance groups of the frame as sorted commands
+static int BuildRenderQueue(RenderCommand **commands, RenderKey **keys, const glm::mat4 &view) {
+  int capacity = staticDrawCount + instancedMeshCount * MAX_RENDER_LAYERS;
+  for (int i = 0; i < bufferHandler.size; i++) capacity += bufferHandler.buffers[i].usedStreams;
+  for (int i = 0; i < quadBufferCount; i++) capacity += quadBuffers[i].usedStreams;
+
+  if (capacity == 0) return 0;
+
+  const size_t commandBytes = ((size_t)capacity * sizeof(RenderCommand) + 15) & ~(size_t)15;
+  const size_t keyBytes = ((size_t)capacity * sizeof(RenderKey) + 15) & ~(size_t)15;
+  const size_t bytes = commandBytes + 2 * keyBytes;
+  unsigned char *memory = (unsigned char *)FrameAlloc(bytes, 16);
+
+  // A full arena does not cost the frame, the queue goes to the heap
+  if (memory == NULL) {
+    if (renderQueueHeapSize < bytes) {
+      unsigned char *heap = (unsigned char *)realloc(renderQueueHeap, bytes);
+      if (heap == NULL) return 0;
+
+      renderQueueHeap = heap;
+      renderQueueHeapSize = bytes;
+    }
+
+    memory = renderQueueHeap;
+  }
+
+  *commands = (RenderCommand *)memory;
+  *keys = (RenderKey *)(memory + commandBytes);
+  RenderKey *scratch = (RenderKey *)(memory + commandBytes + keyBytes);
+
+  int count = 0;
+
+  for (int i = 0; i < bufferHandler.size; i++) {
+    Buffer *buffer = &bufferHandler.buffers[i];
+
+    for (int s = 0; s < buffer->usedStreams; s++) {
+      BatchStream *stream = &buffer->streams[s];
+
+      // Batches have no single depth, streams of a buffer keep their order since the sort is stable
+      (*commands)[count] = { RENDER_COMMAND_BATCH, 0, 0, stream };
+      (*keys)[count].key = MakeRenderKey(stream->layer, stream->translucent, RENDER_SHADER_DEFAULT, i, 0.0f);
+      (*keys)[count].command = count;
+      count++;
+    }
+  }
+
+  for (int i = 0; i < quadBufferCount; i++) {
+    Buffer *buffer = &quadBuffers[i];
+
+    // Texture ids do not fit the key, the first batch sampling the texture stands for it this frame
+    int textureIndex = 0;
+    while (quadBuffers[textureIndex].textureId != buffer->textureId) textureIndex++;
+
+    for (int s = 0; s < buffer->usedStreams; s++) {
+      BatchStream *stream = &buffer->streams[s];
+
+      // Batches of the same texture follow each other, it is bound once for all its layers
+      (*commands)[count] = { RENDER_COMMAND_BATCH, 0, 0, stream };
+      (*keys)[count].key = MakeRenderKey(stream->layer, stream->translucent, RENDER_SHADER_TEXTURED, textureIndex * MAX_QUAD_BATCHES + i, 0.0f);
+      (*keys)[count].command = count;
+      count++;
+    }
+  }
+
+  for (StaticDrawBlock *block = staticDrawFirst; block != NULL; block = block->next) {
+    for (int i = 0; i < block->count; i++) {
+      StaticDraw *draw = &block->items[i];
+      StaticMesh *mesh = &staticMeshes[draw->registryId - 1];
+
+      if (mesh->refCount == 0) continue; // Unloaded after being drawn
+
+      const float depth = -(view * model * draw->model[3]).z;
+
+      // Draws of an arena sort next to each other, front to back when opaque
+      if (draw->instance >= 0) {
+        (*commands)[count] = { RENDER_COMMAND_GEOMETRY, 0, 0, draw };
+        (*keys)[count].key = MakeRenderKey(draw->layer, mesh->translucent, RENDER_SHADER_GEOMETRY, mesh->arenaId - 1, depth);
+      } else {
+        (*commands)[count] = { RENDER_COMMAND_STATIC, 0, 0, draw };
+        (*keys)[count].key = MakeRenderKey(draw->layer, mesh->translucent, RENDER_SHADER_DEFAULT, MAX_BUFFERS_RENDER + draw->registryId, depth);
+      }
+      (*keys)[count].command = count;
+      count++;
+    }
+  }
+
+  long offset = ((long)streamFrame * MAX_INSTANCES_PER_FRAME + frameGeometryDrawCount) * sizeof(InstanceData);
+
+  for (int i = 0; i < instancedMeshCount; i++) {
+    for (int layer = 0; layer < MAX_RENDER_LAYERS; layer++) {
+      InstanceGroup *group = &instancedMeshes[i].groups[layer];
+
+      if (group->instanceCount == 0) continue;
+
+      (*commands)[count] = { RENDER_COMMAND_INSTANCED, group->instanceCount, offset, &instancedMeshes[i] };
+      (*keys)[count].key = MakeRenderKey(layer, group->translucent, RENDER_SHADER_INSTANCED, i, 0.0f);
+      (*keys)[count].command = count;
+      count++;
+
+      offset += group->instanceCount * sizeof(InstanceData);
+    }
+  }
+
+  SortRenderKeys(*keys, scratch, count);
+
+  return count;
+}
+
+CommandBuffer *CreateCommandBuffer() {
+  CommandBuffer *buffer = (CommandBuffer *)malloc(sizeof(CommandBuffer));
+  *buffer = { 0 };
+
+  return buffer;
+}
+
+void DestroyCommandBuffer(CommandBuffer *buffer) {
+  if (buffer == NULL) return;
+
+  free(buffer->commands);
+  free(buffer->data);
+  free(buffer);
+}
+
+void ResetCommandBuffer(CommandBuffer *buffer) {
+  buffer->commandCount = 0;
+  buffer->dataSize = 0;
+}
+
+static GpuCommand *RecordCommand(CommandBuffer *buffer, GpuCommandType type) {
+  if (buffer->commandCount == buffer->commandCapacity) {
+    buffer->commandCapacity = buffer->commandCapacity == 0 ? 256 : buffer->commandCapacity * 2;
+    buffer->commands = (GpuCommand *)realloc(buffer->commands, buffer->commandCapacity * sizeof(GpuCommand));
+  }
+
+  GpuCommand *command = &buffer->commands[buffer->commandCount++];
+  *command = { 0 };
+  command->type = type;
+
+  return command;
+}
+
+// Payload space, valid until the next command is recorded into the buffer
+static void *ReserveCommandData(CommandBuffer *buffer, size_t size, unsigned long long *offset) {
+  const size_t start = (buffer->dataSize + 15) & ~(size_t)15;
+
+  if (start + size > buffer->dataCapacity) {
+    size_t capacity = buffer->dataCapacity == 0 ? 4096 : buffer->dataCapacity;
+    while (capacity < start + size) capacity *= 2;
+
+    buffer->data = (unsigned char *)realloc(buffer->data, capacity);
+    buffer->dataCapacity = capacity;
+  }
+
+  buffer->dataSize = start + size;
+  *offset = start;
+
+  return buffer->data + start;
+}
+
+void CmdUseShader(CommandBuffer *buffer, int shader) {
+  RecordCommand(buffer, GPU_COMMAND_USE_SHADER)->resource = shader;
+}
+
+void CmdSetFrameUniforms(CommandBuffer *buffer, const FrameUniforms *uniforms) {
+  GpuCommand *command = RecordCommand(buffer, GPU_COMMAND_SET_FRAME_UNIFORMS);
+  command->count = sizeof(FrameUniforms);
+
+  memcpy(ReserveCommandData(buffer, sizeof(FrameUniforms), &command->data), uniforms, sizeof(FrameUniforms));
+}
+
+void CmdSetUniform(CommandBuffer *buffer, int uniform, const void *value, int size) {
+  GpuCommand *command = RecordCommand(buffer, GPU_COMMAND_SET_UNIFORM);
+  command->resource = uniform;
+  command->count = size;
+
+  memcpy(ReserveCommandData(buffer, size, &command->data), value, size);
+}
+
+void CmdSetBlend(CommandBuffer *buffer, bool translucent) {
+  RecordCommand(buffer, GPU_COMMAND_SET_BLEND)->count = translucent ? 1 : 0;
+}
+
+void CmdBindVertexArray(CommandBuffer *buffer, unsigned int vaoId) {
+  RecordCommand(buffer, GPU_COMMAND_BIND_VERTEX_ARRAY)->resource = vaoId;
+}
+
+void CmdBindTexture(CommandBuffer *buffer, unsigned int textureId) {
+  RecordCommand(buffer, GPU_COMMAND_BIND_TEXTURE)->resource = textureId;
+}
+
+// Upload command whose `size` payload bytes are left to the caller
+static void *RecordUpload(CommandBuffer *buffer, unsigned int bufferId, long offset, int size) {
+  GpuCommand *command = RecordCommand(buffer, GPU_COMMAND_UPLOAD);
+  command->resource = bufferId;
+  command->offset = offset;
+  command->count = size;
+
+  return ReserveCommandData(buffer, size, &command->data);
+}
+
+void CmdUpload(CommandBuffer *buffer, unsigned int bufferId, long offset, const void *data, int size) {
+  memcpy(RecordUpload(buffer, bufferId, offset, size), data, size);
+}
+
+void CmdSetInstanceAttribs(CommandBuffer *buffer, unsigned int bufferId, long offset) {
+  GpuCommand *command = RecordCommand(buffer, GPU_COMMAND_INSTANCE_ATTRIBS);
+  command->resource = bufferId;
+  command->offset = offset;
+}
+
+void CmdDrawArrays(CommandBuffer *buffer, int first, int count) {
+  GpuCommand *command = RecordCommand(buffer, GPU_COMMAND_DRAW_ARRAYS);
+  command->base = first;
+  command->count = count;
+}
+
+void CmdDrawElements(CommandBuffer *buffer, int count, unsigned int indexType, long offset, int baseVertex) {
+  GpuCommand *command = RecordCommand(buffer, GPU_COMMAND_DRAW_ELEMENTS);
+  command->count = count;
+  command->target = indexType;
+  command->offset = offset;
+  command->base = baseVertex;
+}
+
+void CmdDrawInstanced(CommandBuffer *buffer, int indicesCount, int instances, int baseInstance) {
+  GpuCommand *command = RecordCommand(buffer, GPU_COMMAND_DRAW_INSTANCED);
+  command->count = indicesCount;
+  command->instances = instances;
+  command->base = baseInstance;
+}
+
+// Multi-draw command whose `drawCount` draws are left to the caller
+static DrawElementsCommand *RecordMultiDraw(CommandBuffer *buffer, GpuCommandType type, unsigned int bufferId, long offset, unsigned int indexType, int drawCount) {
+  GpuCommand *command = RecordCommand(buffer, type);
+  command->resource = bufferId;
+  command->offset = offset;
+  command->target = indexType;
+  command->count = drawCount * sizeof(DrawElementsCommand);
+
+  return (DrawElementsCommand *)ReserveCommandData(buffer, command->count, &command->data);
+}
+
+void CmdMultiDrawElements(CommandBuffer *buffer, unsigned int indexType, const DrawElementsCommand *draws, int drawCount) {
+  memcpy(RecordMultiDraw(buffer, GPU_COMMAND_MULTI_DRAW_ELEMENTS, 0, 0, indexType, drawCount), draws, drawCount * sizeof(DrawElementsCommand));
+}
+
+void CmdMultiDrawIndirect(CommandBuffer *buffer, unsigned int bufferId, long offset, unsigned int indexType, const DrawElementsCommand *draws, int drawCount) {
+  memcpy(RecordMultiDraw(buffer, GPU_COMMAND_MULTI_DRAW_INDIRECT, bufferId, offset, indexType, drawCount), draws, drawCount * sizeof(DrawElementsCommand));
+}
+
+// Commands whose `count` payload bytes are at `data`
+static bool HasCommandPayload(const GpuCommand *command) {
+  return command->type == GPU_COMMAND_SET_FRAME_UNIFORMS || command->type == GPU_COMMAND_SET_UNIFORM || command->type == GPU_COMMAND_UPLOAD ||
+    command->type == GPU_COMMAND_MULTI_DRAW_ELEMENTS || command->type == GPU_COMMAND_MULTI_DRAW_INDIRECT;
+}
+
+void AppendCommandBuffer(CommandBuffer *dst, const CommandBuffer *src) {
+  if (src->commandCount == 0) return;
+
+  unsigned long long dataOffset = 0;
+  if (src->dataSize > 0) memcpy(ReserveCommandData(dst, src->dataSize, &dataOffset), src->data, src->dataSize);
+
+  for (int i = 0; i < src->commandCount; i++) {
+    GpuCommand *command = RecordCommand(dst, (GpuCommandType)src->commands[i].type);
+    *command = src->commands[i];
+
+    // Every payload moves by the same amount, the data start is 16 byte aligned in both buffers
+    if (HasCommandPayload(command)) command->data += dataOffset;
+  }
+}
+
+static const Shader *GetRenderShader(unsigned int shader) {
+  if (shader == RENDER_SHADER_INSTANCED) return &instancedShader;
+  if (shader == RENDER_SHADER_TEXTURED) return &texturedShader;
+  if (shader == RENDER_SHADER_GEOMETRY) return &geometryShader;
+
+  return &defaultShader;
+}
+
+// One call for every draw of the payload, the indirect one writes the draws into its ring first
+static void SubmitMultiDraw(const GpuCommand *command, const DrawElementsCommand *draws, int drawCount) {
+  if (command->type == GPU_COMMAND_MULTI_DRAW_INDIRECT) {
+    if (command->resource == 0) return; // Captured on a context with indirect draws, replayed on one without
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command->resource);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, command->offset, command->count, draws);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, command->target, (void *)command->offset, drawCount, 0);
+    return;
+  }
+
+  if (drawCount > multiDrawCapacity) {
+    multiDrawCapacity = drawCount;
+    multiDrawCounts = (GLsizei *)realloc(multiDrawCounts, drawCount * sizeof(GLsizei));
+    multiDrawOffsets = (const void **)realloc(multiDrawOffsets, drawCount * sizeof(const void *));
+    multiDrawBaseVertices = (GLint *)realloc(multiDrawBaseVertices, drawCount * sizeof(GLint));
+  }
+
+  const long indexSize = command->target == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+  for (int i = 0; i < drawCount; i++) {
+    multiDrawCounts[i] = draws[i].count;
+    multiDrawOffsets[i] = (const void *)(draws[i].firstIndex * indexSize);
+    multiDrawBaseVertices[i] = draws[i].baseVertex;
+  }
+
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, multiDrawCounts, command->target, multiDrawOffsets, drawCount, multiDrawBaseVertices);
+}
+
+void SubmitCommandBuffer(const CommandBuffer *buffer, CommandBackend backend) {
+  const bool gl = backend == COMMAND_BACKEND_GL;
+  const Shader *shader = &defaultShader;
+
+  for (int i = 0; i < buffer->commandCount; i++) {
+    const GpuCommand *command = &buffer->commands[i];
+
+    switch (command->type) {
+      case GPU_COMMAND_USE_SHADER:
+        shader = GetRenderShader(command->resource);
+        if (gl) StateUseProgram(shader->id);
+        break;
+      case GPU_COMMAND_SET_FRAME_UNIFORMS:
+        if (gl) StateSetFrameUniforms((const FrameUniforms *)(buffer->data + command->data));
+        break;
+      case GPU_COMMAND_SET_UNIFORM:
+        // A value recorded for another program layout (or a corrupt capture) is not sent
+        if (gl && (int)command->resource < shader->uniformCount && command->count == shader->uniforms[command->resource].size) {
+          StateSetUniform(shader, command->resource, buffer->data + command->data);
+        }
+        break;
+      case GPU_COMMAND_SET_BLEND:
+        // Translucent work blends over what is already drawn without hiding what comes after it
+        if (gl) {
+          StateSetEnabled(GL_BLEND, command->count != 0);
+          StateDepthMask(command->count == 0);
+          if (command->count != 0) StateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+        break;
+      case GPU_COMMAND_BIND_VERTEX_ARRAY:
+        if (gl) StateBindVertexArray(command->resource);
+        break;
+      case GPU_COMMAND_BIND_TEXTURE:
+        if (gl) StateBindTexture(command->resource);
+        break;
+      case GPU_COMMAND_UPLOAD:
+        // The copy target leaves the array and element bindings (and the bound VAO) alone
+        if (gl && command->resource != 0) {
+          glBindBuffer(GL_COPY_WRITE_BUFFER, command->resource);
+          glBufferSubData(GL_COPY_WRITE_BUFFER, command->offset, command->count, buffer->data + command->data);
+        }
+        frameStats.bytesUploaded += command->count;
+        break;
+      case GPU_COMMAND_INSTANCE_ATTRIBS:
+        if (gl) {
+          StateBindBuffer(GL_ARRAY_BUFFER, command->resource);
+          SetInstanceAttribPointers(command->offset);
+        }
+        break;
+      case GPU_COMMAND_DRAW_ARRAYS:
+        if (gl) glDrawArrays(GL_TRIANGLES, command->base, command->count);
+        frameStats.verticesDrawn += command->count;
+        frameStats.drawCalls++;
+        break;
+      case GPU_COMMAND_DRAW_ELEMENTS:
+        if (gl) glDrawElementsBaseVertex(GL_TRIANGLES, command->count, command->target, (void *)command->offset, command->base);
+        frameStats.verticesDrawn += command->count;
+        frameStats.drawCalls++;
+        break;
+      case GPU_COMMAND_DRAW_INSTANCED:
+        if (gl && command->base >= 0) {
+          glDrawElementsInstancedBaseInstance(GL_TRIANGLES, command->count, GL_UNSIGNED_INT, 0, command->instances, command->base);
+        } else if (gl) {
+          glDrawElementsInstanced(GL_TRIANGLES, command->count, GL_UNSIGNED_INT, 0, command->instances);
+        }
+        frameStats.verticesDrawn += (long long)command->count * command->instances;
+        frameStats.drawCalls++;
+        break;
+      case GPU_COMMAND_MULTI_DRAW_ELEMENTS:
+      case GPU_COMMAND_MULTI_DRAW_INDIRECT: {
+        const DrawElementsCommand *draws = (const DrawElementsCommand *)(buffer->data + command->data);
+        const int drawCount = command->count / (int)sizeof(DrawElementsCommand);
+
+        if (gl) SubmitMultiDraw(command, draws, drawCount);
+        if (command->type == GPU_COMMAND_MULTI_DRAW_INDIRECT) frameStats.bytesUploaded += command->count;
+
+        for (int d = 0; d < drawCount; d++) frameStats.verticesDrawn += draws[d].count;
+        frameStats.drawCalls++;
+        break;
+      }
+    }
+  }
+}
+
+// Draw of a geometry arena mesh, the whole mesh or the range given to DrawMeshRange
+static void FillGeometryDraw(DrawElementsCommand *dst, const StaticDraw *draw, unsigned int baseInstance) {
+  const StaticMesh *mesh = &staticMeshes[draw->registryId - 1];
+
+  dst->count = draw->indicesCount > 0 ? draw->indicesCount : mesh->indicesCount;
+  dst->instanceCount = 1;
+  dst->firstIndex = mesh->firstIndex + (draw->indicesCount > 0 ? draw->firstIndex : 0);
+  dst->baseVertex = mesh->firstVertex;
+  dst->baseInstance = baseInstance;
+}
+
+// Geometry draws from `first` sharing its arena and blending, in queue order
+static int CountGeometryRun(const RenderCommand *commands, const RenderKey *keys, int first, int count) {
+  const StaticDraw *draw = (const StaticDraw *)commands[keys[first].command].data;
+  const unsigned int arenaId = staticMeshes[draw->registryId - 1].arenaId;
+  const unsigned long long translucent = (keys[first].key >> 60) & 1;
+  int end = first + 1;
+
+  while (end < count) {
+    const RenderCommand *command = &commands[keys[end].command];
+    if (command->type != RENDER_COMMAND_GEOMETRY || ((keys[end].key >> 60) & 1) != translucent) break;
+
+    draw = (const StaticDraw *)command->data;
+    if (staticMeshes[draw->registryId - 1].arenaId != arenaId) break;
+    end++;
+  }
+
+  return end - first;
+}
+
+// Records the sorted queue as GPU commands. The camera goes once into the frame uniforms, shader, model matrix,
+// texture and blending are recorded when they change between commands. The state cache still drops what the driver
+// already has.
+static void RecordRenderQueue(CommandBuffer *buffer, const RenderCommand *commands, const RenderKey *keys, int count, bool instancesUploaded, const glm::mat4 &view) {
+  const int baseVertex = streamFrame * batchVertexCapacity;
+  const long indexOffset = (long)streamFrame * batchIndexCapacity * sizeof(unsigned int);
+  const int modelUniforms[RENDER_SHADER_COUNT] = {
+    GetShaderUniform(&defaultShader, "model"), GetShaderUniform(&instancedShader, "model"), GetShaderUniform(&texturedShader, "model"),
+    GetShaderUniform(&geometryShader, "model")
+  };
+  const int textureLayerUniform = GetShaderUniform(&texturedShader, "textureLayer");
+  const long instanceRegion = (long)streamFrame * MAX_INSTANCES_PER_FRAME; // First instance ring slot of the frame
+  long indirectOffset = instanceRegion * sizeof(DrawElementsCommand);
+  glm::mat4 recordedModel[RENDER_SHADER_COUNT]; // Last model matrix recorded for the shader
+  bool modelRecorded[RENDER_SHADER_COUNT] = { false, false, false, false };
+  int shader = -1;
+  int translucentState = -1;
+  unsigned int texture = 0;
+  int textureLayer = -1;
+
+  // A captured frame records where the attribute offsets are, even when they did not move since the last frame
+  if (captureRecording) {
+    for (int i = 0; i < instancedMeshCount; i++) instancedMeshes[i].attribOffset = -1;
+    for (int i = 0; i < geometryArenaCount; i++) geometryArenas[i].attribOffset = -1;
+  }
+
+  if (count > 0) {
+    FrameUniforms frame;
+    frame.projection = projection;
+    frame.view = view;
+    frame.viewProjection = projection * view;
+    CmdSetFrameUniforms(buffer, &frame);
+  }
+
+  for (int k = 0; k < count; k++) {
+    const RenderCommand *command = &commands[keys[k].command];
+    const bool translucent = (keys[k].key >> 60) & 1;
+
+    if ((command->type == RENDER_COMMAND_INSTANCED || command->type == RENDER_COMMAND_GEOMETRY) && !instancesUploaded) continue;
+
+    int commandShader = RENDER_SHADER_DEFAULT;
+    if (command->type == RENDER_COMMAND_INSTANCED) commandShader = RENDER_SHADER_INSTANCED;
+    else if (command->type == RENDER_COMMAND_GEOMETRY) commandShader = RENDER_SHADER_GEOMETRY;
+    else if (command->type == RENDER_COMMAND_BATCH && ((const BatchStream *)command->data)->textureId != 0) commandShader = RENDER_SHADER_TEXTURED;
+
+    if (commandShader != shader) {
+      shader = commandShader;
+      CmdUseShader(buffer, shader);
+    }
+
+    const glm::mat4 commandModel = command->type == RENDER_COMMAND_STATIC ? model * ((const StaticDraw *)command->data)->model : model;
+
+    if (modelUniforms[shader] != -1 && (!modelRecorded[shader] || memcmp(&recordedModel[shader], &commandModel, sizeof(glm::mat4)) != 0)) {
+      CmdSetUniform(buffer, modelUniforms[shader], &commandModel, sizeof(glm::mat4));
+      recordedModel[shader] = commandModel;
+      modelRecorded[shader] = true;
+    }
+
+    if ((int)translucent != translucentState) {
+      translucentState = translucent;
+      CmdSetBlend(buffer, translucent);
+    }
+
+    if (command->type == RENDER_COMMAND_BATCH) {
+      const BatchStream *stream = (const BatchStream *)command->data;
+
+      if (stream->textureId != 0 && stream->textureId != texture) {
+        CmdBindTexture(buffer, stream->textureId);
+        texture = stream->textureId;
+      }
+
+      if (stream->textureId != 0 && textureLayerUniform != -1 && stream->textureLayer != textureLayer) {
+        CmdSetUniform(buffer, textureLayerUniform, &stream->textureLayer, sizeof(int));
+        textureLayer = stream->textureLayer;
+      }
+
+      CmdBindVertexArray(buffer, stream->vaoId);
+
+      // Attribute pointers start at region 0, the base vertex selects this frame region
+      if (stream->indexType != 0) CmdDrawElements(buffer, stream->drawCount, stream->indexType, indexOffset, baseVertex);
+      else CmdDrawArrays(buffer, baseVertex, stream->drawCount);
+    } else if (command->type == RENDER_COMMAND_GEOMETRY) {
+      const int runCount = CountGeometryRun(commands, keys, k, count);
+      const StaticDraw *first = (const StaticDraw *)command->data;
+      GeometryArena *arena = &geometryArenas[staticMeshes[first->registryId - 1].arenaId - 1];
+
+      CmdBindVertexArray(buffer, arena->vaoId);
+
+      if (indirectBufferId != 0) {
+        // The base instance of every draw selects its model, the whole run is one call
+        DrawElementsCommand *draws = RecordMultiDraw(buffer, GPU_COMMAND_MULTI_DRAW_INDIRECT, indirectBufferId, indirectOffset, GL_UNSIGNED_SHORT, runCount);
+
+        for (int d = 0; d < runCount; d++) {
+          const StaticDraw *draw = (const StaticDraw *)commands[keys[k + d].command].data;
+          FillGeometryDraw(&draws[d], draw, instanceRegion + draw->instance);
+        }
+
+        indirectOffset += runCount * sizeof(DrawElementsCommand);
+      } else {
+        // Without base instance the model attributes are pointed at the draw, draws sharing a model go together
+        for (int d = 0; d < runCount; ) {
+          const StaticDraw *draw = (const StaticDraw *)commands[keys[k + d].command].data;
+          int sameModel = 1;
+
+          while (d + sameModel < runCount &&
+                 memcmp(&((const StaticDraw *)commands[keys[k + d + sameModel].command].data)->model, &draw->model, sizeof(glm::mat4)) == 0) {
+            sameModel++;
+          }
+
+          const long attribOffset = (instanceRegion + draw->instance) * sizeof(InstanceData);
+          if (arena->attribOffset != attribOffset) {
+            CmdSetInstanceAttribs(buffer, instanceBufferId, attribOffset);
+            arena->attribOffset = attribOffset;
+          }
+
+          DrawElementsCommand *draws = RecordMultiDraw(buffer, GPU_COMMAND_MULTI_DRAW_ELEMENTS, 0, 0, GL_UNSIGNED_SHORT, sameModel);
+          for (int m = 0; m < sameModel; m++) FillGeometryDraw(&draws[m], (const StaticDraw *)commands[keys[k + d + m].command].data, 0);
+
+          d += sameModel;
+        }
+      }
+
+      k += runCount - 1;
+    } else if (command->type == RENDER_COMMAND_STATIC) {
+      const StaticDraw *draw = (const StaticDraw *)command->data;
+      const StaticMesh *mesh = &staticMeshes[draw->registryId - 1];
+
+      CmdBindVertexArray(buffer, mesh->vaoId);
+
+      if (mesh->indexType != 0 && draw->indicesCount > 0) {
+        const long indexSize = mesh->indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        CmdDrawElements(buffer, draw->indicesCount, mesh->indexType, draw->firstIndex * indexSize, 0);
+      } else if (mesh->indexType != 0) {
+        CmdDrawElements(buffer, mesh->indicesCount, mesh->indexType, 0, 0);
+      } else {
+        CmdDrawArrays(buffer, 0, mesh->vertexCount);
+      }
+    } else {
+      InstancedMesh *mesh = (InstancedMesh *)command->data;
+
+      CmdBindVertexArray(buffer, mesh->vaoId);
+
+      if (GLAD_GL_ARB_base_instance) {
+        // Instance attributes point at the start of the ring, the base instance selects the group
+        CmdDrawInstanced(buffer, mesh->indicesCount, command->count, command->offset / sizeof(InstanceData));
+      } else {
+        // Without base instance, instance attributes are pointed at the group range instead
+        if (mesh->attribOffset != command->offset) {
+          CmdSetInstanceAttribs(buffer, instanceBufferId, command->offset);
+          mesh->attribOffset = command->offset;
+        }
+
+        CmdDrawInstanced(buffer, mesh->indicesCount, command->count, -1);
+      }
+    }
+  }
+
+  // Depth writes have to be on for the next clear
+  if (translucentState != 0) CmdSetBlend(buffer, false);
+}
+
+static bool WriteFrameCapture(const char *fileName);
+static int GetGeometryExtent(const GeometryAllocator *allocator);
+static void CreateGeometryArenaBuffers(GeometryArena *arena, long vertexBytes, const void *vertices, long indexBytes, const void *indices);
+
+void RenderCod3rGL() {
+  RenderCod3rGLEx(GetViewMatrixCamera());
+}
+
+void RenderCod3rGLEx(const glm::mat4 &view) {
+  // @TODO: 3D render
+  // @TODO: 2D render
+  PROFILE_ZONE("RenderCod3rGL");
+#if defined(CGAME_PROFILER)
+  ProfileGpuFrame();
+#endif
+  BeginStreamFrame();
+
+  bool instancesUploaded = false;
+  {
+    PROFILE_ZONE("Upload");
+    for (int i = 0; i < bufferHandler.size; i++) FlushBatch(&bufferHandler.buffers[i]);
+    for (int i = 0; i < quadBufferCount; i++) FlushBatch(&quadBuffers[i]);
+
+    instancesUploaded = UploadInstances((long)streamFrame * MAX_INSTANCES_PER_FRAME * sizeof(InstanceData));
+  }
+
+  RenderCommand *commands = NULL;
+  RenderKey *keys = NULL;
+  int count = 0;
+  {
+    PROFILE_ZONE("BuildRenderQueue");
+    count = BuildRenderQueue(&commands, &keys, view);
+  }
+
+  {
+    PROFILE_ZONE("RecordRenderQueue");
+    ResetCommandBuffer(frameCommands);
+    RecordRenderQueue(frameCommands, commands, keys, count, instancesUploaded, view);
+  }
+
+  {
+    PROFILE_ZONE("SubmitCommandBuffer");
+    PROFILE_GPU_ZONE("Scene");
+    SubmitCommandBuffer(frameCommands, COMMAND_BACKEND_GL);
+  }
+  frameStats.renderCommands = count;
+
+  if (captureRecording) {
+    AppendCommandBuffer(captureCommands, frameCommands);
+    WriteFrameCapture(captureFileName);
+    captureRecording = false;
+  }
+
+  for (int i = 0; i < bufferHandler.size; i++) bufferHandler.buffers[i].usedStreams = 0;
+  for (int i = 0; i < quadBufferCount; i++) quadBuffers[i].usedStreams = 0;
+
+  for (int i = 0; i < instancedMeshCount; i++) {
+    for (int layer = 0; layer < MAX_RENDER_LAYERS; layer++) instancedMeshes[i].groups[layer] = { 0 };
+  }
+  frameInstanceCount = 0;
+  frameGeometryDrawCount = 0;
+
+  staticDrawFirst = NULL;
+  staticDrawLast = NULL;
+  staticDrawCount = 0;
+  renderLayer = 0;
+
+  FenceStreamFrame();
+
+  // The capture starts with the next frame, whose first batches can be flushed before RenderCod3rGL
+  if (captureRequested.load(std::memory_order_acquire)) {
+    memcpy(captureFileName, captureRequestName, FRAME_CAPTURE_PATH_LENGTH);
+    captureRequested.store(false, std::memory_order_release);
+
+    if (captureCommands == NULL) captureCommands = CreateCommandBuffer();
+    ResetCommandBuffer(captureCommands);
+    captureRecording = true;
+  }
+}
+
+RenderStats GetRenderStats() {
+  return lastFrameStats;
+}
+
+// Appends `count` values to a packet array, returns their offset or -1 without data
+static int CopyToFramePacket(void **data, int *size, int *capacity, const void *values, int count, int valueSize) {
+  if (values == NULL || count == 0) return -1;
+
+  if (*size + count > *capacity) {
+    while (*size + count > *capacity) *capacity = *capacity == 0 ? 4096 : *capacity * 2;
+    *data = realloc(*data, (size_t)*capacity * valueSize);
+  }
+
+  const int offset = *size;
+  memcpy((char *)*data + (size_t)offset * valueSize, values, (size_t)count * valueSize);
+  *size += count;
+
+  return offset;
+}
+
+// Copy of the mesh geometry in the recording packet, made by the first draw of the mesh this frame
+static int CopyFrameGeometry(const Mesh *mesh) {
+  FramePacket *packet = recordingPacket;
+  const int slot = (int)(((uintptr_t)mesh >> 4) % FRAME_GEOMETRY_CACHE);
+
+  if (packet->cachedMeshes[slot] == mesh && packet->cachedVertices[slot] == mesh->vertices) return packet->cachedGeometries[slot];
+
+  if (packet->geometryCount == packet->geometryCapacity) {
+    packet->geometryCapacity = packet->geometryCapacity == 0 ? 64 : packet->geometryCapacity * 2;
+    packet->geometries = (FrameGeometry *)realloc(packet->geometries, packet->geometryCapacity * sizeof(FrameGeometry));
+  }
+
+  const int count = mesh->vertexCount / 3;
+  FrameGeometry *geometry = &packet->geometries[packet->geometryCount];
+  geometry->vertexCount = mesh->vertexCount;
+  geometry->triangleCount = mesh->triangleCount;
+  geometry->indicesCount = mesh->indicesCount;
+  geometry->vertices = CopyToFramePacket((void **)&packet->floats, &packet->floatCount, &packet->floatCapacity, mesh->vertices, count * 3, sizeof(float));
+  geometry->colors = CopyToFramePacket((void **)&packet->floats, &packet->floatCount, &packet->floatCapacity, mesh->colors, count * 4, sizeof(float));
+  geometry->texcoords = CopyToFramePacket((void **)&packet->floats, &packet->floatCount, &packet->floatCapacity, mesh->texcoords, count * 2, sizeof(float));
+  geometry->indices = CopyToFramePacket((void **)&packet->indices, &packet->indexCount, &packet->indexCapacity, mesh->indices, mesh->indicesCount, sizeof(int));
+
+  packet->cachedMeshes[slot] = mesh;
+  packet->cachedVertices[slot] = mesh->vertices;
+  packet->cachedGeometries[slot] = packet->geometryCount;
+
+  return packet->geometryCount++;
+}
+
+// Registry meshes are recorded by handle, the others and the instanced meshes (whose GPU copy may not exist yet) by a copy
+static FrameDraw *RecordFrameDraw(const Mesh *mesh, const glm::mat4 &matrix, const Vector4 *color, int flags, int firstIndex, int indicesCount) {
+  FramePacket *packet = recordingPacket;
+
+  if (packet->drawCount == packet->drawCapacity) {
+    packet->drawCapacity = packet->drawCapacity == 0 ? 256 : packet->drawCapacity * 2;
+    packet->draws = (FrameDraw *)realloc(packet->draws, packet->drawCapacity * sizeof(FrameDraw));
+  }
+
+  FrameDraw *draw = &packet->draws[packet->drawCount++];
+  draw->registryId = mesh != NULL ? mesh->registryId : 0;
+  draw->geometry = mesh != NULL && (mesh->registryId == 0 || (flags & FRAME_DRAW_INSTANCED)) ? CopyFrameGeometry(mesh) : -1;
+  draw->matrix = matrix;
+  draw->layer = packet->layer;
+  draw->flags = flags;
+  draw->firstIndex = firstIndex;
+  draw->indicesCount = indicesCount;
+
+  if (color != NULL) {
+    draw->color = *color;
+    draw->flags |= FRAME_DRAW_COLOR;
+  }
+
+  return draw;
+}
+
+void BeginFramePacket(FramePacket *packet) {
+  packet->drawCount = 0;
+  packet->geometryCount = 0;
+  packet->floatCount = 0;
+  packet->indexCount = 0;
+  packet->layer = 0;
+  memset(packet->cachedMeshes, 0, sizeof(packet->cachedMeshes));
+  recordingPacket = packet;
+}
+
+void EndFramePacket(FramePacket *packet) {
+  packet->view = GetViewMatrixCamera();
+  recordingPacket = NULL;
+}
+
+// Mesh drawn by a packet draw, pointing at the packet copy of its geometry
+static Mesh GetFrameDrawMesh(const FramePacket *packet, const FrameDraw *draw) {
+  Mesh mesh = { 0 };
+  mesh.registryId = draw->registryId;
+  if (draw->geometry < 0) return mesh;
+
+  const FrameGeometry *geometry = &packet->geometries[draw->geometry];
+  mesh.vertexCount = geometry->vertexCount;
+  mesh.triangleCount = geometry->triangleCount;
+  mesh.indicesCount = geometry->indicesCount;
+  mesh.vertices = geometry->vertices >= 0 ? packet->floats + geometry->vertices : NULL;
+  mesh.colors = geometry->colors >= 0 ? packet->floats + geometry->colors : NULL;
+  mesh.texcoords = geometry->texcoords >= 0 ? packet->floats + geometry->texcoords : NULL;
+  mesh.indices = geometry->indices >= 0 ? packet->indices + geometry->indices : NULL;
+
+  return mesh;
+}
+
+void RenderFramePacket(const FramePacket *packet) {
+  for (int i = 0; i < packet->drawCount; i++) {
+    const FrameDraw *draw = &packet->draws[i];
+
+    if (draw->layer != renderLayer) SetRenderLayer(draw->layer);
+
+    if (draw->flags & FRAME_DRAW_QUAD) {
+      DrawTexturedQuad(draw->textureId, draw->textureLayer, draw->uv, (draw->flags & FRAME_DRAW_TRANSLUCENT) != 0, draw->matrix,
+                       (draw->flags & FRAME_DRAW_COLOR) ? &draw->color : NULL);
+      continue;
+    }
+
+    const Mesh mesh = GetFrameDrawMesh(packet, draw);
+
+    if (draw->flags & FRAME_DRAW_INSTANCED) {
+      DrawMeshInstanced(&mesh, draw->matrix, (draw->flags & FRAME_DRAW_COLOR) ? &draw->color : NULL);
+    } else if (draw->indicesCount > 0) {
+      DrawMeshRange(&mesh, draw->matrix, draw->firstIndex, draw->indicesCount);
+    } else {
+      DrawMesh(&mesh, draw->matrix);
+    }
+  }
+
+  RenderCod3rGLEx(packet->view);
+}
+
+void FreeFramePacket(FramePacket *packet) {
+  free(packet->draws);
+  free(packet->geometries);
+  free(packet->floats);
+  free(packet->indices);
+  packet->draws = NULL;
+  packet->drawCount = 0;
+  packet->drawCapacity = 0;
+  packet->geometries = NULL;
+  packet->geometryCount = 0;
+  packet->geometryCapacity = 0;
+  packet->floats = NULL;
+  packet->floatCount = 0;
+  packet->floatCapacity = 0;
+  packet->indices = NULL;
+  packet->indexCount = 0;
+  packet->indexCapacity = 0;
+}
+
+static void CreateStaticMesh(StaticMesh *uploaded, const PackedMesh *packed, const IndexBuffer *shared);
+static void CreateInstancedMeshBuffers(InstancedMesh *instanced, const float *vertices, int vertexCount, const int *indices, int indicesCount);
+
+bool CaptureNextFrame(const char *fileName) {
+  if (captureRequested.load(std::memory_order_acquire)) return false;
+
+  strncpy(captureRequestName, fileName, FRAME_CAPTURE_PATH_LENGTH - 1);
+  captureRequestName[FRAME_CAPTURE_PATH_LENGTH - 1] = '\0';
+  captureRequested.store(true, std::memory_order_release);
+
+  return true;
+}
+
+// Copies the first `size` bytes of the buffer (all of it when 0) into the capture payload, returns its payload offset
+static unsigned long long ReadBackCaptureBuffer(CommandBuffer *capture, unsigned int bufferId, unsigned long long *size) {
+  GLint bytes = 0;
+  unsigned long long offset = 0;
+
+  // The copy target leaves the array and element bindings (and the bound VAO) alone
+  glBindBuffer(GL_COPY_READ_BUFFER, bufferId);
+  glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &bytes);
+  if (*size > 0 && *size < (unsigned long long)bytes) bytes = (GLint)*size;
+
+  void *dst = ReserveCommandData(capture, bytes, &offset);
+  if (bytes > 0) glGetBufferSubData(GL_COPY_READ_BUFFER, 0, bytes, dst);
+
+  *size = bytes;
+  return offset;
+}
+
+// Every layer of the texture array into the capture payload
+static void ReadBackCaptureTexture(CommandBuffer *capture, CaptureResource *resource, unsigned int textureId) {
+  GLint size = 0;
+  GLint layers = 0;
+
+  StateBindTexture(textureId);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_WIDTH, &size);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_DEPTH, &layers);
+
+  *resource = { 0 };
+  resource->type = CAPTURE_RESOURCE_TEXTURE_ARRAY;
+  resource->bufferIds[0] = textureId;
+  resource->textureSize = size;
+  resource->textureLayers = layers;
+  resource->size[0] = (unsigned long long)size * size * layers * 4;
+
+  void *dst = ReserveCommandData(capture, resource->size[0], &resource->data[0]);
+  if (resource->size[0] > 0) glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, GL_UNSIGNED_BYTE, dst);
+}
+
+// Batch stream of `buffers` owning the VAO (or the buffer when `vaoId` is 0)
+static bool DescribeCaptureStream(CaptureResource *resource, const Buffer *buffers, int count, unsigned int vaoId, unsigned int bufferId) {
+  for (int i = 0; i < count; i++) {
+    const Buffer *buffer = &buffers[i];
+
+    for (int s = 0; s < buffer->streamCount; s++) {
+      const BatchStream *stream = &buffer->streams[s];
+      const bool owner = vaoId != 0 ? stream->vaoId == vaoId : (stream->vertexBufferId == bufferId || stream->indexBufferId == bufferId);
+      if (!owner) continue;
+
+      resource->type = CAPTURE_RESOURCE_BATCH_STREAM;
+      resource->vaoId = stream->vaoId;
+      resource->bufferIds[0] = stream->vertexBufferId;
+      resource->bufferIds[1] = stream->indexBufferId;
+      resource->format = buffer->format;
+      resource->renderType = buffer->type;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Engine object owning the VAO (or the buffer when `vaoId` is 0), false when the engine does not know it
+static bool DescribeCaptureResource(CaptureResource *resource, unsigned int vaoId, unsigned int bufferId) {
+  *resource = { 0 };
+
+  if (vaoId == 0 && bufferId == instanceBufferId) {
+    resource->type = CAPTURE_RESOURCE_INSTANCE_RING;
+    resource->bufferIds[0] = instanceBufferId;
+    return true;
+  }
+
+  if (vaoId == 0 && bufferId != 0 && bufferId == indirectBufferId) {
+    resource->type = CAPTURE_RESOURCE_INDIRECT_RING;
+    resource->bufferIds[0] = indirectBufferId;
+    return true;
+  }
+
+  if (DescribeCaptureStream(resource, bufferHandler.buffers, bufferHandler.size, vaoId, bufferId) ||
+      DescribeCaptureStream(resource, quadBuffers, quadBufferCount, vaoId, bufferId)) {
+    return true;
+  }
+
+  if (vaoId == 0) return false;
+
+  for (int i = 0; i < geometryArenaCount; i++) {
+    const GeometryArena *arena = &geometryArenas[i];
+    if (arena->vaoId != vaoId) continue;
+
+    resource->type = CAPTURE_RESOURCE_GEOMETRY_ARENA;
+    resource->vaoId = vaoId;
+    resource->bufferIds[0] = arena->vboId[0];
+    resource->bufferIds[1] = arena->vboId[1];
+    resource->vertexCount = GetGeometryExtent(&arena->vertices);
+    resource->indexType = GL_UNSIGNED_SHORT;
+    resource->size[0] = (unsigned long long)resource->vertexCount * sizeof(BatchVertex);
+    resource->size[1] = (unsigned long long)GetGeometryExtent(&arena->indices) * sizeof(unsigned short);
+    return true;
+  }
+
+  for (int i = 0; i < staticMeshCount; i++) {
+    const StaticMesh *mesh = &staticMeshes[i];
+    if (mesh->refCount == 0 || mesh->vaoId != vaoId) continue;
+
+    resource->type = CAPTURE_RESOURCE_STATIC_MESH;
+    resource->vaoId = vaoId;
+    resource->bufferIds[0] = mesh->vboId[0];
+    resource->bufferIds[1] = mesh->indexType != 0 ? mesh->vboId[1] : 0;
+    resource->vertexCount = mesh->vertexCount;
+    resource->indexType = mesh->indexType;
+    return true;
+  }
+
+  for (int i = 0; i < instancedMeshCount; i++) {
+    if (instancedMeshes[i].vaoId != vaoId) continue;
+
+    resource->type = CAPTURE_RESOURCE_INSTANCED_MESH;
+    resource->vaoId = vaoId;
+    resource->bufferIds[0] = instancedMeshes[i].vboId[0];
+    resource->bufferIds[1] = instancedMeshes[i].vboId[1];
+    return true;
+  }
+
+  return false;
+}
+
+// Textures have their own ids, they are matched with `textureId` alone
+static bool HasCaptureResource(const CaptureResource *resources, int count, unsigned int vaoId, unsigned int bufferId, unsigned int textureId) {
+  for (int i = 0; i < count; i++) {
+    const bool texture = resources[i].type == CAPTURE_RESOURCE_TEXTURE_ARRAY;
+
+    if (texture != (textureId != 0)) continue;
+    if (texture && resources[i].bufferIds[0] == textureId) return true;
+    if (vaoId != 0 && resources[i].vaoId == vaoId) return true;
+    if (vaoId == 0 && (resources[i].bufferIds[0] == bufferId || resources[i].bufferIds[1] == bufferId)) return true;
+  }
+
+  return false;
+}
+
+// Writes the recorded frame with every resource its commands use, registry and instanced geometry read back from the GPU
+static bool WriteFrameCapture(const char *fileName) {
+  CommandBuffer *capture = captureCommands;
+  CaptureResource *resources = NULL;
+  int resourceCount = 0;
+  const int commandCount = capture->commandCount;
+
+  for (int i = 0; i < commandCount; i++) {
+    const GpuCommand *command = &capture->commands[i];
+    unsigned int vaoId = 0;
+    unsigned int bufferId = 0;
+    unsigned int textureId = 0;
+
+    if (command->type == GPU_COMMAND_BIND_VERTEX_ARRAY) vaoId = command->resource;
+    else if (command->type == GPU_COMMAND_UPLOAD || command->type == GPU_COMMAND_INSTANCE_ATTRIBS || command->type == GPU_COMMAND_MULTI_DRAW_INDIRECT) bufferId = command->resource;
+    else if (command->type == GPU_COMMAND_BIND_TEXTURE) textureId = command->resource;
+    else continue;
+
+    if (HasCaptureResource(resources, resourceCount, vaoId, bufferId, textureId)) continue;
+
+    CaptureResource resource;
+    if (textureId != 0) {
+      ReadBackCaptureTexture(capture, &resource, textureId);
+    } else if (!DescribeCaptureResource(&resource, vaoId, bufferId)) {
+      printf("%s Frame capture uses an unknown object (VAO %i, buffer %i), it is skipped by the replay\n", fileName, vaoId, bufferId);
+      continue;
+    }
+
+    if (resource.type == CAPTURE_RESOURCE_STATIC_MESH || resource.type == CAPTURE_RESOURCE_INSTANCED_MESH || resource.type == CAPTURE_RESOURCE_GEOMETRY_ARENA) {
+      for (int b = 0; b < 2; b++) {
+        if (resource.bufferIds[b] != 0) resource.data[b] = ReadBackCaptureBuffer(capture, resource.bufferIds[b], &resource.size[b]);
+      }
+    }
+
+    resources = (CaptureResource *)realloc(resources, (resourceCount + 1) * sizeof(CaptureResource));
+    resources[resourceCount++] = resource;
+  }
+
+  FrameCaptureHeader header = { 0 };
+  header.magic = FRAME_CAPTURE_MAGIC;
+  header.version = FRAME_CAPTURE_VERSION;
+  header.batchVertices = batchVertexCapacity;
+  header.resourceCount = resourceCount;
+  header.commandCount = commandCount;
+  header.dataSize = capture->dataSize;
+
+  FILE *file = fopen(fileName, "wb");
+  bool written = file != NULL;
+
+  if (file != NULL) {
+    written = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (resourceCount > 0) written = written && fwrite(resources, sizeof(CaptureResource), resourceCount, file) == (size_t)resourceCount;
+    if (commandCount > 0) written = written && fwrite(capture->commands, sizeof(GpuCommand), commandCount, file) == (size_t)commandCount;
+    if (capture->dataSize > 0) written = written && fwrite(capture->data, capture->dataSize, 1, file) == 1;
+    written = fclose(file) == 0 && written;
+  }
+
+  if (!written) printf("%s Frame capture could not be written\n", fileName);
+
+  free(resources);
+  ResetCommandBuffer(capture);
+
+  return written;
+}
+
+FrameCapture *LoadFrameCapture(const char *fileName) {
+  FILE *file = fopen(fileName, "rb");
+
+  if (file == NULL) {
+    printf("%s Frame capture could not be opened\n", fileName);
+    return NULL;
+  }
+
+  FrameCaptureHeader header;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == FRAME_CAPTURE_MAGIC &&
+    header.version == FRAME_CAPTURE_VERSION && header.resourceCount >= 0 && header.commandCount >= 0;
+
+  if (!valid) {
+    printf("%s Not a frame capture, or an unsupported version\n", fileName);
+    fclose(file);
+    return NULL;
+  }
+
+  FrameCapture *capture = (FrameCapture *)malloc(sizeof(FrameCapture));
+  *capture = { 0 };
+  capture->header = header;
+  capture->resources = (CaptureResource *)malloc((header.resourceCount + 1) * sizeof(CaptureResource));
+  capture->objects = (unsigned int *)calloc((header.resourceCount + 1) * 3, sizeof(unsigned int));
+
+  CommandBuffer *commands = CreateCommandBuffer();
+  commands->commands = (GpuCommand *)malloc((header.commandCount + 1) * sizeof(GpuCommand));
+  commands->commandCount = header.commandCount;
+  commands->commandCapacity = header.commandCount + 1;
+  commands->data = (unsigned char *)malloc(header.dataSize + 1);
+  commands->dataSize = header.dataSize;
+  commands->dataCapacity = header.dataSize + 1;
+  capture->commands = commands;
+
+  valid = fread(capture->resources, sizeof(CaptureResource), header.resourceCount, file) == (size_t)header.resourceCount &&
+    fread(commands->commands, sizeof(GpuCommand), header.commandCount, file) == (size_t)header.commandCount &&
+    fread(commands->data, 1, header.dataSize, file) == header.dataSize;
+
+  // Every payload has to be in the file, a truncated capture would replay out of bounds
+  for (int i = 0; i < header.commandCount && valid; i++) {
+    const GpuCommand *command = &commands->commands[i];
+    valid = !HasCommandPayload(command) || (command->count >= 0 && command->data + command->count <= header.dataSize);
+  }
+
+  for (int i = 0; i < header.resourceCount && valid; i++) {
+    const CaptureResource *resource = &capture->resources[i];
+    for (int b = 0; b < 2; b++) valid = valid && resource->data[b] + resource->size[b] <= header.dataSize;
+
+    if (resource->type == CAPTURE_RESOURCE_TEXTURE_ARRAY) {
+      valid = valid && resource->textureSize > 0 && resource->textureLayers > 0 &&
+        resource->size[0] == (unsigned long long)resource->textureSize * resource->textureSize * resource->textureLayers * 4;
+    }
+  }
+
+  fclose(file);
+
+  if (!valid) {
+    printf("%s Frame capture is truncated\n", fileName);
+    FreeFrameCapture(capture);
+    return NULL;
+  }
+
+  return capture;
+}
+
+// New id of a captured object, 0 when the capture has no resource for it
+static unsigned int RemapCaptureObject(const FrameCapture *capture, unsigned int id, bool vertexArray) {
+  for (int i = 0; i < capture->header.resourceCount; i++) {
+    const CaptureResource *resource = &capture->resources[i];
+    if (resource->type == CAPTURE_RESOURCE_TEXTURE_ARRAY) continue;
+
+    if (vertexArray && resource->vaoId == id) return capture->objects[i * 3];
+    if (!vertexArray && resource->bufferIds[0] == id) return capture->objects[i * 3 + 1];
+    if (!vertexArray && resource->bufferIds[1] == id && id != 0) return capture->objects[i * 3 + 2];
+  }
+
+  return 0;
+}
+
+static unsigned int RemapCaptureTexture(const FrameCapture *capture, unsigned int id) {
+  for (int i = 0; i < capture->header.resourceCount; i++) {
+    const CaptureResource *resource = &capture->resources[i];
+    if (resource->type == CAPTURE_RESOURCE_TEXTURE_ARRAY && resource->bufferIds[0] == id) return capture->objects[i * 3 + 1];
+  }
+
+  return 0;
+}
+
+bool PrepareFrameCapture(FrameCapture *capture) {
+  if (capture->prepared) return true;
+
+  if (capture->header.batchVertices != batchVertexCapacity) {
+    printf("Frame capture has %i vertices per batch, InitCod3rGLEx was given %i\n", capture->header.batchVertices, batchVertexCapacity);
+    return false;
+  }
+
+  const unsigned char *data = capture->commands->data;
+
+  for (int i = 0; i < capture->header.resourceCount; i++) {
+    const CaptureResource *resource = &capture->resources[i];
+    unsigned int *objects = &capture->objects[i * 3];
+
+    if (resource->type == CAPTURE_RESOURCE_BATCH_STREAM) {
+      BatchStream stream;
+      CreateBatchStream(&stream, (BufferRenderType)resource->renderType, (VertexFormat)resource->format);
+
+      objects[0] = stream.vaoId;
+      objects[1] = stream.vertexBufferId;
+      objects[2] = stream.indexBufferId;
+    } else if (resource->type == CAPTURE_RESOURCE_STATIC_MESH) {
+      const size_t indexSize = resource->indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+      PackedMesh packed = { 0 };
+      packed.vertices = (const BatchVertex *)(data + resource->data[0]);
+      packed.vertexCount = resource->vertexCount;
+      packed.indices = resource->indexType != 0 ? data + resource->data[1] : NULL;
+      packed.indicesCount = (int)(resource->size[1] / indexSize);
+      packed.indexType = resource->indexType;
+
+      StaticMesh mesh;
+      CreateStaticMesh(&mesh, &packed, NULL);
+
+      objects[0] = mesh.vaoId;
+      objects[1] = mesh.vboId[0];
+      objects[2] = mesh.indexType != 0 ? mesh.vboId[1] : 0;
+    } else if (resource->type == CAPTURE_RESOURCE_INSTANCED_MESH) {
+      InstancedMesh mesh = { 0 };
+      CreateInstancedMeshBuffers(&mesh, (const float *)(data + resource->data[0]), (int)(resource->size[0] / sizeof(float)),
+                                 (const int *)(data + resource->data[1]), (int)(resource->size[1] / sizeof(int)));
+
+      objects[0] = mesh.vaoId;
+      objects[1] = mesh.vboId[0];
+      objects[2] = mesh.vboId[1];
+    } else if (resource->type == CAPTURE_RESOURCE_TEXTURE_ARRAY) {
+      objects[1] = CreateTextureArray(resource->textureSize, resource->textureLayers, data + resource->data[0]);
+    } else if (resource->type == CAPTURE_RESOURCE_GEOMETRY_ARENA) {
+      GeometryArena arena = { 0 };
+      CreateGeometryArenaBuffers(&arena, (long)resource->size[0], data + resource->data[0], (long)resource->size[1], data + resource->data[1]);
+
+      objects[0] = arena.vaoId;
+      objects[1] = arena.vboId[0];
+      objects[2] = arena.vboId[1];
+    } else {
+      // Not owned, the rings of InitCod3rGLEx are used as is
+      objects[1] = resource->type == CAPTURE_RESOURCE_INDIRECT_RING ? indirectBufferId : instanceBufferId;
+    }
+  }
+
+  for (int i = 0; i < capture->commands->commandCount; i++) {
+    GpuCommand *command = &capture->commands->commands[i];
+
+    if (command->type == GPU_COMMAND_BIND_VERTEX_ARRAY) {
+      command->resource = RemapCaptureObject(capture, command->resource, true);
+    } else if (command->type == GPU_COMMAND_UPLOAD || command->type == GPU_COMMAND_INSTANCE_ATTRIBS || command->type == GPU_COMMAND_MULTI_DRAW_INDIRECT) {
+      command->resource = RemapCaptureObject(capture, command->resource, false);
+    } else if (command->type == GPU_COMMAND_BIND_TEXTURE) {
+      command->resource = RemapCaptureTexture(capture, command->resource);
+    }
+  }
+
+  capture->prepared = true;
+  return true;
+}
+
+RenderStats ReplayFrameCapture(FrameCapture *capture, CommandBackend backend) {
+  if (backend == COMMAND_BACKEND_GL && !capture->prepared) {
+    printf("Frame capture has to be prepared before a GL replay\n");
+    RenderStats empty = { 0 };
+    return empty;
+  }
+
+  const int issued = stateCallsIssued;
+  const int skipped = stateCallsSkipped;
+  const RenderStats frame = frameStats;
+
+  frameStats = { 0 };
+  SubmitCommandBuffer(capture->commands, backend);
+
+  RenderStats stats = frameStats;
+  stats.renderCommands = capture->commands->commandCount;
+  stats.stateCallsIssued = stateCallsIssued - issued;
+  stats.stateCallsSkipped = stateCallsSkipped - skipped;
+
+  frameStats = frame;
+
+  return stats;
+}
+
+void FreeFrameCapture(FrameCapture *capture) {
+  if (capture == NULL) return;
+
+  for (int i = 0; i < capture->header.resourceCount && capture->prepared; i++) {
+    if (capture->resources[i].type == CAPTURE_RESOURCE_INSTANCE_RING || capture->resources[i].type == CAPTURE_RESOURCE_INDIRECT_RING) continue;
+
+    if (capture->resources[i].type == CAPTURE_RESOURCE_TEXTURE_ARRAY) {
+      glDeleteTextures(1, &capture->objects[i * 3 + 1]);
+      continue;
+    }
+
+    glDeleteVertexArrays(1, &capture->objects[i * 3]);
+    glDeleteBuffers(2, &capture->objects[i * 3 + 1]);
+  }
+
+  if (capture->prepared) ResetStateCache();
+
+  DestroyCommandBuffer(capture->commands);
+  free(capture->resources);
+  free(capture->objects);
+  free(capture);
+}
+
+void InitCod3rGL(int windowWidth, int windowHeight) {
+  InitCod3rGLEx(windowWidth, windowHeight, STREAM_REGION_VERTICES);
+}
+
+void InitCod3rGLEx(int windowWidth, int windowHeight, int batchVertices) {
+  ResetStateCache();
+
+  // Smaller batches mean more draw calls, bigger ones more memory per batch
+  batchVertexCapacity = batchVertices;
+  batchIndexCapacity = batchVertices * 3;
+
+  // Initialise buffers
+  bufferHandler.buffers = (Buffer *)malloc(MAX_BUFFERS_RENDER * sizeof(struct Buffer));
+  bufferHandler.size = 0;
+  bufferHandler.currentBuffer = 0;
+  Buffer buffer = CreateBuffer(BufferRenderType::Elements); // Creates default Buffer
+  StoreBuffer(&buffer);
+
+  // Every program compiles at the same time
+  int defaultHandle = QueueShader("src/shaders/vertex.glsl", "src/shaders/fragment.glsl");
+  int instancedHandle = QueueShader("src/shaders/vertex_instanced.glsl", "src/shaders/fragment.glsl");
+  int texturedHandle = QueueShader("src/shaders/vertex.glsl", "src/shaders/fragment_textured.glsl");
+  int geometryHandle = QueueShader("src/shaders/vertex_geometry.glsl", "src/shaders/fragment.glsl");
+  defaultShader = WaitShader(defaultHandle);
+  instancedShader = WaitShader(instancedHandle);
+  texturedShader = WaitShader(texturedHandle);
+  geometryShader = WaitShader(geometryHandle);
+
+  glGenBuffers(1, &instanceBufferId);
+  StateBindBuffer(GL_ARRAY_BUFFER, instanceBufferId);
+  glBufferData(GL_ARRAY_BUFFER, STREAM_FRAMES_IN_FLIGHT * MAX_INSTANCES_PER_FRAME * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+
+  // Arena draws of the frame fit one region, each draw uses an instance slot for its model
+  if (GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance) {
+    glGenBuffers(1, &indirectBufferId);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBufferId);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, STREAM_FRAMES_IN_FLIGHT * MAX_INSTANCES_PER_FRAME * sizeof(DrawElementsCommand), NULL, GL_STREAM_DRAW);
+  }
+
+  GLint uniformAlignment = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+  frameUniformStride = ((long)sizeof(FrameUniforms) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+  frameUniformRegion = 0;
+
+  glGenBuffers(1, &frameUniformBufferId);
+  glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBufferId);
+  glBufferData(GL_UNIFORM_BUFFER, STREAM_FRAMES_IN_FLIGHT * frameUniformStride, NULL, GL_DYNAMIC_DRAW);
+
+  for (int i = 0; i < STREAM_FRAMES_IN_FLIGHT; i++) {
+    frameArenas[i].memory = (unsigned char *)malloc(FRAME_ARENA_SIZE);
+    frameArenas[i].capacity = FRAME_ARENA_SIZE;
+    frameArenas[i].used = 0;
+  }
+
+  frameCommands = CreateCommandBuffer();
+
+  // setup matrices
+  projection = glm::perspective(glm::radians(45.0f), (float)windowWidth / (float)windowHeight, 0.1f, 100.0f);
+}
+
+// GL objects and CPU batch of a buffer
+static void FreeBuffer(Buffer *buffer) {
+  for (int s = 0; s < buffer->streamCount; s++) {
+    glDeleteVertexArrays(1, &buffer->streams[s].vaoId);
+    glDeleteBuffers(1, &buffer->streams[s].vertexBufferId);
+    glDeleteBuffers(1, &buffer->streams[s].indexBufferId);
+  }
+
+  free(buffer->streams);
+  free(buffer->vertexBuffer.data);
+  free(buffer->indexBuffer.data);
+}
+
+void CleanCod3rGL() {
+#if defined(CGAME_PROFILER)
+  ReleaseProfilerGpu();
+#endif
+
+  UnloadShader(defaultShader);
+  UnloadShader(instancedShader);
+  UnloadShader(texturedShader);
+  UnloadShader(geometryShader);
+  defaultShader = { 0 };
+  instancedShader = { 0 };
+  texturedShader = { 0 };
+  geometryShader = { 0 };
+
+  // Programs queued but never waited on
+  for (int i = 0; i < MAX_PENDING_SHADERS; i++) {
+    if (pendingShaders[i].used) {
+      ReleaseShaderSources(&pendingShaders[i]);
+      if (pendingShaders[i].programId != 0) glDeleteProgram(pendingShaders[i].programId);
+    }
+    pendingShaders[i] = { 0 };
+  }
+  shaderPendingCount = 0;
+
+  for (int i = 0; i < bufferHandler.size; i++) FreeBuffer(&bufferHandler.buffers[i]);
+  free(bufferHandler.buffers);
+  bufferHandler.buffers = NULL;
+  bufferHandler.size = 0;
+
+  for (int i = 0; i < quadBufferCount; i++) FreeBuffer(&quadBuffers[i]);
+  quadBufferCount = 0;
+
+  for (int i = 0; i < instancedMeshCount; i++) {
+    glDeleteVertexArrays(1, &instancedMeshes[i].vaoId);
+    glDeleteBuffers(2, instancedMeshes[i].vboId);
+  }
+  instancedMeshCount = 0;
+  glDeleteBuffers(1, &instanceBufferId);
+  glDeleteBuffers(1, &frameUniformBufferId);
+  frameUniformBufferId = 0;
+
+  for (int i = 0; i < staticMeshCount; i++) {
+    if (staticMeshes[i].refCount == 0) continue;
+
+    if (staticMeshes[i].arenaId == 0) {
+      glDeleteVertexArrays(1, &staticMeshes[i].vaoId);
+      glDeleteBuffers(staticMeshes[i].sharedIndices ? 1 : 2, staticMeshes[i].vboId);
+    }
+    staticMeshes[i].refCount = 0;
+  }
+  staticMeshCount = 0;
+
+  for (int i = 0; i < geometryArenaCount; i++) {
+    glDeleteVertexArrays(1, &geometryArenas[i].vaoId);
+    glDeleteBuffers(2, geometryArenas[i].vboId);
+    free(geometryArenas[i].vertices.spans);
+    free(geometryArenas[i].indices.spans);
+  }
+  geometryArenaCount = 0;
+  geometryCompactions = 0;
+
+  if (indirectBufferId != 0) glDeleteBuffers(1, &indirectBufferId);
+  indirectBufferId = 0;
+
+  free(streamStaging);
+  streamStaging = NULL;
+  streamStagingSize = 0;
+  free(renderQueueHeap);
+  renderQueueHeap = NULL;
+  renderQueueHeapSize = 0;
+
+  free(multiDrawCounts);
+  free(multiDrawOffsets);
+  free(multiDrawBaseVertices);
+  multiDrawCounts = NULL;
+  multiDrawOffsets = NULL;
+  multiDrawBaseVertices = NULL;
+  multiDrawCapacity = 0;
+
+  staticDrawFirst = NULL;
+  staticDrawLast = NULL;
+  staticDrawCount = 0;
+
+  for (int i = 0; i < STREAM_FRAMES_IN_FLIGHT; i++) {
+    free(frameArenas[i].memory);
+    frameArenas[i] = { 0 };
+  }
+
+  for (int i = 0; i < STREAM_FRAMES_IN_FLIGHT; i++) {
+    if (streamFences[i] != NULL) glDeleteSync(streamFences[i]);
+    streamFences[i] = NULL;
+  }
+  streamFrame = 0;
+  streamFrameReady = false;
+
+  DestroyCommandBuffer(frameCommands);
+  DestroyCommandBuffer(captureCommands);
+  frameCommands = NULL;
+  captureCommands = NULL;
+  captureRecording = false;
+
+  for (int i = 0; i < MAX_CACHED_PROGRAMS; i++) {
+    free(stateCache.programs[i].values);
+    stateCache.programs[i].values = NULL;
+    stateCache.programs[i].capacity = 0;
+  }
+
+  ResetStateCache();
+}
+
+static inline unsigned int PackColor(const float *rgba) {
+    unsigned int color = 0;
+
+    for (int i = 0; i < 4; i++) {
+        float c = rgba[i] < 0.0f ? 0.0f : (rgba[i] > 1.0f ? 1.0f : rgba[i]);
+        color |= (unsigned int)(c * 255.0f + 0.5f) << (i * 8); // R in the lowest byte
+    }
+
+    return color;
+}
+
+// Writes color and texcoord of the `count` first mesh vertices, positions are left untouched.
+// Returns true when a color is translucent.
+static bool PackVertexAttributes(BatchVertex *dst, const Mesh *mesh, int count) {
+    unsigned int alpha = 0xff;
+
+    for (int i = 0; i < count; i++) {
+        dst[i].color = mesh->colors != NULL ? PackColor(mesh->colors + i * 4) : 0xffffffff;
+        alpha &= dst[i].color >> 24;
+
+        if (mesh->texcoords != NULL) {
+            dst[i].texcoord[0] = glm::packHalf1x16(mesh->texcoords[i * 2]);
+            dst[i].texcoord[1] = glm::packHalf1x16(mesh->texcoords[i * 2 + 1]);
+        } else {
+            dst[i].texcoord[0] = 0;
+            dst[i].texcoord[1] = 0;
+        }
+    }
+
+    return alpha != 0xff;
+}
+
+void StoreDataToBufferv(DynamicVBuffer *buffer, const Mesh *mesh, const glm::mat4 &matrix) {
+    const int count = mesh->vertexCount / 3;
+
+    if (buffer->vertexCount + count > batchVertexCapacity) {
+        printf("Batch full, %i vertices dropped, capacity: %i\n", count, batchVertexCapacity);
+        return;
+    }
+
+    BatchVertex *dst = buffer->data + buffer->vertexCount;
+
+    // apply matrix to vertex, straight into the batch (colors are written after, see TransformVertices)
+    TransformVertices(matrix, mesh->vertices, dst->position, sizeof(BatchVertex) / sizeof(float), count);
+    if (PackVertexAttributes(dst, mesh, count)) buffer->translucent = true;
+
+    buffer->vertexCount += count;
+}
+
+void StoreDataToBufferi(DynamicIBuffer *buffer, int *data, int dataSize, int numTriangles) {
+    if (buffer->vertexCount + dataSize > batchIndexCapacity) {
+        printf("Batch full, %i indices dropped, capacity: %i\n", dataSize, batchIndexCapacity);
+        return;
+    }
+
+    for (int i = 0; i < dataSize; i++) {
+        buffer->data[buffer->vertexCount + i] = data[i] + buffer->triangleCount;
+    }
+
+    buffer->vertexCount += dataSize;
+    buffer->triangleCount += numTriangles;
+}
+
+void TransformVerticesScalar(const glm::mat4 &matrix, const float *src, float *dst, int dstStride, int count) {
+    for (int i = 0; i < count; i++) {
+        const float *v = src + i * 3;
+        glm::vec4 newPos = matrix * glm::vec4(v[0], v[1], v[2], VERTEX_TRANSFORM_W);
+
+        dst[i * dstStride] = newPos[0];
+        dst[i * dstStride + 1] = newPos[1];
+        dst[i * dstStride + 2] = newPos[2];
+    }
+}
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+// Every vertex is stored as a full 4-lane vector: the 4th lane lands on the float after the position
+// (next vertex X when packed), which is overwritten afterwards. The last vertex goes through the scalar path.
+static inline __m128 TransformVertex4(__m128 c0, __m128 c1, __m128 c2, __m128 c3, const float *v) {
+    __m128 xy = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(v[0])), _mm_mul_ps(c1, _mm_set1_ps(v[1])));
+    __m128 zw = _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(v[2])), c3);
+
+    return _mm_add_ps(xy, zw);
+}
+#endif
+
+void TransformVertices(const glm::mat4 &matrix, const float *src, float *dst, int dstStride, int count) {
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+    const __m128 c0 = _mm_loadu_ps(&matrix[0][0]);
+    const __m128 c1 = _mm_loadu_ps(&matrix[1][0]);
+    const __m128 c2 = _mm_loadu_ps(&matrix[2][0]);
+    const __m128 c3 = _mm_mul_ps(_mm_loadu_ps(&matrix[3][0]), _mm_set1_ps(VERTEX_TRANSFORM_W));
+    int i = 0;
+
+#if defined(__AVX__)
+    // Two vertices per iteration, one per 128-bit lane
+    const __m256 c0x2 = _mm256_broadcast_ps(&c0);
+    const __m256 c1x2 = _mm256_broadcast_ps(&c1);
+    const __m256 c2x2 = _mm256_broadcast_ps(&c2);
+    const __m256 c3x2 = _mm256_broadcast_ps(&c3);
+
+    for (; i + 2 < count; i += 2) {
+        const float *v = src + i * 3;
+        __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v[0])), _mm_set1_ps(v[3]), 1);
+        __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v[1])), _mm_set1_ps(v[4]), 1);
+        __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v[2])), _mm_set1_ps(v[5]), 1);
+
+        __m256 xy = _mm256_add_ps(_mm256_mul_ps(c0x2, x), _mm256_mul_ps(c1x2, y));
+        __m256 zw = _mm256_add_ps(_mm256_mul_ps(c2x2, z), c3x2);
+        __m256 r = _mm256_add_ps(xy, zw);
+
+        _mm_storeu_ps(dst + i * dstStride, _mm256_castps256_ps128(r));
+        _mm_storeu_ps(dst + (i + 1) * dstStride, _mm256_extractf128_ps(r, 1));
+    }
+#endif
+
+    for (; i + 1 < count; i++) {
+        _mm_storeu_ps(dst + i * dstStride, TransformVertex4(c0, c1, c2, c3, src + i * 3));
+    }
+
+    if (i < count) TransformVerticesScalar(matrix, src + i * 3, dst + i * dstStride, dstStride, count - i);
+#else
+    TransformVerticesScalar(matrix, src, dst, dstStride, count);
+#endif
+}
+
+const char *GetTransformVerticesPath() {
+#if defined(__AVX__)
+    return "avx";
+#elif defined(__SSE2__) || defined(_M_X64)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void DrawEntities(Entity *entities, int entityCount) {
+    for (int e = 0; e < entityCount; e++) {
+        for (int i = 0; i < entities[e].meshCount; i++) {
+            DrawMesh(&entities[e].meshes[i], entities[e].matrix);
+        }
+    }
+}
+
+#if !defined(COD3R_GL_STANDALONE)
+typedef struct BatchFillRange {
+    int begin;                  // Entities [begin, end) of the pass
+    int end;
+    int vertexCount;
+    int indexCount;
+    int vertexBase;             // Where the range is written, sum of the ranges before it
+    int indexBase;
+    int rebase;                 // Added to the indices of the first vertex of the range
+    bool translucent;
+} BatchFillRange;
+
+typedef struct BatchFill {
+    const Entity *entities;
+    DynamicVBuffer *vertices;
+    DynamicIBuffer *indices;
+    BatchFillRange ranges[MAX_FILL_RANGES];
+} BatchFill;
+
+static inline void CountBatchMeshes(const Entity *entity, bool indexed, int *vertexCount, int *indexCount) {
+    for (int i = 0; i < entity->meshCount; i++) {
+        if (entity->meshes[i].registryId != 0) continue;
+
+        *vertexCount += entity->meshes[i].vertexCount / 3;
+        if (indexed) *indexCount += entity->meshes[i].indicesCount;
+    }
+}
+
+static void CountBatchRanges(void *data, int begin, int end) {
+    BatchFill *fill = (BatchFill *)data;
+
+    for (int r = begin; r < end; r++) {
+        BatchFillRange *range = &fill->ranges[r];
+        range->vertexCount = 0;
+        range->indexCount = 0;
+
+        for (int e = range->begin; e < range->end; e++) {
+            CountBatchMeshes(&fill->entities[e], fill->indices != NULL, &range->vertexCount, &range->indexCount);
+        }
+    }
+}
+
+static void WriteBatchRanges(void *data, int begin, int end) {
+    BatchFill *fill = (BatchFill *)data;
+
+    for (int r = begin; r < end; r++) {
+        BatchFillRange *range = &fill->ranges[r];
+        int vertexBase = range->vertexBase;
+        int indexBase = range->indexBase;
+        int rebase = range->rebase;
+        range->translucent = false;
+
+        for (int e = range->begin; e < range->end; e++) {
+            const Entity *entity = &fill->entities[e];
+
+            for (int i = 0; i < entity->meshCount; i++) {
+                const Mesh *mesh = &entity->meshes[i];
+                if (mesh->registryId != 0) continue;
+
+                const int count = mesh->vertexCount / 3;
+                BatchVertex *dst = fill->vertices->data + vertexBase;
+
+                TransformVertices(entity->matrix, mesh->vertices, dst->position, sizeof(BatchVertex) / sizeof(float), count);
+                if (PackVertexAttributes(dst, mesh, count)) range->translucent = true;
+
+                if (fill->indices != NULL) {
+                    int *indices = fill->indices->data + indexBase;
+                    for (int j = 0; j < mesh->indicesCount; j++) indices[j] = mesh->indices[j] + rebase;
+
+                    indexBase += mesh->indicesCount;
+                }
+
+                vertexBase += count;
+                rebase += count;
+            }
+        }
+    }
+}
+
+int FillBatchParallel(JobSystem *jobs, DynamicVBuffer *vertices, DynamicIBuffer *indices, int vertexCapacity, int indexCapacity, const Entity *entities, int entityCount) {
+    PROFILE_ZONE("FillBatchParallel");
+    BatchFill fill;
+    fill.vertices = vertices;
+    fill.indices = indices;
+
+    int stored = 0;
+    bool full = false;
+
+    while (!full && stored < entityCount) {
+        // An entity adds at least one vertex or none at all, so no more than the free vertices + 1 entities can fit
+        int passCount = entityCount - stored;
+        int freeVertices = vertexCapacity - vertices->vertexCount;
+        if (passCount > freeVertices + 1) passCount = freeVertices + 1;
+
+        int rangeCount = GetJobWorkerCount(jobs) * 4;
+        if (rangeCount > MAX_FILL_RANGES) rangeCount = MAX_FILL_RANGES;
+        if (rangeCount > (passCount + FILL_RANGE_MIN_ENTITIES - 1) / FILL_RANGE_MIN_ENTITIES) {
+            rangeCount = (passCount + FILL_RANGE_MIN_ENTITIES - 1) / FILL_RANGE_MIN_ENTITIES;
+        }
+
+        fill.entities = entities + stored;
+
+        for (int r = 0; r < rangeCount; r++) {
+            fill.ranges[r].begin = (int)((long long)passCount * r / rangeCount);
+            fill.ranges[r].end = (int)((long long)passCount * (r + 1) / rangeCount);
+        }
+
+        ParallelFor(jobs, rangeCount, 1, CountBatchRanges, &fill);
+
+        // Exclusive prefix sum of the range sizes, the range that crosses the capacity is cut at the first entity that does not fit
+        int vertexBase = vertices->vertexCount;
+        int indexBase = indices != NULL ? indices->vertexCount : 0;
+        int rebaseOffset = indices != NULL ? indices->triangleCount - vertices->vertexCount : 0;
+        int fitted = 0;
+
+        for (int r = 0; r < rangeCount && !full; r++) {
+            BatchFillRange *range = &fill.ranges[r];
+
+            if (vertexBase + range->vertexCount > vertexCapacity || indexBase + range->indexCount > indexCapacity) {
+                int vertexCount = 0;
+                int indexCount = 0;
+                int end = range->begin;
+
+                for (; end < range->end; end++) {
+                    int entityVertices = 0;
+                    int entityIndices = 0;
+                    CountBatchMeshes(&fill.entities[end], indices != NULL, &entityVertices, &entityIndices);
+
+                    if (vertexBase + vertexCount + entityVertices > vertexCapacity ||
+                        indexBase + indexCount + entityIndices > indexCapacity) break;
+
+                    vertexCount += entityVertices;
+                    indexCount += entityIndices;
+                }
+
+                range->end = end;
+                range->vertexCount = vertexCount;
+                range->indexCount = indexCount;
+                full = true;
+            }
+
+            range->vertexBase = vertexBase;
+            range->indexBase = indexBase;
+            range->rebase = vertexBase + rebaseOffset;
+            vertexBase += range->vertexCount;
+            indexBase += range->indexCount;
+            fitted++;
+        }
+
+        ParallelFor(jobs, fitted, 1, WriteBatchRanges, &fill);
+
+        for (int r = 0; r < fitted; r++) {
+            if (fill.ranges[r].translucent) vertices->translucent = true;
+        }
+
+        if (indices != NULL) {
+            indices->vertexCount = indexBase;
+            indices->triangleCount = vertexBase + rebaseOffset;
+        }
+
+        vertices->vertexCount = vertexBase;
+        stored += fill.ranges[fitted - 1].end;
+    }
+
+    return stored;
+}
+
+void DrawEntitiesParallel(JobSystem *jobs, Entity *entities, int entityCount) {
+    if (recordingPacket != NULL) {
+        DrawEntities(entities, entityCount);
+        return;
+    }
+
+    Buffer *buffer = &bufferHandler.buffers[bufferHandler.currentBuffer];
+    DynamicIBuffer *indices = buffer->type == BufferRenderType::Elements ? &buffer->indexBuffer : NULL;
+
+    // Registered meshes only add a static draw, that list is not shared with the workers
+    for (int e = 0; e < entityCount; e++) {
+        for (int i = 0; i < entities[e].meshCount; i++) {
+            if (entities[e].meshes[i].registryId != 0) DrawMesh(&entities[e].meshes[i], entities[e].matrix);
+        }
+    }
+
+    int drawn = 0;
+
+    while (drawn < entityCount) {
+        drawn += FillBatchParallel(jobs, &buffer->vertexBuffer, indices, batchVertexCapacity, batchIndexCapacity, entities + drawn, entityCount - drawn);
+        if (drawn == entityCount) break;
+
+        if (buffer->vertexBuffer.vertexCount > 0) {
+            FlushBatch(buffer);
+            continue;
+        }
+
+        // Bigger than a whole batch, DrawMesh reports the meshes that do not fit
+        for (int i = 0; i < entities[drawn].meshCount; i++) {
+            if (entities[drawn].meshes[i].registryId == 0) DrawMesh(&entities[drawn].meshes[i], entities[drawn].matrix);
+        }
+        drawn++;
+    }
+}
+#endif // COD3R_GL_STANDALONE
+
+// Model matrix giving the same result as the batch, which transforms with w = VERTEX_TRANSFORM_W
+static inline glm::mat4 GetBatchModelMatrix(const glm::mat4 &matrix) {
+    glm::mat4 result = matrix;
+    result[3] = glm::vec4(glm::vec3(matrix[3]) * VERTEX_TRANSFORM_W, 1.0f);
+
+    return result;
+}
+
+void ComputeMeshBounds(Mesh *mesh) {
+    const int count = mesh->vertexCount / 3;
+
+    if (count == 0) {
+        mesh->boundsMin = glm::vec3(0.0f);
+        mesh->boundsMax = glm::vec3(0.0f);
+        return;
+    }
+
+    mesh->boundsMin = glm::vec3(mesh->vertices[0], mesh->vertices[1], mesh->vertices[2]);
+    mesh->boundsMax = mesh->boundsMin;
+
+    for (int i = 1; i < count; i++) {
+        glm::vec3 v = glm::vec3(mesh->vertices[i * 3], mesh->vertices[i * 3 + 1], mesh->vertices[i * 3 + 2]);
+        mesh->boundsMin = glm::min(mesh->boundsMin, v);
+        mesh->boundsMax = glm::max(mesh->boundsMax, v);
+    }
+}
+
+#if !defined(COD3R_GL_STANDALONE)
+void GetDrawBounds(const glm::vec3 &localMin, const glm::vec3 &localMax, const glm::mat4 &matrix, glm::vec3 *min, glm::vec3 *max) {
+    TransformAABB(GetBatchModelMatrix(matrix), localMin, localMax, min, max);
+}
+
+Frustum GetCameraFrustum() {
+    return MakeFrustum(projection * GetViewMatrixCamera());
+}
+#endif // COD3R_GL_STANDALONE
+
+static void QueueStaticDraw(const Mesh *mesh, const glm::mat4 &matrix, int firstIndex, int indicesCount) {
+    // The model of an arena draw goes to the instance ring
+    const bool geometry = staticMeshes[mesh->registryId - 1].arenaId != 0;
+
+    if (geometry && frameInstanceCount >= MAX_INSTANCES_PER_FRAME) {
+        printf("Too many instances this frame, max: %i\n", MAX_INSTANCES_PER_FRAME);
+        return;
+    }
+
+    if (staticDrawLast == NULL || staticDrawLast->count == FRAME_BLOCK_ITEMS) {
+        StaticDrawBlock *block = (StaticDrawBlock *)FrameAlloc(sizeof(StaticDrawBlock), 16);
+        if (block == NULL) return;
+
+        block->count = 0;
+        block->next = NULL;
+
+        if (staticDrawLast != NULL) staticDrawLast->next = block;
+        else staticDrawFirst = block;
+        staticDrawLast = block;
+    }
+
+    StaticDraw *draw = &staticDrawLast->items[staticDrawLast->count++];
+    draw->registryId = mesh->registryId;
+    draw->layer = renderLayer;
+    draw->firstIndex = firstIndex;
+    draw->indicesCount = indicesCount;
+    draw->instance = geometry ? frameGeometryDrawCount++ : -1;
+    draw->model = GetBatchModelMatrix(matrix);
+    staticDrawCount++;
+
+    if (geometry) frameInstanceCount++;
+}
+
+void DrawMesh(const Mesh *mesh, const glm::mat4 &matrix) {
+    if (recordingPacket != NULL) {
+        RecordFrameDraw(mesh, matrix, NULL, 0, 0, 0);
+        return;
+    }
+
+    if (mesh->registryId != 0) {
+        QueueStaticDraw(mesh, matrix, 0, 0);
+        return;
+    }
+
+    Buffer *buffer = &bufferHandler.buffers[bufferHandler.currentBuffer];
+    const int vertexCount = mesh->vertexCount / 3;
+    const int indicesCount = buffer->type == BufferRenderType::Elements ? mesh->indicesCount : 0;
+
+    if (vertexCount > batchVertexCapacity || indicesCount > batchIndexCapacity) {
+        printf("Mesh too big for a batch (%i vertices), upload it with UploadMesh\n", vertexCount);
+        return;
+    }
+
+    // A full batch goes to the GPU now, the mesh starts the next one
+    if (buffer->vertexBuffer.vertexCount + vertexCount > batchVertexCapacity ||
+        buffer->indexBuffer.vertexCount + indicesCount > batchIndexCapacity) {
+        FlushBatch(buffer);
+    }
+
+    StoreDataToBufferv(&buffer->vertexBuffer, mesh, matrix);
+
+    if (buffer->type == BufferRenderType::Elements) {
+        StoreDataToBufferi(&buffer->indexBuffer, mesh->indices, mesh->indicesCount, mesh->triangleCount);
+    }
+}
+
+void DrawMeshRange(const Mesh *mesh, const glm::mat4 &matrix, int firstIndex, int indicesCount) {
+    if (recordingPacket != NULL) {
+        RecordFrameDraw(mesh, matrix, NULL, 0, firstIndex, indicesCount);
+        return;
+    }
+
+    if (mesh->registryId == 0) {
+        printf("DrawMeshRange needs a mesh uploaded with UploadMesh or UploadMeshVertices\n");
+        return;
+    }
+
+    QueueStaticDraw(mesh, matrix, firstIndex, indicesCount);
+}
+
+// Batch of the quads sampling `textureLayer`, an empty batch left unused this frame is given to it when there is none
+static Buffer *GetQuadBuffer(unsigned int textureId, int textureLayer) {
+    Buffer *idle = NULL;
+
+    for (int i = 0; i < quadBufferCount; i++) {
+        Buffer *buffer = &quadBuffers[i];
+        if (buffer->textureId == textureId && buffer->textureLayer == textureLayer) return buffer;
+        if (idle == NULL && buffer->vertexBuffer.vertexCount == 0 && buffer->usedStreams == 0) idle = buffer;
+    }
+
+    if (idle == NULL) {
+        if (quadBufferCount == MAX_QUAD_BATCHES) {
+            printf("Too many texture layers drawn this frame, max: %i\n", MAX_QUAD_BATCHES);
+            return NULL;
+        }
+
+        quadBuffers[quadBufferCount] = CreateBufferEx(BufferRenderType::Elements, VERTEX_FORMAT_DEFAULT);
+        idle = &quadBuffers[quadBufferCount++];
+    }
+
+    idle->textureId = textureId;
+    idle->textureLayer = textureLayer;
+
+    return idle;
+}
+
+void DrawTexturedQuad(unsigned int textureId, int textureLayer, const float *uv, bool translucent, const glm::mat4 &matrix, const Vector4 *color) {
+    if (recordingPacket != NULL) {
+        FrameDraw *draw = RecordFrameDraw(NULL, matrix, color, FRAME_DRAW_QUAD | (translucent ? FRAME_DRAW_TRANSLUCENT : 0), 0, 0);
+        draw->textureId = textureId;
+        draw->textureLayer = textureLayer;
+        memcpy(draw->uv, uv, sizeof(draw->uv));
+        return;
+    }
+
+    Buffer *buffer = GetQuadBuffer(textureId, textureLayer);
+    if (buffer == NULL) return;
+
+    if (buffer->vertexBuffer.vertexCount + 4 > batchVertexCapacity || buffer->indexBuffer.vertexCount + 6 > batchIndexCapacity) {
+        FlushBatch(buffer);
+    }
+
+    BatchVertex *dst = buffer->vertexBuffer.data + buffer->vertexBuffer.vertexCount;
+    TransformVertices(matrix, rectVertices, dst->position, sizeof(BatchVertex) / sizeof(float), 4);
+
+    // Same corners as rectVertices: top right, bottom right, bottom left, top left
+    const float corners[4][2] = { { uv[2], uv[1] }, { uv[2], uv[3] }, { uv[0], uv[3] }, { uv[0], uv[1] } };
+    const unsigned int packed = color != NULL ? PackColor(&color->x) : 0xffffffff;
+
+    for (int i = 0; i < 4; i++) {
+        dst[i].color = packed;
+        dst[i].texcoord[0] = glm::packHalf1x16(corners[i][0]);
+        dst[i].texcoord[1] = glm::packHalf1x16(corners[i][1]);
+    }
+
+    if (translucent || (packed >> 24) != 0xff) buffer->vertexBuffer.translucent = true;
+
+    buffer->vertexBuffer.vertexCount += 4;
+    StoreDataToBufferi(&buffer->indexBuffer, rectIndices, 6, 4);
+}
+
+// No mipmaps: sprites are drawn about their texel size, the texels around each image keep linear filtering clean
+unsigned int CreateTextureArray(int size, int layers, const void *pixels) {
+    unsigned int textureId = 0;
+
+    glGenTextures(1, &textureId);
+    StateBindTexture(textureId);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+    return textureId;
+}
+
+void UpdateTextureArrayLayer(unsigned int textureId, int size, int layer, const void *pixels) {
+    StateBindTexture(textureId);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+void UnloadTextureArray(unsigned int textureId) {
+    if (textureId == 0) return;
+
+    glDeleteTextures(1, &textureId);
+    if (stateCache.textureArray == textureId) stateCache.textureArray = STATE_UNKNOWN;
+}
+
+void DrawEntity(Entity entity) {
+    DrawEntities(&entity, 1);
+}
+
+// Uploads the geometry and points the instance attributes at the start of the instance ring
+static void CreateInstancedMeshBuffers(InstancedMesh *instanced, const float *vertices, int vertexCount, const int *indices, int indicesCount) {
+    instanced->indicesCount = indicesCount;
+
+    glGenVertexArrays(1, &instanced->vaoId);
+    glGenBuffers(2, instanced->vboId);
+
+    StateBindVertexArray(instanced->vaoId);
+
+    StateBindBuffer(GL_ARRAY_BUFFER, instanced->vboId[0]);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(float), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(LOC_VERTEX_POSITION, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+    glEnableVertexAttribArray(LOC_VERTEX_POSITION);
+
+    StateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, instanced->vboId[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesCount * sizeof(int), indices, GL_STATIC_DRAW);
+
+    // Set once, RecordRenderQueue only moves them when base instance is not supported
+    StateBindBuffer(GL_ARRAY_BUFFER, instanceBufferId);
+    SetInstanceAttribPointers(0);
+    instanced->attribOffset = 0;
+
+    for (int column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(LOC_VERTEX_INSTANCE_MODEL + column);
+        glVertexAttribDivisor(LOC_VERTEX_INSTANCE_MODEL + column, 1);
+    }
+    glEnableVertexAttribArray(LOC_VERTEX_INSTANCE_COLOR);
+    glVertexAttribDivisor(LOC_VERTEX_INSTANCE_COLOR, 1);
+
+    StateBindVertexArray(0);
+}
+
+static bool IsInstancedMeshDrawn(const InstancedMesh *instanced) {
+    for (int layer = 0; layer < MAX_RENDER_LAYERS; layer++) {
+        if (instanced->groups[layer].instanceCount > 0) return true;
+    }
+
+    return false;
+}
+
+static void FreeInstancedMesh(InstancedMesh *instanced) {
+    glDeleteVertexArrays(1, &instanced->vaoId);
+    glDeleteBuffers(2, instanced->vboId);
+    ResetStateCache();
+}
+
+// Finds the GPU copy of the mesh geometry, uploading it the first time it is seen. Registry meshes are found by their
+// id, the others by a hash of their positions and indices (UploadMesh them to skip hashing on every draw). A full
+// cache reuses a mesh not drawn this frame.
+static InstancedMesh *GetInstancedMesh(const Mesh *mesh) {
+    unsigned long long hash = 0;
+
+    if (mesh->registryId == 0) {
+        hash = HashBytes(14695981039346656037ULL, &mesh->vertexCount, sizeof(int));
+        hash = HashBytes(hash, &mesh->indicesCount, sizeof(int));
+        hash = HashBytes(hash, mesh->vertices, mesh->vertexCount * sizeof(float));
+        hash = HashBytes(hash, mesh->indices, mesh->indicesCount * sizeof(int));
+    }
+
+    for (int i = 0; i < instancedMeshCount; i++) {
+        if (instancedMeshes[i].registryId == mesh->registryId && instancedMeshes[i].hash == hash) return &instancedMeshes[i];
+    }
+
+    InstancedMesh *instanced = NULL;
+
+    if (instancedMeshCount < MAX_INSTANCED_MESHES) {
+        instanced = &instancedMeshes[instancedMeshCount++];
+    } else {
+        for (int i = 0; i < instancedMeshCount && instanced == NULL; i++) {
+            if (!IsInstancedMeshDrawn(&instancedMeshes[i])) instanced = &instancedMeshes[i];
+        }
+
+        if (instanced == NULL) {
+            printf("Too many instanced meshes this frame, max: %i\n", MAX_INSTANCED_MESHES);
+            return NULL;
+        }
+
+        FreeInstancedMesh(instanced);
+    }
+
+    *instanced = { 0 };
+    instanced->registryId = mesh->registryId;
+    instanced->hash = hash;
+    CreateInstancedMeshBuffers(instanced, mesh->vertices, mesh->vertexCount, mesh->indices, mesh->indicesCount);
+
+    return instanced;
+}
+
+// The GPU copy of a registry mesh goes with its last reference, the last entry takes its place
+static void ReleaseInstancedMesh(unsigned int registryId) {
+    for (int i = 0; i < instancedMeshCount; i++) {
+        if (instancedMeshes[i].registryId != registryId) continue;
+
+        FreeInstancedMesh(&instancedMeshes[i]);
+        instancedMeshes[i] = instancedMeshes[--instancedMeshCount];
+        return;
+    }
+}
+
+void DrawEntityInstanced(Entity entity) {
+    for (int i = 0; i < entity.meshCount; i++) {
+        DrawMeshInstanced(&entity.meshes[i], entity.matrix, NULL);
+    }
+}
+
+void DrawMeshInstanced(const Mesh *mesh, const glm::mat4 &matrix, const Vector4 *color) {
+    if (recordingPacket != NULL) {
+        RecordFrameDraw(mesh, matrix, color, FRAME_DRAW_INSTANCED, 0, 0);
+        return;
+    }
+
+    if (frameInstanceCount >= MAX_INSTANCES_PER_FRAME) {
+        printf("Too many instances this frame, max: %i\n", MAX_INSTANCES_PER_FRAME);
+        return;
+    }
+
+    InstancedMesh *instanced = GetInstancedMesh(mesh);
+    if (instanced == NULL) return;
+
+    InstanceGroup *group = &instanced->groups[renderLayer];
+
+    if (group->lastBlock == NULL || group->lastBlock->count == FRAME_BLOCK_ITEMS) {
+        InstanceBlock *block = (InstanceBlock *)FrameAlloc(sizeof(InstanceBlock), 16);
+        if (block == NULL) return;
+
+        block->count = 0;
+        block->next = NULL;
+
+        if (group->lastBlock != NULL) group->lastBlock->next = block;
+        else group->firstBlock = block;
+        group->lastBlock = block;
+    }
+
+    InstanceData *instance = &group->lastBlock->items[group->lastBlock->count++];
+    group->instanceCount++;
+
+    instance->model = GetBatchModelMatrix(matrix);
+
+    if (color != NULL) instance->color = PackColor(&color->x);
+    else instance->color = mesh->colors != NULL ? PackColor(mesh->colors) : 0xffffffff;
+
+    if ((instance->color >> 24) != 0xff) group->translucent = true;
+
+    frameInstanceCount++;
+}
+
+// 16-bit copy of the indices when `vertexCount` vertices fit, NULL when they have to stay 32-bit
+static unsigned short *ShortenIndices(const int *indices, int indicesCount, int vertexCount) {
+    if (vertexCount >= 65536) return NULL;
+
+    unsigned short *shortIndices = (unsigned short *)malloc(indicesCount * sizeof(unsigned short));
+    for (int i = 0; i < indicesCount; i++) shortIndices[i] = (unsigned short)indices[i];
+
+    return shortIndices;
+}
+
+bool PackMeshVertices(BatchVertex *dst, const Mesh *mesh) {
+    const int count = mesh->vertexCount / 3;
+
+    for (int i = 0; i < count; i++) {
+        dst[i].position[0] = mesh->vertices[i * 3];
+        dst[i].position[1] = mesh->vertices[i * 3 + 1];
+        dst[i].position[2] = mesh->vertices[i * 3 + 2];
+    }
+
+    return PackVertexAttributes(dst, mesh, count);
+}
+
+unsigned long long HashPackedMesh(const PackedMesh *packed) {
+    const int indicesCount = packed->indices != NULL ? packed->indicesCount : 0;
+    unsigned long long hash = 14695981039346656037ULL;
+
+    hash = HashBytes(hash, &packed->vertexCount, sizeof(int));
+    hash = HashBytes(hash, &indicesCount, sizeof(int));
+    hash = HashBytes(hash, packed->vertices, packed->vertexCount * sizeof(BatchVertex));
+
+    // Index values, 16 and 32-bit copies of the same indices hash the same
+    for (int i = 0; i < indicesCount; i++) {
+        const unsigned int index = packed->indexType == GL_UNSIGNED_SHORT ? ((const unsigned short *)packed->indices)[i] : ((const unsigned int *)packed->indices)[i];
+        hash = HashBytes(hash, &index, sizeof(unsigned int));
+    }
+
+    return hash;
+}
+
+// BatchVertex attributes of the bound VAO, read from the bound array buffer
+static void SetStaticVertexAttribPointers() {
+    glVertexAttribPointer(LOC_VERTEX_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void *)offsetof(BatchVertex, position));
+    glVertexAttribPointer(LOC_VERTEX_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BatchVertex), (void *)offsetof(BatchVertex, color));
+    glVertexAttribPointer(LOC_VERTEX_TEXCOORD, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(BatchVertex), (void *)offsetof(BatchVertex, texcoord));
+    glEnableVertexAttribArray(LOC_VERTEX_POSITION);
+    glEnableVertexAttribArray(LOC_VERTEX_COLOR);
+    glEnableVertexAttribArray(LOC_VERTEX_TEXCOORD);
+}
+
+// Creates the GPU buffers of a registry slot, positions are uploaded untransformed.
+// With `shared` indices, only the vertices are uploaded and the VAO draws from the shared buffer.
+static void CreateStaticMesh(StaticMesh *uploaded, const PackedMesh *packed, const IndexBuffer *shared) {
+    *uploaded = { 0 };
+    uploaded->hash = packed->hash;
+    uploaded->vertexCount = packed->vertexCount;
+    uploaded->indicesCount = packed->indices != NULL ? packed->indicesCount : 0;
+    uploaded->translucent = packed->translucent;
+    uploaded->refCount = 1;
+
+    glGenVertexArrays(1, &uploaded->vaoId);
+    glGenBuffers(shared != NULL ? 1 : 2, uploaded->vboId);
+
+    StateBindVertexArray(uploaded->vaoId);
+
+    StateBindBuffer(GL_ARRAY_BUFFER, uploaded->vboId[0]);
+    glBufferData(GL_ARRAY_BUFFER, packed->vertexCount * sizeof(BatchVertex), packed->vertices, GL_STATIC_DRAW);
+    SetStaticVertexAttribPointers();
+
+    if (shared != NULL) {
+        StateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shared->id);
+        uploaded->vboId[1] = shared->id;
+        uploaded->indicesCount = shared->indicesCount;
+        uploaded->indexType = shared->indexType;
+        uploaded->sharedIndices = true;
+    } else if (uploaded->indicesCount > 0) {
+        const size_t indexSize = packed->indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+        StateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, uploaded->vboId[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, uploaded->indicesCount * indexSize, packed->indices, GL_STATIC_DRAW);
+        uploaded->indexType = packed->indexType;
+    }
+
+    StateBindVertexArray(0);
+}
+
+// Slot holding `hash`, or a new slot when `create` is true (refCount 0, to be filled by CreateStaticMesh). -1 otherwise.
+static int FindStaticMesh(unsigned long long hash, bool create) {
+    int freeSlot = -1;
+
+    for (int i = 0; i < staticMeshCount; i++) {
+        if (staticMeshes[i].refCount == 0) {
+            if (freeSlot == -1) freeSlot = i;
+        } else if (staticMeshes[i].hash == hash) {
+            return i;
+        }
+    }
+
+    if (!create) return -1;
+
+    if (freeSlot == -1) {
+        if (staticMeshCount >= MAX_STATIC_MESHES) {
+            printf("Too many static meshes, max: %i\n", MAX_STATIC_MESHES);
+            return -1;
+        }
+
+        freeSlot = staticMeshCount++;
+    }
+
+    return freeSlot;
+}
+
+static void InitGeometryAllocator(GeometryAllocator *allocator, int capacity) {
+    allocator->spanCapacity = 16;
+    allocator->spans = (GeometrySpan *)malloc(allocator->spanCapacity * sizeof(GeometrySpan));
+    allocator->spans[0].offset = 0;
+    allocator->spans[0].count = capacity;
+    allocator->spanCount = 1;
+    allocator->capacity = capacity;
+    allocator->used = 0;
+}
+
+// First free span large enough, -1 when there is none
+static int AllocateGeometry(GeometryAllocator *allocator, int count) {
+    for (int i = 0; i < allocator->spanCount; i++) {
+        GeometrySpan *span = &allocator->spans[i];
+        if (span->count < count) continue;
+
+        const int offset = span->offset;
+        span->offset += count;
+        span->count -= count;
+
+        if (span->count == 0) {
+            memmove(span, span + 1, (allocator->spanCount - i - 1) * sizeof(GeometrySpan));
+            allocator->spanCount--;
+        }
+
+        allocator->used += count;
+        return offset;
+    }
+
+    return -1;
+}
+
+static void FreeGeometry(GeometryAllocator *allocator, int offset, int count) {
+    int i = 0;
+    while (i < allocator->spanCount && allocator->spans[i].offset < offset) i++;
+
+    GeometrySpan *previous = i > 0 ? &allocator->spans[i - 1] : NULL;
+    GeometrySpan *next = i < allocator->spanCount ? &allocator->spans[i] : NULL;
+    const bool joinPrevious = previous != NULL && previous->offset + previous->count == offset;
+    const bool joinNext = next != NULL && offset + count == next->offset;
+
+    allocator->used -= count;
+
+    if (joinPrevious && joinNext) {
+        previous->count += count + next->count;
+        memmove(next, next + 1, (allocator->spanCount - i - 1) * sizeof(GeometrySpan));
+        allocator->spanCount--;
+    } else if (joinPrevious) {
+        previous->count += count;
+    } else if (joinNext) {
+        next->offset = offset;
+        next->count += count;
+    } else {
+        if (allocator->spanCount == allocator->spanCapacity) {
+            allocator->spanCapacity *= 2;
+            allocator->spans = (GeometrySpan *)realloc(allocator->spans, allocator->spanCapacity * sizeof(GeometrySpan));
+        }
+
+        memmove(&allocator->spans[i + 1], &allocator->spans[i], (allocator->spanCount - i) * sizeof(GeometrySpan));
+        allocator->spans[i].offset = offset;
+        allocator->spans[i].count = count;
+        allocator->spanCount++;
+    }
+}
+
+// Elements up to the end of the last allocation
+static int GetGeometryExtent(const GeometryAllocator *allocator) {
+    if (allocator->spanCount == 0) return allocator->capacity;
+
+    const GeometrySpan *last = &allocator->spans[allocator->spanCount - 1];
+    return last->offset + last->count == allocator->capacity ? last->offset : allocator->capacity;
+}
+
+// Points the arena VAO at its buffers. The model of every draw comes from the instance ring like instanced meshes,
+// from the start of the ring until RecordRenderQueue moves it.
+static void BindGeometryArenaBuffers(GeometryArena *arena) {
+    StateBindVertexArray(arena->vaoId);
+
+    StateBindBuffer(GL_ARRAY_BUFFER, arena->vboId[0]);
+    SetStaticVertexAttribPointers();
+    StateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena->vboId[1]);
+
+    StateBindBuffer(GL_ARRAY_BUFFER, instanceBufferId);
+    SetInstanceAttribPointers(0);
+    arena->attribOffset = 0;
+
+    for (int column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(LOC_VERTEX_INSTANCE_MODEL + column);
+        glVertexAttribDivisor(LOC_VERTEX_INSTANCE_MODEL + column, 1);
+    }
+    glEnableVertexAttribArray(LOC_VERTEX_INSTANCE_COLOR);
+    glVertexAttribDivisor(LOC_VERTEX_INSTANCE_COLOR, 1);
+
+    StateBindVertexArray(0);
+}
+
+// Buffers of `vertexBytes` and `indexBytes`, filled from `vertices` and `indices` when they are not NULL
+static void CreateGeometryArenaBuffers(GeometryArena *arena, long vertexBytes, const void *vertices, long indexBytes, const void *indices) {
+    glGenVertexArrays(1, &arena->vaoId);
+    glGenBuffers(2, arena->vboId);
+
+    // The copy target leaves the array and element bindings (and the bound VAO) alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vboId[0]);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vboId[1]);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
+
+    BindGeometryArenaBuffers(arena);
+}
+
+// Copies the meshes of the arena to the start of new buffers, in registry order. Indices are relative to the first
+// vertex of their mesh, they are copied as is. Both buffers exist at the same time during the copy.
+static void CompactGeometryArena(int arenaIndex) {
+    GeometryArena *arena = &geometryArenas[arenaIndex];
+
+    if (GetGeometryExtent(&arena->vertices) == arena->vertices.used && GetGeometryExtent(&arena->indices) == arena->indices.used) return;
+
+    unsigned int vboId[2];
+    glGenBuffers(2, vboId);
+
+    const size_t elementSizes[2] = { sizeof(BatchVertex), sizeof(unsigned short) };
+    const GeometryAllocator *allocators[2] = { &arena->vertices, &arena->indices };
+    int ends[2] = { 0, 0 };
+
+    for (int b = 0; b < 2; b++) {
+        glBindBuffer(GL_COPY_READ_BUFFER, arena->vboId[b]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vboId[b]);
+        glBufferData(GL_COPY_WRITE_BUFFER, allocators[b]->capacity * elementSizes[b], NULL, GL_STATIC_DRAW);
+
+        for (int i = 0; i < staticMeshCount; i++) {
+            StaticMesh *mesh = &staticMeshes[i];
+            if (mesh->refCount == 0 || mesh->arenaId != (unsigned int)arenaIndex + 1) continue;
+
+            int *first = b == 0 ? &mesh->firstVertex : &mesh->firstIndex;
+            const int count = b == 0 ? mesh->vertexCount : mesh->indicesCount;
+
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, *first * elementSizes[b], ends[b] * elementSizes[b], count * elementSizes[b]);
+            *first = ends[b];
+            ends[b] += count;
+            mesh->vboId[b] = vboId[b];
+        }
+    }
+
+    glDeleteBuffers(2, arena->vboId);
+    arena->vboId[0] = vboId[0];
+    arena->vboId[1] = vboId[1];
+
+    // The free space is now one span at the end of each buffer
+    GeometryAllocator *rebuilt[2] = { &arena->vertices, &arena->indices };
+    for (int b = 0; b < 2; b++) {
+        rebuilt[b]->spanCount = 0;
+        if (ends[b] == rebuilt[b]->capacity) continue;
+
+        rebuilt[b]->spans[0].offset = ends[b];
+        rebuilt[b]->spans[0].count = rebuilt[b]->capacity - ends[b];
+        rebuilt[b]->spanCount = 1;
+    }
+
+    ResetStateCache();
+    BindGeometryArenaBuffers(arena);
+    geometryCompactions++;
+}
+
+void CompactGeometryArenas() {
+    for (int i = 0; i < geometryArenaCount; i++) CompactGeometryArena(i);
+}
+
+// Vertex and index ranges in one arena, compacted first when only its holes put together have room
+static bool AllocateArenaRanges(int arenaIndex, int vertexCount, int indicesCount, int *firstVertex, int *firstIndex) {
+    GeometryArena *arena = &geometryArenas[arenaIndex];
+
+    if (arena->vertices.capacity - arena->vertices.used < vertexCount || arena->indices.capacity - arena->indices.used < indicesCount) {
+        return false;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        *firstVertex = AllocateGeometry(&arena->vertices, vertexCount);
+        *firstIndex = *firstVertex != -1 ? AllocateGeometry(&arena->indices, indicesCount) : -1;
+        if (*firstIndex != -1) return true;
+
+        if (*firstVertex != -1) FreeGeometry(&arena->vertices, *firstVertex, vertexCount);
+        if (attempt == 0) CompactGeometryArena(arenaIndex);
+    }
+
+    return false;
+}
+
+// Fills a registry slot with a place in the first arena with room, a new arena is opened when none has. False when
+// the mesh has to get its own buffers: not indexed, 32-bit indices, or every arena is full.
+static bool PlaceArenaMesh(StaticMesh *uploaded, const PackedMesh *packed) {
+    if (packed->indices == NULL || packed->indexType != GL_UNSIGNED_SHORT ||
+        packed->vertexCount > GEOMETRY_ARENA_VERTICES || packed->indicesCount > GEOMETRY_ARENA_INDICES) {
+        return false;
+    }
+
+    int arenaIndex = -1;
+    int firstVertex = 0;
+    int firstIndex = 0;
+
+    for (int i = 0; i < geometryArenaCount && arenaIndex == -1; i++) {
+        if (AllocateArenaRanges(i, packed->vertexCount, packed->indicesCount, &firstVertex, &firstIndex)) arenaIndex = i;
+    }
+
+    if (arenaIndex == -1) {
+        if (geometryArenaCount == MAX_GEOMETRY_ARENAS) return false;
+
+        GeometryArena *arena = &geometryArenas[geometryArenaCount];
+        *arena = { 0 };
+        InitGeometryAllocator(&arena->vertices, GEOMETRY_ARENA_VERTICES);
+        InitGeometryAllocator(&arena->indices, GEOMETRY_ARENA_INDICES);
+        CreateGeometryArenaBuffers(arena, GEOMETRY_ARENA_VERTICES * sizeof(BatchVertex), NULL, GEOMETRY_ARENA_INDICES * sizeof(unsigned short), NULL);
+
+        arenaIndex = geometryArenaCount++;
+        AllocateArenaRanges(arenaIndex, packed->vertexCount, packed->indicesCount, &firstVertex, &firstIndex);
+    }
+
+    GeometryArena *arena = &geometryArenas[arenaIndex];
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vboId[0]);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (long)firstVertex * sizeof(BatchVertex), packed->vertexCount * sizeof(BatchVertex), packed->vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vboId[1]);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (long)firstIndex * sizeof(unsigned short), packed->indicesCount * sizeof(unsigned short), packed->indices);
+
+    *uploaded = { 0 };
+    uploaded->hash = packed->hash;
+    uploaded->vaoId = arena->vaoId;
+    uploaded->vboId[0] = arena->vboId[0];
+    uploaded->vboId[1] = arena->vboId[1];
+    uploaded->vertexCount = packed->vertexCount;
+    uploaded->indicesCount = packed->indicesCount;
+    uploaded->indexType = GL_UNSIGNED_SHORT;
+    uploaded->translucent = packed->translucent;
+    uploaded->refCount = 1;
+    uploaded->arenaId = arenaIndex + 1;
+    uploaded->firstVertex = firstVertex;
+    uploaded->firstIndex = firstIndex;
+    arena->meshCount++;
+
+    return true;
+}
+
+GeometryStats GetGeometryStats() {
+    GeometryStats stats = { 0 };
+    stats.arenas = geometryArenaCount;
+    stats.compactions = geometryCompactions;
+
+    for (int i = 0; i < geometryArenaCount; i++) {
+        stats.meshes += geometryArenas[i].meshCount;
+        stats.verticesUsed += geometryArenas[i].vertices.used;
+        stats.indicesUsed += geometryArenas[i].indices.used;
+        stats.freeSpans += geometryArenas[i].vertices.spanCount + geometryArenas[i].indices.spanCount;
+    }
+
+    return stats;
+}
+
+static unsigned int AcquireStaticMesh(Mesh *mesh, int slot) {
+    mesh->vaoId = staticMeshes[slot].vaoId;
+    mesh->vboId = staticMeshes[slot].vboId;
+    mesh->registryId = slot + 1;
+
+    return mesh->registryId;
+}
+
+static unsigned int UploadMeshEx(Mesh *mesh, const IndexBuffer *shared) {
+    if (mesh->registryId != 0) return mesh->registryId;
+
+    // Packed first, the registry key is the hash of the GPU layout
+    PackedMesh packed = { 0 };
+    BatchVertex *vertices = (BatchVertex *)malloc((mesh->vertexCount / 3) * sizeof(BatchVertex));
+    unsigned short *shortIndices = NULL;
+
+    packed.vertices = vertices;
+    packed.vertexCount = mesh->vertexCount / 3;
+    packed.translucent = PackMeshVertices(vertices, mesh);
+
+    if (shared == NULL && mesh->indices != NULL) {
+        shortIndices = ShortenIndices(mesh->indices, mesh->indicesCount, packed.vertexCount);
+        packed.indices = shortIndices != NULL ? (const void *)shortIndices : (const void *)mesh->indices;
+        packed.indicesCount = mesh->indicesCount;
+        packed.indexType = shortIndices != NULL ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    packed.hash = HashPackedMesh(&packed);
+    if (shared != NULL) packed.hash = HashBytes(packed.hash, &shared->id, sizeof(unsigned int));
+
+    const int slot = FindStaticMesh(packed.hash, true);
+
+    if (slot != -1 && staticMeshes[slot].refCount > 0) {
+        staticMeshes[slot].refCount++;
+    } else if (slot != -1 && (shared != NULL || !PlaceArenaMesh(&staticMeshes[slot], &packed))) {
+        CreateStaticMesh(&staticMeshes[slot], &packed, shared);
+    }
+
+    free(vertices);
+    free(shortIndices);
+
+    return slot != -1 ? AcquireStaticMesh(mesh, slot) : 0;
+}
+
+unsigned int UploadMesh(Mesh *mesh) {
+    return UploadMeshEx(mesh, NULL);
+}
+
+unsigned int UploadMeshVertices(Mesh *mesh, const IndexBuffer *indices) {
+    return UploadMeshEx(mesh, indices);
+}
+
+unsigned int UploadPackedMesh(Mesh *mesh, const PackedMesh *packed) {
+    if (mesh->registryId != 0) return mesh->registryId;
+
+    int slot = FindStaticMesh(packed->hash, true);
+    if (slot == -1) return 0;
+
+    if (staticMeshes[slot].refCount > 0) staticMeshes[slot].refCount++;
+    else if (!PlaceArenaMesh(&staticMeshes[slot], packed)) CreateStaticMesh(&staticMeshes[slot], packed, NULL);
+
+    return AcquireStaticMesh(mesh, slot);
+}
+
+IndexBuffer UploadIndexBuffer(const int *indices, int indicesCount, int vertexCount) {
+    IndexBuffer buffer = { 0 };
+
+    glGenBuffers(1, &buffer.id);
+
+    // Filled through the array target, the element array binding belongs to the bound VAO
+    StateBindBuffer(GL_ARRAY_BUFFER, buffer.id);
+
+    unsigned short *shortIndices = ShortenIndices(indices, indicesCount, vertexCount);
+
+    if (shortIndices != NULL) {
+        glBufferData(GL_ARRAY_BUFFER, indicesCount * sizeof(unsigned short), shortIndices, GL_STATIC_DRAW);
+        buffer.indexType = GL_UNSIGNED_SHORT;
+        free(shortIndices);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, indicesCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+        buffer.indexType = GL_UNSIGNED_INT;
+    }
+    buffer.indicesCount = indicesCount;
+
+    return buffer;
+}
+
+void UnloadIndexBuffer(IndexBuffer *indices) {
+    if (indices->id == 0) return;
+
+    glDeleteBuffers(1, &indices->id);
+    ResetStateCache();
+    *indices = { 0 };
+}
+
+void UnloadMesh(Mesh *mesh) {
+    if (mesh->registryId == 0) return;
+
+    StaticMesh *uploaded = &staticMeshes[mesh->registryId - 1];
+
+    if (--uploaded->refCount == 0) ReleaseInstancedMesh(mesh->registryId);
+
+    if (uploaded->refCount == 0 && uploaded->arenaId != 0) {
+        GeometryArena *arena = &geometryArenas[uploaded->arenaId - 1];
+        FreeGeometry(&arena->vertices, uploaded->firstVertex, uploaded->vertexCount);
+        FreeGeometry(&arena->indices, uploaded->firstIndex, uploaded->indicesCount);
+        arena->meshCount--;
+    } else if (uploaded->refCount == 0) {
+        glDeleteVertexArrays(1, &uploaded->vaoId);
+        glDeleteBuffers(uploaded->sharedIndices ? 1 : 2, uploaded->vboId);
+        ResetStateCache();
+    }
+
+    mesh->vaoId = 0;
+    mesh->vboId = NULL;
+    mesh->registryId = 0;
+}
+
+void UploadEntityMeshes(Entity *entity) {
+    for (int i = 0; i < entity->meshCount; i++) UploadMesh(&entity->meshes[i]);
+}
+
+void RotateEntityZ(Entity *entity, float angle) {
+    glm::mat4 matrix = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    };
+
+    entity->matrix = glm::rotate(entity->matrix, glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+void SetupCamera(glm::vec3 position, glm::vec3 up, float yaw, float pitch) {
+    currentCamera.position = position;
+    currentCamera.worldUp = up;
+
+    currentCamera.yaw = yaw;
+    currentCamera.pitch = pitch;
+
+    currentCamera.front = glm::vec3(0.0f, 0.0f, -1.0f);
+    currentCamera.movementSpeed = 2.5f;
+    currentCamera.mouseSensitivity = 0.1f;
+    currentCamera.zoom = 45.0f;
+
+    UpdateCameraVectors();
+}
+
+void UpdateCameraVectors() {
+    glm::vec3 front;
 
     front.x = std::cos(glm::radians(currentCamera.yaw)) * std::cos(glm::radians(currentCamera.pitch));
     front.y = std::sin(glm::radians(currentCamera.pitch));
@@ -627,6 +4651,52 @@ glm::mat4 GetViewMatrixCamera() {
     return glm::lookAt(currentCamera.position, currentCamera.position + currentCamera.front, currentCamera.up);
 }
 
+// Terrain grid, built once and shared by every terrain entity
+#define TERRAIN_SIZE 40.0f
+#define TERRAIN_VERTEX_COUNT 4
+static float terrainVertices[TERRAIN_VERTEX_COUNT * TERRAIN_VERTEX_COUNT * 3];
+static float terrainColors[TERRAIN_VERTEX_COUNT * TERRAIN_VERTEX_COUNT * 4];
+static int terrainIndices[(TERRAIN_VERTEX_COUNT - 1) * (TERRAIN_VERTEX_COUNT - 1) * 6];
+static bool terrainBuilt = false;
+
+static void BuildTerrainGrid() {
+    int vertexCount = 0;
+    int indicesCount = 0;
+
+    for (int z = 0; z < TERRAIN_VERTEX_COUNT; z++) {
+        for (int x = 0; x < TERRAIN_VERTEX_COUNT; x++) {
+            terrainVertices[vertexCount++] = (float) x / ((float)TERRAIN_VERTEX_COUNT - 1) * TERRAIN_SIZE;
+            terrainVertices[vertexCount++] = 0.0f;
+            terrainVertices[vertexCount++] = (float) z / ((float)TERRAIN_VERTEX_COUNT - 1) * TERRAIN_SIZE;
+        }
+    }
+
+    for (int i = 0; i < TERRAIN_VERTEX_COUNT * TERRAIN_VERTEX_COUNT * 4;) {
+        terrainColors[i++] = 0.15f;
+        terrainColors[i++] = 0.7f;
+        terrainColors[i++] = 0.26f;
+        terrainColors[i++] = 1.0f; // color alpha
+    }
+
+    for (int gz = 0; gz < TERRAIN_VERTEX_COUNT - 1; gz++) {
+        for (int gx = 0; gx < TERRAIN_VERTEX_COUNT - 1; gx++) {
+            int topLeft = (gz * TERRAIN_VERTEX_COUNT) + gx;
+            int topRight = topLeft +1;
+            int bottomLeft = ((gz + 1) * TERRAIN_VERTEX_COUNT) + gx;
+            int bottomRight = bottomLeft + 1;
+
+            terrainIndices[indicesCount++] = topLeft;
+            terrainIndices[indicesCount++] = bottomLeft;
+            terrainIndices[indicesCount++] = topRight;
+            terrainIndices[indicesCount++] = topRight;
+            terrainIndices[indicesCount++] = bottomLeft;
+            terrainIndices[indicesCount++] = bottomRight;
+        }
+    }
+
+    terrainBuilt = true;
+}
+
 Entity CreateTerrain(glm::vec3 position) {
     Entity entity;
     entity.meshes = (Mesh *)malloc(sizeof(Mesh));
@@ -639,59 +4709,16 @@ Entity CreateTerrain(glm::vec3 position) {
     };
     entity.matrix = glm::translate(matrix, position);
 
-    // 10x10 grid size
-    const float SIZE = 40.0f;
-    const int VERTEX_COUNT = 4;
-    Mesh mesh;
-    mesh.vertices = (float *)malloc((VERTEX_COUNT * VERTEX_COUNT * 3) * sizeof(float));
-    mesh.colors = (float *)malloc((VERTEX_COUNT * VERTEX_COUNT * 4) * sizeof(float));
-    mesh.indices = (int *)malloc(((VERTEX_COUNT - 1) * (VERTEX_COUNT - 1) * 6) * sizeof(int));
-
-    for (int z = 0; z < VERTEX_COUNT; z++) {
-        for (int x = 0; x < VERTEX_COUNT; x++) {
-            float xVert = (float) x / ((float)VERTEX_COUNT - 1) * SIZE;
-            float zVert = (float) z / ((float)VERTEX_COUNT - 1) * SIZE;
-
-            mesh.vertices[mesh.vertexCount] = xVert;
-            mesh.vertexCount++;
-            mesh.vertices[mesh.vertexCount] = 0.0f;
-            mesh.vertexCount++;
-            mesh.vertices[mesh.vertexCount] = zVert;
-            mesh.vertexCount++;
-        }
-    }
+    if (!terrainBuilt) BuildTerrainGrid();
 
+    Mesh mesh = { 0 };
+    mesh.vertexCount = TERRAIN_VERTEX_COUNT * TERRAIN_VERTEX_COUNT * 3;
     mesh.triangleCount = mesh.vertexCount / 3;
-    const int MAX_COLORS = mesh.vertexCount + mesh.triangleCount;
-
-    for (int i = 0; i < MAX_COLORS;) {
-        mesh.colors[i++] = 0.15f;
-        mesh.colors[i++] = 0.7f;
-        mesh.colors[i++] = 0.26f;
-        mesh.colors[i++] = 1.0f; // color alpha
-    }
-
-    for (int gz = 0; gz < VERTEX_COUNT - 1; gz++) {
-        for (int gx = 0; gx < VERTEX_COUNT - 1; gx++) {
-            int topLeft = (gz * VERTEX_COUNT) + gx;
-            int topRight = topLeft +1;
-            int bottomLeft = ((gz + 1) * VERTEX_COUNT) + gx;
-            int bottomRight = bottomLeft + 1;
-
-            mesh.indices[mesh.indicesCount] = topLeft;
-            mesh.indicesCount++;
-            mesh.indices[mesh.indicesCount] = bottomLeft;
-            mesh.indicesCount++;
-            mesh.indices[mesh.indicesCount] = topRight;
-            mesh.indicesCount++;
-            mesh.indices[mesh.indicesCount] = topRight;
-            mesh.indicesCount++;
-            mesh.indices[mesh.indicesCount] = bottomLeft;
-            mesh.indicesCount++;
-            mesh.indices[mesh.indicesCount] = bottomRight;
-            mesh.indicesCount++;
-        }
-    }
+    mesh.indicesCount = (TERRAIN_VERTEX_COUNT - 1) * (TERRAIN_VERTEX_COUNT - 1) * 6;
+    mesh.vertices = terrainVertices;
+    mesh.colors = terrainColors;
+    mesh.indices = terrainIndices;
+    ComputeMeshBounds(&mesh);
 
     entity.meshes[0] = mesh;
     entity.meshCount = 1;
@@ -700,30 +4727,84 @@ Entity CreateTerrain(glm::vec3 position) {
 }
 
 Buffer CreateBuffer(BufferRenderType type) {
+  return CreateBufferEx(type, VERTEX_FORMAT_DEFAULT);
+}
+
+// Streaming storage: STREAM_FRAMES_IN_FLIGHT regions per GL buffer, allocated once.
+// The VAO keeps the attribute setup since the storage never gets re-specified.
+static void CreateBatchStream(BatchStream *stream, BufferRenderType type, VertexFormat format) {
+  const int stride = GetVertexFormatStride(format);
+
+  *stream = { 0 };
+
+  glGenVertexArrays(1, &stream->vaoId);
+  glGenBuffers(1, &stream->vertexBufferId);
+  glGenBuffers(1, &stream->indexBufferId);
+
+  StateBindVertexArray(stream->vaoId);
+
+  StateBindBuffer(GL_ARRAY_BUFFER, stream->vertexBufferId);
+  glBufferData(GL_ARRAY_BUFFER, (long)STREAM_FRAMES_IN_FLIGHT * batchVertexCapacity * stride, NULL, GL_STREAM_DRAW);
+
+  if (format == VERTEX_FORMAT_COMPACT) {
+    glVertexAttribPointer(LOC_VERTEX_POSITION, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void *)offsetof(CompactBatchVertex, position));
+    glVertexAttribPointer(LOC_VERTEX_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offsetof(CompactBatchVertex, color));
+    glVertexAttribPointer(LOC_VERTEX_TEXCOORD, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)offsetof(CompactBatchVertex, texcoord));
+  } else {
+    glVertexAttribPointer(LOC_VERTEX_POSITION, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(BatchVertex, position));
+    glVertexAttribPointer(LOC_VERTEX_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offsetof(BatchVertex, color));
+    glVertexAttribPointer(LOC_VERTEX_TEXCOORD, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)offsetof(BatchVertex, texcoord));
+  }
+
+  glEnableVertexAttribArray(LOC_VERTEX_POSITION);
+  glEnableVertexAttribArray(LOC_VERTEX_COLOR);
+  glEnableVertexAttribArray(LOC_VERTEX_TEXCOORD);
+
+  if (type == BufferRenderType::Elements) {
+    StateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream->indexBufferId);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (long)STREAM_FRAMES_IN_FLIGHT * batchIndexCapacity * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+  }
+
+  StateBindVertexArray(0);
+}
+
+Buffer CreateBufferEx(BufferRenderType type, VertexFormat format) {
   Buffer buffer;
 
   buffer.type = type;
-  buffer.verticesBuffer = { 0 };
-  buffer.colorsBuffer = { 0 };
+  buffer.format = format;
+  buffer.vertexBuffer = { 0 };
   buffer.indexBuffer = { 0 };
+  buffer.id = -1;
+  buffer.textureId = 0;
+  buffer.textureLayer = 0;
 
-  glGenVertexArrays(1, &buffer.vaoId);
-  glGenBuffers(1, &buffer.verticesBuffer.bufferId);
-  glGenBuffers(1, &buffer.colorsBuffer.bufferId);
-  glGenBuffers(1, &buffer.indexBuffer.bufferId);
+  // One stream up front, more are added the first time a frame needs them
+  buffer.streams = (BatchStream *)malloc(sizeof(BatchStream));
+  buffer.streamCount = 1;
+  buffer.usedStreams = 0;
+  CreateBatchStream(&buffer.streams[0], type, format);
 
   // Allocate memory for Dynamic Buffers
-  buffer.verticesBuffer.data = (float *)malloc(MAX_DYNAMIC_DATA_PER_BUFFER * sizeof(float));
-  buffer.colorsBuffer.data = (float *)malloc(MAX_DYNAMIC_DATA_PER_BUFFER * sizeof(float));
+  buffer.vertexBuffer.data = (BatchVertex *)malloc(batchVertexCapacity * sizeof(BatchVertex));
 
   if (type == BufferRenderType::Elements) {
-    buffer.indexBuffer.data = (int *)malloc(MAX_DYNAMIC_DATA_PER_BUFFER * sizeof(int));
+    buffer.indexBuffer.data = (int *)malloc(batchIndexCapacity * sizeof(int));
   }
 
   return buffer;
 }
 
+int GetVertexFormatStride(VertexFormat format) {
+  return format == VERTEX_FORMAT_COMPACT ? sizeof(CompactBatchVertex) : sizeof(BatchVertex);
+}
+
 void BindBuffer(int id) {
+  if (id < 0 || id >= bufferHandler.size) {
+    printf("[Buffer ID: %i] Buffer not stored, ignored\n", id);
+    return;
+  }
+
   bufferHandler.currentBuffer = id;
 }
 
@@ -733,13 +4814,16 @@ int GetCurrentBuffer() {
 }
 
 void CleanBuffer(int id) {
-  bufferHandler.buffers[id].verticesBuffer.vertexCount = 0;
-  bufferHandler.buffers[id].colorsBuffer.vertexCount = 0;
-  bufferHandler.buffers[id].indexBuffer.vertexCount = 0;
-  bufferHandler.buffers[id].indexBuffer.triangleCount = 0;
+  ResetBatch(&bufferHandler.buffers[id]);
 }
 
 void StoreBuffer(Buffer *buffer) {
+  if (bufferHandler.size >= MAX_BUFFERS_RENDER) {
+    printf("Too many buffers, max: %i\n", MAX_BUFFERS_RENDER);
+    buffer->id = -1;
+    return;
+  }
+
   bufferHandler.buffers[bufferHandler.size] = *buffer;
   buffer->id = bufferHandler.size;
   bufferHandler.size += 1;
@@ -0,0 +1,386 @@
+#include "culling.h"
+#include <stdlib.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+
+Frustum MakeFrustum(const glm::mat4 &viewProjection) {
+    Frustum frustum;
+
+    // Rows of the matrix (glm is column major): left, right, bottom, top, near and far are w +- x, y and z
+    for (int i = 0; i < 6; i++) {
+        int axis = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+
+        frustum.nx[i] = viewProjection[0][3] + sign * viewProjection[0][axis];
+        frustum.ny[i] = viewProjection[1][3] + sign * viewProjection[1][axis];
+        frustum.nz[i] = viewProjection[2][3] + sign * viewProjection[2][axis];
+        frustum.d[i] = viewProjection[3][3] + sign * viewProjection[3][axis];
+    }
+
+    for (int i = 6; i < FRUSTUM_PLANE_LANES; i++) {
+        frustum.nx[i] = 0.0f;
+        frustum.ny[i] = 0.0f;
+        frustum.nz[i] = 0.0f;
+        frustum.d[i] = 1.0f;
+    }
+
+    return frustum;
+}
+
+// Center and extents form: the box is outside a plane when center distance + projected radius < 0
+CullResult TestFrustumAABBScalar(const Frustum *frustum, const glm::vec3 &min, const glm::vec3 &max) {
+    const glm::vec3 center = (min + max) * 0.5f;
+    const glm::vec3 extents = (max - min) * 0.5f;
+    bool intersects = false;
+
+    for (int i = 0; i < 6; i++) {
+        float distance = frustum->nx[i] * center.x + frustum->ny[i] * center.y + frustum->nz[i] * center.z + frustum->d[i];
+        float radius = fabsf(frustum->nx[i]) * extents.x + fabsf(frustum->ny[i]) * extents.y + fabsf(frustum->nz[i]) * extents.z;
+
+        if (distance + radius < 0.0f) return CULL_OUTSIDE;
+        if (distance - radius < 0.0f) intersects = true;
+    }
+
+    return intersects ? CULL_INTERSECTS : CULL_INSIDE;
+}
+
+CullResult TestFrustumAABB(const Frustum *frustum, const glm::vec3 &min, const glm::vec3 &max) {
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 cx = _mm_mul_ps(_mm_set1_ps(min.x + max.x), half);
+    const __m128 cy = _mm_mul_ps(_mm_set1_ps(min.y + max.y), half);
+    const __m128 cz = _mm_mul_ps(_mm_set1_ps(min.z + max.z), half);
+    const __m128 ex = _mm_mul_ps(_mm_set1_ps(max.x - min.x), half);
+    const __m128 ey = _mm_mul_ps(_mm_set1_ps(max.y - min.y), half);
+    const __m128 ez = _mm_mul_ps(_mm_set1_ps(max.z - min.z), half);
+    int outside = 0;
+    int intersects = 0;
+
+    // Four planes per iteration
+    for (int i = 0; i < FRUSTUM_PLANE_LANES; i += 4) {
+        __m128 nx = _mm_loadu_ps(frustum->nx + i);
+        __m128 ny = _mm_loadu_ps(frustum->ny + i);
+        __m128 nz = _mm_loadu_ps(frustum->nz + i);
+
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_loadu_ps(frustum->d + i)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(nx, absMask), ex), _mm_mul_ps(_mm_and_ps(ny, absMask), ey)),
+                                   _mm_mul_ps(_mm_and_ps(nz, absMask), ez));
+
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        intersects |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+    }
+
+    if (outside) return CULL_OUTSIDE;
+    return intersects ? CULL_INTERSECTS : CULL_INSIDE;
+#else
+    return TestFrustumAABBScalar(frustum, min, max);
+#endif
+}
+
+// Arvo: every output axis is the sum of the smallest and biggest contribution of each input axis
+void TransformAABB(const glm::mat4 &matrix, const glm::vec3 &min, const glm::vec3 &max, glm::vec3 *outMin, glm::vec3 *outMax) {
+    glm::vec3 resultMin = glm::vec3(matrix[3]);
+    glm::vec3 resultMax = resultMin;
+
+    for (int column = 0; column < 3; column++) {
+        for (int row = 0; row < 3; row++) {
+            float a = matrix[column][row] * min[column];
+            float b = matrix[column][row] * max[column];
+
+            resultMin[row] += a < b ? a : b;
+            resultMax[row] += a < b ? b : a;
+        }
+    }
+
+    *outMin = resultMin;
+    *outMax = resultMax;
+}
+
+static inline float GetSurfaceArea(const glm::vec3 &min, const glm::vec3 &max) {
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static inline bool ContainsAABB(const BVHNode *node, const glm::vec3 &min, const glm::vec3 &max) {
+    return node->min.x <= min.x && node->min.y <= min.y && node->min.z <= min.z &&
+           node->max.x >= max.x && node->max.y >= max.y && node->max.z >= max.z;
+}
+
+BoundingVolumeHierarchy *CreateBVH(float margin) {
+    BoundingVolumeHierarchy *bvh = (BoundingVolumeHierarchy *)calloc(1, sizeof(BoundingVolumeHierarchy));
+
+    bvh->root = BVH_NULL_NODE;
+    bvh->freeList = BVH_NULL_NODE;
+    bvh->margin = margin;
+
+    return bvh;
+}
+
+void DestroyBVH(BoundingVolumeHierarchy *bvh) {
+    free(bvh->nodes);
+    free(bvh->stack);
+    free(bvh);
+}
+
+static int AllocateBVHNode(BoundingVolumeHierarchy *bvh) {
+    if (bvh->freeList == BVH_NULL_NODE) {
+        int oldCapacity = bvh->nodeCapacity;
+
+        bvh->nodeCapacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+        bvh->nodes = (BVHNode *)realloc(bvh->nodes, bvh->nodeCapacity * sizeof(BVHNode));
+
+        for (int i = oldCapacity; i < bvh->nodeCapacity; i++) {
+            bvh->nodes[i].parent = i + 1 < bvh->nodeCapacity ? i + 1 : BVH_NULL_NODE;
+            bvh->nodes[i].height = -1;
+        }
+        bvh->freeList = oldCapacity;
+    }
+
+    int index = bvh->freeList;
+    BVHNode *node = &bvh->nodes[index];
+
+    bvh->freeList = node->parent;
+    node->parent = BVH_NULL_NODE;
+    node->left = BVH_NULL_NODE;
+    node->right = BVH_NULL_NODE;
+    node->height = 0;
+    node->userData = -1;
+    bvh->nodeCount++;
+
+    return index;
+}
+
+static void FreeBVHNode(BoundingVolumeHierarchy *bvh, int index) {
+    bvh->nodes[index].parent = bvh->freeList;
+    bvh->nodes[index].height = -1;
+    bvh->freeList = index;
+    bvh->nodeCount--;
+}
+
+static void RefitBVHNode(BoundingVolumeHierarchy *bvh, int index) {
+    BVHNode *node = &bvh->nodes[index];
+    const BVHNode *left = &bvh->nodes[node->left];
+    const BVHNode *right = &bvh->nodes[node->right];
+
+    node->min = glm::min(left->min, right->min);
+    node->max = glm::max(left->max, right->max);
+    node->height = 1 + (left->height > right->height ? left->height : right->height);
+}
+
+static void ReplaceBVHChild(BoundingVolumeHierarchy *bvh, int parent, int oldChild, int newChild) {
+    if (parent == BVH_NULL_NODE) {
+        bvh->root = newChild;
+    } else if (bvh->nodes[parent].left == oldChild) {
+        bvh->nodes[parent].left = newChild;
+    } else {
+        bvh->nodes[parent].right = newChild;
+    }
+}
+
+// Tree rotation when the children heights differ by more than one, returns the new subtree root
+static int BalanceBVHNode(BoundingVolumeHierarchy *bvh, int a) {
+    BVHNode *nodes = bvh->nodes;
+
+    if (nodes[a].height < 2) return a;
+
+    const int b = nodes[a].left;
+    const int c = nodes[a].right;
+    const int balance = nodes[c].height - nodes[b].height;
+
+    if (balance > 1 || balance < -1) {
+        // The taller child goes up, A takes its shorter grandchild
+        const int up = balance > 1 ? c : b;
+        const int grandLeft = nodes[up].left;
+        const int grandRight = nodes[up].right;
+        const int keep = nodes[grandLeft].height > nodes[grandRight].height ? grandLeft : grandRight;
+        const int moved = keep == grandLeft ? grandRight : grandLeft;
+
+        nodes[up].parent = nodes[a].parent;
+        ReplaceBVHChild(bvh, nodes[a].parent, a, up);
+
+        nodes[up].left = a;
+        nodes[up].right = keep;
+        nodes[a].parent = up;
+
+        if (balance > 1) nodes[a].right = moved;
+        else nodes[a].left = moved;
+        nodes[moved].parent = a;
+
+        RefitBVHNode(bvh, a);
+        RefitBVHNode(bvh, up);
+        return up;
+    }
+
+    return a;
+}
+
+// Rebalances and refits every ancestor of `index`, itself included
+static void RefitBVHAncestors(BoundingVolumeHierarchy *bvh, int index) {
+    while (index != BVH_NULL_NODE) {
+        index = BalanceBVHNode(bvh, index);
+        RefitBVHNode(bvh, index);
+        index = bvh->nodes[index].parent;
+    }
+}
+
+// Surface area heuristic: walks down to the sibling that grows the tree the least
+static void InsertBVHLeaf(BoundingVolumeHierarchy *bvh, int leaf) {
+    if (bvh->root == BVH_NULL_NODE) {
+        bvh->root = leaf;
+        bvh->nodes[leaf].parent = BVH_NULL_NODE;
+        return;
+    }
+
+    const glm::vec3 leafMin = bvh->nodes[leaf].min;
+    const glm::vec3 leafMax = bvh->nodes[leaf].max;
+    int index = bvh->root;
+
+    while (bvh->nodes[index].left != BVH_NULL_NODE) {
+        const BVHNode *node = &bvh->nodes[index];
+        const float area = GetSurfaceArea(node->min, node->max);
+        const float combinedArea = GetSurfaceArea(glm::min(node->min, leafMin), glm::max(node->max, leafMax));
+
+        // Cost of a new parent for this node and the leaf, and the minimum cost of pushing the leaf further down
+        const float cost = 2.0f * combinedArea;
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+        float childCosts[2];
+
+        for (int i = 0; i < 2; i++) {
+            const BVHNode *child = &bvh->nodes[i == 0 ? node->left : node->right];
+            float childArea = GetSurfaceArea(glm::min(child->min, leafMin), glm::max(child->max, leafMax));
+
+            if (child->left != BVH_NULL_NODE) childArea -= GetSurfaceArea(child->min, child->max);
+            childCosts[i] = childArea + inheritanceCost;
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1]) break;
+
+        index = childCosts[0] < childCosts[1] ? node->left : node->right;
+    }
+
+    const int sibling = index;
+    const int oldParent = bvh->nodes[sibling].parent;
+    const int newParent = AllocateBVHNode(bvh);
+    BVHNode *nodes = bvh->nodes; // AllocateBVHNode can move the nodes
+
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    ReplaceBVHChild(bvh, oldParent, sibling, newParent);
+
+    RefitBVHAncestors(bvh, newParent);
+}
+
+static void RemoveBVHLeaf(BoundingVolumeHierarchy *bvh, int leaf) {
+    if (leaf == bvh->root) {
+        bvh->root = BVH_NULL_NODE;
+        return;
+    }
+
+    BVHNode *nodes = bvh->nodes;
+    const int parent = nodes[leaf].parent;
+    const int grandParent = nodes[parent].parent;
+    const int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    // The sibling takes the place of the parent
+    ReplaceBVHChild(bvh, grandParent, parent, sibling);
+    nodes[sibling].parent = grandParent;
+    FreeBVHNode(bvh, parent);
+
+    RefitBVHAncestors(bvh, grandParent);
+}
+
+int CreateBVHProxy(BoundingVolumeHierarchy *bvh, const glm::vec3 &min, const glm::vec3 &max, int userData) {
+    const int proxy = AllocateBVHNode(bvh);
+    BVHNode *node = &bvh->nodes[proxy];
+
+    node->min = min - glm::vec3(bvh->margin);
+    node->max = max + glm::vec3(bvh->margin);
+    node->userData = userData;
+
+    InsertBVHLeaf(bvh, proxy);
+    bvh->proxyCount++;
+
+    return proxy;
+}
+
+void DestroyBVHProxy(BoundingVolumeHierarchy *bvh, int proxy) {
+    RemoveBVHLeaf(bvh, proxy);
+    FreeBVHNode(bvh, proxy);
+    bvh->proxyCount--;
+}
+
+bool MoveBVHProxy(BoundingVolumeHierarchy *bvh, int proxy, const glm::vec3 &min, const glm::vec3 &max) {
+    BVHNode *node = &bvh->nodes[proxy];
+
+    // Still inside the enlarged box, the tree stays as it is
+    if (ContainsAABB(node, min, max)) return false;
+
+    RemoveBVHLeaf(bvh, proxy);
+
+    node = &bvh->nodes[proxy];
+    node->min = min - glm::vec3(bvh->margin);
+    node->max = max + glm::vec3(bvh->margin);
+
+    InsertBVHLeaf(bvh, proxy);
+    return true;
+}
+
+int GetBVHHeight(BoundingVolumeHierarchy *bvh) {
+    return bvh->root == BVH_NULL_NODE ? 0 : bvh->nodes[bvh->root].height;
+}
+
+static inline void PushBVHStack(BoundingVolumeHierarchy *bvh, int *count, int value) {
+    if (*count == bvh->stackCapacity) {
+        bvh->stackCapacity = bvh->stackCapacity == 0 ? 64 : bvh->stackCapacity * 2;
+        bvh->stack = (int *)realloc(bvh->stack, bvh->stackCapacity * sizeof(int));
+    }
+
+    bvh->stack[(*count)++] = value;
+}
+
+// Stack entries below BVH_NULL_NODE are subtrees already known to be inside: -2 - node
+int QueryBVHFrustum(BoundingVolumeHierarchy *bvh, const Frustum *frustum, int *results, CullStats *stats) {
+    int resultCount = 0;
+    int nodesTested = 0;
+    int stackCount = 0;
+
+    if (bvh->root != BVH_NULL_NODE) PushBVHStack(bvh, &stackCount, bvh->root);
+
+    while (stackCount > 0) {
+        int entry = bvh->stack[--stackCount];
+        bool inside = entry < BVH_NULL_NODE;
+        int index = inside ? -2 - entry : entry;
+        const BVHNode *node = &bvh->nodes[index];
+
+        if (!inside) {
+            CullResult result = TestFrustumAABB(frustum, node->min, node->max);
+            nodesTested++;
+
+            if (result == CULL_OUTSIDE) continue;
+            inside = result == CULL_INSIDE;
+        }
+
+        if (node->left == BVH_NULL_NODE) {
+            results[resultCount++] = node->userData;
+            continue;
+        }
+
+        PushBVHStack(bvh, &stackCount, inside ? -2 - node->left : node->left);
+        PushBVHStack(bvh, &stackCount, inside ? -2 - node->right : node->right);
+    }
+
+    if (stats != NULL) {
+        stats->visible = resultCount;
+        stats->culled = bvh->proxyCount - resultCount;
+        stats->nodesTested = nodesTested;
+    }
+
+    return resultCount;
+}
@@ -0,0 +1,71 @@
+#ifndef CGAME_ENGINE_CULLING_H
+#define CGAME_ENGINE_CULLING_H
+
+#include <glm/glm.hpp>
+
+#define BVH_NULL_NODE -1
+#define FRUSTUM_PLANE_LANES 8 // 6 planes padded to two SIMD registers, the padding planes accept everything
+
+// View frustum planes stored per component, a point p is inside a plane when nx * p.x + ny * p.y + nz * p.z + d >= 0
+typedef struct Frustum {
+    float nx[FRUSTUM_PLANE_LANES];
+    float ny[FRUSTUM_PLANE_LANES];
+    float nz[FRUSTUM_PLANE_LANES];
+    float d[FRUSTUM_PLANE_LANES];
+} Frustum;
+
+typedef enum {
+    CULL_OUTSIDE = 0,
+    CULL_INTERSECTS,
+    CULL_INSIDE
+} CullResult;
+
+typedef struct CullStats {
+    int visible;                // Proxies that passed the frustum test
+    int culled;                 // Proxies skipped, most of them without being tested
+    int nodesTested;            // Boxes tested against the frustum
+} CullStats;
+
+// Dynamic AABB tree node, leaves hold a box enlarged by the tree margin so small moves keep the same leaf
+typedef struct BVHNode {
+    glm::vec3 min;
+    glm::vec3 max;
+    int parent;                 // Next free node when the node is free
+    int left;                   // BVH_NULL_NODE for leaves
+    int right;
+    int height;                 // 0 for leaves, -1 for free nodes
+    int userData;
+} BVHNode;
+
+typedef struct BoundingVolumeHierarchy {
+    BVHNode *nodes;
+    int nodeCount;              // Nodes in use
+    int nodeCapacity;
+    int root;
+    int freeList;
+    int proxyCount;
+    float margin;
+
+    int *stack;                 // Traversal stack of the queries
+    int stackCapacity;
+} BoundingVolumeHierarchy;
+
+// Frustum Functions
+Frustum MakeFrustum(const glm::mat4 &viewProjection); // Planes of the clip volume, in the space `viewProjection` transforms from
+CullResult TestFrustumAABB(const Frustum *frustum, const glm::vec3 &min, const glm::vec3 &max); // All planes at once with SSE
+CullResult TestFrustumAABBScalar(const Frustum *frustum, const glm::vec3 &min, const glm::vec3 &max); // Reference scalar path
+void TransformAABB(const glm::mat4 &matrix, const glm::vec3 &min, const glm::vec3 &max, glm::vec3 *outMin, glm::vec3 *outMax);
+
+// BVH Functions
+BoundingVolumeHierarchy *CreateBVH(float margin); // Leaf boxes are enlarged by `margin` on every side
+void DestroyBVH(BoundingVolumeHierarchy *bvh);
+int CreateBVHProxy(BoundingVolumeHierarchy *bvh, const glm::vec3 &min, const glm::vec3 &max, int userData);
+void DestroyBVHProxy(BoundingVolumeHierarchy *bvh, int proxy);
+bool MoveBVHProxy(BoundingVolumeHierarchy *bvh, int proxy, const glm::vec3 &min, const glm::vec3 &max); // True when the leaf got reinserted
+int GetBVHHeight(BoundingVolumeHierarchy *bvh);
+
+// Writes the userData of the proxies in the frustum to `results` (room for proxyCount items), returns how many.
+// Subtrees outside the frustum are skipped and subtrees fully inside are accepted without testing their leaves.
+int QueryBVHFrustum(BoundingVolumeHierarchy *bvh, const Frustum *frustum, int *results, CullStats *stats);
+
+#endif // CGAME_ENGINE_CULLING_H
@@ -0,0 +1,519 @@
+#include "ecs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <glm/ext.hpp>
+
+World *CreateWorld() {
+    World *world = (World *)calloc(1, sizeof(World));
+
+    world->componentSizes[COMPONENT_TRANSFORM] = sizeof(glm::mat4);
+    world->componentSizes[COMPONENT_COLOR] = sizeof(Vector4);
+    world->componentSizes[COMPONENT_MESH] = sizeof(MeshComponent);
+    world->componentSizes[COMPONENT_TRANSFORM_NODE] = sizeof(TransformId);
+    world->componentSizes[COMPONENT_BOUNDS] = sizeof(BoundsComponent);
+    world->componentSizes[COMPONENT_PREVIOUS_TRANSFORM] = sizeof(glm::mat4);
+    world->componentCount = COMPONENT_BUILTIN_COUNT;
+
+    world->transforms = CreateTransformHierarchy();
+    world->bvh = CreateBVH(ECS_BVH_MARGIN);
+
+    return world;
+}
+
+void DestroyWorld(World *world) {
+    for (int a = 0; a < world->archetypeCount; a++) {
+        for (int c = 0; c < world->archetypes[a].chunkCount; c++) {
+            free(world->archetypes[a].chunks[c].data);
+            free(world->archetypes[a].chunks[c].entities);
+        }
+        free(world->archetypes[a].chunks);
+    }
+
+    free(world->archetypes);
+    free(world->records);
+    free(world->freeRecords);
+    DestroyTransformHierarchy(world->transforms);
+    DestroyBVH(world->bvh);
+    free(world->visible);
+    free(world);
+}
+
+int RegisterComponent(World *world, int size) {
+    if (world->componentCount >= MAX_COMPONENT_TYPES) {
+        printf("Too many component types, max: %i\n", MAX_COMPONENT_TYPES);
+        return -1;
+    }
+
+    world->componentSizes[world->componentCount] = size;
+    return world->componentCount++;
+}
+
+static int FindArchetype(World *world, ComponentMask mask) {
+    for (int a = 0; a < world->archetypeCount; a++) {
+        if (world->archetypes[a].mask == mask) return a;
+    }
+
+    if (world->archetypeCount == world->archetypeCapacity) {
+        world->archetypeCapacity = world->archetypeCapacity == 0 ? 16 : world->archetypeCapacity * 2;
+        world->archetypes = (Archetype *)realloc(world->archetypes, world->archetypeCapacity * sizeof(Archetype));
+    }
+
+    Archetype *archetype = &world->archetypes[world->archetypeCount];
+    *archetype = { 0 };
+    archetype->mask = mask;
+
+    // Component arrays are laid one after the other in the chunk, each 16 bytes aligned
+    int offset = 0;
+    for (int type = 0; type < MAX_COMPONENT_TYPES; type++) {
+        archetype->offsets[type] = -1;
+
+        if (mask & COMPONENT_BIT(type)) {
+            archetype->offsets[type] = offset;
+            offset += (world->componentSizes[type] * ECS_CHUNK_CAPACITY + 15) & ~15;
+        }
+    }
+
+    return world->archetypeCount++;
+}
+
+static int GetArchetypeChunkSize(World *world, Archetype *archetype) {
+    int size = 0;
+
+    for (int type = 0; type < world->componentCount; type++) {
+        if (archetype->mask & COMPONENT_BIT(type)) size += (world->componentSizes[type] * ECS_CHUNK_CAPACITY + 15) & ~15;
+    }
+
+    return size;
+}
+
+// Appends a zeroed row for `entityIndex` at the end of the archetype
+static void AddArchetypeRow(World *world, int archetypeIndex, unsigned int entityIndex) {
+    Archetype *archetype = &world->archetypes[archetypeIndex];
+
+    if (archetype->chunkCount == 0 || archetype->chunks[archetype->chunkCount - 1].count == ECS_CHUNK_CAPACITY) {
+        if (archetype->chunkCount == archetype->chunkCapacity) {
+            archetype->chunkCapacity = archetype->chunkCapacity == 0 ? 4 : archetype->chunkCapacity * 2;
+            archetype->chunks = (Chunk *)realloc(archetype->chunks, archetype->chunkCapacity * sizeof(Chunk));
+        }
+
+        Chunk *chunk = &archetype->chunks[archetype->chunkCount++];
+        chunk->count = 0;
+        chunk->data = (unsigned char *)malloc(GetArchetypeChunkSize(world, archetype));
+        chunk->entities = (unsigned int *)malloc(ECS_CHUNK_CAPACITY * sizeof(unsigned int));
+    }
+
+    int chunkIndex = archetype->chunkCount - 1;
+    Chunk *chunk = &archetype->chunks[chunkIndex];
+    int row = chunk->count++;
+
+    for (int type = 0; type < world->componentCount; type++) {
+        if (archetype->offsets[type] < 0) continue;
+
+        int size = world->componentSizes[type];
+        memset(chunk->data + archetype->offsets[type] + row * size, 0, size);
+    }
+
+    chunk->entities[row] = entityIndex;
+
+    EntityRecord *record = &world->records[entityIndex];
+    record->archetype = archetypeIndex;
+    record->chunk = chunkIndex;
+    record->row = row;
+}
+
+// Fills the hole with the last row of the archetype so chunks stay tightly packed
+static void RemoveArchetypeRow(World *world, int archetypeIndex, int chunkIndex, int row) {
+    Archetype *archetype = &world->archetypes[archetypeIndex];
+    Chunk *last = &archetype->chunks[archetype->chunkCount - 1];
+    Chunk *chunk = &archetype->chunks[chunkIndex];
+    int lastRow = last->count - 1;
+
+    if (last != chunk || lastRow != row) {
+        for (int type = 0; type < world->componentCount; type++) {
+            if (archetype->offsets[type] < 0) continue;
+
+            int size = world->componentSizes[type];
+            memcpy(
+                   chunk->data + archetype->offsets[type] + row * size,
+                   last->data + archetype->offsets[type] + lastRow * size,
+                   size
+                   );
+        }
+
+        unsigned int moved = last->entities[lastRow];
+        chunk->entities[row] = moved;
+        world->records[moved].chunk = chunkIndex;
+        world->records[moved].row = row;
+    }
+
+    last->count--;
+
+    // Empty chunks are released, except the first one which is likely to be refilled
+    if (last->count == 0 && archetype->chunkCount > 1) {
+        free(last->data);
+        free(last->entities);
+        archetype->chunkCount--;
+    }
+}
+
+EntityHandle CreateWorldEntity(World *world, ComponentMask mask) {
+    unsigned int index;
+
+    if (world->freeCount > 0) {
+        index = world->freeRecords[--world->freeCount];
+    } else {
+        if (world->recordCount == world->recordCapacity) {
+            world->recordCapacity = world->recordCapacity == 0 ? 1024 : world->recordCapacity * 2;
+            world->records = (EntityRecord *)realloc(world->records, world->recordCapacity * sizeof(EntityRecord));
+            world->freeRecords = (unsigned int *)realloc(world->freeRecords, world->recordCapacity * sizeof(unsigned int));
+        }
+
+        index = world->recordCount++;
+        world->records[index].generation = 0;
+    }
+
+    AddArchetypeRow(world, FindArchetype(world, mask), index);
+    world->entityCount++;
+
+    EntityHandle handle = { index, world->records[index].generation };
+    return handle;
+}
+
+bool IsWorldEntityAlive(World *world, EntityHandle entity) {
+    return entity.index < (unsigned int)world->recordCount &&
+        world->records[entity.index].generation == entity.generation &&
+        world->records[entity.index].archetype >= 0;
+}
+
+void DestroyWorldEntity(World *world, EntityHandle entity) {
+    if (!IsWorldEntityAlive(world, entity)) return;
+
+    TransformId *node = (TransformId *)GetWorldComponent(world, entity, COMPONENT_TRANSFORM_NODE);
+    if (node != NULL) DestroyTransform(world->transforms, *node);
+
+    BoundsComponent *bounds = (BoundsComponent *)GetWorldComponent(world, entity, COMPONENT_BOUNDS);
+    if (bounds != NULL && bounds->proxy != BVH_NULL_NODE) DestroyBVHProxy(world->bvh, bounds->proxy);
+
+    EntityRecord *record = &world->records[entity.index];
+    RemoveArchetypeRow(world, record->archetype, record->chunk, record->row);
+
+    record->archetype = -1;
+    record->generation++;
+    world->freeRecords[world->freeCount++] = entity.index;
+    world->entityCount--;
+}
+
+void *GetWorldComponent(World *world, EntityHandle entity, int type) {
+    if (!IsWorldEntityAlive(world, entity)) return NULL;
+
+    EntityRecord *record = &world->records[entity.index];
+    Archetype *archetype = &world->archetypes[record->archetype];
+
+    if (archetype->offsets[type] < 0) return NULL;
+
+    Chunk *chunk = &archetype->chunks[record->chunk];
+    return chunk->data + archetype->offsets[type] + record->row * world->componentSizes[type];
+}
+
+static void MoveWorldEntity(World *world, EntityHandle entity, ComponentMask mask) {
+    EntityRecord *record = &world->records[entity.index];
+    int from = record->archetype;
+    int fromChunk = record->chunk;
+    int fromRow = record->row;
+
+    if (world->archetypes[from].mask == mask) return;
+
+    int to = FindArchetype(world, mask);
+    AddArchetypeRow(world, to, entity.index);
+
+    // Both archetypes are looked up again, FindArchetype may have moved them
+    Archetype *source = &world->archetypes[from];
+    Archetype *target = &world->archetypes[to];
+    Chunk *sourceChunk = &source->chunks[fromChunk];
+    Chunk *targetChunk = &target->chunks[record->chunk];
+
+    for (int type = 0; type < world->componentCount; type++) {
+        if (source->offsets[type] < 0 || target->offsets[type] < 0) continue;
+
+        int size = world->componentSizes[type];
+        memcpy(
+               targetChunk->data + target->offsets[type] + record->row * size,
+               sourceChunk->data + source->offsets[type] + fromRow * size,
+               size
+               );
+    }
+
+    RemoveArchetypeRow(world, from, fromChunk, fromRow);
+}
+
+void AddWorldComponent(World *world, EntityHandle entity, int type) {
+    if (!IsWorldEntityAlive(world, entity)) return;
+
+    ComponentMask mask = world->archetypes[world->records[entity.index].archetype].mask;
+    if (mask & COMPONENT_BIT(type)) return;
+
+    MoveWorldEntity(world, entity, mask | COMPONENT_BIT(type));
+
+    if (type == COMPONENT_BOUNDS) ((BoundsComponent *)GetWorldComponent(world, entity, type))->proxy = BVH_NULL_NODE;
+}
+
+void RemoveWorldComponent(World *world, EntityHandle entity, int type) {
+    if (!IsWorldEntityAlive(world, entity)) return;
+
+    BoundsComponent *bounds = type == COMPONENT_BOUNDS ? (BoundsComponent *)GetWorldComponent(world, entity, type) : NULL;
+    if (bounds != NULL && bounds->proxy != BVH_NULL_NODE) DestroyBVHProxy(world->bvh, bounds->proxy);
+
+    TransformId *node = type == COMPONENT_TRANSFORM_NODE ? (TransformId *)GetWorldComponent(world, entity, type) : NULL;
+    if (node != NULL) DestroyTransform(world->transforms, *node);
+
+    ComponentMask mask = world->archetypes[world->records[entity.index].archetype].mask;
+    MoveWorldEntity(world, entity, mask & ~COMPONENT_BIT(type));
+}
+
+void ForEachChunk(World *world, ComponentMask required, ChunkSystem system, void *userData) {
+    for (int a = 0; a < world->archetypeCount; a++) {
+        Archetype *archetype = &world->archetypes[a];
+
+        if ((archetype->mask & required) != required) continue;
+
+        for (int c = 0; c < archetype->chunkCount; c++) {
+            if (archetype->chunks[c].count > 0) system(archetype, &archetype->chunks[c], userData);
+        }
+    }
+}
+
+EntityHandle SpawnEntity(World *world, Entity entity, bool instanced) {
+    ComponentMask mask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_TRANSFORM_NODE) |
+        COMPONENT_BIT(COMPONENT_COLOR) | COMPONENT_BIT(COMPONENT_MESH) | COMPONENT_BIT(COMPONENT_PREVIOUS_TRANSFORM);
+    EntityHandle handle = CreateWorldEntity(world, mask);
+
+    glm::vec3 position, scale;
+    glm::quat rotation;
+    DecomposeMatrix(entity.matrix, &position, &rotation, &scale);
+
+    TransformId node = CreateTransform(world->transforms, TRANSFORM_NONE, position, rotation, scale);
+    SetTransformOwner(world->transforms, node, handle.index);
+
+    *(TransformId *)GetWorldComponent(world, handle, COMPONENT_TRANSFORM_NODE) = node;
+    *(glm::mat4 *)GetWorldComponent(world, handle, COMPONENT_TRANSFORM) = entity.matrix;
+    *(glm::mat4 *)GetWorldComponent(world, handle, COMPONENT_PREVIOUS_TRANSFORM) = entity.matrix;
+
+    Vector4 *color = (Vector4 *)GetWorldComponent(world, handle, COMPONENT_COLOR);
+    *color = { 1.0f, 1.0f, 1.0f, 1.0f };
+    if (entity.meshCount > 0 && entity.meshes[0].colors != NULL) {
+        memcpy(color, entity.meshes[0].colors, sizeof(Vector4));
+    }
+
+    MeshComponent *mesh = (MeshComponent *)GetWorldComponent(world, handle, COMPONENT_MESH);
+    mesh->meshes = entity.meshes;
+    mesh->meshCount = entity.meshCount;
+    mesh->instanced = instanced;
+
+    if (entity.meshCount > 0) {
+        glm::vec3 min = entity.meshes[0].boundsMin;
+        glm::vec3 max = entity.meshes[0].boundsMax;
+
+        for (int i = 1; i < entity.meshCount; i++) {
+            min = glm::min(min, entity.meshes[i].boundsMin);
+            max = glm::max(max, entity.meshes[i].boundsMax);
+        }
+
+        SetWorldEntityBounds(world, handle, min, max);
+    }
+
+    return handle;
+}
+
+void SetWorldEntityParent(World *world, EntityHandle entity, EntityHandle parent) {
+    TransformId *node = (TransformId *)GetWorldComponent(world, entity, COMPONENT_TRANSFORM_NODE);
+    TransformId *parentNode = (TransformId *)GetWorldComponent(world, parent, COMPONENT_TRANSFORM_NODE);
+
+    if (node == NULL || parentNode == NULL) return;
+
+    SetTransformParent(world->transforms, *node, *parentNode);
+}
+
+static void GetWorldEntityBounds(const BoundsComponent *bounds, const glm::mat4 &transform, glm::vec3 *min, glm::vec3 *max) {
+    GetDrawBounds(bounds->min, bounds->max, transform, min, max);
+}
+
+void SetWorldEntityBounds(World *world, EntityHandle entity, glm::vec3 min, glm::vec3 max) {
+    AddWorldComponent(world, entity, COMPONENT_BOUNDS);
+
+    BoundsComponent *bounds = (BoundsComponent *)GetWorldComponent(world, entity, COMPONENT_BOUNDS);
+    glm::mat4 *transform = (glm::mat4 *)GetWorldComponent(world, entity, COMPONENT_TRANSFORM);
+
+    if (bounds == NULL) return;
+
+    bounds->min = min;
+    bounds->max = max;
+
+    glm::vec3 worldMin, worldMax;
+    GetWorldEntityBounds(bounds, transform != NULL ? *transform : glm::mat4(1.0f), &worldMin, &worldMax);
+
+    if (bounds->proxy == BVH_NULL_NODE) bounds->proxy = CreateBVHProxy(world->bvh, worldMin, worldMax, entity.index);
+    else MoveBVHProxy(world->bvh, bounds->proxy, worldMin, worldMax);
+}
+
+typedef struct RotateZSystemData {
+    int spinComponent;
+    float deltaTime;
+    TransformHierarchy *transforms;
+    BoundingVolumeHierarchy *bvh;
+} RotateZSystemData;
+
+static void RotateZChunk(Archetype *archetype, Chunk *chunk, void *userData) {
+    RotateZSystemData *data = (RotateZSystemData *)userData;
+    float *spins = (float *)GetChunkComponents(archetype, chunk, data->spinComponent);
+
+    // Entities with a node rotate their local TRS, the world matrix follows on UpdateWorldTransforms
+    if (archetype->offsets[COMPONENT_TRANSFORM_NODE] >= 0) {
+        TransformId *nodes = (TransformId *)GetChunkComponents(archetype, chunk, COMPONENT_TRANSFORM_NODE);
+
+        for (int i = 0; i < chunk->count; i++) RotateTransformZ(data->transforms, nodes[i], spins[i] * data->deltaTime);
+        return;
+    }
+
+    glm::mat4 *transforms = (glm::mat4 *)GetChunkComponents(archetype, chunk, COMPONENT_TRANSFORM);
+
+    for (int i = 0; i < chunk->count; i++) {
+        transforms[i] = glm::rotate(transforms[i], glm::radians(spins[i] * data->deltaTime), glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    // Without a node there is no UpdateWorldTransforms pass to move the BVH leaves
+    if (archetype->offsets[COMPONENT_BOUNDS] < 0) return;
+
+    const BoundsComponent *bounds = (const BoundsComponent *)GetChunkComponents(archetype, chunk, COMPONENT_BOUNDS);
+
+    for (int i = 0; i < chunk->count; i++) {
+        if (bounds[i].proxy == BVH_NULL_NODE) continue;
+
+        glm::vec3 min, max;
+        GetWorldEntityBounds(&bounds[i], transforms[i], &min, &max);
+        MoveBVHProxy(data->bvh, bounds[i].proxy, min, max);
+    }
+}
+
+void RotateZSystem(World *world, int spinComponent, float deltaTime) {
+    RotateZSystemData data = { spinComponent, deltaTime, world->transforms, world->bvh };
+    ForEachChunk(world, COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(spinComponent), RotateZChunk, &data);
+}
+
+void UpdateWorldTransforms(World *world) {
+    TransformHierarchy *transforms = world->transforms;
+
+    UpdateTransformHierarchy(transforms);
+
+    // Only the recomputed matrices are copied, static entities cost nothing
+    for (int i = 0; i < transforms->changedCount; i++) {
+        int slot = transforms->changed[i];
+        int owner = transforms->owners[slot];
+
+        if (owner < 0) continue;
+
+        EntityRecord *record = &world->records[owner];
+        Archetype *archetype = &world->archetypes[record->archetype];
+        Chunk *chunk = &archetype->chunks[record->chunk];
+
+        // The node can outlive the Transform component, it only drives the matrix while both are there
+        if (archetype->offsets[COMPONENT_TRANSFORM] < 0) continue;
+
+        ((glm::mat4 *)GetChunkComponents(archetype, chunk, COMPONENT_TRANSFORM))[record->row] = transforms->worlds[slot];
+
+        if (archetype->offsets[COMPONENT_BOUNDS] < 0) continue;
+
+        // The leaf is enlarged by ECS_BVH_MARGIN, the tree only changes when the entity leaves it
+        const BoundsComponent *bounds = &((BoundsComponent *)GetChunkComponents(archetype, chunk, COMPONENT_BOUNDS))[record->row];
+        if (bounds->proxy == BVH_NULL_NODE) continue;
+
+        glm::vec3 min, max;
+        GetWorldEntityBounds(bounds, transforms->worlds[slot], &min, &max);
+        MoveBVHProxy(world->bvh, bounds->proxy, min, max);
+    }
+}
+
+static void SaveTransformsChunk(Archetype *archetype, Chunk *chunk, void *) {
+    memcpy(GetChunkComponents(archetype, chunk, COMPONENT_PREVIOUS_TRANSFORM), GetChunkComponents(archetype, chunk, COMPONENT_TRANSFORM),
+           chunk->count * sizeof(glm::mat4));
+}
+
+void SaveWorldTransforms(World *world) {
+    ForEachChunk(world, COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_PREVIOUS_TRANSFORM), SaveTransformsChunk, NULL);
+}
+
+// Blends translation, rotation and scale separately, a plain matrix lerp would shrink rotating entities
+static glm::mat4 InterpolateTransform(const glm::mat4 &previous, const glm::mat4 &current, float alpha) {
+    glm::vec3 previousPosition, currentPosition, previousScale, currentScale;
+    glm::quat previousRotation, currentRotation;
+
+    DecomposeMatrix(previous, &previousPosition, &previousRotation, &previousScale);
+    DecomposeMatrix(current, &currentPosition, &currentRotation, &currentScale);
+
+    glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::mix(previousPosition, currentPosition, alpha));
+    matrix *= glm::mat4_cast(glm::slerp(previousRotation, currentRotation, alpha));
+    return glm::scale(matrix, glm::mix(previousScale, currentScale, alpha));
+}
+
+static void SubmitMeshRow(Archetype *archetype, Chunk *chunk, int row, float alpha) {
+    const glm::mat4 *transform = &((glm::mat4 *)GetChunkComponents(archetype, chunk, COMPONENT_TRANSFORM))[row];
+    glm::mat4 interpolated;
+
+    // Entities that did not move during the last step are drawn as they are
+    if (alpha < 1.0f && archetype->offsets[COMPONENT_PREVIOUS_TRANSFORM] >= 0) {
+        const glm::mat4 *previous = &((glm::mat4 *)GetChunkComponents(archetype, chunk, COMPONENT_PREVIOUS_TRANSFORM))[row];
+
+        if (*previous != *transform) {
+            interpolated = InterpolateTransform(*previous, *transform, alpha);
+            transform = &interpolated;
+        }
+    }
+
+    const MeshComponent *mesh = &((MeshComponent *)GetChunkComponents(archetype, chunk, COMPONENT_MESH))[row];
+    const Vector4 *color = archetype->offsets[COMPONENT_COLOR] >= 0 ? &((Vector4 *)GetChunkComponents(archetype, chunk, COMPONENT_COLOR))[row] : NULL;
+
+    for (int m = 0; m < mesh->meshCount; m++) {
+        if (mesh->instanced) DrawMeshInstanced(&mesh->meshes[m], *transform, color);
+        else DrawMesh(&mesh->meshes[m], *transform);
+    }
+}
+
+// Entities in the BVH are submitted by the cull, except the ones that have no proxy yet
+static void SubmitMeshChunk(Archetype *archetype, Chunk *chunk, void *userData) {
+    const BoundsComponent *bounds = archetype->offsets[COMPONENT_BOUNDS] >= 0 ? (BoundsComponent *)GetChunkComponents(archetype, chunk, COMPONENT_BOUNDS) : NULL;
+    const float alpha = *(const float *)userData;
+
+    for (int i = 0; i < chunk->count; i++) {
+        if (bounds == NULL || bounds[i].proxy == BVH_NULL_NODE) SubmitMeshRow(archetype, chunk, i, alpha);
+    }
+}
+
+void SubmitMeshSystem(World *world) {
+    SubmitMeshSystemEx(world, 1.0f);
+}
+
+void SubmitMeshSystemEx(World *world, float alpha) {
+    if (world->visibleCapacity < world->bvh->proxyCount) {
+        world->visibleCapacity = world->bvh->proxyCount;
+        world->visible = (int *)realloc(world->visible, world->visibleCapacity * sizeof(int));
+    }
+
+    Frustum frustum = GetCameraFrustum();
+    int visibleCount = QueryBVHFrustum(world->bvh, &frustum, world->visible, &world->cullStats);
+
+    // Culled entities are never touched
+    for (int i = 0; i < visibleCount; i++) {
+        EntityRecord *record = &world->records[world->visible[i]];
+        Archetype *archetype = &world->archetypes[record->archetype];
+
+        if (archetype->offsets[COMPONENT_MESH] < 0 || archetype->offsets[COMPONENT_TRANSFORM] < 0) continue;
+
+        SubmitMeshRow(archetype, &archetype->chunks[record->chunk], record->row, alpha);
+    }
+
+    ForEachChunk(world, COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_MESH), SubmitMeshChunk, &alpha);
+}
+
+CullStats GetWorldCullStats(World *world) {
+    return world->cullStats;
+}
@@ -0,0 +1,127 @@
+#ifndef CGAME_ENGINE_ECS_H
+#define CGAME_ENGINE_ECS_H
+
+#include <glm/glm.hpp>
+#if !defined(COD3R_GL_IMPLEMENTATION)
+    #include "cod3rGL.h" // for Entity, Mesh and Vector4
+#endif
+#include "transform.h"
+#include "culling.h"
+
+#define MAX_COMPONENT_TYPES 32 // Maximum number of component types, builtin ones included
+#define ECS_CHUNK_CAPACITY 512 // Entities per chunk, every component array of a chunk holds this many items
+#define ECS_BVH_MARGIN 0.1f // World units the BVH leaves are enlarged by, entities moving less keep their leaf
+
+typedef unsigned int ComponentMask;
+#define COMPONENT_BIT(type) (1u << (type))
+
+typedef enum {
+    COMPONENT_TRANSFORM = 0,    // glm::mat4, world matrix (written by UpdateWorldTransforms when the entity has a node)
+    COMPONENT_COLOR,            // Vector4
+    COMPONENT_MESH,             // MeshComponent
+    COMPONENT_TRANSFORM_NODE,   // TransformId in World::transforms
+    COMPONENT_BOUNDS,           // BoundsComponent, the entity is culled through World::bvh
+    COMPONENT_PREVIOUS_TRANSFORM, // glm::mat4, Transform as of the previous fixed step (see SaveWorldTransforms)
+    COMPONENT_BUILTIN_COUNT
+} BuiltinComponent;
+
+typedef struct MeshComponent {
+    Mesh *meshes;               // Meshes are referenced, not owned
+    int meshCount;
+    bool instanced;             // Submitted with DrawMeshInstanced instead of the batch
+} MeshComponent;
+
+typedef struct BoundsComponent {
+    glm::vec3 min;              // Local AABB of every mesh of the entity
+    glm::vec3 max;
+    int proxy;                  // Leaf in World::bvh, BVH_NULL_NODE until SetWorldEntityBounds
+} BoundsComponent;
+
+// Stable reference to an entity, stale handles (destroyed entities) are detected by the generation
+typedef struct EntityHandle {
+    unsigned int index;
+    unsigned int generation;
+} EntityHandle;
+
+// Fixed size block of entities, each component stored as one tightly packed array (structure of arrays)
+typedef struct Chunk {
+    int count;
+    unsigned char *data;        // Component arrays, see Archetype::offsets
+    unsigned int *entities;     // Entity index of every row
+} Chunk;
+
+// Every entity with the same component set lives in the chunks of the same archetype.
+// Only the last chunk can be partially filled.
+typedef struct Archetype {
+    ComponentMask mask;
+    int offsets[MAX_COMPONENT_TYPES];   // Byte offset of each component array in a chunk, -1 when not in the mask
+    int chunkCount;
+    int chunkCapacity;
+    Chunk *chunks;
+} Archetype;
+
+typedef struct EntityRecord {
+    int archetype;              // -1 when the entity is dead
+    int chunk;
+    int row;
+    unsigned int generation;
+} EntityRecord;
+
+typedef struct World {
+    int componentSizes[MAX_COMPONENT_TYPES];
+    int componentCount;
+
+    Archetype *archetypes;
+    int archetypeCount;
+    int archetypeCapacity;
+
+    EntityRecord *records;
+    int recordCount;
+    int recordCapacity;
+
+    unsigned int *freeRecords;  // Stack of dead record indices
+    int freeCount;
+
+    int entityCount;
+
+    TransformHierarchy *transforms; // Local TRS and parents of the entities with a COMPONENT_TRANSFORM_NODE
+
+    BoundingVolumeHierarchy *bvh;   // World bounds of the entities with a COMPONENT_BOUNDS, userData is the entity index
+    int *visible;                   // Entities found by the last cull
+    int visibleCapacity;
+    CullStats cullStats;
+} World;
+
+typedef void (*ChunkSystem)(Archetype *archetype, Chunk *chunk, void *userData);
+
+// World Functions
+World *CreateWorld(); // Creates a world with the builtin components registered
+void DestroyWorld(World *world);
+int RegisterComponent(World *world, int size); // Returns the new component type, -1 when full
+
+EntityHandle CreateWorldEntity(World *world, ComponentMask mask); // Components are zero initialised
+void DestroyWorldEntity(World *world, EntityHandle entity);
+bool IsWorldEntityAlive(World *world, EntityHandle entity);
+void *GetWorldComponent(World *world, EntityHandle entity, int type); // NULL when missing or entity is dead
+void AddWorldComponent(World *world, EntityHandle entity, int type); // Moves the entity to the matching archetype
+void RemoveWorldComponent(World *world, EntityHandle entity, int type); // Removing the TransformNode destroys the node, children go to its parent
+
+// Calls `system` for every chunk of every archetype that has all the `required` components
+void ForEachChunk(World *world, ComponentMask required, ChunkSystem system, void *userData);
+
+static inline void *GetChunkComponents(Archetype *archetype, Chunk *chunk, int type) {
+    return chunk->data + archetype->offsets[type];
+}
+
+// Entity conversion and builtin systems
+EntityHandle SpawnEntity(World *world, Entity entity, bool instanced); // Transform, TransformNode, Color (from the first mesh), Mesh and Bounds components
+void SetWorldEntityParent(World *world, EntityHandle entity, EntityHandle parent); // Both need a TransformNode
+void SetWorldEntityBounds(World *world, EntityHandle entity, glm::vec3 min, glm::vec3 max); // Local bounds, adds the Bounds component when missing
+void RotateZSystem(World *world, int spinComponent, float deltaTime); // Rotates every transform by its spin component (float, degrees per second)
+void UpdateWorldTransforms(World *world); // Recomputes changed world matrices and copies them to the Transform components, moves their bounds
+void SaveWorldTransforms(World *world); // Copies Transform to PreviousTransform, call before every fixed step
+void SubmitMeshSystem(World *world); // Draws every entity with a Transform and a Mesh, the ones with Bounds only when in the camera frustum
+void SubmitMeshSystemEx(World *world, float alpha); // Same, entities with a PreviousTransform are drawn `alpha` of the way from it to Transform
+CullStats GetWorldCullStats(World *world); // Bounded entities visible and culled by the last SubmitMeshSystem
+
+#endif // CGAME_ENGINE_ECS_H
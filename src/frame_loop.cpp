@@ -0,0 +1,77 @@
+#include "frame_loop.h"
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "profiler.h"
+
+FrameLoop *CreateFrameLoop(double stepSeconds, int maxSteps) {
+    FrameLoop *loop = (FrameLoop *)calloc(1, sizeof(FrameLoop));
+
+    loop->stepSeconds = stepSeconds > 0.0 ? stepSeconds : 1.0 / FRAME_LOOP_STEP_HZ;
+    loop->maxSteps = maxSteps > 0 ? maxSteps : FRAME_LOOP_MAX_STEPS;
+
+    return loop;
+}
+
+void DestroyFrameLoop(FrameLoop *loop) {
+    free(loop);
+}
+
+int BeginLoopFrame(FrameLoop *loop) {
+    const uint64_t now = ProfileNowNs();
+
+    // The first frame simulates one step, there is no previous frame to measure
+    loop->frameSeconds = loop->lastFrameNs != 0 ? (now - loop->lastFrameNs) / 1e9 : loop->stepSeconds;
+    loop->lastFrameNs = now;
+
+    if (loop->frames > 0) {
+        loop->frameSamples[loop->sampleCount % FRAME_TIME_SAMPLE_COUNT] = (float)(loop->frameSeconds * 1000.0);
+        loop->sampleCount++;
+    }
+    loop->frames++;
+
+    loop->accumulator += loop->frameSeconds;
+
+    int steps = (int)(loop->accumulator / loop->stepSeconds);
+
+    // Spiral of death: a frame slower than its steps would need even more steps next frame, drop the excess instead
+    if (steps > loop->maxSteps) {
+        loop->droppedSeconds += (steps - loop->maxSteps) * loop->stepSeconds;
+        steps = loop->maxSteps;
+    }
+
+    loop->accumulator -= steps * loop->stepSeconds;
+    if (loop->accumulator >= loop->stepSeconds) loop->accumulator = fmod(loop->accumulator, loop->stepSeconds);
+
+    loop->steps += steps;
+
+    return steps;
+}
+
+float GetLoopAlpha(const FrameLoop *loop) {
+    return (float)std::min(loop->accumulator / loop->stepSeconds, 1.0);
+}
+
+FrameTimeStats GetFrameTimeStats(const FrameLoop *loop) {
+    FrameTimeStats stats = { 0 };
+    float samples[FRAME_TIME_SAMPLE_COUNT];
+
+    stats.frames = std::min(loop->sampleCount, FRAME_TIME_SAMPLE_COUNT);
+    stats.stepsPerFrame = loop->frames > 0 ? (double)loop->steps / loop->frames : 0.0;
+    stats.droppedMs = loop->droppedSeconds * 1000.0;
+
+    if (stats.frames == 0) return stats;
+
+    std::copy(loop->frameSamples, loop->frameSamples + stats.frames, samples);
+    std::sort(samples, samples + stats.frames);
+
+    double sum = 0.0;
+    for (int i = 0; i < stats.frames; i++) sum += samples[i];
+
+    stats.averageMs = sum / stats.frames;
+    stats.p50Ms = samples[stats.frames / 2];
+    stats.p99Ms = samples[(stats.frames * 99) / 100];
+    stats.maxMs = samples[stats.frames - 1];
+
+    return stats;
+}
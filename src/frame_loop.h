@@ -0,0 +1,49 @@
+#ifndef CGAME_ENGINE_FRAME_LOOP_H
+#define CGAME_ENGINE_FRAME_LOOP_H
+
+#include <stdint.h>
+
+#define FRAME_LOOP_STEP_HZ 60 // Default simulation rate
+#define FRAME_LOOP_MAX_STEPS 5 // Default cap of fixed steps per frame, time past it is dropped
+#define FRAME_TIME_SAMPLE_COUNT 512 // Frames kept for the frame time percentiles
+
+// Fixed timestep simulation with variable rate rendering:
+//
+//   int steps = BeginLoopFrame(loop);
+//   for (int i = 0; i < steps; i++) { SaveWorldTransforms(world); ...simulate loop->stepSeconds... }
+//   SubmitMeshSystemEx(world, GetLoopAlpha(loop));
+//
+// The simulation runs at the same speed whatever the frame rate, frames render between the last two steps.
+typedef struct FrameLoop {
+    double stepSeconds;         // Simulated time per step
+    int maxSteps;               // Steps a slow frame can run to catch up, beyond that the simulation slows down
+    double accumulator;         // Real time not simulated yet, below stepSeconds after BeginLoopFrame
+    double frameSeconds;        // Real time of the last frame
+    uint64_t lastFrameNs;       // 0 before the first frame
+
+    unsigned long long frames;
+    unsigned long long steps;
+    double droppedSeconds;      // Time dropped by the maxSteps cap
+
+    float frameSamples[FRAME_TIME_SAMPLE_COUNT]; // Milliseconds
+    int sampleCount;
+} FrameLoop;
+
+typedef struct FrameTimeStats {
+    int frames;                 // Frames measured (last FRAME_TIME_SAMPLE_COUNT at most)
+    double averageMs;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+    double stepsPerFrame;       // Average fixed steps per frame since the loop was created
+    double droppedMs;           // Time the spiral of death cap dropped since the loop was created
+} FrameTimeStats;
+
+FrameLoop *CreateFrameLoop(double stepSeconds, int maxSteps); // stepSeconds <= 0 uses FRAME_LOOP_STEP_HZ, maxSteps <= 0 FRAME_LOOP_MAX_STEPS
+void DestroyFrameLoop(FrameLoop *loop);
+
+int BeginLoopFrame(FrameLoop *loop); // Measures the frame and returns the fixed steps to run (0 to maxSteps)
+float GetLoopAlpha(const FrameLoop *loop); // Position of the frame between the previous (0) and the last (1) step
+FrameTimeStats GetFrameTimeStats(const FrameLoop *loop);
+
+#endif // CGAME_ENGINE_FRAME_LOOP_H
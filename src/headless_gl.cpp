@@ -0,0 +1,78 @@
+#include "headless_gl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <EGL/eglext.h>
+#include "external/glad.h"
+
+static void *LoadHeadlessGLProc(const char *name) {
+    return (void *)eglGetProcAddress(name);
+}
+
+HeadlessContext *CreateHeadlessContext(int size) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay display = getPlatformDisplay != NULL ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+    EGLint major, minor;
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        fprintf(stderr, "EGL surfaceless platform not available\n");
+        return NULL;
+    }
+
+    const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+
+    eglBindAPI(EGL_OPENGL_API);
+    eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+
+    EGLContext context = eglCreateContext(display, configCount > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttributes);
+
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) ||
+        !gladLoadGLLoader((GLADloadproc)LoadHeadlessGLProc)) {
+        fprintf(stderr, "EGL GL 4.1 core context could not be created (0x%x)\n", eglGetError());
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+        return NULL;
+    }
+
+    HeadlessContext *headless = (HeadlessContext *)malloc(sizeof(HeadlessContext));
+    headless->display = display;
+    headless->context = context;
+    headless->size = size;
+
+    glGenRenderbuffers(2, headless->renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless->renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless->renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+
+    glGenFramebuffers(1, &headless->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, headless->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless->renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless->renderbuffers[1]);
+    glViewport(0, 0, size, size);
+    glEnable(GL_DEPTH_TEST);
+
+    fprintf(stderr, "GL context: %s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    return headless;
+}
+
+void DestroyHeadlessContext(HeadlessContext *headless) {
+    if (headless == NULL) return;
+
+    glDeleteFramebuffers(1, &headless->framebuffer);
+    glDeleteRenderbuffers(2, headless->renderbuffers);
+
+    eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(headless->display, headless->context);
+    eglTerminate(headless->display);
+
+    free(headless);
+}
@@ -0,0 +1,20 @@
+#ifndef CGAME_ENGINE_HEADLESS_GL_H
+#define CGAME_ENGINE_HEADLESS_GL_H
+
+#include <EGL/egl.h>
+
+// GL 4.1 core context without a window, for the bench and the offline tools
+typedef struct HeadlessContext {
+    EGLDisplay display;
+    EGLContext context;
+    unsigned int framebuffer;       // Bound, there is no default framebuffer
+    unsigned int renderbuffers[2];  // Color and depth
+    int size;                       // Pixels per side of the render target
+} HeadlessContext;
+
+// Current on the calling thread with glad loaded, on EGL's surfaceless platform (Mesa llvmpipe works without a GPU
+// or a display). NULL when EGL is not usable.
+HeadlessContext *CreateHeadlessContext(int size);
+void DestroyHeadlessContext(HeadlessContext *headless);
+
+#endif // CGAME_ENGINE_HEADLESS_GL_H
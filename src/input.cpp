@@ -0,0 +1,196 @@
+#include "input.h"
+#include <stdio.h>
+InputSystem *CreateInputSystem() {
+    InputSystem *input = new InputSystem(); // Value initialised, the queue, bindings and states start at zero
+
+    input->head.store(0, std::memory_order_relaxed);
+    input->tail.store(0, std::memory_order_relaxed);
+    input->dropped.store(0, std::memory_order_relaxed);
+
+    return input;
+}
+
+void DestroyInputSystem(InputSystem *input) {
+    const unsigned int dropped = input->dropped.load(std::memory_order_relaxed);
+    if (dropped > 0) printf("Input queue full, %u event(s) dropped\n", dropped);
+
+    delete input;
+}
+
+bool PushInputEvent(InputSystem *input, const InputEvent *event) {
+    const unsigned int tail = input->tail.load(std::memory_order_relaxed);
+
+    if (tail - input->head.load(std::memory_order_acquire) == INPUT_QUEUE_EVENTS) {
+        input->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    input->events[tail & (INPUT_QUEUE_EVENTS - 1)] = *event;
+    input->tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+}
+
+// Press or release of a key or button: edges go to every action bound to it
+static void ApplyInputButton(InputSystem *input, bool *held, InputSource source, const InputEvent *event) {
+    if (event->action == INPUT_REPEAT) return;
+
+    const bool down = event->action == INPUT_PRESS;
+    if (down == *held) return;  // Release of a key pressed before the window had focus
+    *held = down;
+
+    for (int i = 0; i < input->bindingCount; i++) {
+        const InputBinding *binding = &input->bindings[i];
+        if (binding->source != source || binding->code != event->code) continue;
+
+        InputAction *action = &input->actions[binding->action];
+        if (down) action->pressed++;
+        else action->released++;
+        action->lastEventNs = event->timeNs;
+    }
+}
+
+static void ApplyInputMovement(InputSystem *input, InputSource source, double movement, uint64_t timeNs) {
+    if (movement == 0.0) return;
+
+    for (int i = 0; i < input->bindingCount; i++) {
+        const InputBinding *binding = &input->bindings[i];
+        if (binding->source != source) continue;
+
+        InputAction *action = &input->actions[binding->action];
+        action->delta += (float)movement * binding->scale;
+        action->lastEventNs = timeNs;
+    }
+}
+
+static void ApplyInputEvent(InputSystem *input, const InputEvent *event) {
+    switch (event->type) {
+        case INPUT_EVENT_KEY:
+            if (event->code < 0 || event->code >= INPUT_MAX_KEYS) return;
+            ApplyInputButton(input, &input->keys[event->code], INPUT_SOURCE_KEY, event);
+            break;
+        case INPUT_EVENT_MOUSE_BUTTON:
+            if (event->code < 0 || event->code >= INPUT_MAX_BUTTONS) return;
+            ApplyInputButton(input, &input->buttons[event->code], INPUT_SOURCE_MOUSE_BUTTON, event);
+            break;
+        case INPUT_EVENT_CURSOR:
+            if (input->hasCursor) {
+                ApplyInputMovement(input, INPUT_SOURCE_CURSOR_X, event->x - input->cursorX, event->timeNs);
+                ApplyInputMovement(input, INPUT_SOURCE_CURSOR_Y, event->y - input->cursorY, event->timeNs);
+            }
+
+            input->cursorX = event->x;
+            input->cursorY = event->y;
+            input->hasCursor = true;
+            break;
+        case INPUT_EVENT_SCROLL:
+            ApplyInputMovement(input, INPUT_SOURCE_SCROLL_X, event->x, event->timeNs);
+            ApplyInputMovement(input, INPUT_SOURCE_SCROLL_Y, event->y, event->timeNs);
+            break;
+    }
+}
+
+// Held state and values come from the keys and buttons down once the events are applied
+static void UpdateInputHeld(InputSystem *input) {
+    for (int i = 0; i < INPUT_MAX_ACTIONS; i++) {
+        input->actions[i].down = false;
+        input->actions[i].value = 0.0f;
+    }
+
+    for (int i = 0; i < input->bindingCount; i++) {
+        const InputBinding *binding = &input->bindings[i];
+        bool held = false;
+
+        if (binding->source == INPUT_SOURCE_KEY) held = input->keys[binding->code];
+        else if (binding->source == INPUT_SOURCE_MOUSE_BUTTON) held = input->buttons[binding->code];
+
+        if (!held) continue;
+
+        InputAction *action = &input->actions[binding->action];
+        action->down = true;
+        action->value += binding->scale;
+    }
+}
+
+int ConsumeInputEvents(InputSystem *input, uint64_t untilNs) {
+    for (int i = 0; i < INPUT_MAX_ACTIONS; i++) {
+        input->actions[i].pressed = 0;
+        input->actions[i].released = 0;
+        input->actions[i].delta = 0.0f;
+    }
+
+    unsigned int head = input->head.load(std::memory_order_relaxed);
+    const unsigned int tail = input->tail.load(std::memory_order_acquire);
+    int consumed = 0;
+
+    while (head != tail) {
+        const InputEvent *event = &input->events[head & (INPUT_QUEUE_EVENTS - 1)];
+        if (event->timeNs > untilNs) break;
+
+        ApplyInputEvent(input, event);
+        head++;
+        consumed++;
+    }
+
+    input->head.store(head, std::memory_order_release);
+    UpdateInputHeld(input);
+
+    return consumed;
+}
+
+int BindInput(InputSystem *input, int action, InputSource source, int code, float scale) {
+    if (action < 0 || action >= INPUT_MAX_ACTIONS) {
+        printf("Input action %i out of range, max: %i\n", action, INPUT_MAX_ACTIONS);
+        return -1;
+    }
+
+    if ((source == INPUT_SOURCE_KEY && (code < 0 || code >= INPUT_MAX_KEYS)) ||
+        (source == INPUT_SOURCE_MOUSE_BUTTON && (code < 0 || code >= INPUT_MAX_BUTTONS))) {
+        printf("Input code %i cannot be bound\n", code);
+        return -1;
+    }
+
+    if (input->bindingCount == INPUT_MAX_BINDINGS) {
+        printf("Too many input bindings, max: %i\n", INPUT_MAX_BINDINGS);
+        return -1;
+    }
+
+    InputBinding *binding = &input->bindings[input->bindingCount];
+    binding->action = action;
+    binding->source = source;
+    binding->code = code;
+    binding->scale = scale;
+
+    return input->bindingCount++;
+}
+
+void UnbindInputAction(InputSystem *input, int action) {
+    int count = 0;
+
+    for (int i = 0; i < input->bindingCount; i++) {
+        if (input->bindings[i].action != action) input->bindings[count++] = input->bindings[i];
+    }
+
+    input->bindingCount = count;
+}
+
+void RebindInput(InputSystem *input, int action, InputSource source, int code, float scale) {
+    UnbindInputAction(input, action);
+    BindInput(input, action, source, code, scale);
+}
+
+const InputAction *GetInputAction(InputSystem *input, int action) {
+    return &input->actions[action];
+}
+
+bool IsInputActionDown(InputSystem *input, int action) {
+    return input->actions[action].down;
+}
+
+bool WasInputActionPressed(InputSystem *input, int action) {
+    return input->actions[action].pressed > 0;
+}
+
+float GetInputAxis(InputSystem *input, int action) {
+    return input->actions[action].value + input->actions[action].delta;
+}
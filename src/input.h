@@ -0,0 +1,108 @@
+#ifndef CGAME_ENGINE_INPUT_H
+#define CGAME_ENGINE_INPUT_H
+
+#include <stdint.h>
+#include <atomic>
+#include "profiler.h" // ProfileNowNs, the clock of the event timestamps
+
+#define INPUT_QUEUE_EVENTS 1024 // Power of two, events pushed while the queue is full are dropped
+#define INPUT_MAX_KEYS 512 // Key codes below it can be bound, GLFW_KEY_LAST is 348
+#define INPUT_MAX_BUTTONS 8 // GLFW_MOUSE_BUTTON_LAST + 1
+#define INPUT_MAX_ACTIONS 32
+#define INPUT_MAX_BINDINGS 64
+
+// Same values as GLFW_RELEASE, GLFW_PRESS and GLFW_REPEAT, callbacks pass theirs through
+#define INPUT_RELEASE 0
+#define INPUT_PRESS 1
+#define INPUT_REPEAT 2
+
+// Window callbacks push timestamped events, the simulation consumes them as actions:
+//
+//   BindInput(input, ACTION_JUMP, INPUT_SOURCE_KEY, GLFW_KEY_SPACE, 1.0f);
+//   glfwPollEvents(); // callbacks call PushInputEvent
+//   ConsumeInputEvents(input, ProfileNowNs());
+//   if (WasInputActionPressed(input, ACTION_JUMP)) ...
+//
+// A key pressed and released between two consumes still counts as pressed once.
+typedef enum {
+    INPUT_EVENT_KEY = 0,
+    INPUT_EVENT_MOUSE_BUTTON,
+    INPUT_EVENT_CURSOR,         // Absolute position in x, y
+    INPUT_EVENT_SCROLL          // Offsets in x, y
+} InputEventType;
+
+typedef struct InputEvent {
+    uint64_t timeNs;            // ProfileNowNs when the callback ran
+    double x;
+    double y;
+    int type;                   // InputEventType
+    int code;                   // Key or mouse button
+    int action;                 // INPUT_PRESS, INPUT_RELEASE or INPUT_REPEAT
+    int mods;
+} InputEvent;
+
+typedef enum {
+    INPUT_SOURCE_KEY = 0,       // Digital, code is the key
+    INPUT_SOURCE_MOUSE_BUTTON,  // Digital, code is the button
+    INPUT_SOURCE_CURSOR_X,      // Analog, cursor movement since the last consume
+    INPUT_SOURCE_CURSOR_Y,
+    INPUT_SOURCE_SCROLL_X,
+    INPUT_SOURCE_SCROLL_Y
+} InputSource;
+
+typedef struct InputBinding {
+    int action;
+    int source;                 // InputSource
+    int code;                   // Key or button of digital sources
+    float scale;                // Added to the action value while held, multiplies the movement of analog sources
+} InputBinding;
+
+// State of one action after a consume
+typedef struct InputAction {
+    bool down;                  // A digital binding is held
+    int pressed;                // Presses since the previous consume, repeats are not counted
+    int released;
+    float value;                // Sum of the scales of the held bindings: -1, 0 or 1 for a pair of opposite keys
+    float delta;                // Analog movement since the previous consume, scaled
+    uint64_t lastEventNs;       // Timestamp of the last event that changed the action
+} InputAction;
+
+// Lock-free queue with one producer thread (the one polling the window) and one consumer thread (the simulation)
+typedef struct InputSystem {
+    InputEvent events[INPUT_QUEUE_EVENTS];
+    std::atomic<unsigned int> head;     // Next event to consume, written by the consumer
+    std::atomic<unsigned int> tail;     // Next free slot, written by the producer
+    std::atomic<unsigned int> dropped;  // Events lost to a full queue
+
+    // Consumer thread only
+    InputBinding bindings[INPUT_MAX_BINDINGS];
+    int bindingCount;
+    InputAction actions[INPUT_MAX_ACTIONS];
+    bool keys[INPUT_MAX_KEYS];
+    bool buttons[INPUT_MAX_BUTTONS];
+    double cursorX;
+    double cursorY;
+    bool hasCursor;             // The first cursor event only sets the position, it has no movement
+} InputSystem;
+
+InputSystem *CreateInputSystem();
+void DestroyInputSystem(InputSystem *input);
+
+// Producer thread, safe to call from window callbacks. Returns false when the queue is full.
+bool PushInputEvent(InputSystem *input, const InputEvent *event);
+
+// Consumer thread. Applies the events stamped up to untilNs to the actions, later ones wait for the next call.
+// Pressed, released and delta restart from zero on every call. Returns the number of events consumed.
+int ConsumeInputEvents(InputSystem *input, uint64_t untilNs);
+
+// Mapping table, consumer thread. Several bindings can drive the same action.
+int BindInput(InputSystem *input, int action, InputSource source, int code, float scale); // Binding index, -1 when full
+void UnbindInputAction(InputSystem *input, int action); // Removes every binding of the action
+void RebindInput(InputSystem *input, int action, InputSource source, int code, float scale); // Replaces them with one
+
+const InputAction *GetInputAction(InputSystem *input, int action);
+bool IsInputActionDown(InputSystem *input, int action);
+bool WasInputActionPressed(InputSystem *input, int action); // Since the previous consume
+float GetInputAxis(InputSystem *input, int action); // value + delta
+
+#endif // CGAME_ENGINE_INPUT_H
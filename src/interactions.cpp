@@ -1,48 +1,94 @@
 #include "interactions.h"
 
-bool firstMouse = true;
-double lastMouseX;
-double lastMouseY;
+static void PushWindowInput(GLFWwindow *window, InputEvent *event) {
+    event->timeNs = ProfileNowNs();
+    PushInputEvent((InputSystem *)glfwGetWindowUserPointer(window), event);
+}
+
+static void KeyCallback(GLFWwindow *window, int key, int, int action, int mods) {
+    InputEvent event = {};
+    event.type = INPUT_EVENT_KEY;
+    event.code = key;
+    event.action = action;
+    event.mods = mods;
+    PushWindowInput(window, &event);
+}
+
+static void MouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
+    InputEvent event = {};
+    event.type = INPUT_EVENT_MOUSE_BUTTON;
+    event.code = button;
+    event.action = action;
+    event.mods = mods;
+    PushWindowInput(window, &event);
+}
+
+static void CursorPosCallback(GLFWwindow *window, double x, double y) {
+    InputEvent event = {};
+    event.type = INPUT_EVENT_CURSOR;
+    event.x = x;
+    event.y = y;
+    PushWindowInput(window, &event);
+}
+
+static void ScrollCallback(GLFWwindow *window, double x, double y) {
+    InputEvent event = {};
+    event.type = INPUT_EVENT_SCROLL;
+    event.x = x;
+    event.y = y;
+    PushWindowInput(window, &event);
+}
 
-void UserInputs(GLFWwindow *window, float deltaTime, Camera *camera) {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+void AttachInputCallbacks(GLFWwindow *window, InputSystem *input) {
+    glfwSetWindowUserPointer(window, input);
+    glfwSetKeyCallback(window, KeyCallback);
+    glfwSetMouseButtonCallback(window, MouseButtonCallback);
+    glfwSetCursorPosCallback(window, CursorPosCallback);
+    glfwSetScrollCallback(window, ScrollCallback);
+}
+
+void DetachInputCallbacks(GLFWwindow *window) {
+    glfwSetKeyCallback(window, NULL);
+    glfwSetMouseButtonCallback(window, NULL);
+    glfwSetCursorPosCallback(window, NULL);
+    glfwSetScrollCallback(window, NULL);
+    glfwSetWindowUserPointer(window, NULL);
+}
+
+void BindDefaultInputs(InputSystem *input) {
+    BindInput(input, ACTION_QUIT, INPUT_SOURCE_KEY, GLFW_KEY_ESCAPE, 1.0f);
+    BindInput(input, ACTION_MOVE_FORWARD, INPUT_SOURCE_KEY, GLFW_KEY_W, 1.0f);
+    BindInput(input, ACTION_MOVE_FORWARD, INPUT_SOURCE_KEY, GLFW_KEY_S, -1.0f);
+    BindInput(input, ACTION_MOVE_RIGHT, INPUT_SOURCE_KEY, GLFW_KEY_D, 1.0f);
+    BindInput(input, ACTION_MOVE_RIGHT, INPUT_SOURCE_KEY, GLFW_KEY_A, -1.0f);
+    BindInput(input, ACTION_LOOK, INPUT_SOURCE_MOUSE_BUTTON, GLFW_MOUSE_BUTTON_RIGHT, 1.0f);
+    BindInput(input, ACTION_LOOK_X, INPUT_SOURCE_CURSOR_X, 0, 1.0f);
+    BindInput(input, ACTION_LOOK_Y, INPUT_SOURCE_CURSOR_Y, 0, -1.0f); // Screen y goes down, pitch goes up
+    BindInput(input, ACTION_TOGGLE_PROFILER, INPUT_SOURCE_KEY, GLFW_KEY_F9, 1.0f);
+    BindInput(input, ACTION_CAPTURE_FRAME, INPUT_SOURCE_KEY, GLFW_KEY_F10, 1.0f);
+}
+
+void UserInputs(GLFWwindow *window, InputSystem *input, float deltaTime, Camera *camera) {
+    if (WasInputActionPressed(input, ACTION_QUIT)) {
         // @TODO: change this...
         glfwSetWindowShouldClose(window, true);
     }
 
-    float cameraSpeed = 2.5f * deltaTime;
+    float cameraSpeed = 7.5f * deltaTime; // World units per second
     // Camera Actions
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        camera->position += cameraSpeed * camera->front;
-    }
+    const float forward = GetInputAxis(input, ACTION_MOVE_FORWARD);
+    const float right = GetInputAxis(input, ACTION_MOVE_RIGHT);
 
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        camera->position -= cameraSpeed * camera->front;
+    if (forward != 0.0f) {
+        camera->position += forward * cameraSpeed * camera->front;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        camera->position -= glm::normalize(glm::cross(camera->front, camera->up)) * cameraSpeed;
-    }
-    
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        camera->position += glm::normalize(glm::cross(camera->front, camera->up)) * cameraSpeed;
+    if (right != 0.0f) {
+        camera->position += glm::normalize(glm::cross(camera->front, camera->up)) * (right * cameraSpeed);
     }
 
-    double mouseX, mouseY;
-    glfwGetCursorPos(window, &mouseX, &mouseY);
-    int mouseLeftBtn = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT);
-    if (mouseLeftBtn == GLFW_PRESS) {
-        if (firstMouse) {
-            lastMouseX = mouseX;
-            lastMouseY = mouseY;
-            firstMouse = false;
-        }
-
-        float xoffset = mouseX - lastMouseX;
-        float yoffset = lastMouseY - mouseY;
-        MouseMovementCamera(xoffset, yoffset, false);
+    // Movement made while the button is up is dropped, the camera does not jump when it goes down
+    if (IsInputActionDown(input, ACTION_LOOK)) {
+        MouseMovementCamera(GetInputAxis(input, ACTION_LOOK_X), GetInputAxis(input, ACTION_LOOK_Y), false);
     }
-
-    lastMouseX = mouseX;
-    lastMouseY = mouseY;
 }
@@ -9,7 +9,26 @@
 #if !defined(COD3R_GL_IMPLEMENTATION)
     #include "cod3rGL.h" // for Camera
 #endif
+#include "input.h"
 
-void UserInputs(GLFWwindow *window, float deltaTime, Camera *camera);
+// Actions of the game, bound to keys and the mouse by BindDefaultInputs
+typedef enum {
+    ACTION_QUIT = 0,
+    ACTION_MOVE_FORWARD,        // Axis, W / S
+    ACTION_MOVE_RIGHT,          // Axis, D / A
+    ACTION_LOOK,                // Right mouse button, the camera only turns while it is held
+    ACTION_LOOK_X,              // Cursor movement
+    ACTION_LOOK_Y,
+    ACTION_TOGGLE_PROFILER,     // F9
+    ACTION_CAPTURE_FRAME        // F10
+} GameAction;
+
+// Key, button and cursor callbacks push to input, events are collected by whatever thread calls glfwPollEvents
+void AttachInputCallbacks(GLFWwindow *window, InputSystem *input);
+void DetachInputCallbacks(GLFWwindow *window);
+void BindDefaultInputs(InputSystem *input);
+
+// Once per frame after ConsumeInputEvents
+void UserInputs(GLFWwindow *window, InputSystem *input, float deltaTime, Camera *camera);
 
 #endif // CGAME_ENGINE_INTERACTIONS_H
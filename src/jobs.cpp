@@ -0,0 +1,208 @@
+#include "jobs.h"
+#include <stdio.h>
+#include "profiler.h"
+
+#define JOB_SPIN_ROUNDS 64 // Empty polls before an idle worker goes to sleep
+
+static thread_local int workerIndex = 0;
+
+static bool PushJob(JobQueue *queue, const Job *job) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+
+    if (queue->bottom - queue->top == JOB_QUEUE_CAPACITY) return false;
+
+    queue->jobs[queue->bottom & (JOB_QUEUE_CAPACITY - 1)] = *job;
+    queue->bottom++;
+    return true;
+}
+
+static bool PopJob(JobQueue *queue, Job *job) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+
+    if (queue->bottom == queue->top) return false;
+
+    queue->bottom--;
+    *job = queue->jobs[queue->bottom & (JOB_QUEUE_CAPACITY - 1)];
+    return true;
+}
+
+static bool StealJob(JobQueue *queue, Job *job) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+
+    if (queue->bottom == queue->top) return false;
+
+    *job = queue->jobs[queue->top & (JOB_QUEUE_CAPACITY - 1)];
+    queue->top++;
+    return true;
+}
+
+static void ExecuteJob(JobSystem *jobs, const Job *job) {
+    PROFILE_ZONE("Job");
+    job->function(job->data, job->begin, job->end);
+    jobs->executedJobs.fetch_add(1, std::memory_order_relaxed);
+
+    if (job->counter != NULL) job->counter->fetch_sub(1, std::memory_order_release);
+}
+
+// Own queue first, then the other workers starting with the next one
+static bool FindJob(JobSystem *jobs, int worker, Job *job) {
+    if (PopJob(&jobs->queues[worker], job)) {
+        jobs->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    for (int i = 1; i < jobs->workerCount; i++) {
+        int victim = (worker + i) % jobs->workerCount;
+
+        if (StealJob(&jobs->queues[victim], job)) {
+            jobs->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            jobs->stolenJobs.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void WakeWorkers(JobSystem *jobs, bool all) {
+    { std::lock_guard<std::mutex> guard(jobs->sleepLock); }
+
+    if (all) jobs->wake.notify_all();
+    else jobs->wake.notify_one();
+}
+
+static void WorkerLoop(JobSystem *jobs, int worker) {
+    workerIndex = worker;
+
+    char name[PROFILER_THREAD_NAME_LENGTH];
+    snprintf(name, sizeof(name), "Job worker %i", worker);
+    SetProfilerThreadName(name);
+
+    int idleRounds = 0;
+
+    while (jobs->running.load(std::memory_order_acquire)) {
+        Job job;
+
+        if (FindJob(jobs, worker, &job)) {
+            ExecuteJob(jobs, &job);
+            idleRounds = 0;
+            continue;
+        }
+
+        if (++idleRounds < JOB_SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> sleep(jobs->sleepLock);
+        jobs->wake.wait(sleep, [jobs] {
+            return !jobs->running.load(std::memory_order_acquire) || jobs->queuedJobs.load(std::memory_order_relaxed) > 0;
+        });
+        idleRounds = 0;
+    }
+}
+
+JobSystem *CreateJobSystem(int workerCount) {
+    if (workerCount <= 0) workerCount = (int)std::thread::hardware_concurrency();
+    if (workerCount <= 0) workerCount = 1;
+
+    if (workerCount > MAX_JOB_WORKERS) {
+        printf("Too many job workers (%i), max: %i\n", workerCount, MAX_JOB_WORKERS);
+        workerCount = MAX_JOB_WORKERS;
+    }
+
+    JobSystem *jobs = new JobSystem();
+    jobs->workerCount = workerCount;
+    jobs->queues = new JobQueue[workerCount];
+    jobs->running = true;
+    jobs->queuedJobs = 0;
+    jobs->executedJobs = 0;
+    jobs->stolenJobs = 0;
+
+    for (int i = 0; i < workerCount; i++) {
+        jobs->queues[i].top = 0;
+        jobs->queues[i].bottom = 0;
+    }
+
+    workerIndex = 0;
+    jobs->threads = new std::thread[workerCount - 1];
+    for (int i = 1; i < workerCount; i++) jobs->threads[i - 1] = std::thread(WorkerLoop, jobs, i);
+
+    return jobs;
+}
+
+void DestroyJobSystem(JobSystem *jobs) {
+    jobs->running.store(false, std::memory_order_release);
+    WakeWorkers(jobs, true);
+
+    for (int i = 1; i < jobs->workerCount; i++) jobs->threads[i - 1].join();
+
+    delete[] jobs->threads;
+    delete[] jobs->queues;
+    delete jobs;
+}
+
+int GetJobWorkerCount(JobSystem *jobs) {
+    return jobs->workerCount;
+}
+
+int GetJobWorkerIndex() {
+    return workerIndex;
+}
+
+// Queues without waking anyone, returns false when the job had to run inline
+static bool QueueJob(JobSystem *jobs, const Job *job) {
+    if (job->counter != NULL) job->counter->fetch_add(1, std::memory_order_relaxed);
+
+    jobs->queuedJobs.fetch_add(1, std::memory_order_relaxed);
+    if (PushJob(&jobs->queues[workerIndex], job)) return true;
+
+    jobs->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    ExecuteJob(jobs, job);
+    return false;
+}
+
+void RunJob(JobSystem *jobs, JobFunction function, void *data, int begin, int end, JobCounter *counter) {
+    Job job = { function, data, begin, end, counter };
+
+    if (QueueJob(jobs, &job)) WakeWorkers(jobs, false);
+}
+
+void WaitJobCounter(JobSystem *jobs, JobCounter *counter) {
+    while (counter->load(std::memory_order_acquire) > 0) {
+        Job job;
+
+        if (FindJob(jobs, workerIndex, &job)) ExecuteJob(jobs, &job);
+        else std::this_thread::yield();
+    }
+}
+
+void ParallelFor(JobSystem *jobs, int count, int minBatch, JobFunction function, void *data) {
+    if (count <= 0) return;
+    if (minBatch < 1) minBatch = 1;
+
+    // A few ranges per worker so the ones that finish early can steal from the others
+    int batches = jobs->workerCount * 4;
+    if (batches > count / minBatch) batches = count / minBatch;
+
+    if (jobs->workerCount == 1 || batches <= 1) {
+        function(data, 0, count);
+        return;
+    }
+
+    JobCounter counter(0);
+    const int batchSize = count / batches;
+    const int remainder = count % batches;
+    int begin = 0;
+
+    for (int i = 0; i < batches; i++) {
+        int end = begin + batchSize + (i < remainder ? 1 : 0);
+        Job job = { function, data, begin, end, &counter };
+
+        QueueJob(jobs, &job);
+        begin = end;
+    }
+
+    WakeWorkers(jobs, true);
+    WaitJobCounter(jobs, &counter);
+}
@@ -0,0 +1,58 @@
+#ifndef CGAME_ENGINE_JOBS_H
+#define CGAME_ENGINE_JOBS_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#define MAX_JOB_WORKERS 64          // Maximum number of workers, the thread that created the system included
+#define JOB_QUEUE_CAPACITY 4096     // Jobs per worker queue (power of two), a full queue runs new jobs inline
+
+typedef void (*JobFunction)(void *data, int begin, int end); // Runs the [begin, end) part of the work
+
+typedef std::atomic<int> JobCounter; // Jobs not finished yet, see WaitJobCounter
+
+typedef struct Job {
+    JobFunction function;
+    void *data;
+    int begin;
+    int end;
+    JobCounter *counter;        // Decremented once the job ran, can be NULL
+} Job;
+
+// Work-stealing deque: the owner pushes and pops at the bottom (newest first),
+// other workers steal from the top (oldest first, usually the biggest chunks of work)
+typedef struct JobQueue {
+    std::mutex lock;
+    Job jobs[JOB_QUEUE_CAPACITY];
+    int top;
+    int bottom;
+} JobQueue;
+
+typedef struct JobSystem {
+    int workerCount;            // Worker 0 is the thread that created the system, it runs jobs while waiting
+    JobQueue *queues;           // One per worker
+    std::thread *threads;       // Workers 1 to workerCount - 1
+
+    std::atomic<bool> running;
+    std::atomic<int> queuedJobs;
+    std::mutex sleepLock;
+    std::condition_variable wake;   // Idle workers sleep until jobs get queued
+
+    std::atomic<unsigned long long> executedJobs;
+    std::atomic<unsigned long long> stolenJobs;
+} JobSystem;
+
+JobSystem *CreateJobSystem(int workerCount); // workerCount <= 0 uses every hardware thread
+void DestroyJobSystem(JobSystem *jobs); // Waits for the workers, queued jobs are dropped
+int GetJobWorkerCount(JobSystem *jobs);
+int GetJobWorkerIndex(); // Worker running the calling thread, 0 for threads outside the system
+
+void RunJob(JobSystem *jobs, JobFunction function, void *data, int begin, int end, JobCounter *counter); // Queues one job on the calling worker
+void WaitJobCounter(JobSystem *jobs, JobCounter *counter); // Runs queued jobs until the counter reaches 0
+
+// Splits [0, count) in ranges of at least `minBatch` items and runs them on every worker, returns once all ran
+void ParallelFor(JobSystem *jobs, int count, int minBatch, JobFunction function, void *data);
+
+#endif // CGAME_ENGINE_JOBS_H
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <ostream>
 #include <stdio.h>
+#include <string.h>
 #include "external/glad.h"
 #include "glm/fwd.hpp"
 #include <GLFW/glfw3.h>
@@ -9,11 +10,59 @@
 #include "cod3rGL.h"
 #include <glm/vec3.hpp>
 #include "interactions.h"
+#include "ecs.h"
+#include "render_thread.h"
+#include "terrain.h"
+#include "frame_loop.h"
 
 int windowWidth = 1280;
 int windowHeight = 720;
 
-int main() {
+#define PROFILE_TRACE_FILE "profile_trace.json" // Written when a capture started with F9 is stopped with F9
+#define FRAME_CAPTURE_FILE "frame_capture.cgfc" // Frame captured with F10, replayed by cgame_frame_replay
+
+// User data of the render thread callbacks
+typedef struct RenderContext {
+    GLFWwindow *window;
+    ChunkedTerrain *terrain;    // Streamed and drawn by the render thread, chunk uploads need the GL context
+} RenderContext;
+
+static void AttachRenderContext(const FramePacket *, void *userData) {
+    glfwMakeContextCurrent(((RenderContext *)userData)->window);
+}
+
+static void DetachRenderContext(const FramePacket *, void *) {
+    glfwMakeContextCurrent(NULL);
+}
+
+static void BeginRenderFrame(const FramePacket *frame, void *userData) {
+    RenderContext *context = (RenderContext *)userData;
+
+    glMatrixMode(GL_PROJECTION);
+    glViewport(0, 0, frame->width, frame->height);
+    glMatrixMode(GL_MODELVIEW);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    StateSetEnabled(GL_DEPTH_TEST, true);
+    StateSetEnabled(GL_MULTISAMPLE, true);
+
+    // The frame camera, the simulation may already be moving the current one
+    const glm::vec3 cameraPosition = glm::vec3(glm::inverse(frame->view)[3]);
+    const Frustum frustum = MakeFrustum(projection * frame->view);
+
+    UpdateTerrain(context->terrain, cameraPosition);
+    DrawTerrain(context->terrain, &frustum);
+}
+
+static void PresentFrame(const FramePacket *, void *userData) {
+    glfwSwapBuffers(((RenderContext *)userData)->window);
+}
+
+// Usage: cgame_engine [--uncapped] (vsync off, frames are rendered as fast as possible)
+int main(int argc, char **argv) {
+    bool uncapped = argc > 1 && strcmp(argv[1], "--uncapped") == 0;
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
@@ -25,7 +74,7 @@ int main() {
 
     GLFWwindow *window = glfwCreateWindow(windowWidth, windowHeight, "CGame - Learn OpenGL", NULL, NULL);
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    glfwSwapInterval(uncapped ? 0 : 1);
 
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 
@@ -36,7 +85,11 @@ int main() {
 
     InitCod3rGL(windowWidth, windowHeight);
 
-    int frameBufferWidth, frameBufferHeight;
+    // Cold startup compiles every program, warm startup loads them from the cache
+    ShaderCacheStats shaderStats = GetShaderCacheStats();
+    printf("Shaders ready in %.2f ms: %i from the cache, %i compiled (%i stale)%s\n", shaderStats.startupMs,
+           shaderStats.programsLoaded, shaderStats.programsCompiled, shaderStats.programsStale,
+           shaderStats.parallelCompile ? ", parallel compile" : "");
 
     SetupCamera(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
 
@@ -47,35 +100,105 @@ int main() {
 
     Buffer buffer2D = CreateBuffer(BufferRenderType::Elements);
 
-    Entity test = CreateRect(&purple, glm::vec3(-10.0f, 100.0f, 0.0f));
-    Entity liz = CreateRect(&magenta, glm::vec3(-130.0f, 100.0f, 0.0f));
+    World *world = CreateWorld();
+    int spinComponent = RegisterComponent(world, sizeof(float)); // degrees per second
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwGetFramebufferSize(window, &frameBufferWidth, &frameBufferHeight);
+    // Rects share their geometry, both go out in one instanced draw
+    SpawnEntity(world, CreateRect(&purple, glm::vec3(-10.0f, 100.0f, 0.0f)), true);
+    EntityHandle liz = SpawnEntity(world, CreateRect(&magenta, glm::vec3(-130.0f, 100.0f, 0.0f)), true);
+
+    AddWorldComponent(world, liz, spinComponent);
+    *(float *)GetWorldComponent(world, liz, spinComponent) = 60.0f;
 
-        glMatrixMode(GL_PROJECTION);
-        glViewport(0, 0, frameBufferWidth, frameBufferHeight);
-        glMatrixMode(GL_MODELVIEW);
+    // Terrain chunks are generated by the job workers around the camera, up to the far plane
+    JobSystem *jobs = CreateJobSystem(0);
+    TerrainDesc terrainDesc = GetDefaultTerrainDesc();
+    terrainDesc.origin = glm::vec3(0.0f, -3.0f, 0.0f);
+    terrainDesc.chunkSize = 8.0f;
+    terrainDesc.noise.frequency = 1.0f / 32.0f;
+    terrainDesc.noise.amplitude = 1.5f;
 
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_MULTISAMPLE);
+    RenderContext renderContext = { window, CreateChunkedTerrain(&terrainDesc, jobs) };
 
-        UserInputs(window, 0.05f, &currentCamera);
+    // The render thread owns the GL context from here, frame N is rendered while N + 1 is simulated
+    glfwMakeContextCurrent(NULL);
 
-        RotateEntityZ(&liz, 1.0f);
+    RenderThreadDesc renderDesc = { AttachRenderContext, BeginRenderFrame, PresentFrame, DetachRenderContext, &renderContext };
+    RenderThread *renderThread = CreateRenderThread(&renderDesc);
 
-        //BindBuffer(buffer2D.id);
-        DrawEntity(test);
-        DrawEntity(liz);
+    SetProfilerThreadName("Main thread");
 
-        RenderCod3rGL();
+    // Window callbacks queue timestamped events, the simulation reads them as actions once per frame
+    InputSystem *input = CreateInputSystem();
+    BindDefaultInputs(input);
+    AttachInputCallbacks(window, input);
+
+    // The simulation steps at FRAME_LOOP_STEP_HZ, frames are drawn between the last two steps
+    FrameLoop *loop = CreateFrameLoop(0.0, 0);
+
+    while (!glfwWindowShouldClose(window)) {
+        PROFILE_ZONE("Frame");
+        FramePacket *frame = AcquireFramePacket(renderThread);
 
         glfwPollEvents();
-        glfwSwapBuffers(window);
+        frame->inputTimeNs = ProfileNowNs(); // Events the callbacks stamped up to now are consumed this frame
+        glfwGetFramebufferSize(window, &frame->width, &frame->height);
+
+        const int steps = BeginLoopFrame(loop);
+
+        ConsumeInputEvents(input, frame->inputTimeNs);
+        UserInputs(window, input, (float)loop->frameSeconds, &currentCamera);
+
+        if (WasInputActionPressed(input, ACTION_TOGGLE_PROFILER)) {
+            if (!IsProfilerCapturing()) BeginProfilerCapture();
+            else if (EndProfilerCapture(PROFILE_TRACE_FILE)) printf("Profiler capture written to %s\n", PROFILE_TRACE_FILE);
+        }
+
+        if (WasInputActionPressed(input, ACTION_CAPTURE_FRAME) && CaptureNextFrame(FRAME_CAPTURE_FILE)) {
+            printf("Capturing a frame to %s\n", FRAME_CAPTURE_FILE);
+        }
+
+        {
+            PROFILE_ZONE("Simulate");
+
+            for (int step = 0; step < steps; step++) {
+                SaveWorldTransforms(world);
+                RotateZSystem(world, spinComponent, (float)loop->stepSeconds);
+                UpdateWorldTransforms(world);
+            }
+        }
+
+        {
+            PROFILE_ZONE("Submit");
+            BeginFramePacket(frame);
+            //BindBuffer(buffer2D.id);
+            SubmitMeshSystemEx(world, GetLoopAlpha(loop));
+            EndFramePacket(frame);
+        }
+
+        SubmitFramePacket(renderThread, frame);
     }
 
+    if (IsProfilerCapturing()) EndProfilerCapture(PROFILE_TRACE_FILE);
+
+    FrameTimeStats frameTimes = GetFrameTimeStats(loop);
+    printf("Frame time: %.2f ms average, %.2f ms p50, %.2f ms p99, %.2f fixed steps per frame, %.2f ms dropped\n",
+           frameTimes.averageMs, frameTimes.p50Ms, frameTimes.p99Ms, frameTimes.stepsPerFrame, frameTimes.droppedMs);
+    DestroyFrameLoop(loop);
+
+    RenderLatency latency = GetRenderLatency(renderThread);
+    printf("Input to present latency: %.2f ms average, %.2f ms p99, %i frame(s) queued at most\n",
+           latency.averageMs, latency.p99Ms, latency.maxFramesQueued);
+
+    DestroyRenderThread(renderThread);
+    glfwMakeContextCurrent(window);
+
+    DetachInputCallbacks(window);
+    DestroyInputSystem(input);
+
+    DestroyChunkedTerrain(renderContext.terrain);
+    DestroyJobSystem(jobs);
+    DestroyWorld(world);
     CleanCod3rGL();
 
     glfwDestroyWindow(window);
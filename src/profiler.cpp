@@ -0,0 +1,261 @@
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "external/glad.h"
+
+#define PROFILER_GPU_TRACK PROFILER_MAX_THREADS // Trace thread id of the GPU passes
+
+// GPU queries of one frame, reused PROFILER_GPU_FRAMES frames later
+typedef struct ProfileGpuFrameQueries {
+    unsigned int queries[PROFILER_MAX_GPU_PASSES];
+    const char *names[PROFILER_MAX_GPU_PASSES];
+    uint64_t issued[PROFILER_MAX_GPU_PASSES];   // CPU time of the begin call
+    int count;
+} ProfileGpuFrameQueries;
+
+std::atomic<bool> profilerCapturing(false);
+
+static ProfileThread profileThreads[PROFILER_MAX_THREADS];
+static std::atomic<int> profileThreadCount(0);
+static thread_local ProfileThread *currentProfileThread = NULL;
+static thread_local bool profileThreadRejected = false;
+static uint64_t captureStartNs = 0;
+
+// GL thread only
+static ProfileGpuFrameQueries gpuFrames[PROFILER_GPU_FRAMES];
+static int gpuFrame = 0;
+static bool gpuQueriesCreated = false;
+static bool gpuZoneOpen = false;
+static int gpuDroppedPasses = 0;    // Results not available PROFILER_GPU_FRAMES frames later
+
+uint64_t ProfileNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+ProfileThread *GetProfileThread() {
+    if (currentProfileThread != NULL || profileThreadRejected) return currentProfileThread;
+
+    const int index = profileThreadCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (index >= PROFILER_MAX_THREADS) {
+        printf("Too many profiled threads, max: %i\n", PROFILER_MAX_THREADS);
+        profileThreadRejected = true;
+        return NULL;
+    }
+
+    currentProfileThread = &profileThreads[index];
+    snprintf(currentProfileThread->name, PROFILER_THREAD_NAME_LENGTH, "Thread %i", index);
+
+    return currentProfileThread;
+}
+
+void SetProfilerThreadName(const char *name) {
+    ProfileThread *thread = GetProfileThread();
+    if (thread == NULL) return;
+
+    strncpy(thread->name, name, PROFILER_THREAD_NAME_LENGTH - 1);
+    thread->name[PROFILER_THREAD_NAME_LENGTH - 1] = '\0';
+}
+
+// The slot is written before `written` is published, the exporter never reads past it
+static ProfileEvent *NextProfileEvent(ProfileThread *thread) {
+    if (thread->events == NULL) {
+        thread->events = (ProfileEvent *)malloc(PROFILER_RING_EVENTS * sizeof(ProfileEvent));
+    }
+
+    const uint64_t written = thread->written.load(std::memory_order_relaxed);
+    return &thread->events[written & (PROFILER_RING_EVENTS - 1)];
+}
+
+static void PublishProfileEvent(ProfileThread *thread) {
+    thread->written.store(thread->written.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void RecordProfileZone(ProfileThread *thread, const char *name, uint64_t start, uint32_t depth) {
+    ProfileEvent *event = NextProfileEvent(thread);
+
+    event->name = name;
+    event->start = start;
+    event->duration = ProfileNowNs() - start;
+    event->depth = depth;
+    event->type = PROFILE_EVENT_ZONE;
+
+    PublishProfileEvent(thread);
+}
+
+void ProfileCounter(const char *name, double value) {
+    if (!profilerCapturing.load(std::memory_order_relaxed)) return;
+
+    ProfileThread *thread = GetProfileThread();
+    if (thread == NULL) return;
+
+    ProfileEvent *event = NextProfileEvent(thread);
+
+    event->name = name;
+    event->start = ProfileNowNs();
+    event->value = value;
+    event->depth = 0;
+    event->type = PROFILE_EVENT_COUNTER;
+
+    PublishProfileEvent(thread);
+}
+
+void BeginProfileGpuZone(const char *name) {
+    if (gpuZoneOpen || glGenQueries == NULL) return;
+
+    if (!gpuQueriesCreated) {
+        for (int i = 0; i < PROFILER_GPU_FRAMES; i++) {
+            glGenQueries(PROFILER_MAX_GPU_PASSES, gpuFrames[i].queries);
+            gpuFrames[i].count = 0;
+        }
+
+        gpuQueriesCreated = true;
+    }
+
+    ProfileGpuFrameQueries *frame = &gpuFrames[gpuFrame];
+    if (frame->count == PROFILER_MAX_GPU_PASSES) return;
+
+    frame->names[frame->count] = name;
+    frame->issued[frame->count] = ProfileNowNs();
+    glBeginQuery(GL_TIME_ELAPSED, frame->queries[frame->count]);
+    gpuZoneOpen = true;
+}
+
+void EndProfileGpuZone() {
+    if (!gpuZoneOpen) return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuFrames[gpuFrame].count++;
+    gpuZoneOpen = false;
+}
+
+void ProfileGpuFrame() {
+    if (!gpuQueriesCreated) return;
+
+    gpuFrame = (gpuFrame + 1) % PROFILER_GPU_FRAMES;
+
+    // Oldest frame, issued PROFILER_GPU_FRAMES frames ago: its results are normally in, never wait for them
+    ProfileGpuFrameQueries *frame = &gpuFrames[gpuFrame];
+    ProfileThread *thread = profilerCapturing.load(std::memory_order_relaxed) ? GetProfileThread() : NULL;
+
+    for (int i = 0; i < frame->count && thread != NULL; i++) {
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (available == GL_FALSE) {
+            gpuDroppedPasses++;
+            continue;
+        }
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &elapsed);
+
+        ProfileEvent *event = NextProfileEvent(thread);
+        event->name = frame->names[i];
+        event->start = frame->issued[i];
+        event->duration = elapsed;
+        event->depth = 0;
+        event->type = PROFILE_EVENT_GPU;
+        PublishProfileEvent(thread);
+    }
+
+    frame->count = 0;
+}
+
+void ReleaseProfilerGpu() {
+    if (!gpuQueriesCreated) return;
+
+    for (int i = 0; i < PROFILER_GPU_FRAMES; i++) glDeleteQueries(PROFILER_MAX_GPU_PASSES, gpuFrames[i].queries);
+
+    gpuQueriesCreated = false;
+    gpuZoneOpen = false;
+}
+
+void BeginProfilerCapture() {
+    captureStartNs = ProfileNowNs();
+    gpuDroppedPasses = 0;
+    profilerCapturing.store(true, std::memory_order_release);
+}
+
+bool IsProfilerCapturing() {
+    return profilerCapturing.load(std::memory_order_relaxed);
+}
+
+// Zone names are identifiers in practice, quotes and backslashes are the only characters escaped
+static void WriteTraceString(FILE *file, const char *text) {
+    fputc('"', file);
+
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        if ((unsigned char)*c >= 0x20) fputc(*c, file);
+    }
+
+    fputc('"', file);
+}
+
+static void WriteTraceEvent(FILE *file, const ProfileEvent *event, int track, bool *first) {
+    const double ts = (event->start - captureStartNs) / 1000.0;
+
+    fprintf(file, *first ? "\n" : ",\n");
+    *first = false;
+
+    fprintf(file, "{\"name\":");
+    WriteTraceString(file, event->name);
+
+    if (event->type == PROFILE_EVENT_COUNTER) {
+        fprintf(file, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%i,\"args\":{\"value\":%.17g}}", ts, track, event->value);
+    } else {
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%i}",
+                event->type == PROFILE_EVENT_GPU ? "gpu" : "cpu", ts, event->duration / 1000.0,
+                event->type == PROFILE_EVENT_GPU ? PROFILER_GPU_TRACK : track);
+    }
+}
+
+bool EndProfilerCapture(const char *fileName) {
+    profilerCapturing.store(false, std::memory_order_release);
+
+    FILE *file = fopen(fileName, "w");
+
+    if (file == NULL) {
+        printf("%s Trace file could not be opened\n", fileName);
+        return false;
+    }
+
+    const int threadCount = std::min(profileThreadCount.load(std::memory_order_acquire), PROFILER_MAX_THREADS);
+    bool first = true;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for (int t = 0; t < threadCount; t++) {
+        ProfileThread *thread = &profileThreads[t];
+        const uint64_t written = thread->written.load(std::memory_order_acquire);
+        const uint64_t oldest = written > PROFILER_RING_EVENTS ? written - PROFILER_RING_EVENTS : 0;
+
+        fprintf(file, first ? "\n" : ",\n");
+        first = false;
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":", t);
+        WriteTraceString(file, thread->name);
+        fprintf(file, "}}");
+
+        // Events from before the capture are still in the ring, only the ones recorded since BeginProfilerCapture go out
+        for (uint64_t i = oldest; i < written; i++) {
+            const ProfileEvent *event = &thread->events[i & (PROFILER_RING_EVENTS - 1)];
+            if (event->start < captureStartNs) continue;
+
+            WriteTraceEvent(file, event, t, &first);
+        }
+    }
+
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"GPU\"}}", PROFILER_GPU_TRACK);
+    fprintf(file, "\n],\"otherData\":{\"gpuPassesDropped\":%i}}\n", gpuDroppedPasses);
+
+    bool written = fclose(file) == 0;
+    if (!written) printf("%s Trace file could not be written\n", fileName);
+
+    return written;
+}
@@ -0,0 +1,114 @@
+#ifndef CGAME_ENGINE_PROFILER_H
+#define CGAME_ENGINE_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define PROFILER_MAX_THREADS 64 // Threads that can record zones, each one gets its own ring
+#define PROFILER_RING_EVENTS 65536 // Events per thread ring (power of two), the oldest are overwritten
+#define PROFILER_GPU_FRAMES 4 // Frames between a GPU query and its readback, it is never waited on
+#define PROFILER_MAX_GPU_PASSES 16 // GPU zones per frame
+#define PROFILER_THREAD_NAME_LENGTH 32
+
+// PROFILE_ZONE and PROFILE_GPU_ZONE compile to nothing without CGAME_PROFILER (see CGAME_ENABLE_PROFILER).
+// Compiled in, a zone outside a capture costs one relaxed atomic load.
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if defined(CGAME_PROFILER)
+    #define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+    #define PROFILE_GPU_ZONE(name) ProfileGpuZone PROFILE_CONCAT(profileGpuZone, __LINE__)(name)
+    #define PROFILE_COUNTER(name, value) ProfileCounter(name, value)
+#else
+    #define PROFILE_ZONE(name)
+    #define PROFILE_GPU_ZONE(name)
+    #define PROFILE_COUNTER(name, value)
+#endif
+
+typedef enum {
+    PROFILE_EVENT_ZONE = 0,     // CPU zone, [start, start + duration)
+    PROFILE_EVENT_GPU,          // GPU pass, placed at the CPU time it was issued
+    PROFILE_EVENT_COUNTER       // Value sampled at `start`
+} ProfileEventType;
+
+typedef struct ProfileEvent {
+    const char *name;           // Static string, only the pointer is stored
+    uint64_t start;             // Monotonic clock, nanoseconds
+    union {
+        uint64_t duration;      // Nanoseconds, zones and GPU passes
+        double value;           // Counters
+    };
+    uint32_t depth;             // Zones open on the thread when this one started
+    uint32_t type;              // ProfileEventType
+} ProfileEvent;
+
+// Written by its thread only: events are stored, then `written` is published. The exporter reads behind it.
+typedef struct ProfileThread {
+    ProfileEvent *events;       // PROFILER_RING_EVENTS, allocated on the first event of the thread
+    std::atomic<uint64_t> written;
+    uint32_t depth;
+    char name[PROFILER_THREAD_NAME_LENGTH];
+} ProfileThread;
+
+uint64_t ProfileNowNs(); // Monotonic clock used by every event
+void SetProfilerThreadName(const char *name); // Track name of the calling thread in the trace
+
+// Only events recorded between Begin and End are exported. Any thread, zones already open are still recorded.
+void BeginProfilerCapture();
+bool EndProfilerCapture(const char *fileName); // Writes the capture as Chrome trace JSON (chrome://tracing, Perfetto)
+bool IsProfilerCapturing();
+
+void ProfileCounter(const char *name, double value); // Per frame counters: draw calls, vertices, bytes uploaded...
+
+// GPU passes, GL thread only. Queries are read back PROFILER_GPU_FRAMES frames later without waiting on the GPU.
+void BeginProfileGpuZone(const char *name); // Zones cannot nest, GL_TIME_ELAPSED queries cannot
+void EndProfileGpuZone();
+void ProfileGpuFrame(); // Once per frame on the GL thread, reads back finished queries
+void ReleaseProfilerGpu(); // Deletes the queries, before the GL context goes away
+
+// Low level zone recording, used by ProfileZone
+extern std::atomic<bool> profilerCapturing;
+ProfileThread *GetProfileThread(); // Ring of the calling thread, NULL when PROFILER_MAX_THREADS already record
+void RecordProfileZone(ProfileThread *thread, const char *name, uint64_t start, uint32_t depth);
+
+typedef struct ProfileZone {
+    ProfileThread *thread;      // NULL when the zone started outside a capture
+    const char *name;
+    uint64_t start;
+    uint32_t depth;
+
+    explicit ProfileZone(const char *zoneName) {
+        thread = NULL;
+        if (!profilerCapturing.load(std::memory_order_relaxed)) return;
+
+        thread = GetProfileThread();
+        if (thread == NULL) return;
+
+        name = zoneName;
+        depth = thread->depth++;
+        start = ProfileNowNs();
+    }
+
+    ~ProfileZone() {
+        if (thread == NULL) return;
+
+        thread->depth--;
+        RecordProfileZone(thread, name, start, depth);
+    }
+} ProfileZone;
+
+typedef struct ProfileGpuZone {
+    bool open;
+
+    explicit ProfileGpuZone(const char *name) {
+        open = profilerCapturing.load(std::memory_order_relaxed);
+        if (open) BeginProfileGpuZone(name);
+    }
+
+    ~ProfileGpuZone() {
+        if (open) EndProfileGpuZone();
+    }
+} ProfileGpuZone;
+
+#endif // CGAME_ENGINE_PROFILER_H
@@ -0,0 +1,167 @@
+#include "render_thread.h"
+#include <algorithm>
+#include <chrono>
+#include "profiler.h"
+
+#define FRAME_WAIT_SPINS 64 // Yields before a waiting thread starts sleeping
+
+static bool PushFrame(FrameQueue *queue, FramePacket *packet) {
+    unsigned int tail = queue->tail.load(std::memory_order_relaxed);
+
+    if (tail - queue->head.load(std::memory_order_acquire) == FRAME_QUEUE_CAPACITY) return false;
+
+    queue->items[tail & (FRAME_QUEUE_CAPACITY - 1)] = packet;
+    queue->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+static FramePacket *PopFrame(FrameQueue *queue) {
+    unsigned int head = queue->head.load(std::memory_order_relaxed);
+
+    if (head == queue->tail.load(std::memory_order_acquire)) return NULL;
+
+    FramePacket *packet = queue->items[head & (FRAME_QUEUE_CAPACITY - 1)];
+    queue->head.store(head + 1, std::memory_order_release);
+    return packet;
+}
+
+static int GetQueuedFrames(FrameQueue *queue) {
+    return (int)(queue->tail.load(std::memory_order_acquire) - queue->head.load(std::memory_order_relaxed));
+}
+
+// The other side is often blocked on vsync, sleep instead of burning a core once yielding did not help
+static void WaitFrame(int *spins) {
+    if (++*spins < FRAME_WAIT_SPINS) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+static void RecordLatency(RenderThread *renderThread, const FramePacket *packet, int queuedFrames) {
+    std::lock_guard<std::mutex> guard(renderThread->latencyLock);
+
+    if (queuedFrames > renderThread->maxFramesQueued) renderThread->maxFramesQueued = queuedFrames;
+    if (packet->inputTimeNs == 0) return;
+
+    float latencyMs = (float)((ProfileNowNs() - packet->inputTimeNs) / 1e6);
+    renderThread->latencySamples[renderThread->latencyCount % LATENCY_SAMPLE_COUNT] = latencyMs;
+    renderThread->latencyCount++;
+}
+
+static void RenderThreadLoop(RenderThread *renderThread) {
+    const RenderThreadDesc *desc = &renderThread->desc;
+    int spins = 0;
+
+    SetProfilerThreadName("Render thread");
+    if (desc->attach != NULL) desc->attach(NULL, desc->userData);
+
+    for (;;) {
+        FramePacket *packet = PopFrame(&renderThread->submitted);
+
+        if (packet == NULL) {
+            if (renderThread->running.load(std::memory_order_acquire)) {
+                WaitFrame(&spins);
+                continue;
+            }
+
+            // Stopped, frames submitted before that still get rendered
+            packet = PopFrame(&renderThread->submitted);
+            if (packet == NULL) break;
+        }
+
+        spins = 0;
+        const int queuedFrames = GetQueuedFrames(&renderThread->submitted);
+
+        {
+            PROFILE_ZONE("RenderFrame");
+            if (desc->beginFrame != NULL) desc->beginFrame(packet, desc->userData);
+            RenderFramePacket(packet);
+        }
+
+        {
+            PROFILE_ZONE("Present");
+            if (desc->present != NULL) desc->present(packet, desc->userData);
+        }
+
+        RecordLatency(renderThread, packet, queuedFrames);
+
+        // Released once presented, so the simulation is never more than one frame ahead
+        PushFrame(&renderThread->released, packet);
+    }
+
+    if (desc->detach != NULL) desc->detach(NULL, desc->userData);
+}
+
+RenderThread *CreateRenderThread(const RenderThreadDesc *desc) {
+    RenderThread *renderThread = new RenderThread();
+
+    renderThread->desc = *desc;
+    renderThread->submitted.head = 0;
+    renderThread->submitted.tail = 0;
+    renderThread->released.head = 0;
+    renderThread->released.tail = 0;
+    renderThread->running = true;
+    renderThread->nextFrameIndex = 0;
+    renderThread->latencyCount = 0;
+    renderThread->maxFramesQueued = 0;
+
+    for (int i = 0; i < FRAME_PACKET_COUNT; i++) {
+        renderThread->packets[i] = { };
+        PushFrame(&renderThread->released, &renderThread->packets[i]);
+    }
+
+    renderThread->thread = std::thread(RenderThreadLoop, renderThread);
+
+    return renderThread;
+}
+
+void DestroyRenderThread(RenderThread *renderThread) {
+    renderThread->running.store(false, std::memory_order_release);
+    renderThread->thread.join();
+
+    for (int i = 0; i < FRAME_PACKET_COUNT; i++) FreeFramePacket(&renderThread->packets[i]);
+
+    delete renderThread;
+}
+
+FramePacket *AcquireFramePacket(RenderThread *renderThread) {
+    PROFILE_ZONE("AcquireFramePacket");
+    int spins = 0;
+    FramePacket *packet;
+
+    while ((packet = PopFrame(&renderThread->released)) == NULL) WaitFrame(&spins);
+
+    return packet;
+}
+
+void SubmitFramePacket(RenderThread *renderThread, FramePacket *packet) {
+    packet->frameIndex = renderThread->nextFrameIndex++;
+
+    // Never full, there are fewer packets than slots
+    PushFrame(&renderThread->submitted, packet);
+}
+
+RenderLatency GetRenderLatency(RenderThread *renderThread) {
+    RenderLatency latency = { 0 };
+    float samples[LATENCY_SAMPLE_COUNT];
+
+    {
+        std::lock_guard<std::mutex> guard(renderThread->latencyLock);
+
+        latency.frames = std::min(renderThread->latencyCount, LATENCY_SAMPLE_COUNT);
+        latency.maxFramesQueued = renderThread->maxFramesQueued;
+        std::copy(renderThread->latencySamples, renderThread->latencySamples + latency.frames, samples);
+    }
+
+    if (latency.frames == 0) return latency;
+
+    std::sort(samples, samples + latency.frames);
+
+    double sum = 0.0;
+    for (int i = 0; i < latency.frames; i++) sum += samples[i];
+
+    latency.averageMs = sum / latency.frames;
+    latency.p50Ms = samples[latency.frames / 2];
+    latency.p99Ms = samples[(latency.frames * 99) / 100];
+    latency.maxMs = samples[latency.frames - 1];
+
+    return latency;
+}
@@ -0,0 +1,64 @@
+#ifndef CGAME_ENGINE_RENDER_THREAD_H
+#define CGAME_ENGINE_RENDER_THREAD_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#if !defined(COD3R_GL_IMPLEMENTATION)
+    #include "cod3rGL.h" // for FramePacket
+#endif
+
+#define FRAME_PACKET_COUNT 2 // Frame N is rendered while N + 1 is simulated
+#define FRAME_QUEUE_CAPACITY 4 // Power of two, at least FRAME_PACKET_COUNT
+#define LATENCY_SAMPLE_COUNT 256 // Frames kept for the latency percentiles
+
+typedef void (*RenderThreadCallback)(const FramePacket *packet, void *userData); // packet is NULL for attach and detach
+
+// Lock-free queue with one producer thread and one consumer thread
+typedef struct FrameQueue {
+    FramePacket *items[FRAME_QUEUE_CAPACITY];
+    std::atomic<unsigned int> head;     // Next item to pop, written by the consumer
+    std::atomic<unsigned int> tail;     // Next free slot, written by the producer
+} FrameQueue;
+
+typedef struct RenderThreadDesc {
+    RenderThreadCallback attach;        // Makes the GL context current on the render thread
+    RenderThreadCallback beginFrame;    // Viewport, clear... before the packet draws
+    RenderThreadCallback present;       // Swaps buffers, the vsync wait only blocks the render thread
+    RenderThreadCallback detach;        // Releases the GL context so the caller can take it back
+    void *userData;
+} RenderThreadDesc;
+
+typedef struct RenderLatency {
+    int frames;                 // Frames measured (last LATENCY_SAMPLE_COUNT at most)
+    double averageMs;           // Input sampled to present returned
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+    int maxFramesQueued;        // Frames waiting behind the one being rendered, 1 at most with double buffering
+} RenderLatency;
+
+typedef struct RenderThread {
+    std::thread thread;
+    RenderThreadDesc desc;
+    FramePacket packets[FRAME_PACKET_COUNT];
+    FrameQueue submitted;       // Simulation to render thread
+    FrameQueue released;        // Render thread back to the simulation once presented
+    std::atomic<bool> running;
+    unsigned long long nextFrameIndex;
+
+    std::mutex latencyLock;     // Samples are written by the render thread, read by GetRenderLatency
+    float latencySamples[LATENCY_SAMPLE_COUNT];
+    int latencyCount;
+    int maxFramesQueued;
+} RenderThread;
+
+// The GL context must not be current on the calling thread, desc.attach makes it current on the render thread
+RenderThread *CreateRenderThread(const RenderThreadDesc *desc);
+void DestroyRenderThread(RenderThread *renderThread); // Renders what was submitted, then joins after desc.detach
+
+FramePacket *AcquireFramePacket(RenderThread *renderThread); // Waits until the render thread presented a packet, if both are in use
+void SubmitFramePacket(RenderThread *renderThread, FramePacket *packet); // The packet belongs to the render thread until acquired again
+RenderLatency GetRenderLatency(RenderThread *renderThread); // Frames that had an inputTimeNs, from any thread
+
+#endif // CGAME_ENGINE_RENDER_THREAD_H
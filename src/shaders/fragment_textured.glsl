@@ -0,0 +1,13 @@
+#version 410
+
+out vec4 FragColor;
+
+in vec4 color;
+in vec2 texCoord;
+
+uniform sampler2DArray atlas;
+uniform int textureLayer;
+
+void main() {
+  FragColor = color * texture(atlas, vec3(texCoord, textureLayer));
+}
@@ -2,14 +2,21 @@
 
 layout (location = 0) in vec3 vertexPosition;
 layout (location = 1) in vec4 vertexColor;
+layout (location = 2) in vec2 vertexTexCoord;
+
+layout (std140) uniform FrameData {
+  mat4 projection;
+  mat4 view;
+  mat4 viewProjection;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 out vec4 color;
+out vec2 texCoord;
 
 void main() {
-  gl_Position = projection * view * vec4(vertexPosition, 1.0);
+  gl_Position = viewProjection * model * vec4(vertexPosition, 1.0);
   color = vertexColor;
+  texCoord = vertexTexCoord;
 }
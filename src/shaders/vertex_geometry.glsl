@@ -0,0 +1,23 @@
+#version 410
+
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec4 vertexColor;
+layout (location = 2) in vec2 vertexTexCoord;
+layout (location = 3) in mat4 instanceModel;
+
+layout (std140) uniform FrameData {
+  mat4 projection;
+  mat4 view;
+  mat4 viewProjection;
+};
+
+uniform mat4 model;
+
+out vec4 color;
+out vec2 texCoord;
+
+void main() {
+  gl_Position = viewProjection * model * instanceModel * vec4(vertexPosition, 1.0);
+  color = vertexColor;
+  texCoord = vertexTexCoord;
+}
@@ -0,0 +1,436 @@
+#include "terrain.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include "profiler.h"
+
+#define TERRAIN_CHUNK_CPU_BYTES (TERRAIN_CHUNK_VERTICES * 7 * sizeof(float)) // XYZ positions and RGBA colors
+#define TERRAIN_CHUNK_GPU_BYTES (TERRAIN_CHUNK_VERTICES * sizeof(BatchVertex))
+#define TERRAIN_HEIGHTS_SIDE (TERRAIN_CHUNK_QUADS + 3) // Chunk heights plus a one vertex border for the normals
+
+static const glm::mat4 terrainMatrix = glm::mat4(1.0f); // Chunk vertices are already in world space
+
+TerrainDesc GetDefaultTerrainDesc() {
+    TerrainDesc desc;
+
+    desc.origin = glm::vec3(0.0f);
+    desc.chunkSize = 64.0f;
+    desc.viewChunks = 12;
+    desc.lodCount = 4;
+    desc.lodRingChunks = 2;
+    desc.memoryBudget = 64 * 1024 * 1024;
+    desc.maxChunkJobs = 16;
+    desc.maxUploadsPerFrame = 8;
+    desc.height = NULL;
+    desc.heightData = NULL;
+    desc.noise.seed = 1337;
+    desc.noise.octaves = 5;
+    desc.noise.frequency = 1.0f / 256.0f;
+    desc.noise.amplitude = 40.0f;
+
+    return desc;
+}
+
+// Lattice value in [-1, 1]
+static float HashLattice(int x, int z, unsigned int seed) {
+    unsigned int hash = seed ^ ((unsigned int)x * 374761393u) ^ ((unsigned int)z * 668265263u);
+
+    hash = (hash ^ (hash >> 13)) * 1274126177u;
+    hash ^= hash >> 16;
+
+    return (float)(hash & 0xFFFFFF) / (float)0xFFFFFF * 2.0f - 1.0f;
+}
+
+static float ValueNoise(float x, float z, unsigned int seed) {
+    const float fx = floorf(x);
+    const float fz = floorf(z);
+    const int ix = (int)fx;
+    const int iz = (int)fz;
+
+    // Smoothstep weights, the noise has no visible creases along the lattice
+    float tx = x - fx;
+    float tz = z - fz;
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    tz = tz * tz * (3.0f - 2.0f * tz);
+
+    const float top = HashLattice(ix, iz, seed) + (HashLattice(ix + 1, iz, seed) - HashLattice(ix, iz, seed)) * tx;
+    const float bottom = HashLattice(ix, iz + 1, seed) + (HashLattice(ix + 1, iz + 1, seed) - HashLattice(ix, iz + 1, seed)) * tx;
+
+    return top + (bottom - top) * tz;
+}
+
+float SampleTerrainNoise(float x, float z, void *noise) {
+    const TerrainNoise *params = (const TerrainNoise *)noise;
+    float frequency = params->frequency;
+    float amplitude = params->amplitude;
+    float height = 0.0f;
+
+    for (int i = 0; i < params->octaves; i++) {
+        height += ValueNoise(x * frequency, z * frequency, params->seed + i) * amplitude;
+        frequency *= 2.0f;
+        amplitude *= 0.5f;
+    }
+
+    return height;
+}
+
+static inline int GetChunkSlot(const ChunkedTerrain *terrain, int x, int z) {
+    const int size = terrain->windowSize;
+
+    return ((z % size + size) % size) * size + (x % size + size) % size;
+}
+
+// LOD of the chunk `dx`, `dz` chunks away from the camera chunk, from the square ring it is in
+static inline int GetChunkLod(const ChunkedTerrain *terrain, int dx, int dz) {
+    const int ring = std::max(abs(dx), abs(dz));
+
+    return std::min(ring / terrain->desc.lodRingChunks, terrain->desc.lodCount - 1);
+}
+
+// Vertices on an edge next to a coarser chunk move to the previous vertex the coarser chunk has
+static inline int GetSeamVertex(int i, int j, int step, int mask) {
+    const int coarse = step * 2;
+
+    if ((mask & TERRAIN_EDGE_NORTH) && j == 0) i = i / coarse * coarse;
+    if ((mask & TERRAIN_EDGE_SOUTH) && j == TERRAIN_CHUNK_QUADS) i = i / coarse * coarse;
+    if ((mask & TERRAIN_EDGE_WEST) && i == 0) j = j / coarse * coarse;
+    if ((mask & TERRAIN_EDGE_EAST) && i == TERRAIN_CHUNK_QUADS) j = j / coarse * coarse;
+
+    return j * (TERRAIN_CHUNK_QUADS + 1) + i;
+}
+
+static int AppendTriangle(int *indices, int count, int a, int b, int c) {
+    // Collapsed by the seam snapping
+    if (a == b || b == c || a == c) return count;
+
+    indices[count++] = a;
+    indices[count++] = b;
+    indices[count++] = c;
+
+    return count;
+}
+
+// Same triangulation as CreateTerrain, one quad every `step` vertices
+static int BuildLodIndices(int *indices, int step, int mask) {
+    int count = 0;
+
+    for (int z = 0; z < TERRAIN_CHUNK_QUADS; z += step) {
+        for (int x = 0; x < TERRAIN_CHUNK_QUADS; x += step) {
+            const int topLeft = GetSeamVertex(x, z, step, mask);
+            const int topRight = GetSeamVertex(x + step, z, step, mask);
+            const int bottomLeft = GetSeamVertex(x, z + step, step, mask);
+            const int bottomRight = GetSeamVertex(x + step, z + step, step, mask);
+
+            count = AppendTriangle(indices, count, topLeft, bottomLeft, topRight);
+            count = AppendTriangle(indices, count, topRight, bottomLeft, bottomRight);
+        }
+    }
+
+    return count;
+}
+
+static void BuildTerrainIndices(ChunkedTerrain *terrain) {
+    int capacity = 0;
+    for (int lod = 0; lod < terrain->desc.lodCount; lod++) {
+        const int quads = TERRAIN_CHUNK_QUADS >> lod;
+        capacity += quads * quads * 6 * TERRAIN_SEAM_MASKS;
+    }
+
+    terrain->lodIndices = (int *)malloc(capacity * sizeof(int));
+    terrain->lodIndicesTotal = 0;
+
+    for (int lod = 0; lod < terrain->desc.lodCount; lod++) {
+        const int step = 1 << lod;
+
+        for (int mask = 0; mask < TERRAIN_SEAM_MASKS; mask++) {
+            // The coarsest LOD never has a coarser neighbour
+            if (mask != 0 && step * 2 > TERRAIN_CHUNK_QUADS) {
+                terrain->lodFirstIndex[lod][mask] = terrain->lodFirstIndex[lod][0];
+                terrain->lodIndicesCount[lod][mask] = terrain->lodIndicesCount[lod][0];
+                continue;
+            }
+
+            const int count = BuildLodIndices(terrain->lodIndices + terrain->lodIndicesTotal, step, mask);
+
+            terrain->lodFirstIndex[lod][mask] = terrain->lodIndicesTotal;
+            terrain->lodIndicesCount[lod][mask] = count;
+            terrain->lodIndicesTotal += count;
+        }
+    }
+
+    terrain->stats.indexBytes = terrain->lodIndicesTotal * (sizeof(int) + sizeof(unsigned short));
+}
+
+static bool CompareChunkOffsets(const glm::ivec2 &a, const glm::ivec2 &b) {
+    const int distanceA = a.x * a.x + a.y * a.y;
+    const int distanceB = b.x * b.x + b.y * b.y;
+
+    if (distanceA != distanceB) return distanceA < distanceB;
+    return a.y != b.y ? a.y < b.y : a.x < b.x;
+}
+
+ChunkedTerrain *CreateChunkedTerrain(const TerrainDesc *desc, JobSystem *jobs) {
+    ChunkedTerrain *terrain = (ChunkedTerrain *)calloc(1, sizeof(ChunkedTerrain));
+
+    terrain->desc = *desc;
+    terrain->desc.viewChunks = std::max(terrain->desc.viewChunks, 0);
+    terrain->desc.lodCount = std::min(std::max(terrain->desc.lodCount, 1), TERRAIN_MAX_LODS);
+    terrain->desc.lodRingChunks = std::max(terrain->desc.lodRingChunks, 1);
+    terrain->desc.maxChunkJobs = std::max(terrain->desc.maxChunkJobs, 1);
+    terrain->desc.maxUploadsPerFrame = std::max(terrain->desc.maxUploadsPerFrame, 1);
+
+    if (terrain->desc.height == NULL) {
+        terrain->desc.height = SampleTerrainNoise;
+        terrain->desc.heightData = &terrain->desc.noise;
+    }
+
+    // Jobs queued from a thread outside the system only run on the other workers
+    terrain->jobs = jobs != NULL && GetJobWorkerCount(jobs) > 1 ? jobs : NULL;
+
+    terrain->windowSize = terrain->desc.viewChunks * 2 + 1;
+    terrain->slots = new TerrainChunk[terrain->windowSize * terrain->windowSize]();
+    terrain->loadOrderCount = terrain->windowSize * terrain->windowSize;
+    terrain->loadOrder = (glm::ivec2 *)malloc(terrain->loadOrderCount * sizeof(glm::ivec2));
+
+    for (int dz = -terrain->desc.viewChunks, i = 0; dz <= terrain->desc.viewChunks; dz++) {
+        for (int dx = -terrain->desc.viewChunks; dx <= terrain->desc.viewChunks; dx++) terrain->loadOrder[i++] = glm::ivec2(dx, dz);
+    }
+    std::sort(terrain->loadOrder, terrain->loadOrder + terrain->loadOrderCount, CompareChunkOffsets);
+
+    const size_t budgetChunks = std::max(terrain->desc.memoryBudget / TERRAIN_CHUNK_CPU_BYTES, (size_t)1);
+    terrain->budgetChunks = (int)std::min(budgetChunks, (size_t)std::min(terrain->loadOrderCount, MAX_STATIC_MESHES));
+
+    BuildTerrainIndices(terrain);
+
+    return terrain;
+}
+
+// Fills the vertices and colors of the chunk
+static void GenerateChunk(const ChunkedTerrain *terrain, TerrainChunk *chunk) {
+    const TerrainDesc *desc = &terrain->desc;
+    const unsigned long long start = ProfileNowNs();
+
+    const float step = desc->chunkSize / TERRAIN_CHUNK_QUADS;
+    float heights[TERRAIN_HEIGHTS_SIDE * TERRAIN_HEIGHTS_SIDE];
+
+    // Positions come from global vertex coordinates, so chunks sharing an edge compute the exact same vertices
+    const int firstX = chunk->x * TERRAIN_CHUNK_QUADS - 1;
+    const int firstZ = chunk->z * TERRAIN_CHUNK_QUADS - 1;
+
+    for (int j = 0; j < TERRAIN_HEIGHTS_SIDE; j++) {
+        for (int i = 0; i < TERRAIN_HEIGHTS_SIDE; i++) {
+            heights[j * TERRAIN_HEIGHTS_SIDE + i] = desc->height(desc->origin.x + (firstX + i) * step, desc->origin.z + (firstZ + j) * step, desc->heightData);
+        }
+    }
+
+    Mesh *mesh = &chunk->mesh;
+    *mesh = { 0 };
+    mesh->vertexCount = TERRAIN_CHUNK_VERTICES * 3;
+    mesh->triangleCount = TERRAIN_CHUNK_VERTICES;
+    mesh->vertices = (float *)malloc(TERRAIN_CHUNK_VERTICES * 3 * sizeof(float));
+    mesh->colors = (float *)malloc(TERRAIN_CHUNK_VERTICES * 4 * sizeof(float));
+
+    for (int j = 0; j <= TERRAIN_CHUNK_QUADS; j++) {
+        for (int i = 0; i <= TERRAIN_CHUNK_QUADS; i++) {
+            const int vertex = j * (TERRAIN_CHUNK_QUADS + 1) + i;
+            const float *height = &heights[(j + 1) * TERRAIN_HEIGHTS_SIDE + i + 1];
+
+            mesh->vertices[vertex * 3] = desc->origin.x + (firstX + i + 1) * step;
+            mesh->vertices[vertex * 3 + 1] = desc->origin.y + *height;
+            mesh->vertices[vertex * 3 + 2] = desc->origin.z + (firstZ + j + 1) * step;
+
+            // Steep slopes get darker, the shader has no lighting
+            const glm::vec3 normal = glm::normalize(glm::vec3(height[-1] - height[1], 2.0f * step, height[-TERRAIN_HEIGHTS_SIDE] - height[TERRAIN_HEIGHTS_SIDE]));
+            const float shade = 0.45f + 0.55f * normal.y * normal.y;
+
+            mesh->colors[vertex * 4] = 0.15f * shade;
+            mesh->colors[vertex * 4 + 1] = 0.7f * shade;
+            mesh->colors[vertex * 4 + 2] = 0.26f * shade;
+            mesh->colors[vertex * 4 + 3] = 1.0f; // color alpha
+        }
+    }
+
+    ComputeMeshBounds(mesh);
+
+    chunk->generationNs = ProfileNowNs() - start;
+}
+
+// Job: generates the chunks in slots [begin, end)
+static void GenerateChunkJob(void *data, int begin, int end) {
+    const ChunkedTerrain *terrain = (const ChunkedTerrain *)data;
+
+    for (int i = begin; i < end; i++) GenerateChunk(terrain, &terrain->slots[i]);
+}
+
+static void RetireChunkJob(ChunkedTerrain *terrain, TerrainChunk *chunk) {
+    chunk->state = TERRAIN_CHUNK_READY;
+    terrain->stats.chunksGenerating--;
+    terrain->stats.chunksGenerated++;
+    terrain->stats.generationMs += chunk->generationNs / 1e6;
+}
+
+static void SetChunkBytes(ChunkedTerrain *terrain, TerrainChunk *chunk, size_t bytes) {
+    terrain->stats.memoryUsed += bytes - chunk->bytes;
+    terrain->stats.memoryPeak = std::max(terrain->stats.memoryPeak, terrain->stats.memoryUsed);
+    chunk->bytes = bytes;
+}
+
+static void EvictChunk(ChunkedTerrain *terrain, TerrainChunk *chunk) {
+    if (chunk->state == TERRAIN_CHUNK_UPLOADED) UnloadMesh(&chunk->mesh);
+
+    free(chunk->mesh.vertices);
+    free(chunk->mesh.colors);
+    chunk->mesh = { 0 };
+
+    SetChunkBytes(terrain, chunk, 0);
+    chunk->state = TERRAIN_CHUNK_FREE;
+    terrain->stats.chunksLoaded--;
+    terrain->stats.chunksEvicted++;
+}
+
+static void GenerateChunk(ChunkedTerrain *terrain, int slot, int x, int z) {
+    TerrainChunk *chunk = &terrain->slots[slot];
+
+    chunk->x = x;
+    chunk->z = z;
+    chunk->state = TERRAIN_CHUNK_GENERATING;
+    SetChunkBytes(terrain, chunk, TERRAIN_CHUNK_CPU_BYTES);
+    terrain->stats.chunksLoaded++;
+    terrain->stats.chunksGenerating++;
+
+    if (terrain->jobs != NULL) {
+        RunJob(terrain->jobs, GenerateChunkJob, terrain, slot, slot + 1, &chunk->pending);
+    } else {
+        GenerateChunkJob(terrain, slot, slot + 1);
+        RetireChunkJob(terrain, chunk);
+    }
+}
+
+void UpdateTerrain(ChunkedTerrain *terrain, const glm::vec3 &cameraPosition) {
+    const TerrainDesc *desc = &terrain->desc;
+
+    for (int i = 0; i < terrain->loadOrderCount; i++) {
+        TerrainChunk *chunk = &terrain->slots[i];
+
+        if (chunk->state == TERRAIN_CHUNK_GENERATING && chunk->pending.load(std::memory_order_acquire) == 0) {
+            RetireChunkJob(terrain, chunk);
+        }
+    }
+
+    // Without job workers, this is how many chunks are generated by this call
+    int startableChunks = desc->maxChunkJobs - terrain->stats.chunksGenerating;
+
+    terrain->cameraX = (int)floorf((cameraPosition.x - desc->origin.x) / desc->chunkSize);
+    terrain->cameraZ = (int)floorf((cameraPosition.z - desc->origin.z) / desc->chunkSize);
+
+    // Nearest chunks first: they are generated first and the farthest ones are the ones over the budget
+    for (int i = 0; i < terrain->loadOrderCount; i++) {
+        const int x = terrain->cameraX + terrain->loadOrder[i].x;
+        const int z = terrain->cameraZ + terrain->loadOrder[i].y;
+        const int slot = GetChunkSlot(terrain, x, z);
+        const bool wanted = i < terrain->budgetChunks;
+        TerrainChunk *chunk = &terrain->slots[slot];
+
+        if (chunk->state != TERRAIN_CHUNK_FREE && (chunk->x != x || chunk->z != z || !wanted)) {
+            // Evicted by a later update, once the worker is done with it
+            if (chunk->state == TERRAIN_CHUNK_GENERATING) continue;
+
+            EvictChunk(terrain, chunk);
+        }
+
+        if (!wanted || chunk->state != TERRAIN_CHUNK_FREE || startableChunks == 0) continue;
+
+        // Chunks still owned by a worker may keep the budget full for a few updates
+        if (terrain->stats.memoryUsed + TERRAIN_CHUNK_CPU_BYTES > desc->memoryBudget) continue;
+
+        GenerateChunk(terrain, slot, x, z);
+        startableChunks--;
+    }
+}
+
+static bool UploadChunk(ChunkedTerrain *terrain, TerrainChunk *chunk) {
+    if (UploadMeshVertices(&chunk->mesh, &terrain->indexBuffer) == 0) return false;
+
+    // Only the bounds and the registry handle are needed from now on
+    free(chunk->mesh.vertices);
+    free(chunk->mesh.colors);
+    chunk->mesh.vertices = NULL;
+    chunk->mesh.colors = NULL;
+
+    chunk->state = TERRAIN_CHUNK_UPLOADED;
+    SetChunkBytes(terrain, chunk, TERRAIN_CHUNK_GPU_BYTES);
+
+    return true;
+}
+
+void DrawTerrain(ChunkedTerrain *terrain, const Frustum *frustum) {
+    TerrainStats *stats = &terrain->stats;
+    int uploads = 0;
+
+    if (terrain->indexBuffer.id == 0) {
+        terrain->indexBuffer = UploadIndexBuffer(terrain->lodIndices, terrain->lodIndicesTotal, TERRAIN_CHUNK_VERTICES);
+    }
+
+    stats->chunksDrawn = 0;
+    stats->chunksCulled = 0;
+    stats->trianglesDrawn = 0;
+    for (int lod = 0; lod < TERRAIN_MAX_LODS; lod++) stats->chunksPerLod[lod] = 0;
+
+    for (int i = 0; i < terrain->budgetChunks; i++) {
+        const int dx = terrain->loadOrder[i].x;
+        const int dz = terrain->loadOrder[i].y;
+        TerrainChunk *chunk = &terrain->slots[GetChunkSlot(terrain, terrain->cameraX + dx, terrain->cameraZ + dz)];
+
+        if (chunk->x != terrain->cameraX + dx || chunk->z != terrain->cameraZ + dz) continue;
+        if (chunk->state != TERRAIN_CHUNK_READY && chunk->state != TERRAIN_CHUNK_UPLOADED) continue;
+
+        if (chunk->state == TERRAIN_CHUNK_READY) {
+            if (uploads == terrain->desc.maxUploadsPerFrame || !UploadChunk(terrain, chunk)) continue;
+            uploads++;
+        }
+
+        if (frustum != NULL && TestFrustumAABB(frustum, chunk->mesh.boundsMin, chunk->mesh.boundsMax) == CULL_OUTSIDE) {
+            stats->chunksCulled++;
+            continue;
+        }
+
+        const int lod = GetChunkLod(terrain, dx, dz);
+        int mask = 0;
+
+        if (GetChunkLod(terrain, dx, dz - 1) > lod) mask |= TERRAIN_EDGE_NORTH;
+        if (GetChunkLod(terrain, dx + 1, dz) > lod) mask |= TERRAIN_EDGE_EAST;
+        if (GetChunkLod(terrain, dx, dz + 1) > lod) mask |= TERRAIN_EDGE_SOUTH;
+        if (GetChunkLod(terrain, dx - 1, dz) > lod) mask |= TERRAIN_EDGE_WEST;
+
+        DrawMeshRange(&chunk->mesh, terrainMatrix, terrain->lodFirstIndex[lod][mask], terrain->lodIndicesCount[lod][mask]);
+
+        stats->chunksDrawn++;
+        stats->chunksPerLod[lod]++;
+        stats->trianglesDrawn += terrain->lodIndicesCount[lod][mask] / 3;
+    }
+}
+
+TerrainStats GetTerrainStats(ChunkedTerrain *terrain) {
+    return terrain->stats;
+}
+
+void DestroyChunkedTerrain(ChunkedTerrain *terrain) {
+    for (int i = 0; i < terrain->loadOrderCount; i++) {
+        TerrainChunk *chunk = &terrain->slots[i];
+
+        if (chunk->state == TERRAIN_CHUNK_GENERATING) {
+            WaitJobCounter(terrain->jobs, &chunk->pending);
+            RetireChunkJob(terrain, chunk);
+        }
+
+        if (chunk->state != TERRAIN_CHUNK_FREE) EvictChunk(terrain, chunk);
+    }
+
+    UnloadIndexBuffer(&terrain->indexBuffer);
+
+    delete[] terrain->slots;
+    free(terrain->loadOrder);
+    free(terrain->lodIndices);
+    free(terrain);
+}
@@ -0,0 +1,118 @@
+#ifndef CGAME_ENGINE_TERRAIN_H
+#define CGAME_ENGINE_TERRAIN_H
+
+#include <stddef.h>
+#include <atomic>
+#include <glm/glm.hpp>
+#if !defined(COD3R_GL_IMPLEMENTATION)
+    #include "cod3rGL.h" // for Mesh and IndexBuffer
+#endif
+#include "jobs.h"
+#include "culling.h"
+
+#define TERRAIN_CHUNK_QUADS 32 // Quads per chunk side at LOD 0, power of two
+#define TERRAIN_CHUNK_VERTICES ((TERRAIN_CHUNK_QUADS + 1) * (TERRAIN_CHUNK_QUADS + 1))
+#define TERRAIN_MAX_LODS 6 // LOD l keeps one vertex out of 2^l per side, down to one quad per chunk
+#define TERRAIN_SEAM_MASKS 16 // One bit per chunk edge whose neighbour is one LOD coarser
+
+// Chunk edges, bits of a seam mask
+#define TERRAIN_EDGE_NORTH 1 // -z
+#define TERRAIN_EDGE_EAST 2 // +x
+#define TERRAIN_EDGE_SOUTH 4 // +z
+#define TERRAIN_EDGE_WEST 8 // -x
+
+typedef float (*TerrainHeightFunction)(float x, float z, void *userData); // Height at a world position, called from the job workers
+
+// Fractal value noise, see SampleTerrainNoise
+typedef struct TerrainNoise {
+    unsigned int seed;
+    int octaves;
+    float frequency;            // Of the first octave, per world unit
+    float amplitude;            // Of the first octave, every next octave has half the amplitude and twice the frequency
+} TerrainNoise;
+
+typedef struct TerrainDesc {
+    glm::vec3 origin;           // Corner of chunk (0, 0), heights are added to origin.y
+    float chunkSize;            // World units per chunk side
+    int viewChunks;             // Chunks are loaded up to this many chunks away from the camera chunk
+    int lodCount;               // 1 to TERRAIN_MAX_LODS
+    int lodRingChunks;          // Width of every LOD ring in chunks, neighbours never differ by more than one LOD
+    size_t memoryBudget;        // Bytes of chunk geometry (CPU and GPU) kept loaded, the farthest chunks are left out
+    int maxChunkJobs;           // Chunks generated at the same time, or by one UpdateTerrain without job workers
+    int maxUploadsPerFrame;     // Generated chunks uploaded by one DrawTerrain
+    TerrainHeightFunction height; // NULL samples `noise`, a heightmap sampler can be used instead
+    void *heightData;
+    TerrainNoise noise;
+} TerrainDesc;
+
+typedef enum {
+    TERRAIN_CHUNK_FREE = 0,
+    TERRAIN_CHUNK_GENERATING,   // Owned by a job worker until `pending` is 0
+    TERRAIN_CHUNK_READY,        // Geometry on the CPU, uploaded by the next DrawTerrain
+    TERRAIN_CHUNK_UPLOADED      // Geometry in the mesh registry only
+} TerrainChunkState;
+
+typedef struct TerrainChunk {
+    int x;                      // Chunk coordinates, the chunk covers [x, x + 1) * chunkSize from the origin
+    int z;
+    TerrainChunkState state;
+    std::atomic<int> pending;   // Generation jobs not finished
+    Mesh mesh;                  // TERRAIN_CHUNK_VERTICES world space vertices, drawn with the shared LOD indices
+    size_t bytes;               // Memory held by the chunk
+    unsigned long long generationNs;
+} TerrainChunk;
+
+typedef struct TerrainStats {
+    int chunksLoaded;           // Chunks generating, generated or uploaded
+    int chunksGenerating;
+    unsigned long long chunksGenerated;
+    unsigned long long chunksEvicted;
+    double generationMs;        // Job time spent generating chunks, summed over every worker
+    size_t memoryUsed;          // Chunk geometry, the shared LOD indices are not counted
+    size_t memoryPeak;
+    size_t indexBytes;          // Shared LOD indices, once on the CPU and once on the GPU
+    int chunksDrawn;            // Last DrawTerrain
+    int chunksCulled;
+    int trianglesDrawn;         // Degenerate seam triangles are dropped when the indices are built
+    int chunksPerLod[TERRAIN_MAX_LODS];
+} TerrainStats;
+
+// Streaming chunked terrain. Chunks are placed in a ring buffer of (2 * viewChunks + 1)^2 slots around the camera chunk,
+// generated on the job workers and paged out when they leave the view or the memory budget.
+// Every chunk has the full resolution vertex grid: LODs only pick other indices from TERRAIN_MAX_LODS * TERRAIN_SEAM_MASKS
+// index ranges shared by every chunk. Edges next to a coarser chunk snap their odd vertices to the even ones so no crack opens.
+typedef struct ChunkedTerrain {
+    TerrainDesc desc;
+    JobSystem *jobs;            // NULL generates on the calling thread
+
+    TerrainChunk *slots;        // windowSize * windowSize, chunk (x, z) lives in slot (x mod windowSize, z mod windowSize)
+    int windowSize;
+    glm::ivec2 *loadOrder;      // Offsets (dx, dz) from the camera chunk covering every slot, nearest first
+    int loadOrderCount;
+    int budgetChunks;           // Nearest chunks that fit the memory budget, MAX_STATIC_MESHES at most
+    int cameraX;                // Chunk of the last UpdateTerrain
+    int cameraZ;
+
+    int *lodIndices;            // Every (LOD, seam mask) index range, back to back
+    int lodFirstIndex[TERRAIN_MAX_LODS][TERRAIN_SEAM_MASKS];
+    int lodIndicesCount[TERRAIN_MAX_LODS][TERRAIN_SEAM_MASKS];
+    int lodIndicesTotal;
+    IndexBuffer indexBuffer;    // GPU copy of lodIndices, uploaded by the first DrawTerrain
+
+    TerrainStats stats;
+} ChunkedTerrain;
+
+TerrainDesc GetDefaultTerrainDesc();
+float SampleTerrainNoise(float x, float z, void *noise); // TerrainHeightFunction over a TerrainNoise
+
+ChunkedTerrain *CreateChunkedTerrain(const TerrainDesc *desc, JobSystem *jobs);
+void DestroyChunkedTerrain(ChunkedTerrain *terrain); // Waits for the generation jobs, GL thread if DrawTerrain was used
+
+// Pages chunks in and out around `cameraPosition` and queues the generation of missing ones. No GL calls, except
+// unloading chunks DrawTerrain uploaded: call it on the thread drawing the terrain.
+void UpdateTerrain(ChunkedTerrain *terrain, const glm::vec3 &cameraPosition);
+// Uploads generated chunks, picks their LOD and seams and draws the ones in the frustum, GL thread only
+void DrawTerrain(ChunkedTerrain *terrain, const Frustum *frustum);
+TerrainStats GetTerrainStats(ChunkedTerrain *terrain);
+
+#endif // CGAME_ENGINE_TERRAIN_H
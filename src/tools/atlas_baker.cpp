@@ -0,0 +1,172 @@
+// Offline atlas baker from TGA images to the atlas format, see atlas.h
+//
+//   cgame_atlas_baker [-s pageSize] [-p padding] <image.tga>... <output.cgta>
+//
+// Every image becomes one region named after its file (without directory and extension). Supported: uncompressed
+// and RLE true-color TGA, 24 or 32 bits, either origin. Images are packed tallest first, which keeps the skyline flat.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#define COD3R_GL_IMPLEMENTATION
+#define COD3R_GL_STANDALONE
+#include "../cod3rGL.h"
+#include "../atlas.h"
+
+#define BAKER_DEFAULT_PAGE_SIZE 1024
+#define BAKER_DEFAULT_PADDING 1
+#define BAKER_MAX_PAGES 256 // GL_MAX_ARRAY_TEXTURE_LAYERS is at least 256 on GL 4.1
+
+typedef struct TgaImage {
+    std::string name;
+    int width;
+    int height;
+    std::vector<unsigned char> rgba; // Top row first
+} TgaImage;
+
+static std::string GetImageName(const char *fileName) {
+    std::string name = fileName;
+
+    const size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos) name = name.substr(slash + 1);
+
+    const size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) name = name.substr(0, dot);
+
+    return name;
+}
+
+static bool LoadTgaImage(TgaImage *image, const char *fileName) {
+    FILE *file = fopen(fileName, "rb");
+
+    if (file == NULL) {
+        printf("%s could not be opened\n", fileName);
+        return false;
+    }
+
+    unsigned char header[18];
+    bool valid = fread(header, sizeof(header), 1, file) == 1;
+
+    const int idLength = header[0];
+    const int colorMapType = header[1];
+    const int imageType = header[2];
+    const int width = header[12] | (header[13] << 8);
+    const int height = header[14] | (header[15] << 8);
+    const int bytesPerPixel = header[16] / 8;
+    const bool topOrigin = (header[17] & 0x20) != 0;
+    const bool rle = imageType == 10;
+
+    if (!valid || colorMapType != 0 || (imageType != 2 && imageType != 10) || (bytesPerPixel != 3 && bytesPerPixel != 4) ||
+        width == 0 || height == 0) {
+        printf("%s is not an uncompressed or RLE true-color TGA (24 or 32 bits)\n", fileName);
+        fclose(file);
+        return false;
+    }
+
+    fseek(file, idLength, SEEK_CUR);
+
+    // Pixels in file order, BGR(A)
+    std::vector<unsigned char> bgra((size_t)width * height * 4);
+    const size_t pixelCount = (size_t)width * height;
+    unsigned char pixel[4] = { 0, 0, 0, 0xff };
+
+    for (size_t i = 0; i < pixelCount && valid; ) {
+        int run = 1;
+        bool repeat = false;
+
+        if (rle) {
+            const int packet = fgetc(file);
+            valid = packet != EOF;
+            run = (packet & 0x7f) + 1;
+            repeat = (packet & 0x80) != 0;
+        }
+
+        for (int p = 0; p < run && i < pixelCount && valid; p++, i++) {
+            if (p == 0 || !repeat) valid = fread(pixel, bytesPerPixel, 1, file) == 1;
+            memcpy(&bgra[i * 4], pixel, 4);
+        }
+    }
+
+    fclose(file);
+
+    if (!valid) {
+        printf("%s is truncated\n", fileName);
+        return false;
+    }
+
+    image->name = GetImageName(fileName);
+    image->width = width;
+    image->height = height;
+    image->rgba.resize(pixelCount * 4);
+
+    for (int row = 0; row < height; row++) {
+        const int srcRow = topOrigin ? row : height - 1 - row;
+
+        for (int column = 0; column < width; column++) {
+            const unsigned char *src = &bgra[((size_t)srcRow * width + column) * 4];
+            unsigned char *dst = &image->rgba[((size_t)row * width + column) * 4];
+
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = bytesPerPixel == 4 ? src[3] : 0xff;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int pageSize = BAKER_DEFAULT_PAGE_SIZE;
+    int padding = BAKER_DEFAULT_PADDING;
+    int first = 1;
+
+    while (first + 1 < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-s") == 0) pageSize = atoi(argv[first + 1]);
+        else if (strcmp(argv[first], "-p") == 0) padding = atoi(argv[first + 1]);
+        else break;
+
+        first += 2;
+    }
+
+    if (argc - first < 2 || argv[first][0] == '-') {
+        printf("usage: %s [-s pageSize] [-p padding] <image.tga>... <output.cgta>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<TgaImage> images(argc - 1 - first);
+
+    for (int i = first; i < argc - 1; i++) {
+        if (!LoadTgaImage(&images[i - first], argv[i])) return 1;
+    }
+
+    std::stable_sort(images.begin(), images.end(), [](const TgaImage &a, const TgaImage &b) {
+        return a.height != b.height ? a.height > b.height : a.width > b.width;
+    });
+
+    TextureAtlas *atlas = CreateTextureAtlas(pageSize, BAKER_MAX_PAGES, padding);
+    if (atlas == NULL) return 1;
+
+    for (size_t i = 0; i < images.size(); i++) {
+        if (images[i].name.size() >= ATLAS_NAME_LENGTH) {
+            printf("%s: name longer than %i characters\n", images[i].name.c_str(), ATLAS_NAME_LENGTH - 1);
+            DestroyTextureAtlas(atlas);
+            return 1;
+        }
+
+        if (AddAtlasImage(atlas, images[i].name.c_str(), images[i].rgba.data(), images[i].width, images[i].height) == -1) {
+            DestroyTextureAtlas(atlas);
+            return 1;
+        }
+    }
+
+    const bool written = WriteAtlasFile(atlas, argv[argc - 1]);
+
+    if (written) {
+        printf("%s: %i images, %i pages of %i texels, %.1f%% occupied\n", argv[argc - 1], atlas->regionCount,
+               atlas->pageCount, atlas->pageSize, GetAtlasOccupancy(atlas) * 100.0);
+    }
+
+    DestroyTextureAtlas(atlas);
+    return written ? 0 : 1;
+}
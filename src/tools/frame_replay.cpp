@@ -0,0 +1,91 @@
+// Offline replay of a frame captured with CaptureNextFrame (F10 in the game)
+//
+//   cgame_frame_replay <capture.cgfc> [--null] [--runs N]
+//
+// Replays the captured command buffer N times (10 by default) on an offscreen EGL context, or with --null on the null
+// backend (no GL calls, the submission cost alone). Run it from the repository root, the shaders are loaded from
+// src/shaders.
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#define COD3R_GL_IMPLEMENTATION
+#define COD3R_GL_STANDALONE
+#include "../cod3rGL.h"
+#include "../headless_gl.h"
+
+#define REPLAY_TARGET_SIZE 256
+
+static double NowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s <capture.cgfc> [--null] [--runs N]\n", argv[0]);
+        return 1;
+    }
+
+    CommandBackend backend = COMMAND_BACKEND_GL;
+    int runs = 10;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--null") == 0) backend = COMMAND_BACKEND_NULL;
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = std::max(1, atoi(argv[++i]));
+    }
+
+    FrameCapture *capture = LoadFrameCapture(argv[1]);
+    if (capture == NULL) return 1;
+
+    HeadlessContext *headless = NULL;
+
+    if (backend == COMMAND_BACKEND_GL) {
+        headless = CreateHeadlessContext(REPLAY_TARGET_SIZE);
+
+        if (headless == NULL) {
+            FreeFrameCapture(capture);
+            return 1;
+        }
+
+        SetShaderCacheDir(NULL);
+        InitCod3rGLEx(REPLAY_TARGET_SIZE, REPLAY_TARGET_SIZE, capture->header.batchVertices);
+
+        if (!PrepareFrameCapture(capture)) {
+            FreeFrameCapture(capture);
+            CleanCod3rGL();
+            DestroyHeadlessContext(headless);
+            return 1;
+        }
+    }
+
+    std::vector<double> times(runs);
+    RenderStats stats = { 0 };
+
+    for (int run = 0; run < runs; run++) {
+        const double start = NowMs();
+
+        if (backend == COMMAND_BACKEND_GL) glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        stats = ReplayFrameCapture(capture, backend);
+        if (backend == COMMAND_BACKEND_GL) glFinish();
+
+        times[run] = NowMs() - start;
+    }
+
+    std::sort(times.begin(), times.end());
+
+    printf("%s: %i commands, %i resources, %.1f KB of payload\n", argv[1], capture->header.commandCount,
+           capture->header.resourceCount, capture->header.dataSize / 1024.0);
+    printf("%i draw calls, %lld vertices, %.2f MB uploaded, %.1f KB of uniforms, %i state calls issued, %i skipped\n", stats.drawCalls,
+           stats.verticesDrawn, stats.bytesUploaded / (1024.0 * 1024.0), stats.uniformBytes / 1024.0, stats.stateCallsIssued, stats.stateCallsSkipped);
+    printf("%s backend, %i runs: %.3f ms min, %.3f ms median, %.3f ms max\n", backend == COMMAND_BACKEND_GL ? "GL" : "Null",
+           runs, times[0], times[runs / 2], times[runs - 1]);
+
+    FreeFrameCapture(capture);
+
+    if (headless != NULL) {
+        CleanCod3rGL();
+        DestroyHeadlessContext(headless);
+    }
+
+    return 0;
+}
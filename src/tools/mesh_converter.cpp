@@ -0,0 +1,212 @@
+// Offline converter from Wavefront OBJ to the mesh asset format, see asset.h
+//
+//   cgame_mesh_converter <input.obj>... <output.cga>
+//
+// Every `o` / `g` of every input becomes one mesh named after it (the file name when there is none).
+// Supported: `v x y z [r g b]`, `vt u v`, `f` with v, v/vt, v//vn and v/vt/vn corners, negative indices and polygons
+// (fan triangulated). Normals and materials are ignored, the engine vertex has no room for them.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#define COD3R_GL_IMPLEMENTATION
+#define COD3R_GL_STANDALONE
+#include "../cod3rGL.h"
+#include "../asset.h"
+
+typedef struct ObjMesh {
+    std::string name;
+    std::vector<float> vertices;
+    std::vector<float> colors;
+    std::vector<float> texcoords;
+    std::vector<int> indices;
+    std::unordered_map<unsigned long long, int> corners; // (position, texcoord) pair to mesh vertex
+} ObjMesh;
+
+typedef struct ObjFile {
+    std::vector<float> positions; // XYZ
+    std::vector<float> colors;    // RGB, white when the file has no vertex colors
+    std::vector<float> texcoords; // UV
+    std::vector<ObjMesh> meshes;
+} ObjFile;
+
+// 1-based or negative (relative to the end) OBJ index to a 0-based one, -1 when out of range
+static int ResolveObjIndex(long index, size_t count) {
+    if (index > 0 && (size_t)index <= count) return (int)(index - 1);
+    if (index < 0 && (size_t)-index <= count) return (int)(count + index);
+    return -1;
+}
+
+static int AddObjCorner(ObjFile *obj, ObjMesh *mesh, int position, int texcoord) {
+    const unsigned long long key = ((unsigned long long)(unsigned int)position << 32) | (unsigned int)(texcoord + 1);
+    auto found = mesh->corners.find(key);
+
+    if (found != mesh->corners.end()) return found->second;
+
+    const int vertex = (int)(mesh->vertices.size() / 3);
+    mesh->corners[key] = vertex;
+
+    for (int i = 0; i < 3; i++) {
+        mesh->vertices.push_back(obj->positions[position * 3 + i]);
+        mesh->colors.push_back(obj->colors[position * 3 + i]);
+    }
+    mesh->colors.push_back(1.0f);
+
+    // OBJ has v going up, the engine textures have it going down
+    mesh->texcoords.push_back(texcoord >= 0 ? obj->texcoords[texcoord * 2] : 0.0f);
+    mesh->texcoords.push_back(texcoord >= 0 ? 1.0f - obj->texcoords[texcoord * 2 + 1] : 0.0f);
+
+    return vertex;
+}
+
+// Reads the corners of an `f` line, returns false on a malformed one
+static bool ParseObjFace(ObjFile *obj, ObjMesh *mesh, const char *line) {
+    std::vector<int> face;
+    char *cursor = (char *)line;
+
+    for (;;) {
+        while (*cursor == ' ' || *cursor == '\t') cursor++;
+        if (*cursor == '\0' || *cursor == '\n' || *cursor == '\r') break;
+
+        char *end;
+        const int position = ResolveObjIndex(strtol(cursor, &end, 10), obj->positions.size() / 3);
+        int texcoord = -1;
+
+        if (end == cursor || position == -1) return false;
+        cursor = end;
+
+        if (*cursor == '/') {
+            cursor++;
+
+            if (*cursor != '/') {
+                texcoord = ResolveObjIndex(strtol(cursor, &end, 10), obj->texcoords.size() / 2);
+                if (end == cursor || texcoord == -1) return false;
+                cursor = end;
+            }
+
+            // Normal, skipped
+            if (*cursor == '/') {
+                cursor++;
+                strtol(cursor, &end, 10);
+                cursor = end;
+            }
+        }
+
+        face.push_back(AddObjCorner(obj, mesh, position, texcoord));
+    }
+
+    if (face.size() < 3) return false;
+
+    for (size_t i = 1; i + 1 < face.size(); i++) {
+        mesh->indices.push_back(face[0]);
+        mesh->indices.push_back(face[i]);
+        mesh->indices.push_back(face[i + 1]);
+    }
+
+    return true;
+}
+
+static bool LoadObjFile(ObjFile *obj, const char *fileName) {
+    FILE *file = fopen(fileName, "r");
+
+    if (file == NULL) {
+        printf("%s OBJ file could not be opened\n", fileName);
+        return false;
+    }
+
+    // Every file starts its own meshes, they never share vertices
+    std::string baseName = fileName;
+    baseName = baseName.substr(baseName.find_last_of('/') + 1);
+    baseName = baseName.substr(0, baseName.find_last_of('.'));
+
+    obj->positions.clear();
+    obj->colors.clear();
+    obj->texcoords.clear();
+
+    const size_t firstMesh = obj->meshes.size();
+    char line[4096];
+    int lineNumber = 0;
+    bool valid = true;
+
+    obj->meshes.push_back(ObjMesh());
+    obj->meshes.back().name = baseName;
+
+    while (valid && fgets(line, sizeof(line), file) != NULL) {
+        float x, y, z, r, g, b;
+        char name[ASSET_NAME_LENGTH];
+        lineNumber++;
+
+        if (strncmp(line, "v ", 2) == 0) {
+            int count = sscanf(line + 2, "%f %f %f %f %f %f", &x, &y, &z, &r, &g, &b);
+
+            if (count < 3) valid = false;
+            if (count < 6) r = g = b = 1.0f;
+
+            obj->positions.insert(obj->positions.end(), { x, y, z });
+            obj->colors.insert(obj->colors.end(), { r, g, b });
+        } else if (strncmp(line, "vt ", 3) == 0) {
+            if (sscanf(line + 3, "%f %f", &x, &y) != 2) valid = false;
+
+            obj->texcoords.insert(obj->texcoords.end(), { x, y });
+        } else if (strncmp(line, "f ", 2) == 0) {
+            valid = ParseObjFace(obj, &obj->meshes.back(), line + 2);
+        } else if (strncmp(line, "o ", 2) == 0 || strncmp(line, "g ", 2) == 0) {
+            if (sscanf(line + 2, "%47s", name) != 1) continue;
+
+            // Faces before the first object keep the file name
+            if (!obj->meshes.back().indices.empty()) obj->meshes.push_back(ObjMesh());
+            obj->meshes.back().name = name;
+        }
+    }
+
+    fclose(file);
+
+    if (!valid) {
+        printf("%s:%i: malformed OBJ line\n", fileName, lineNumber);
+        return false;
+    }
+
+    if (obj->meshes.back().indices.empty()) obj->meshes.pop_back();
+    if (obj->meshes.size() == firstMesh) printf("%s: no faces\n", fileName);
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("usage: %s <input.obj>... <output.cga>\n", argv[0]);
+        return 1;
+    }
+
+    ObjFile obj;
+
+    for (int i = 1; i < argc - 1; i++) {
+        if (!LoadObjFile(&obj, argv[i])) return 1;
+    }
+
+    std::vector<Mesh> meshes(obj.meshes.size());
+    std::vector<const char *> names(obj.meshes.size());
+    size_t vertexCount = 0;
+
+    for (size_t i = 0; i < obj.meshes.size(); i++) {
+        ObjMesh *source = &obj.meshes[i];
+        Mesh *mesh = &meshes[i];
+
+        *mesh = { 0 };
+        mesh->vertexCount = (int)source->vertices.size();
+        mesh->indicesCount = (int)source->indices.size();
+        mesh->triangleCount = mesh->indicesCount / 3;
+        mesh->vertices = source->vertices.data();
+        mesh->colors = source->colors.data();
+        mesh->texcoords = source->texcoords.data();
+        mesh->indices = source->indices.data();
+
+        names[i] = source->name.c_str();
+        vertexCount += mesh->vertexCount / 3;
+    }
+
+    if (!WriteAssetFile(argv[argc - 1], meshes.data(), names.data(), (int)meshes.size())) return 1;
+
+    printf("%s: %zu meshes, %zu vertices\n", argv[argc - 1], meshes.size(), vertexCount);
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include "transform.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <glm/ext.hpp>
+
+TransformHierarchy *CreateTransformHierarchy() {
+    return (TransformHierarchy *)calloc(1, sizeof(TransformHierarchy));
+}
+
+void DestroyTransformHierarchy(TransformHierarchy *hierarchy) {
+    free(hierarchy->positions);
+    free(hierarchy->rotations);
+    free(hierarchy->scales);
+    free(hierarchy->parents);
+    free(hierarchy->worlds);
+    free(hierarchy->flags);
+    free(hierarchy->owners);
+    free(hierarchy->slotIds);
+    free(hierarchy->changed);
+    free(hierarchy->idSlots);
+    free(hierarchy->freeIds);
+    free(hierarchy);
+}
+
+static void ReserveTransformSlots(TransformHierarchy *hierarchy, int capacity) {
+    if (capacity <= hierarchy->capacity) return;
+
+    hierarchy->capacity = hierarchy->capacity == 0 ? 256 : hierarchy->capacity;
+    while (hierarchy->capacity < capacity) hierarchy->capacity *= 2;
+
+    int n = hierarchy->capacity;
+    hierarchy->positions = (glm::vec3 *)realloc(hierarchy->positions, n * sizeof(glm::vec3));
+    hierarchy->rotations = (glm::quat *)realloc(hierarchy->rotations, n * sizeof(glm::quat));
+    hierarchy->scales = (glm::vec3 *)realloc(hierarchy->scales, n * sizeof(glm::vec3));
+    hierarchy->parents = (int *)realloc(hierarchy->parents, n * sizeof(int));
+    hierarchy->worlds = (glm::mat4 *)realloc(hierarchy->worlds, n * sizeof(glm::mat4));
+    hierarchy->flags = (unsigned char *)realloc(hierarchy->flags, n * sizeof(unsigned char));
+    hierarchy->owners = (int *)realloc(hierarchy->owners, n * sizeof(int));
+    hierarchy->slotIds = (int *)realloc(hierarchy->slotIds, n * sizeof(int));
+    hierarchy->changed = (int *)realloc(hierarchy->changed, n * sizeof(int));
+}
+
+static int GetTransformSlot(TransformHierarchy *hierarchy, TransformId id) {
+    if (id < 0 || id >= hierarchy->idCount) return -1;
+
+    return hierarchy->idSlots[id];
+}
+
+static void MarkTransformDirty(TransformHierarchy *hierarchy, int slot) {
+    hierarchy->flags[slot] |= TRANSFORM_FLAG_DIRTY;
+    if (slot < hierarchy->firstDirty) hierarchy->firstDirty = slot;
+}
+
+TransformId CreateTransform(TransformHierarchy *hierarchy, TransformId parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale) {
+    TransformId id;
+
+    if (hierarchy->freeIdCount > 0) {
+        id = hierarchy->freeIds[--hierarchy->freeIdCount];
+    } else {
+        if (hierarchy->idCount == hierarchy->idCapacity) {
+            hierarchy->idCapacity = hierarchy->idCapacity == 0 ? 256 : hierarchy->idCapacity * 2;
+            hierarchy->idSlots = (int *)realloc(hierarchy->idSlots, hierarchy->idCapacity * sizeof(int));
+            hierarchy->freeIds = (int *)realloc(hierarchy->freeIds, hierarchy->idCapacity * sizeof(int));
+        }
+        id = hierarchy->idCount++;
+    }
+
+    // Appending keeps parents before children: the parent already has a slot
+    ReserveTransformSlots(hierarchy, hierarchy->count + 1);
+    int slot = hierarchy->count++;
+
+    hierarchy->positions[slot] = position;
+    hierarchy->rotations[slot] = rotation;
+    hierarchy->scales[slot] = scale;
+    hierarchy->parents[slot] = GetTransformSlot(hierarchy, parent);
+    hierarchy->worlds[slot] = glm::mat4(1.0f);
+    hierarchy->flags[slot] = 0;
+    hierarchy->owners[slot] = -1;
+    hierarchy->slotIds[slot] = id;
+    hierarchy->idSlots[id] = slot;
+
+    MarkTransformDirty(hierarchy, slot);
+
+    return id;
+}
+
+void DestroyTransform(TransformHierarchy *hierarchy, TransformId id) {
+    int slot = GetTransformSlot(hierarchy, id);
+    if (slot < 0) return;
+
+    // Children only live after their parent
+    for (int i = slot + 1; i < hierarchy->count; i++) {
+        if (hierarchy->parents[i] == slot && !(hierarchy->flags[i] & TRANSFORM_FLAG_FREE)) {
+            hierarchy->parents[i] = hierarchy->parents[slot];
+            MarkTransformDirty(hierarchy, i);
+        }
+    }
+
+    hierarchy->flags[slot] = TRANSFORM_FLAG_FREE;
+    hierarchy->parents[slot] = -1;
+    hierarchy->owners[slot] = -1;
+    hierarchy->idSlots[id] = -1;
+    hierarchy->freeIds[hierarchy->freeIdCount++] = id;
+    hierarchy->freeSlotCount++;
+}
+
+bool SetTransformParent(TransformHierarchy *hierarchy, TransformId id, TransformId parent) {
+    int slot = GetTransformSlot(hierarchy, id);
+    int parentSlot = GetTransformSlot(hierarchy, parent);
+
+    if (slot < 0) return false;
+
+    for (int ancestor = parentSlot; ancestor >= 0; ancestor = hierarchy->parents[ancestor]) {
+        if (ancestor == slot) {
+            printf("[Transform ID: %i] Parent %i would create a cycle\n", id, parent);
+            return false;
+        }
+    }
+
+    hierarchy->parents[slot] = parentSlot;
+    if (parentSlot > slot) hierarchy->orderDirty = true;
+
+    MarkTransformDirty(hierarchy, slot);
+
+    return true;
+}
+
+void SetTransformLocal(TransformHierarchy *hierarchy, TransformId id, glm::vec3 position, glm::quat rotation, glm::vec3 scale) {
+    int slot = GetTransformSlot(hierarchy, id);
+    if (slot < 0) return;
+
+    hierarchy->positions[slot] = position;
+    hierarchy->rotations[slot] = rotation;
+    hierarchy->scales[slot] = scale;
+    MarkTransformDirty(hierarchy, slot);
+}
+
+void SetTransformPosition(TransformHierarchy *hierarchy, TransformId id, glm::vec3 position) {
+    int slot = GetTransformSlot(hierarchy, id);
+    if (slot < 0) return;
+
+    hierarchy->positions[slot] = position;
+    MarkTransformDirty(hierarchy, slot);
+}
+
+void RotateTransformZ(TransformHierarchy *hierarchy, TransformId id, float angle) {
+    int slot = GetTransformSlot(hierarchy, id);
+    if (slot < 0) return;
+
+    // Normalising keeps the rotation from drifting, the matrix is rebuilt from TRS every time
+    glm::quat rotation = hierarchy->rotations[slot] * glm::angleAxis(glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
+    hierarchy->rotations[slot] = glm::normalize(rotation);
+    MarkTransformDirty(hierarchy, slot);
+}
+
+void SetTransformOwner(TransformHierarchy *hierarchy, TransformId id, int owner) {
+    int slot = GetTransformSlot(hierarchy, id);
+    if (slot >= 0) hierarchy->owners[slot] = owner;
+}
+
+// Sorts live slots by depth (breadth-first order) and drops free slots
+static void ReorderTransformHierarchy(TransformHierarchy *hierarchy) {
+    const int count = hierarchy->count;
+    int *depths = (int *)malloc((count + 1) * sizeof(int));
+    int *depthStarts = (int *)calloc(count + 2, sizeof(int));
+    int *newSlots = (int *)malloc((count + 1) * sizeof(int));
+    int maxDepth = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (hierarchy->flags[i] & TRANSFORM_FLAG_FREE) continue;
+
+        int depth = 0;
+        for (int p = hierarchy->parents[i]; p >= 0; p = hierarchy->parents[p]) depth++;
+
+        depths[i] = depth;
+        depthStarts[depth + 1]++;
+        if (depth > maxDepth) maxDepth = depth;
+    }
+
+    for (int d = 1; d <= maxDepth + 1; d++) depthStarts[d] += depthStarts[d - 1];
+
+    for (int i = 0; i < count; i++) {
+        if (hierarchy->flags[i] & TRANSFORM_FLAG_FREE) continue;
+        newSlots[i] = depthStarts[depths[i]]++;
+    }
+
+    const int liveCount = count - hierarchy->freeSlotCount;
+    TransformHierarchy sorted = *hierarchy;
+    sorted.positions = (glm::vec3 *)malloc(hierarchy->capacity * sizeof(glm::vec3));
+    sorted.rotations = (glm::quat *)malloc(hierarchy->capacity * sizeof(glm::quat));
+    sorted.scales = (glm::vec3 *)malloc(hierarchy->capacity * sizeof(glm::vec3));
+    sorted.parents = (int *)malloc(hierarchy->capacity * sizeof(int));
+    sorted.worlds = (glm::mat4 *)malloc(hierarchy->capacity * sizeof(glm::mat4));
+    sorted.flags = (unsigned char *)malloc(hierarchy->capacity * sizeof(unsigned char));
+    sorted.owners = (int *)malloc(hierarchy->capacity * sizeof(int));
+    sorted.slotIds = (int *)malloc(hierarchy->capacity * sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        if (hierarchy->flags[i] & TRANSFORM_FLAG_FREE) continue;
+
+        int slot = newSlots[i];
+        sorted.positions[slot] = hierarchy->positions[i];
+        sorted.rotations[slot] = hierarchy->rotations[i];
+        sorted.scales[slot] = hierarchy->scales[i];
+        sorted.parents[slot] = hierarchy->parents[i] >= 0 ? newSlots[hierarchy->parents[i]] : -1;
+        sorted.worlds[slot] = hierarchy->worlds[i];
+        sorted.flags[slot] = hierarchy->flags[i];
+        sorted.owners[slot] = hierarchy->owners[i];
+        sorted.slotIds[slot] = hierarchy->slotIds[i];
+        hierarchy->idSlots[hierarchy->slotIds[i]] = slot;
+    }
+
+    free(hierarchy->positions);
+    free(hierarchy->rotations);
+    free(hierarchy->scales);
+    free(hierarchy->parents);
+    free(hierarchy->worlds);
+    free(hierarchy->flags);
+    free(hierarchy->owners);
+    free(hierarchy->slotIds);
+
+    *hierarchy = sorted;
+    hierarchy->count = liveCount;
+    hierarchy->freeSlotCount = 0;
+    hierarchy->orderDirty = false;
+    hierarchy->firstDirty = 0; // Dirty slots moved, one full pass finds them again
+
+    free(depths);
+    free(depthStarts);
+    free(newSlots);
+}
+
+void UpdateTransformHierarchy(TransformHierarchy *hierarchy) {
+    for (int i = 0; i < hierarchy->changedCount; i++) {
+        hierarchy->flags[hierarchy->changed[i]] &= ~TRANSFORM_FLAG_CHANGED;
+    }
+    hierarchy->changedCount = 0;
+
+    if (hierarchy->orderDirty || hierarchy->freeSlotCount * 4 > hierarchy->count) {
+        ReorderTransformHierarchy(hierarchy);
+    }
+
+    // Slots before the first dirty one can't be affected: their parents come even earlier
+    for (int i = hierarchy->firstDirty; i < hierarchy->count; i++) {
+        unsigned char flags = hierarchy->flags[i];
+        int parent = hierarchy->parents[i];
+
+        if (flags & TRANSFORM_FLAG_FREE) continue;
+        if (!(flags & TRANSFORM_FLAG_DIRTY) && (parent < 0 || !(hierarchy->flags[parent] & TRANSFORM_FLAG_CHANGED))) continue;
+
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), hierarchy->positions[i]);
+        local = local * glm::mat4_cast(hierarchy->rotations[i]);
+        local = glm::scale(local, hierarchy->scales[i]);
+
+        hierarchy->worlds[i] = parent >= 0 ? hierarchy->worlds[parent] * local : local;
+        hierarchy->flags[i] = (flags & ~TRANSFORM_FLAG_DIRTY) | TRANSFORM_FLAG_CHANGED;
+        hierarchy->changed[hierarchy->changedCount++] = i;
+    }
+
+    hierarchy->firstDirty = hierarchy->count;
+}
+
+const glm::mat4 *GetTransformWorldMatrix(TransformHierarchy *hierarchy, TransformId id) {
+    int slot = GetTransformSlot(hierarchy, id);
+
+    return slot >= 0 ? &hierarchy->worlds[slot] : NULL;
+}
+
+int GetTransformRecomputedCount(TransformHierarchy *hierarchy) {
+    return hierarchy->changedCount;
+}
+
+void DecomposeMatrix(const glm::mat4 &matrix, glm::vec3 *position, glm::quat *rotation, glm::vec3 *scale) {
+    *position = glm::vec3(matrix[3]);
+    *scale = glm::vec3(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])));
+
+    glm::mat3 basis(
+                    glm::vec3(matrix[0]) / scale->x,
+                    glm::vec3(matrix[1]) / scale->y,
+                    glm::vec3(matrix[2]) / scale->z
+                    );
+    *rotation = glm::normalize(glm::quat_cast(basis));
+}
@@ -0,0 +1,63 @@
+#ifndef CGAME_ENGINE_TRANSFORM_H
+#define CGAME_ENGINE_TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#define TRANSFORM_NONE -1
+
+// Transform flags
+#define TRANSFORM_FLAG_DIRTY 1      // Local TRS changed since the last update
+#define TRANSFORM_FLAG_CHANGED 2    // World matrix recomputed by the last update
+#define TRANSFORM_FLAG_FREE 4       // Slot released, compacted by the next reorder
+
+typedef int TransformId; // Stable id, slots move when the hierarchy gets reordered
+
+// Scene graph transforms, stored as arrays indexed by slot. Slots are kept in breadth-first
+// order (parents before children) so one linear pass updates every dirty subtree.
+typedef struct TransformHierarchy {
+    int count;                  // Slots in use, free ones included
+    int capacity;
+
+    glm::vec3 *positions;       // Local TRS
+    glm::quat *rotations;
+    glm::vec3 *scales;
+    int *parents;               // Slot of the parent, -1 for roots
+    glm::mat4 *worlds;          // Cached world matrices
+    unsigned char *flags;
+    int *owners;                // User value of every slot (ECS entity index)
+    int *slotIds;               // Id of every slot
+
+    int *idSlots;               // Slot of every id, -1 when free
+    int idCount;
+    int idCapacity;
+    int *freeIds;
+    int freeIdCount;
+
+    int freeSlotCount;
+    int firstDirty;             // Lowest dirty slot, `count` when nothing is dirty
+    bool orderDirty;            // A parent got placed after its child, reorder on next update
+
+    int *changed;               // Slots recomputed by the last update
+    int changedCount;
+} TransformHierarchy;
+
+TransformHierarchy *CreateTransformHierarchy();
+void DestroyTransformHierarchy(TransformHierarchy *hierarchy);
+
+TransformId CreateTransform(TransformHierarchy *hierarchy, TransformId parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale);
+void DestroyTransform(TransformHierarchy *hierarchy, TransformId id); // Children are attached to the parent of the destroyed node
+bool SetTransformParent(TransformHierarchy *hierarchy, TransformId id, TransformId parent); // False when it would create a cycle
+void SetTransformLocal(TransformHierarchy *hierarchy, TransformId id, glm::vec3 position, glm::quat rotation, glm::vec3 scale);
+void SetTransformPosition(TransformHierarchy *hierarchy, TransformId id, glm::vec3 position);
+void RotateTransformZ(TransformHierarchy *hierarchy, TransformId id, float angle); // Degrees, applied to the local rotation
+void SetTransformOwner(TransformHierarchy *hierarchy, TransformId id, int owner);
+
+// Recomputes the world matrices of dirty subtrees only, nothing is touched when nothing changed
+void UpdateTransformHierarchy(TransformHierarchy *hierarchy);
+const glm::mat4 *GetTransformWorldMatrix(TransformHierarchy *hierarchy, TransformId id); // As of the last update
+int GetTransformRecomputedCount(TransformHierarchy *hierarchy); // World matrices recomputed by the last update
+
+void DecomposeMatrix(const glm::mat4 &matrix, glm::vec3 *position, glm::quat *rotation, glm::vec3 *scale); // No shear or projection
+
+#endif // CGAME_ENGINE_TRANSFORM_H